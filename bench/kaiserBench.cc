@@ -0,0 +1,538 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* @brief Benchmarks of the hot paths of coadd_kaiser
+*
+* Usage: kaiserBench [minSeconds [maxImageSize]]
+*
+* Each benchmark is repeated until it has run for at least minSeconds (default 0.5) and the mean time
+* per iteration is reported. Each benchmark runs in its own child process, so its peak memory use
+* is not hidden by that of earlier benchmarks. Images up to maxImageSize pixels on a side (default 2048) are used.
+* The inputs are synthetic and reproducible: Gaussian noise with a fixed random seed, about 2% of pixels
+* masked BAD and a few columns masked SAT; the PSFs are Gaussians and spatially varying linear combinations
+* of two Gaussians.
+*
+* The output is one tab-separated line per benchmark, preceded by a header line starting with "#":
+* - benchmark: name of the benchmark
+* - variant: kernel type and convolution method, number of images in a stack, or "unmasked" for a median
+*   that ignores the mask, if relevant, else "-"
+* - width, height: size of the image processed (pixels)
+* - kernelSize: width and height of the PSF kernel (pixels); 0 if not relevant
+* - nBins: number of bins for medianBinapprox, medianBinned and medianBinapproxStack; 0 if not relevant
+* - nIter: number of iterations timed
+* - secPerIter: mean wall time per iteration (sec)
+* - pixelsPerSec: width * height / secPerIter
+* - peakRssKB: peak resident set size of the child process that ran the benchmark (kB); this includes
+*   the inputs, which are made before the child is forked
+* - relError: |approximate median - exact median| / exact median, for medianBinapprox and medianBinned;
+*   else 0
+*
+* @file
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "boost/random/mersenne_twister.hpp"
+#include "boost/random/normal_distribution.hpp"
+#include "boost/random/uniform_real.hpp"
+#include "boost/random/variate_generator.hpp"
+
+#include "lsst/afw/image.h"
+#include "lsst/afw/math.h"
+#include "lsst/coadd/kaiser.h"
+
+namespace afwImage = lsst::afw::image;
+namespace afwMath = lsst::afw::math;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    typedef afwImage::MaskedImage<float, afwImage::MaskPixel, afwImage::VariancePixel> MaskedImageF;
+    typedef afwImage::MaskedImage<double, afwImage::MaskPixel, afwImage::VariancePixel> MaskedImageD;
+    typedef afwImage::Exposure<float, afwImage::MaskPixel, afwImage::VariancePixel> ExposureF;
+
+    double const DefaultMinSeconds = 0.5;
+    int const DefaultMaxImageSize = 2048;
+    unsigned int const RandomSeed = 12345;
+    int const ImageSizeList[] = {256, 1024, 2048, 4096};
+    int const NImageSizes = sizeof(ImageSizeList) / sizeof(ImageSizeList[0]);
+    int const KernelSizeList[] = {5, 11, 21, 41};
+    int const NKernelSizes = sizeof(KernelSizeList) / sizeof(KernelSizeList[0]);
+    int const NBinsList[] = {100, 1000, 10000};
+    int const NNBins = sizeof(NBinsList) / sizeof(NBinsList[0]);
+    int const StackDepthList[] = {5, 20, 100};
+    int const NStackDepths = sizeof(StackDepthList) / sizeof(StackDepthList[0]);
+    int const MaxStackHeight = 256;   ///< medianBinapproxStack is timed on blocks of at most this many rows
+
+    /// return the wall time (sec)
+    double getTime() {
+        timeval tv;
+        gettimeofday(&tv, 0);
+        return static_cast<double>(tv.tv_sec) + (1.0e-6 * static_cast<double>(tv.tv_usec));
+    }
+
+    /// return the peak resident set size from a resource usage (kB)
+    long getPeakRssKB(rusage const &usage) {
+#if defined(__APPLE__)
+        return usage.ru_maxrss / 1024;  // bytes on Mac OS X
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+
+    /// print an error message and exit
+    void fail(std::string const &message) {
+        std::cerr << "kaiserBench: " << message << std::endl;
+        std::exit(1);
+    }
+
+    /**
+     * @brief Make a reproducible synthetic masked image
+     *
+     * The image is Gaussian noise (sigma 10), the variance is about 100 and varies from pixel to pixel
+     * so the median is not trivial, about 2% of pixels are masked BAD and every 97th column is masked SAT.
+     */
+    MaskedImageF makeMaskedImage(int width, int height, unsigned int seed = RandomSeed) {
+        boost::mt19937 rng(seed);
+        boost::variate_generator<boost::mt19937&, boost::normal_distribution<double> >
+            normal(rng, boost::normal_distribution<double>(0.0, 10.0));
+        boost::variate_generator<boost::mt19937&, boost::uniform_real<double> >
+            uniform(rng, boost::uniform_real<double>(0.0, 1.0));
+        afwImage::MaskPixel const badMask = afwImage::Mask<afwImage::MaskPixel>::getPlaneBitMask("BAD");
+        afwImage::MaskPixel const satMask = afwImage::Mask<afwImage::MaskPixel>::getPlaneBitMask("SAT");
+
+        MaskedImageF maskedImage(width, height);
+        for (int y = 0; y < height; ++y) {
+            int x = 0;
+            for (MaskedImageF::x_iterator ptr = maskedImage.row_begin(y), end = maskedImage.row_end(y);
+                ptr != end; ++ptr, ++x) {
+                ptr.image() = static_cast<float>(normal());
+                ptr.variance() = static_cast<float>(100.0 * (0.9 + (0.2 * uniform())));
+                ptr.mask() = 0;
+                if (uniform() < 0.02) {
+                    ptr.mask() |= badMask;
+                }
+                if (x % 97 == 0) {
+                    ptr.mask() |= satMask;
+                }
+            }
+        }
+        return maskedImage;
+    }
+
+    /// make a circular Gaussian kernel whose width is about 1/6 of its size
+    afwMath::Kernel::Ptr makeGaussianKernel(int kernelSize) {
+        double const sigma = static_cast<double>(kernelSize) / 6.0;
+        afwMath::GaussianFunction2<afwMath::Kernel::Pixel> gaussFunc(sigma, sigma);
+        return afwMath::Kernel::Ptr(new afwMath::AnalyticKernel(kernelSize, kernelSize, gaussFunc));
+    }
+
+    /// make a kernel that varies linearly in x from one Gaussian to a wider one across the image
+    afwMath::Kernel::Ptr makeVaryingKernel(int kernelSize, int width) {
+        afwMath::KernelList kernelList;
+        double const sigmaList[2] = {static_cast<double>(kernelSize) / 8.0, static_cast<double>(kernelSize) / 5.0};
+        for (int i = 0; i < 2; ++i) {
+            afwMath::GaussianFunction2<afwMath::Kernel::Pixel> gaussFunc(sigmaList[i], sigmaList[i]);
+            kernelList.push_back(afwMath::Kernel::Ptr(new afwMath::AnalyticKernel(kernelSize, kernelSize, gaussFunc)));
+        }
+        afwMath::PolynomialFunction2<double> spatialFunction(1);
+        afwMath::LinearCombinationKernel *kernelPtr = new afwMath::LinearCombinationKernel(kernelList, spatialFunction);
+        afwMath::Kernel::Ptr retPtr(kernelPtr);
+        std::vector<std::vector<double> > spatialParams(2, std::vector<double>(3, 0.0));
+        spatialParams[0][0] = 1.0;
+        spatialParams[0][1] = -1.0 / static_cast<double>(width);
+        spatialParams[1][1] = 1.0 / static_cast<double>(width);
+        kernelPtr->setSpatialParameters(spatialParams);
+        return retPtr;
+    }
+
+    /// return the name of a convolution method
+    std::string getMethodName(coaddKaiser::ConvolutionMethod method) {
+        switch (method) {
+            case coaddKaiser::DIRECT_CONVOLUTION:
+                return "DIRECT";
+            case coaddKaiser::FFT_CONVOLUTION:
+                return "FFT";
+            case coaddKaiser::SEPARABLE_CONVOLUTION:
+                return "SEPARABLE";
+            default:
+                return "AUTO";
+        }
+    }
+
+    /**
+     * @brief Timing and memory use of a benchmark
+     */
+    struct Timing {
+        int nIter;          ///< number of iterations timed
+        double secPerIter;  ///< mean wall time per iteration (sec)
+        long peakRssKB;     ///< peak resident set size of the process that ran the benchmark (kB)
+    };
+
+    /**
+     * @brief Run functor repeatedly in a child process until at least minSeconds have elapsed
+     *
+     * ru_maxrss is a high-water mark over the life of a process, so each benchmark is run in a forked child
+     * and the child's own peak is reported. Anything the functor computes is lost with the child.
+     */
+    template <typename FunctorT>
+    Timing timeFunctor(FunctorT &functor, double minSeconds) {
+        Timing timing;
+        int pipeFds[2];
+        if (pipe(pipeFds) != 0) {
+            fail("cannot create pipe");
+        }
+        std::cout.flush();
+        pid_t const pid = fork();
+        if (pid < 0) {
+            fail("cannot fork");
+        }
+        if (pid == 0) {
+            close(pipeFds[0]);
+            int exitStatus = 0;
+            try {
+                timing.nIter = 0;
+                double const startTime = getTime();
+                double elapsed = 0;
+                do {
+                    functor();
+                    ++timing.nIter;
+                    elapsed = getTime() - startTime;
+                } while (elapsed < minSeconds);
+                timing.secPerIter = elapsed / static_cast<double>(timing.nIter);
+                timing.peakRssKB = 0;
+                if (write(pipeFds[1], &timing, sizeof(timing)) != static_cast<ssize_t>(sizeof(timing))) {
+                    exitStatus = 1;
+                }
+            } catch (std::exception &e) {
+                std::cerr << "kaiserBench: " << e.what() << std::endl;
+                exitStatus = 1;
+            }
+            _exit(exitStatus);
+        }
+        close(pipeFds[1]);
+        ssize_t const nRead = read(pipeFds[0], &timing, sizeof(timing));
+        close(pipeFds[0]);
+        int status = 0;
+        rusage usage;
+        if (wait4(pid, &status, 0, &usage) != pid) {
+            fail("cannot wait for benchmark process");
+        }
+        if ((nRead != static_cast<ssize_t>(sizeof(timing))) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+            fail("benchmark process failed");
+        }
+        timing.peakRssKB = getPeakRssKB(usage);
+        return timing;
+    }
+
+    void printHeader() {
+        std::cout << "#benchmark\tvariant\twidth\theight\tkernelSize\tnBins\tnIter\tsecPerIter"
+            << "\tpixelsPerSec\tpeakRssKB\trelError" << std::endl;
+    }
+
+    void printResult(
+        std::string const &benchmark,
+        std::string const &variant,
+        int width,
+        int height,
+        int kernelSize,
+        int nBins,
+        Timing const &timing,
+        double relError = 0
+    ) {
+        double const pixelsPerSec = static_cast<double>(width) * static_cast<double>(height) / timing.secPerIter;
+        std::cout << benchmark << "\t" << variant << "\t" << width << "\t" << height << "\t"
+            << kernelSize << "\t" << nBins << "\t" << timing.nIter << "\t" << timing.secPerIter << "\t"
+            << pixelsPerSec << "\t" << timing.peakRssKB << "\t" << relError << std::endl;
+    }
+
+    struct ReflectImageFunctor {
+        afwImage::Image<double> &image;
+        explicit ReflectImageFunctor(afwImage::Image<double> &image_) : image(image_) {}
+        void operator()() { coaddKaiser::reflectImage(image); }
+    };
+
+    struct MedianFunctor {
+        MaskedImageF const &maskedImage;
+        int nBins;
+        float median;
+        MedianFunctor(MaskedImageF const &maskedImage_, int nBins_) :
+            maskedImage(maskedImage_), nBins(nBins_), median(0) {}
+        void operator()() {
+            // the same computation as CoaddComponent::computeSigmaSq
+            median = coaddKaiser::medianBinapproxMaskedImage(*maskedImage.getVariance(), *maskedImage.getMask(),
+                ~static_cast<afwImage::MaskPixel>(0), nBins);
+        }
+    };
+
+    struct MedianImageFunctor {
+        afwImage::Image<float> const &image;
+        int nBins;
+        bool useBinned; ///< use medianBinned, else medianBinapprox
+        float median;
+        MedianImageFunctor(afwImage::Image<float> const &image_, int nBins_, bool useBinned_) :
+            image(image_), nBins(nBins_), useBinned(useBinned_), median(0) {}
+        void operator()() {
+            if (useBinned) {
+                median = coaddKaiser::medianBinnedImage(image,
+                    coaddKaiser::MedianBinnedControl(coaddKaiser::BINAPPROX, nBins));
+            } else {
+                median = coaddKaiser::medianBinapproxImage(image, nBins);
+            }
+        }
+    };
+
+    struct MedianStackFunctor {
+        afwImage::Image<float> &medianImage;
+        std::vector<afwImage::Image<float>::Ptr> const &imageList;
+        std::vector<afwImage::Mask<afwImage::MaskPixel>::Ptr> const &maskList;
+        int nBins;
+        MedianStackFunctor(afwImage::Image<float> &medianImage_,
+            std::vector<afwImage::Image<float>::Ptr> const &imageList_,
+            std::vector<afwImage::Mask<afwImage::MaskPixel>::Ptr> const &maskList_, int nBins_) :
+            medianImage(medianImage_), imageList(imageList_), maskList(maskList_), nBins(nBins_) {}
+        void operator()() {
+            coaddKaiser::medianBinapproxStack(medianImage, imageList, maskList,
+                ~static_cast<afwImage::MaskPixel>(0), nBins);
+        }
+    };
+
+    struct DilateMaskFunctor {
+        afwImage::Mask<afwImage::MaskPixel> &outMask;
+        afwImage::Mask<afwImage::MaskPixel> const &inMask;
+        int kernelSize;
+        DilateMaskFunctor(afwImage::Mask<afwImage::MaskPixel> &outMask_,
+            afwImage::Mask<afwImage::MaskPixel> const &inMask_, int kernelSize_) :
+            outMask(outMask_), inMask(inMask_), kernelSize(kernelSize_) {}
+        void operator()() {
+            coaddKaiser::dilateMask(outMask, inMask, kernelSize, kernelSize, kernelSize / 2, kernelSize / 2);
+        }
+    };
+
+    struct BlurredPsfFunctor {
+        afwMath::Kernel const &kernel;
+        explicit BlurredPsfFunctor(afwMath::Kernel const &kernel_) : kernel(kernel_) {}
+        void operator()() { coaddKaiser::computeBlurredPsfImage(kernel, true); }
+    };
+
+    struct BlurredExposureFunctor {
+        MaskedImageD &blurredImage;
+        MaskedImageF const &inImage;
+        afwMath::Kernel const &kernel;
+        coaddKaiser::ConvolutionMethod method;
+        BlurredExposureFunctor(MaskedImageD &blurredImage_, MaskedImageF const &inImage_,
+            afwMath::Kernel const &kernel_, coaddKaiser::ConvolutionMethod method_) :
+            blurredImage(blurredImage_), inImage(inImage_), kernel(kernel_), method(method_) {}
+        void operator()() {
+            // the same computation as CoaddComponent::computeBlurredExposure without PSF tiles
+            coaddKaiser::convolveMaskedImage(blurredImage, inImage, kernel, true, method);
+        }
+    };
+
+    struct CoaddComponentFunctor {
+        ExposureF const &exposure;
+        afwMath::Kernel const &kernel;
+        coaddKaiser::CoaddComponentControl const &control;
+        CoaddComponentFunctor(ExposureF const &exposure_, afwMath::Kernel const &kernel_,
+            coaddKaiser::CoaddComponentControl const &control_) :
+            exposure(exposure_), kernel(kernel_), control(control_) {}
+        void operator()() { coaddKaiser::CoaddComponent<double> coaddComponent(exposure, kernel, true, control); }
+    };
+
+    /// return the exact median of the variance of pixels with no mask bits set
+    double computeExactMedian(MaskedImageF const &maskedImage, bool useMask = true) {
+        std::vector<float> valueList;
+        for (int y = 0; y < maskedImage.getHeight(); ++y) {
+            for (MaskedImageF::x_iterator ptr = maskedImage.row_begin(y), end = maskedImage.row_end(y);
+                ptr != end; ++ptr) {
+                if (!useMask || (ptr.mask() == 0)) {
+                    valueList.push_back(ptr.variance());
+                }
+            }
+        }
+        std::vector<float>::iterator const midPtr = valueList.begin() + (valueList.size() / 2);
+        std::nth_element(valueList.begin(), midPtr, valueList.end());
+        return *midPtr;
+    }
+}
+
+int main(int argc, char **argv) {
+    double minSeconds = DefaultMinSeconds;
+    int maxImageSize = DefaultMaxImageSize;
+    if (argc > 1) {
+        std::istringstream(argv[1]) >> minSeconds;
+    }
+    if (argc > 2) {
+        std::istringstream(argv[2]) >> maxImageSize;
+    }
+    if (argc > 3) {
+        std::cerr << "Usage: kaiserBench [minSeconds [maxImageSize]]" << std::endl;
+        return 1;
+    }
+
+    printHeader();
+
+    // reflectImage is applied to PSF-sized images
+    for (int k = 0; k < NKernelSizes; ++k) {
+        int const size = (2 * KernelSizeList[k]) - 1;
+        afwImage::Image<double> image(size, size, 1.0);
+        ReflectImageFunctor functor(image);
+        Timing const timing = timeFunctor(functor, minSeconds);
+        printResult("reflectImage", "-", size, size, KernelSizeList[k], 0, timing);
+    }
+
+    for (int s = 0; s < NImageSizes; ++s) {
+        int const size = ImageSizeList[s];
+        if (size > maxImageSize) {
+            break;
+        }
+        MaskedImageF const maskedImage = makeMaskedImage(size, size);
+        double const exactMedian = computeExactMedian(maskedImage);
+        double const unmaskedExactMedian = computeExactMedian(maskedImage, false);
+
+        for (int b = 0; b < NNBins; ++b) {
+            MedianFunctor functor(maskedImage, NBinsList[b]);
+            Timing const timing = timeFunctor(functor, minSeconds);
+            functor();  // the median computed while timing was lost with the child process
+            printResult("medianBinapprox", "-", size, size, 0, NBinsList[b], timing,
+                std::fabs(functor.median - exactMedian) / exactMedian);
+        }
+        for (int b = 0; b < NNBins; ++b) {
+            // medianBinned has no mask, so compare it to medianBinapprox of the same unmasked variance
+            for (int useBinned = 0; useBinned < 2; ++useBinned) {
+                MedianImageFunctor functor(*maskedImage.getVariance(), NBinsList[b], useBinned != 0);
+                Timing const timing = timeFunctor(functor, minSeconds);
+                functor();  // the median computed while timing was lost with the child process
+                printResult(useBinned ? "medianBinned" : "medianBinapprox", "unmasked", size, size, 0,
+                    NBinsList[b], timing,
+                    std::fabs(functor.median - unmaskedExactMedian) / unmaskedExactMedian);
+            }
+        }
+        {
+            MedianFunctor functor(maskedImage, 1000);   // the default used by CoaddComponent
+            Timing const timing = timeFunctor(functor, minSeconds);
+            functor();  // the median computed while timing was lost with the child process
+            printResult("computeSigmaSq", "-", size, size, 0, 1000, timing,
+                std::fabs(functor.median - exactMedian) / exactMedian);
+        }
+        {
+            // a stack of independent images, one block of rows at a time as a coadd would be processed
+            int const stackHeight = std::min(size, MaxStackHeight);
+            std::vector<afwImage::Image<float>::Ptr> imageList;
+            std::vector<afwImage::Mask<afwImage::MaskPixel>::Ptr> maskList;
+            afwImage::Image<float> medianImage(size, stackHeight);
+            for (int d = 0; d < NStackDepths; ++d) {
+                int const depth = StackDepthList[d];
+                while (static_cast<int>(imageList.size()) < depth) {
+                    MaskedImageF const stackMI = makeMaskedImage(size, stackHeight,
+                        RandomSeed + 1 + static_cast<unsigned int>(imageList.size()));
+                    imageList.push_back(stackMI.getImage());
+                    maskList.push_back(stackMI.getMask());
+                }
+                std::vector<afwImage::Image<float>::Ptr> const depthImageList(
+                    imageList.begin(), imageList.begin() + depth);
+                std::vector<afwImage::Mask<afwImage::MaskPixel>::Ptr> const depthMaskList(
+                    maskList.begin(), maskList.begin() + depth);
+                MedianStackFunctor functor(medianImage, depthImageList, depthMaskList, 1000);
+                Timing const timing = timeFunctor(functor, minSeconds);
+                std::ostringstream variant;
+                variant << "n=" << depth;
+                printResult("medianBinapproxStack", variant.str(), size, stackHeight, 0, 1000, timing);
+            }
+        }
+        {
+            afwImage::Mask<afwImage::MaskPixel> dilatedMask(size, size);
+            for (int k = 0; k < NKernelSizes; ++k) {
+                DilateMaskFunctor functor(dilatedMask, *maskedImage.getMask(), KernelSizeList[k]);
+                Timing const timing = timeFunctor(functor, minSeconds);
+                printResult("dilateMask", "-", size, size, KernelSizeList[k], 0, timing);
+            }
+        }
+
+        ExposureF exposure(const_cast<MaskedImageF &>(maskedImage));
+        MaskedImageD blurredImage(size, size);
+        for (int k = 0; k < NKernelSizes; ++k) {
+            int const kernelSize = KernelSizeList[k];
+            afwMath::Kernel::Ptr kernelList[2] = {
+                makeGaussianKernel(kernelSize),
+                makeVaryingKernel(kernelSize, size)
+            };
+            std::string const kernelNameList[2] = {"gaussian", "varying"};
+            for (int kt = 0; kt < 2; ++kt) {
+                afwMath::Kernel const &kernel = *kernelList[kt];
+                if (s == 0) {
+                    // the blurred PSF does not depend on the image size
+                    BlurredPsfFunctor functor(kernel);
+                    Timing const timing = timeFunctor(functor, minSeconds);
+                    int const psfSize = (2 * kernelSize) - 1;
+                    printResult("computeBlurredPsf", kernelNameList[kt], psfSize, psfSize, kernelSize, 0,
+                        timing);
+                }
+
+                std::vector<coaddKaiser::ConvolutionMethod> methodList;
+                methodList.push_back(coaddKaiser::AUTO_CONVOLUTION);
+                methodList.push_back(coaddKaiser::FFT_CONVOLUTION);
+                if (kernelSize <= 11) {
+                    // direct convolution with large kernels is too slow to be worth timing
+                    methodList.push_back(coaddKaiser::DIRECT_CONVOLUTION);
+                }
+                if (!kernel.isSpatiallyVarying()) {
+                    methodList.push_back(coaddKaiser::SEPARABLE_CONVOLUTION);
+                }
+                for (std::vector<coaddKaiser::ConvolutionMethod>::const_iterator methodIter = methodList.begin();
+                    methodIter != methodList.end(); ++methodIter) {
+                    std::string variant = kernelNameList[kt] + "/" + getMethodName(*methodIter);
+                    if (*methodIter == coaddKaiser::AUTO_CONVOLUTION) {
+                        variant += "=" + getMethodName(coaddKaiser::chooseConvolutionMethod(size, size, kernel));
+                    }
+                    BlurredExposureFunctor functor(blurredImage, maskedImage, kernel, *methodIter);
+                    Timing const timing = timeFunctor(functor, minSeconds);
+                    printResult("computeBlurredExposure", variant, size, size, kernelSize, 0, timing);
+                }
+
+                coaddKaiser::CoaddComponentControl control;
+                if (kernel.isSpatiallyVarying()) {
+                    control.setNPsfTiles(4, 4);
+                }
+                CoaddComponentFunctor functor(exposure, kernel, control);
+                Timing const timing = timeFunctor(functor, minSeconds);
+                printResult("CoaddComponent", kernelNameList[kt] + (kernel.isSpatiallyVarying() ? "/tiles" : ""),
+                    size, size, kernelSize, 0, timing);
+            }
+        }
+    }
+    return 0;
+}
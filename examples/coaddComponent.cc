@@ -29,6 +29,7 @@
 
 int main(int argc, char **argv) {
     typedef float Pixel;
+    typedef double CoaddPixel; // pixel type of blurred exposure: float or double
     const double DefFwhm = 3.0;
     
     lsst::pex::logging::Trace::setDestination(std::cout);
@@ -55,7 +56,7 @@ int main(int argc, char **argv) {
         lsst::afw::math::DoubleGaussianFunction2<double> psfFunc(sigma, sigma*10.0, 0.1);
         int kSize = 2 * static_cast<int>(fwhm + 0.5) + 1;
         lsst::afw::math::AnalyticKernel psfKernel(kSize, kSize, psfFunc);
-        lsst::coadd::kaiser::CoaddComponent(scienceExposure, psfKernel);
+        lsst::coadd::kaiser::CoaddComponent<CoaddPixel>(scienceExposure, psfKernel);
         
         std::cout << "Got CoaddComponent" << std::endl;
     }
@@ -37,6 +37,7 @@ On my Mac
 python examples/makeBlurredCoadd.py testTemplate examples/imagesToCoadd.txt
 """
 import os
+import shutil
 import sys
 import math
 import numpy
@@ -60,34 +61,9 @@ DefPolicyPath = os.path.join(BaseDir, "makeBlurredCoadd_policy.paf")
 
 RadPerDeg = math.pi / 180.0
 
-DefSaveImages = False
 # names of mask planes permitted in the coadd
 AcceptableMaskPlaneList = ("SAT", "INTRP")
 
-BackgroundCells = 256
-
-def subtractBackground(maskedImage, doDisplay = False):
-    """Subtract the background from a MaskedImage
-    
-    Note: at present the mask and variance are ignored, but they might used be someday.
-    
-    Returns the background object returned by afwMath.makeBackground.
-    """
-    if doDisplay:
-        ds9.mtv(maskedImage)
-    bkgControl = afwMath.BackgroundControl(afwMath.NATURAL_SPLINE)
-    bkgControl.setNxSample(int(maskedImage.getWidth() // BackgroundCells) + 1)
-    bkgControl.setNySample(int(maskedImage.getHeight() // BackgroundCells) + 1)
-    bkgControl.sctrl.setNumSigmaClip(3)
-    bkgControl.sctrl.setNumIter(3)
-
-    image = maskedImage.getImage()
-    bkgObj = afwMath.makeBackground(image, bkgControl)
-    image -= bkgObj.getImageF()
-    if doDisplay:
-        ds9.mtv(image)
-    return bkgObj
-
 def unpersistPsf(xmlPath):
     """Read a PSF from an XML file"""
     # Set up persistence object
@@ -111,22 +87,75 @@ def unpersistPsf(xmlPath):
     return psf
     
 
+def loadPsfKernel(psfPath, normalizePsf, usePsfTiles):
+    """Read a PSF from an XML file and return its kernel, made a FixedKernel if it must be normalized"""
+    psfModel = unpersistPsf(psfPath)
+    psfKernel = psfModel.getKernel()
+    if normalizePsf and not usePsfTiles \
+        and afwMath.LinearCombinationKernel.swigConvert(psfKernel) != None:
+        # psf kernel is a LinearCombinationKernel; convert to a FixedKernel
+        if psfKernel.isSpatiallyVarying():
+            print """Warning: ignoring spatial variation of psf: normalizePsf is True,
+but psf kernel is a spatially varying LinearCombinationKernel,
+which cannot be normalized unless PSF tiles are used (see nPsfTilesX, nPsfTilesY)."""
+        psfImage = afwImage.ImageD(psfKernel.getWidth(), psfKernel.getHeight())
+        xCtrInd = (psfKernel.getWidth() - 1) / 2.0
+        yCtrInd = (psfKernel.getHeight() - 1) / 2.0
+#       note: use indexToPosition once a floating point version is available -- ticket #845
+#         xCtrPos = afwImage.indexToPosition(xCtrInd)
+#         yCtrPos = afwImage.indexToPosition(yCtrInd)
+        xCtrPos = afwImage.PixelZeroPos + xCtrInd
+        yCtrPos = afwImage.PixelZeroPos + yCtrInd
+        psfKernel.computeImage(psfImage, True, xCtrPos, yCtrPos)
+        psfKernel = afwMath.FixedKernel(psfImage)
+    return psfKernel
+
+
+def makeCoaddWcs(imagePath, resolutionFactor):
+    """Compute the WCS and size of a coadd aligned with an exposure, reading only the header of its image file
+
+    The coadd covers the exposure with resolutionFactor times as many pixels along each axis,
+    so the CD matrix is divided by resolutionFactor and CRPIX is scaled about the lower left corner
+    of the image. No pixels are read or allocated.
+
+    @return coaddWcs, coaddWidth, coaddHeight
+    """
+    metadata = afwImage.readMetadata(imagePath)
+    if not metadata.exists("CD1_1"):
+        raise RuntimeError("Image %s has no CD matrix" % (imagePath,))
+    for cdName in ("CD1_1", "CD1_2", "CD2_1", "CD2_2"):
+        if metadata.exists(cdName):
+            metadata.set(cdName, metadata.getAsDouble(cdName) / resolutionFactor)
+    for crpixName in ("CRPIX1", "CRPIX2"):
+        # FITS pixel indices start at 1, so the lower left corner of the image is at 0.5
+        metadata.set(crpixName, ((metadata.getAsDouble(crpixName) - 0.5) * resolutionFactor) + 0.5)
+    # the coadd starts at pixel 0, 0 whatever the xy0 of the exposure
+    for ltvName in ("LTV1", "LTV2"):
+        if metadata.exists(ltvName):
+            metadata.remove(ltvName)
+    coaddWidth = int(math.ceil(metadata.getAsInt("NAXIS1") * resolutionFactor))
+    coaddHeight = int(math.ceil(metadata.getAsInt("NAXIS2") * resolutionFactor))
+    return afwImage.makeWcs(metadata), coaddWidth, coaddHeight
+
+
 if __name__ == "__main__":
     pexLog.Trace.setVerbosity('lsst.coadd', 5)
-    helpStr = """Usage: makeBlurredCoadd.py coaddfile indata
+    helpStr = """Usage: makeBlurredCoadd.py coaddfile indata [patchX patchY]
 
 where:
-- coaddfile is the desired name or path of the output coadd
+- coaddfile is the desired name or path of the output coadd (or of the patch of it)
 - indata is a file containing a list of:
   pathToExposure pathToPsf
   where:
   - pathToExposure is the path to an Exposure (without the final _img.fits)
   - pathToPsf is the path to a Psf model persisted as an XML file
   - empty lines and lines that start with # are ignored.
+- patchX patchY are the indices of the patch of the coadd to make, if patchSize > 0;
+  omit them to list the patches that some exposure overlaps. Each patch may be made by its own process.
 
 The policy controlling the parameters is makeBlurredCoadd_policy.paf
 """
-    if len(sys.argv) != 3:
+    if len(sys.argv) not in (3, 5):
         print helpStr
         sys.exit(0)
     
@@ -136,16 +165,39 @@ The policy controlling the parameters is makeBlurredCoadd_policy.paf
         print helpStr
         sys.exit(1)
     depthOutName = outName + "_depth.fits"
+    checkpointDir = outName + "_checkpoint"
     
     indata = sys.argv[2]
-    
-
-    saveImages = DefSaveImages # could make this a command-line option
+    patchIndices = None
+    if len(sys.argv) == 5:
+        patchIndices = (int(sys.argv[3]), int(sys.argv[4]))
 
     makeBlurredCoaddPolicyPath = DefPolicyPath
     makeBlurredCoaddPolicy = pexPolicy.Policy.createPolicy(makeBlurredCoaddPolicyPath)
     normalizePsf = makeBlurredCoaddPolicy.get("normalizePsf")
+    coaddPipelineClass = getattr(coaddKaiser,
+        "CoaddPipeline%s" % (makeBlurredCoaddPolicy.get("coaddComponentPixelType"),))
+    convolutionMethod = getattr(coaddKaiser, "%s_CONVOLUTION" % (makeBlurredCoaddPolicy.get("convolutionMethod"),))
+    coaddComponentControl = coaddKaiser.CoaddComponentControl(convolutionMethod)
+    coaddComponentControl.setNPsfTiles(makeBlurredCoaddPolicy.get("nPsfTilesX"),
+        makeBlurredCoaddPolicy.get("nPsfTilesY"))
+    coaddComponentControl.setBlendPsfTiles(makeBlurredCoaddPolicy.get("blendPsfTiles"))
+    coaddComponentControl.setReflectPsf(makeBlurredCoaddPolicy.get("reflectPsf"))
+    blurredPsfCache = coaddKaiser.BlurredPsfCache(makeBlurredCoaddPolicy.get("blurredPsfCacheDir"))
+    coaddComponentControl.setBlurredPsfCache(blurredPsfCache)
+    coaddComponentControl.setLazy(makeBlurredCoaddPolicy.get("lazyComponents"))
+    coaddComponentControl.setNSigmaSqCells(makeBlurredCoaddPolicy.get("nSigmaSqCellsX"),
+        makeBlurredCoaddPolicy.get("nSigmaSqCellsY"))
+    usePsfTiles = coaddComponentControl.getNPsfTilesX() > 0 and coaddComponentControl.getNPsfTilesY() > 0
+    coaddPipelineControl = coaddKaiser.CoaddPipelineControl(makeBlurredCoaddPolicy.get("nThreads"),
+        makeBlurredCoaddPolicy.get("maxInFlightMemoryMB") * 1.0e6)
+    coaddPipelineControl.setCheckpointInterval(makeBlurredCoaddPolicy.get("checkpointInterval"))
+    checkpointTileSize = makeBlurredCoaddPolicy.get("checkpointTileSize")
     resolutionFactor = policy.get("resolutionFactor")
+    warpingKernelOrder = makeBlurredCoaddPolicy.get("warpingKernelOrder")
+    warpTileSize = makeBlurredCoaddPolicy.get("warpTileSize")
+    coaddTileSize = makeBlurredCoaddPolicy.get("coaddTileSize")
+    patchSize = makeBlurredCoaddPolicy.get("patchSize")
     allowedMaskPlanes = policy.get("allowedMaskPlanes")
     detectSourcesPolicy = makeBlurredCoaddPolicy.getPolicy("detectSourcesPolicy")
     psfPolicy = detectSourcesPolicy.getPolicy("psfPolicy")
@@ -160,11 +212,7 @@ The policy controlling the parameters is makeBlurredCoadd_policy.paf
 
     # parse indata
     ImageSuffix = "_img.fits"
-    imageDataList = []
-    coaddExposure = None
-    coaddMaskedImage = None
-    coaddWcs = None
-    depthMap = None
+    inputList = []
     with file(indata, "rU") as infile:
         for lineNum, line in enumerate(infile):
             line = line.strip()
@@ -178,72 +226,77 @@ The policy controlling the parameters is makeBlurredCoadd_policy.paf
             if not os.path.isfile(psfPath):
                 print "Skipping exposure %s; psf file %s not found" % (fileName, psfPath)
                 continue
-            
-            print "Processing exposure %s" % (filePath,)
-            exposure = afwImage.ExposureF(filePath)
-#           Uncomment to make a quick small template
-#             subStart = afwImage.PointI(0, 0)
-#             subExposureBBox = afwImage.BBox(subStart, 300, 300)
-#             exposure = afwImage.ExposureF(exposure, subExposureBBox, True)
-            maskedImage = exposure.getMaskedImage()
-            psfModel = unpersistPsf(psfPath)
-            psfKernel = psfModel.getKernel()
-            if normalizePsf and afwMath.LinearCombinationKernel.swigConvert(psfKernel) != None:
-                # psf kernel is a LinearCombinationKernel; convert to a FixedKernel
-                if psfKernel.isSpatiallyVarying():
-                    print """Warning: ignoring spatial variation of psf: normalizePsf is True,
-but psf kernel is a spatially varying LinearCombinationKernel,
-which cannot be normalized until ticket 833 is implemented."""
-                psfImage = afwImage.ImageD(psfKernel.getWidth(), psfKernel.getHeight())
-                xCtrInd = (psfKernel.getWidth() - 1) / 2.0
-                yCtrInd = (psfKernel.getHeight() - 1) / 2.0
-#               note: use indexToPosition once a floating point version is available -- ticket #845
-#                 xCtrPos = afwImage.indexToPosition(xCtrInd)
-#                 yCtrPos = afwImage.indexToPosition(yCtrInd)
-                xCtrPos = afwImage.PixelZeroPos + xCtrInd
-                yCtrPos = afwImage.PixelZeroPos + yCtrInd
-                psfKernel.computeImage(psfImage, True, xCtrPos, yCtrPos)
-                psfKernel = afwMath.FixedKernel(psfImage)
-            
-            if not coaddExposure:
-                coaddExposure = coaddUtils.makeBlankCoadd(exposure, resolutionFactor=resolutionFactor)
-                coaddMaskedImage = coaddExposure.getMaskedImage()
-                coaddWcs = coaddExposure.getWcs()
-                depthMap = afwImage.ImageU(coaddMaskedImage.getDimensions(), 0)
-            
-            print "  Fit and subtract background"
-            subtractBackground(maskedImage)
-            if saveImages:
-                exposure.writeFits("bgSubtracted%s" % (fileName,))
-            
-            print "  Compute coadd component"
-            coaddComponent = coaddKaiser.CoaddComponent(exposure, psfKernel, normalizePsf)
-
-            print "  Divide exposure by sigma squared = %s" % (coaddComponent.getSigmaSq(),)
-            blurredExposure = coaddComponent.getBlurredExposure()
-            blurredMaskedImage = blurredExposure.getMaskedImage()
-            sigmaSq = coaddComponent.getSigmaSq()
-            if saveImages:
-                blurredExposure.writeFits("blurred%s" % (fileName,))
-            blurredMaskedImage /= sigmaSq
-            if saveImages:
-                blurredExposure.writeFits("scaledBlurred%s" % (fileName,))
-            
-            print "  Remap blurred exposure to match coadd WCS"
-            remappedBlurredMaskedImage = afwImage.MaskedImageD(
-                coaddExposure.getWidth(), coaddExposure.getHeight())
-            remappedBlurredExposure = afwImage.ExposureD(remappedBlurredMaskedImage, coaddWcs)
-            if saveImages:
-                remappedBlurredExposure.writeFits("remappedBlurred%s" % (fileName,))
-            nGoodPix = afwMath.warpExposure(remappedBlurredExposure, blurredExposure,
-                afwMath.LanczosWarpingKernel(3))
-            nPix = coaddExposure.getWidth() * coaddExposure.getHeight()
-            print "  Remapped image has %d good pixels (%0.0f %%)" % (nGoodPix, 100 * nGoodPix / float(nPix))
-
-            print "  Add remapped blurred exposure to coadd and save updated coadd exposure"
-            coaddUtils.addToCoadd(coaddMaskedImage, depthMap, remappedBlurredExposure.getMaskedImage(),
-                coaddMask)
-            coaddExposure.writeFits(outName)
-            depthMap.writeFits(depthOutName)
-    coaddUtils.setCoaddEdgeBits(coaddMaskedImage.getMask(), depthMap)
-    coaddExposure.writeFits(outName)    
\ No newline at end of file
+            inputList.append((filePath, psfPath))
+    if not inputList:
+        print "No exposures to coadd"
+        sys.exit(1)
+
+    # the coadd WCS is set by the first exposure, so every patch of the coadd gets the same one
+    coaddWcs, coaddWidth, coaddHeight = makeCoaddWcs(inputList[0][0] + ImageSuffix, resolutionFactor)
+
+    # find the footprint of each exposure on the coadd, reading only the header of each image file
+    footprintIndex = coaddKaiser.FootprintIndex(coaddWcs, coaddWidth, coaddHeight)
+    for filePath, psfPath in inputList:
+        footprintIndex.addExposure(filePath)
+    patchBBox = afwImage.BBox(afwImage.PointI(0, 0), coaddWidth, coaddHeight)
+    if patchSize > 0:
+        if patchIndices == None:
+            nPatchesX = (coaddWidth + patchSize - 1) // patchSize
+            nPatchesY = (coaddHeight + patchSize - 1) // patchSize
+            print "Patches of the %d x %d coadd overlapped by an exposure:" % (coaddWidth, coaddHeight)
+            print "patchX patchY nExposures"
+            for patchY in range(nPatchesY):
+                for patchX in range(nPatchesX):
+                    nExposures = len(footprintIndex.findOverlapping(
+                        footprintIndex.getPatchBBox(patchX, patchY, patchSize)))
+                    if nExposures > 0:
+                        print "%6d %6d %10d" % (patchX, patchY, nExposures)
+            sys.exit(0)
+        patchBBox = footprintIndex.getPatchBBox(patchIndices[0], patchIndices[1], patchSize)
+        coaddWcs = coaddWcs.clone()
+        coaddWcs.shiftReferencePixel(-patchBBox.getX0(), -patchBBox.getY0())
+        print "Making patch %s: %d x %d pixels at %d, %d of the coadd" % (patchIndices,
+            patchBBox.getWidth(), patchBBox.getHeight(), patchBBox.getX0(), patchBBox.getY0())
+    inputIndexList = footprintIndex.findOverlapping(patchBBox)
+    print "%d of %d exposures overlap" % (len(inputIndexList), len(inputList))
+    if len(inputIndexList) == 0:
+        sys.exit(0)
+
+    kaiserCoadd = coaddKaiser.KaiserCoadd(patchBBox.getWidth(), patchBBox.getHeight(),
+        coaddWcs, coaddMask, warpingKernelOrder, coaddTileSize)
+    kaiserCoadd.setWarpTileSize(warpTileSize)
+    coaddPipeline = coaddPipelineClass(kaiserCoadd, normalizePsf, coaddComponentControl,
+        coaddPipelineControl)
+    if os.path.isdir(checkpointDir):
+        print "Resuming from checkpoint %s" % (checkpointDir,)
+    coaddPipeline.setCheckpoint(coaddKaiser.CoaddCheckpoint(checkpointDir, checkpointTileSize))
+    for inputIndex in inputIndexList:
+        filePath, psfPath = inputList[inputIndex]
+        print "Queueing exposure %s" % (filePath,)
+        coaddPipeline.addInput(filePath, loadPsfKernel(psfPath, normalizePsf, usePsfTiles))
+
+    print "Subtract background, compute coadd components and add them to the coadd"
+    coaddPipeline.run()
+    print "Blurred PSF cache: %d hits (%d from disk), %d misses" % \
+        (blurredPsfCache.getNHits(), blurredPsfCache.getNDiskHits(), blurredPsfCache.getNMisses())
+    nPix = kaiserCoadd.getWidth() * kaiserCoadd.getHeight()
+    stageTimes = [0.0, 0.0, 0.0]
+    for i in range(coaddPipeline.getNInputs()):
+        nGoodPix = coaddPipeline.getNGoodPixels(i)
+        print "  Input %d added %d good pixels (%0.0f %%)" % (i, nGoodPix, 100 * nGoodPix / float(nPix))
+        stats = coaddPipeline.getStats(i)
+        stageTimes[0] += stats.sigmaSqTime
+        stageTimes[1] += stats.blurredPsfTime
+        stageTimes[2] += stats.blurredExposureTime
+    print "Time computing sigmaSq: %0.1f s; blurred PSFs: %0.1f s; blurred exposures: %0.1f s" % \
+        tuple(stageTimes)
+    print "Coadd stored in %d of %d tiles" % (kaiserCoadd.getTileMap().getNPopulatedTiles(),
+        kaiserCoadd.getTileMap().getNTilesX() * kaiserCoadd.getTileMap().getNTilesY())
+    # a coadd stored in tiles is only made dense here, to write it
+    coaddExposure = kaiserCoadd.getExposure()
+    depthMap = kaiserCoadd.getDepthMap()
+    coaddUtils.setCoaddEdgeBits(coaddExposure.getMaskedImage().getMask(), depthMap)
+    coaddExposure.writeFits(outName)
+    depthMap.writeFits(depthOutName)
+    kaiserCoadd.getBlurredPsfImage().writeFits(outName + "_psf.fits")
+    shutil.rmtree(checkpointDir)
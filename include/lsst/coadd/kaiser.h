@@ -26,4 +26,27 @@
 * @file
 */
 #include "lsst/coadd/kaiser/medianBinapprox.h"
+#include "lsst/coadd/kaiser/imageBuffer.h"
+#include "lsst/coadd/kaiser/fitsMutex.h"
+#include "lsst/coadd/kaiser/medianBinned.h"
+#include "lsst/coadd/kaiser/medianBinapproxStack.h"
+#include "lsst/coadd/kaiser/StreamingMedian.h"
+#include "lsst/coadd/kaiser/BinapproxSketch.h"
+#include "lsst/coadd/kaiser/SigmaSqMap.h"
+#include "lsst/coadd/kaiser/dilateMask.h"
+#include "lsst/coadd/kaiser/fftConvolve.h"
+#include "lsst/coadd/kaiser/reflectImage.h"
+#include "lsst/coadd/kaiser/PsfTileGrid.h"
+#include "lsst/coadd/kaiser/StripSource.h"
+#include "lsst/coadd/kaiser/StripSink.h"
+#include "lsst/coadd/kaiser/BlurredPsfCache.h"
+#include "lsst/coadd/kaiser/MaskedImagePool.h"
+#include "lsst/coadd/kaiser/CoaddComponentControl.h"
+#include "lsst/coadd/kaiser/CoaddComponentStats.h"
 #include "lsst/coadd/kaiser/CoaddComponent.h"
+#include "lsst/coadd/kaiser/FootprintIndex.h"
+#include "lsst/coadd/kaiser/CoaddTileMap.h"
+#include "lsst/coadd/kaiser/KaiserCoadd.h"
+#include "lsst/coadd/kaiser/CoaddCheckpoint.h"
+#include "lsst/coadd/kaiser/CoaddPipelineControl.h"
+#include "lsst/coadd/kaiser/CoaddPipeline.h"
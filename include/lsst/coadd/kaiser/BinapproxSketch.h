@@ -0,0 +1,217 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_BINAPPROXSKETCH_H
+#define LSST_COADD_KAISER_BINAPPROXSKETCH_H
+/**
+* @brief Mergeable, serializable summary of a stream of values for approximate medians and quantiles
+*
+* @file
+*/
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "boost/cstdint.hpp"
+#include "boost/shared_ptr.hpp"
+
+#include "lsst/afw/image.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief Approximate median and quantiles of a stream of values, which may be split among threads,
+     * strips or processes and merged
+     *
+     * Like medianBinapprox the values are histogrammed in bins about 2 sigma / nBins wide, and a quantile
+     * is reported as the center of the bin that contains it, so it is accurate to sigma / nBins.
+     * Unlike medianBinapprox the bin range must be chosen before all the values are seen. It is either
+     * set from a prior (setPrior) or set from the mean and standard deviation of the first sampleSize values,
+     * which are kept until then (and give exact quantiles until then). The range covers at least
+     * mean +/- RangeNSigma sigma; values outside it are counted but not binned, so quantiles that fall
+     * outside the range cannot be computed. The median is always within 1 sigma of the mean, so it is
+     * available if the prior (or first sample) is representative of all the values.
+     *
+     * Bin widths are powers of 2 and bin edges are multiples of the bin width, so sketches with different
+     * ranges can be merged exactly: the finer sketch is coarsened to the bin width of the other,
+     * and the merged range is the overlap of the two ranges. For the best accuracy give all sketches
+     * that will be merged the same prior.
+     *
+     * The count, mean, standard deviation, minimum and maximum of the values are exact (to roundoff).
+     * Non-finite values are ignored.
+     *
+     * @ingroup coadd::kaiser
+     */
+    class BinapproxSketch {
+    public:
+        typedef boost::shared_ptr<BinapproxSketch> Ptr;
+        typedef boost::shared_ptr<BinapproxSketch const> ConstPtr;
+
+        static int const DefaultNBins = 1000;       ///< default number of bins per 2 sigma
+        static int const DefaultSampleSize = 10000; ///< default number of values used to set the bin range
+        static int const RangeNSigma = 3;           ///< the binned range covers at least mean +/- this * sigma
+
+        explicit BinapproxSketch(
+            int nBins = DefaultNBins,
+            int sampleSize = DefaultSampleSize
+        );
+        virtual ~BinapproxSketch() {};
+
+        void setPrior(
+            double mean,
+            double sigma
+        );
+
+        /// add one value
+        void addValue(double value) {
+            if (!(value - value == 0)) {
+                return; // NaN or inf
+            }
+            ++_count;
+            double const delta = value - _mean;
+            _mean += delta / static_cast<double>(_count);
+            _m2 += delta * (value - _mean);
+            if (value < _min) {
+                _min = value;
+            }
+            if (value > _max) {
+                _max = value;
+            }
+            if (isBinned()) {
+                addToBins(value);
+            } else {
+                _sample.push_back(value);
+                if (static_cast<int>(_sample.size()) >= _sampleSize) {
+                    fixRange(_mean, getSigma());
+                }
+            }
+        }
+
+        /// add a range of values
+        template <class InputIterator>
+        void addValues(InputIterator first, InputIterator last) {
+            for (InputIterator it = first; it != last; ++it) {
+                addValue(static_cast<double>(*it));
+            }
+        }
+
+        template <typename T>
+        void addImage(
+            lsst::afw::image::Image<T> const &image
+        );
+
+        template <typename T>
+        void addMaskedImage(
+            lsst::afw::image::Image<T> const &image,
+            lsst::afw::image::Mask<lsst::afw::image::MaskPixel> const &mask,
+            lsst::afw::image::MaskPixel badMask
+        );
+
+        void merge(BinapproxSketch const &other);
+
+        std::string serialize() const;
+
+        static BinapproxSketch deserialize(std::string const &data);
+
+        double getQuantile(double fraction) const;
+
+        /// get the approximate median; see getQuantile
+        double getMedian() const { return getQuantile(0.5); }
+
+        int getNBins() const { return _nBins; }
+
+        int getSampleSize() const { return _sampleSize; }
+
+        /// get the number of (finite) values added so far
+        boost::uint64_t getCount() const { return _count; }
+
+        /// get the mean of the values added so far
+        double getMean() const { return _mean; }
+
+        /// get the (population) standard deviation of the values added so far
+        double getSigma() const { return (_count > 0) ? std::sqrt(_m2 / static_cast<double>(_count)) : 0.0; }
+
+        /// get the smallest value added so far; +inf if none
+        double getMin() const { return _min; }
+
+        /// get the largest value added so far; -inf if none
+        double getMax() const { return _max; }
+
+        /// has the bin range been set? If not, all values are kept and quantiles are exact
+        bool isBinned() const { return _binWidth > 0; }
+
+        /// get the bin width; 0 if not binned
+        double getBinWidth() const { return _binWidth; }
+
+        /// get the lower edge of the binned range; 0 if not binned
+        double getRangeMin() const { return _firstBin * _binWidth; }
+
+        /// get the upper edge of the binned range; 0 if not binned
+        double getRangeMax() const { return (_firstBin + static_cast<double>(_binCounts.size())) * _binWidth; }
+
+        /// get the number of values below the binned range
+        boost::uint64_t getNBelow() const { return _nBelow; }
+
+        /// get the number of values at or above the upper edge of the binned range
+        boost::uint64_t getNAbove() const { return _nAbove; }
+
+    private:
+        int _nBins;
+        int _sampleSize;
+        boost::uint64_t _count;
+        double _mean;
+        double _m2;     ///< sum of squared deviations from the mean
+        double _min;
+        double _max;
+        std::vector<double> _sample;    ///< values added before the bin range was set; empty once binned
+        int _binExponent;   ///< bin width = 2^_binExponent
+        double _binWidth;   ///< 0 if not binned
+        double _firstBin;   ///< index of first bin on the grid of multiples of the bin width (an integer)
+        std::vector<boost::uint64_t> _binCounts;
+        boost::uint64_t _nBelow;
+        boost::uint64_t _nAbove;
+
+        void fixRange(double mean, double sigma);
+
+        void coarsen(int binExponent);
+
+        void clip(double firstBin, double endBin);
+
+        void addToBins(double value) {
+            double const bin = std::floor(std::ldexp(value, -_binExponent)) - _firstBin;
+            if (bin < 0) {
+                ++_nBelow;
+            } else if (bin >= static_cast<double>(_binCounts.size())) {
+                ++_nAbove;
+            } else {
+                ++_binCounts[static_cast<std::size_t>(bin)];
+            }
+        }
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_BINAPPROXSKETCH_H)
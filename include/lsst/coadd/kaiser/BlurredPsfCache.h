@@ -0,0 +1,120 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_BLURREDPSFCACHE_H
+#define LSST_COADD_KAISER_BLURREDPSFCACHE_H
+/**
+* @brief Cache of blurred PSF images, keyed by the contents of the PSF kernel
+*
+* @file
+*/
+#include <map>
+#include <string>
+
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/mutex.hpp"
+
+#include "lsst/afw/image.h"
+#include "lsst/afw/math.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    typedef lsst::afw::image::Image<double> BlurredPsfImage;
+
+    BlurredPsfImage::Ptr computeBlurredPsfImage(
+        lsst::afw::math::Kernel const &psfKernel,
+        bool normalizePsf
+    );
+
+    /**
+     * @brief A cache of blurred PSF images (the PSF convolved with the reflected PSF)
+     *
+     * Entries are keyed by a hash of the PSF kernel image and the normalize flag, so kernels with identical
+     * images share an entry even if they are different objects. Each entry also holds the kernel image,
+     * which is compared on lookup, so a hash collision cannot return the wrong blurred PSF.
+     * If the cache has a directory then entries are also stored there, and later runs read them back
+     * rather than computing them.
+     *
+     * Spatially varying kernels are not cached (their blurred PSF is computed every time and counted as
+     * a miss). The cache may be shared by CoaddComponents computed in different threads. Entries are read
+     * from and written to the directory with getFitsMutex() held (so do not call get while holding it),
+     * and each file is written under a temporary name and then renamed, so a reader never sees part of one.
+     *
+     * @ingroup coadd::kaiser
+     */
+    class BlurredPsfCache {
+    public:
+        typedef boost::shared_ptr<BlurredPsfCache> Ptr;
+        typedef boost::shared_ptr<BlurredPsfCache const> ConstPtr;
+
+        explicit BlurredPsfCache(
+            std::string const &dirPath = ""
+        );
+        virtual ~BlurredPsfCache() {};
+
+        BlurredPsfImage::ConstPtr get(
+            lsst::afw::math::Kernel const &psfKernel,
+            bool normalizePsf
+        );
+
+        /// get the path of the directory in which entries are stored; "" if entries are only kept in memory
+        std::string getDirPath() const { return _dirPath; }
+
+        /// get the number of entries in memory
+        int getSize() const;
+
+        /// get the number of lookups that found an entry, in memory or in the directory
+        int getNHits() const;
+
+        /// get the number of lookups that found an entry in the directory but not in memory
+        int getNDiskHits() const;
+
+        /// get the number of lookups that had to compute the blurred PSF
+        int getNMisses() const;
+
+        void clear();
+
+    private:
+        struct Entry {
+            BlurredPsfImage::ConstPtr kernelImage;
+            BlurredPsfImage::ConstPtr blurredPsfImage;
+        };
+        typedef std::map<std::string, Entry> EntryMap;
+
+        std::string _dirPath;
+        EntryMap _entryMap;
+        int _nHits;
+        int _nDiskHits;
+        int _nMisses;
+        mutable boost::mutex _mutex;
+
+        bool readEntry(std::string const &key, BlurredPsfImage const &kernelImage, Entry &entry) const;
+        void writeEntry(std::string const &key, Entry const &entry) const;
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_BLURREDPSFCACHE_H)
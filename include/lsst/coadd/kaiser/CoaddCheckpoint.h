@@ -0,0 +1,113 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_COADDCHECKPOINT_H
+#define LSST_COADD_KAISER_COADDCHECKPOINT_H
+/**
+* @brief Incremental checkpoints of a KaiserCoadd
+*
+* @file
+*/
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/shared_ptr.hpp"
+
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/KaiserCoadd.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief Incremental checkpoints of a KaiserCoadd, for resuming after a crash
+     *
+     * A checkpoint directory holds a journal plus FITS files for each tile of the coadd and for the
+     * blurred PSF image. Each checkpoint writes only the tiles modified since the previous checkpoint
+     * (to files named for the checkpoint, so the previous files remain valid until the checkpoint is
+     * complete), then appends to the journal a block listing the inputs added and tiles written.
+     * A block is only used if it is complete, so a crash during a checkpoint loses only that checkpoint.
+     * Files superseded by a checkpoint are deleted once it is complete and the new files, the journal
+     * and the directory have been synced (fsync) to stable storage.
+     *
+     * @ingroup coadd::kaiser
+     */
+    class CoaddCheckpoint {
+    public:
+        typedef boost::shared_ptr<CoaddCheckpoint> Ptr;
+        typedef boost::shared_ptr<CoaddCheckpoint const> ConstPtr;
+
+        explicit CoaddCheckpoint(
+            std::string const &dirPath,
+            int tileSize = 1024
+        );
+        virtual ~CoaddCheckpoint() {};
+
+        /// get the path of the checkpoint directory
+        std::string getDirPath() const { return _dirPath; }
+
+        /// get the size of each tile along x and y
+        int getTileSize() const { return _tileSize; }
+
+        /// get the number of complete checkpoints
+        int getNCheckpoints() const { return _nCheckpoints; }
+
+        /// get the number of inputs recorded in complete checkpoints
+        int getNInputs() const { return static_cast<int>(_inputList.size()); }
+
+        std::string getInput(int index) const;
+
+        void addInput(std::string const &input);
+
+        void restore(KaiserCoadd &kaiserCoadd) const;
+
+        void write(KaiserCoadd &kaiserCoadd);
+
+    private:
+        typedef std::pair<int, int> TileIndex;
+        typedef std::map<TileIndex, int> TileCheckpointMap;
+
+        std::string _dirPath;
+        int _tileSize;
+        int _width;     ///< width of coadd; 0 if no checkpoints
+        int _height;    ///< height of coadd; 0 if no checkpoints
+        int _nCheckpoints;
+        int _nComponents;   ///< number of components in the coadd as of the last checkpoint
+        int _psfCheckpoint; ///< checkpoint in which the blurred PSF image was last written; 0 if none
+        TileCheckpointMap _tileCheckpointMap;   ///< checkpoint in which each tile was last written
+        std::vector<std::string> _inputList;    ///< inputs recorded in complete checkpoints
+        std::vector<std::string> _pendingInputList; ///< inputs to record in the next checkpoint
+
+        std::string getJournalPath() const;
+        std::string getTilePath(TileIndex const &tileIndex, int checkpoint) const;
+        std::string getPsfPath(int checkpoint) const;
+        void readJournal();
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_COADDCHECKPOINT_H)
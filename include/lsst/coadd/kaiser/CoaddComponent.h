@@ -31,9 +31,19 @@
 *
 * @author Russell Owen
 */
+#include <vector>
+
+#include "boost/shared_ptr.hpp"
+
 #include "lsst/daf/base/Citizen.h"
 #include "lsst/afw/image.h"
 #include "lsst/afw/math.h"
+#include "lsst/coadd/kaiser/CoaddComponentControl.h"
+#include "lsst/coadd/kaiser/CoaddComponentStats.h"
+#include "lsst/coadd/kaiser/PsfTileGrid.h"
+#include "lsst/coadd/kaiser/SigmaSqMap.h"
+#include "lsst/coadd/kaiser/StripSink.h"
+#include "lsst/coadd/kaiser/StripSource.h"
 
 namespace lsst {
 namespace coadd {
@@ -42,11 +52,22 @@ namespace kaiser {
     /**
      * @brief One component (processed Exposure) of a Kaiser coadd
      *
+     * @tparam PixelT  pixel type of the blurred exposure and blurred PSF image: float or double.
+     *  float halves the memory and bandwidth required; double retains more precision.
+     *
+     * In lazy mode (see CoaddComponentControl::setLazy) nothing is computed until it is first asked for,
+     * and getBlurredExposure(bbox) convolves only the requested region (plus a halo) of the science exposure.
+     * A lazy CoaddComponent keeps a shallow copy of the science exposure, which must not be modified
+     * while the CoaddComponent is in use, and is not safe to use from more than one thread at a time.
+     *
      * @ingroup coadd::kaiser
      */
+    template <typename PixelT>
     class CoaddComponent : public lsst::daf::base::Citizen {
     public:
-        typedef double pixelType; // pixel type for blurred science exposure
+        typedef boost::shared_ptr<CoaddComponent> Ptr;
+        typedef boost::shared_ptr<CoaddComponent const> ConstPtr;
+        typedef PixelT pixelType; // pixel type for blurred science exposure
         typedef lsst::afw::image::Exposure<float, lsst::afw::image::MaskPixel,
             lsst::afw::image::VariancePixel> ExposureF;
         typedef lsst::afw::image::MaskedImage<float, lsst::afw::image::MaskPixel,
@@ -58,34 +79,120 @@ namespace kaiser {
         explicit CoaddComponent(
             ExposureF const &scienceExposure,
             lsst::afw::math::Kernel const &psfKernel,
-            bool normalizePsf = true
+            bool normalizePsf = true,
+            CoaddComponentControl const &control = CoaddComponentControl()
+        );
+        explicit CoaddComponent(
+            ExposureF const &scienceExposure,
+            lsst::afw::math::Kernel const &psfKernel,
+            ExposureCC &blurredExposure,
+            bool normalizePsf = true,
+            CoaddComponentControl const &control = CoaddComponentControl()
+        );
+        explicit CoaddComponent(
+            StripSource &scienceSource,
+            lsst::afw::math::Kernel const &psfKernel,
+            StripSink<PixelT> &blurredSink,
+            bool normalizePsf = true,
+            CoaddComponentControl const &control = CoaddComponentControl()
         );
         virtual ~CoaddComponent() {};
 
-        double getSigmaSq() const { return _sigmaSq; }
+        double getSigmaSq() const;
+
+        SigmaSqMap::ConstPtr getSigmaSqMap() const;
 
-        ExposureCC getBlurredExposure() const { return _blurredExposure; }
+        ExposureCC getBlurredExposure() const;
+
+        ExposureCC getBlurredExposure(
+            lsst::afw::image::BBox const &bbox
+        ) const;
+
+        ExposureCC blurRegion(
+            lsst::afw::image::BBox const &bbox
+        ) const;
         
-        ImageCC getBlurredPsfImage() const { return _blurredPsfImage; };
+        ImageCC getBlurredPsfImage() const;
+
+        /// is the CoaddComponent lazy (computing each item on first use)?
+        bool isLazy() const { return _isLazy; }
+
+        /**
+         * @brief Get the bounding box of the blurred exposure, relative to the origin of the science exposure
+         *
+         * @return the bounding box, which is empty if the CoaddComponent was computed in strips
+         */
+        lsst::afw::image::BBox getBBox() const { return _bbox; }
+
+        /// get the WCS of the science exposure; a null pointer if it has none
+        lsst::afw::image::Wcs::Ptr getWcs() const { return _wcsPtr; }
+
+        /**
+         * @brief Get the PSF tile grid used to convolve the science exposure
+         *
+         * @return the grid, or a null pointer if the exposure was convolved directly with the PSF kernel
+         */
+        PsfTileGrid::ConstPtr getPsfTileGrid() const { return _psfTileGridPtr; }
+
+        /// get timing and counters recorded while computing this CoaddComponent
+        CoaddComponentStats getStats() const { return _stats; }
         
     private:
-        double _sigmaSq;
+        mutable double _sigmaSq;
         ExposureCC _blurredExposure;
-        ImageCC _blurredPsfImage;
+        mutable ImageCC _blurredPsfImage;
         bool _normalizePsf;
+        CoaddComponentControl _control;
+        PsfTileGrid::ConstPtr _psfTileGridPtr;
+        bool _isLazy;
+        lsst::afw::image::BBox _bbox;
+        lsst::afw::image::Wcs::Ptr _wcsPtr;
+        ExposureF _scienceExposure;     ///< science exposure (lazy mode only)
+        lsst::afw::math::Kernel::Ptr _psfKernelPtr; ///< PSF kernel (lazy mode only)
+        mutable bool _haveSigmaSq;
+        mutable bool _haveBlurredPsf;
+        mutable boost::shared_ptr<ExposureCC> _lastBlurredRegionPtr;   ///< last blurred region computed by
+                                                                        ///< getBlurredExposure(bbox) (lazy mode only)
+        mutable CoaddComponentStats _stats;
+        mutable SigmaSqMap::ConstPtr _sigmaSqMapPtr;    ///< null unless control specifies sigmaSq cells
         
         void computeSigmaSq(
             ExposureF const &scienceExposure
-        );
+        ) const;
         
         void computeBlurredPsf(
             lsst::afw::math::Kernel const &psfKernel
-        );
+        ) const;
 
         void computeBlurredExposure(
             ExposureF const &scienceExposure,
             lsst::afw::math::Kernel const &psfKernel
         );
+
+        void checkRegion(
+            lsst::afw::image::BBox const &bbox
+        ) const;
+
+        ExposureCC computeBlurredRegion(
+            lsst::afw::image::BBox const &bbox
+        ) const;
+
+        void computeBlurredStrips(
+            StripSource &scienceSource,
+            lsst::afw::math::Kernel const &psfKernel,
+            StripSink<PixelT> &blurredSink
+        );
+
+        void makePsfTileGrid(
+            lsst::afw::math::Kernel const &psfKernel,
+            lsst::afw::image::BBox const &bbox
+        );
+
+        void blurMaskedImage(
+            typename ExposureCC::MaskedImageT &blurredMI,
+            MaskedImageF const &scienceMI,
+            lsst::afw::math::Kernel const &psfKernel
+        ) const;
     };
 
 }}} // lsst::coadd::kaiser
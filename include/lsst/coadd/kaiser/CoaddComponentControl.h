@@ -0,0 +1,142 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_COADDCOMPONENTCONTROL_H
+#define LSST_COADD_KAISER_COADDCOMPONENTCONTROL_H
+/**
+* @brief Parameters controlling how a CoaddComponent is computed
+*
+* @file
+*/
+#include "lsst/coadd/kaiser/BlurredPsfCache.h"
+#include "lsst/coadd/kaiser/fftConvolve.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief Pass parameters to CoaddComponent
+     *
+     * To convolve with a spatially varying PSF at nearly the cost of a fixed PSF, set the number of PSF tiles;
+     * the PSF is then evaluated once per tile (see PsfTileGrid and convolveWithPsfTiles).
+     *
+     * To avoid recomputing the blurred PSF for exposures whose PSF kernels have identical images,
+     * set a BlurredPsfCache; copies of the control share the cache.
+     *
+     * To weight each part of the exposure by its own noise level (rather than by a single median variance),
+     * set the number of sigmaSq cells; see SigmaSqMap.
+     *
+     * To compute only what is used (e.g. only the part of the blurred exposure that overlaps a coadd patch),
+     * set lazy mode.
+     *
+     * @ingroup coadd::kaiser
+     */
+    class CoaddComponentControl {
+    public:
+        CoaddComponentControl(
+            ConvolutionMethod convolutionMethod = AUTO_CONVOLUTION, ///< convolution method
+            int fftSize = 0     ///< FFT size along each axis for FFT convolution; if <= 0 then use a default
+        ) :
+            _convolutionMethod(convolutionMethod),
+            _fftSize(fftSize),
+            _nPsfTilesX(0),
+            _nPsfTilesY(0),
+            _blendPsfTiles(false),
+            _reflectPsf(false),
+            _stripHeight(0),
+            _blurredPsfCachePtr(),
+            _lazy(false),
+            _nSigmaSqCellsX(0),
+            _nSigmaSqCellsY(0),
+            _nSigmaSqThreads(1)
+        {}
+
+        ConvolutionMethod getConvolutionMethod() const { return _convolutionMethod; }
+        void setConvolutionMethod(ConvolutionMethod convolutionMethod) { _convolutionMethod = convolutionMethod; }
+
+        int getFftSize() const { return _fftSize; }
+        void setFftSize(int fftSize) { _fftSize = fftSize; }
+
+        int getNPsfTilesX() const { return _nPsfTilesX; }
+        int getNPsfTilesY() const { return _nPsfTilesY; }
+        /// set the number of PSF tiles in x and y; 0 to convolve with the PSF kernel directly
+        /// (a fixed PSF kernel is always evaluated on a single tile)
+        void setNPsfTiles(int nPsfTilesX, int nPsfTilesY) {
+            _nPsfTilesX = nPsfTilesX;
+            _nPsfTilesY = nPsfTilesY;
+        }
+
+        bool getBlendPsfTiles() const { return _blendPsfTiles; }
+        /// blend the PSF bilinearly between tile centers? (ignored unless PSF tiles are used)
+        void setBlendPsfTiles(bool blendPsfTiles) { _blendPsfTiles = blendPsfTiles; }
+
+        bool getReflectPsf() const { return _reflectPsf; }
+        /// convolve with the reflected PSF, psf(-r)? Requires PSF tiles if the PSF is spatially varying.
+        void setReflectPsf(bool reflectPsf) { _reflectPsf = reflectPsf; }
+
+        /// get the number of rows per strip for streaming CoaddComponent; if <= 0 a default is used
+        int getStripHeight() const { return _stripHeight; }
+        void setStripHeight(int stripHeight) { _stripHeight = stripHeight; }
+
+        /// get the blurred PSF cache; null if none
+        BlurredPsfCache::Ptr getBlurredPsfCache() const { return _blurredPsfCachePtr; }
+        /// set the blurred PSF cache; null for none
+        void setBlurredPsfCache(BlurredPsfCache::Ptr blurredPsfCachePtr) { _blurredPsfCachePtr = blurredPsfCachePtr; }
+
+        bool getLazy() const { return _lazy; }
+        /// compute sigmaSq, the blurred PSF and regions of the blurred exposure on first use?
+        /// (ignored by the streaming CoaddComponent constructor)
+        void setLazy(bool lazy) { _lazy = lazy; }
+
+        int getNSigmaSqCellsX() const { return _nSigmaSqCellsX; }
+        int getNSigmaSqCellsY() const { return _nSigmaSqCellsY; }
+        /// set the number of cells in x and y of the SigmaSqMap; 0 to only compute a single sigmaSq
+        void setNSigmaSqCells(int nSigmaSqCellsX, int nSigmaSqCellsY) {
+            _nSigmaSqCellsX = nSigmaSqCellsX;
+            _nSigmaSqCellsY = nSigmaSqCellsY;
+        }
+
+        int getNSigmaSqThreads() const { return _nSigmaSqThreads; }
+        /// set the number of threads used to compute the SigmaSqMap (ignored for streaming CoaddComponents)
+        void setNSigmaSqThreads(int nSigmaSqThreads) { _nSigmaSqThreads = nSigmaSqThreads; }
+
+    private:
+        ConvolutionMethod _convolutionMethod;
+        int _fftSize;
+        int _nPsfTilesX;
+        int _nPsfTilesY;
+        bool _blendPsfTiles;
+        bool _reflectPsf;
+        int _stripHeight;
+        BlurredPsfCache::Ptr _blurredPsfCachePtr;
+        bool _lazy;
+        int _nSigmaSqCellsX;
+        int _nSigmaSqCellsY;
+        int _nSigmaSqThreads;
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_COADDCOMPONENTCONTROL_H)
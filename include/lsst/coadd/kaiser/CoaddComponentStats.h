@@ -0,0 +1,82 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_COADDCOMPONENTSTATS_H
+#define LSST_COADD_KAISER_COADDCOMPONENTSTATS_H
+/**
+* @brief Timing and counters recorded while computing a CoaddComponent
+*
+* @file
+*/
+#include <string>
+
+#include "lsst/coadd/kaiser/fftConvolve.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief Timing and counters recorded while computing a CoaddComponent
+     *
+     * Times are wall times, so they include time spent waiting for other threads.
+     * For a lazy CoaddComponent the values grow as items are computed.
+     *
+     * @ingroup coadd::kaiser
+     */
+    struct CoaddComponentStats {
+        double sigmaSqTime;         ///< time spent computing sigmaSq (sec)
+        double blurredPsfTime;      ///< time spent computing the blurred PSF image (sec)
+        double blurredExposureTime; ///< time spent blurring the science exposure (sec)
+        int nMaskedPixels;          ///< number of science pixels with any mask bit set
+        int nUnmaskedPixels;        ///< number of science pixels with no mask bits set (used for sigmaSq)
+        ConvolutionMethod convolutionMethod;    ///< convolution method used; AUTO_CONVOLUTION if none yet
+        int kernelWidth;            ///< width of PSF kernel (pixels)
+        int kernelHeight;           ///< height of PSF kernel (pixels)
+        double nBytesAllocated;     ///< bytes allocated for results: blurred exposure (or regions of it),
+                                    ///< blurred PSF image and PSF tile kernels; temporary buffers are not counted
+
+        CoaddComponentStats() :
+            sigmaSqTime(0),
+            blurredPsfTime(0),
+            blurredExposureTime(0),
+            nMaskedPixels(0),
+            nUnmaskedPixels(0),
+            convolutionMethod(AUTO_CONVOLUTION),
+            kernelWidth(0),
+            kernelHeight(0),
+            nBytesAllocated(0)
+        {}
+
+        std::string toString() const;
+
+        void trace(
+            std::string const &label,
+            int verbosity
+        ) const;
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_COADDCOMPONENTSTATS_H)
@@ -0,0 +1,134 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_COADDPIPELINE_H
+#define LSST_COADD_KAISER_COADDPIPELINE_H
+/**
+* @brief Build a Kaiser coadd from many exposures using a pool of worker threads
+*
+* @file
+*/
+#include <string>
+#include <vector>
+
+#include "boost/shared_ptr.hpp"
+
+#include "lsst/afw/image.h"
+#include "lsst/afw/math.h"
+#include "lsst/coadd/kaiser/CoaddCheckpoint.h"
+#include "lsst/coadd/kaiser/CoaddComponent.h"
+#include "lsst/coadd/kaiser/CoaddComponentControl.h"
+#include "lsst/coadd/kaiser/CoaddComponentStats.h"
+#include "lsst/coadd/kaiser/CoaddPipelineControl.h"
+#include "lsst/coadd/kaiser/KaiserCoadd.h"
+#include "lsst/coadd/kaiser/MaskedImagePool.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief Add exposures to a KaiserCoadd, processing several at once
+     *
+     * Worker threads read each exposure, subtract its background and compute its CoaddComponent,
+     * while the calling thread adds finished components to the coadd. Components are always added
+     * in the order the inputs were added to the pipeline, so the result does not depend on the number
+     * of threads. FITS files (including BlurredPsfCache entries) are read and written by one thread
+     * at a time (see getFitsMutex), and each worker evaluates its own copy of the input's PSF kernel.
+     * The number of inputs in flight (started but not yet added) is limited by an estimate of their
+     * memory use; see CoaddPipelineControl.
+     *
+     * Unless the CoaddComponents are lazy, each is blurred into a buffer drawn from a MaskedImagePool,
+     * and the buffer is returned to the pool once the component has been added (or has failed, or the run
+     * has stopped before adding it), so a run of same-sized exposures reuses a few blurred exposures rather
+     * than allocating one per exposure. The pool keeps
+     * up to one free buffer per worker thread; this memory is not counted in the in-flight memory limit.
+     *
+     * The CoaddComponentStats of each input added are kept (see getStats) and sent to pex_logging Trace
+     * at the verbosity given by CoaddPipelineControl.
+     *
+     * To survive a crash, set a CoaddCheckpoint: the coadd is checkpointed as inputs are added,
+     * and a new pipeline given the same inputs and checkpoint resumes after the last checkpointed input.
+     *
+     * @tparam PixelT  pixel type of the CoaddComponents: float or double
+     *
+     * @ingroup coadd::kaiser
+     */
+    template <typename PixelT>
+    class CoaddPipeline {
+    public:
+        typedef boost::shared_ptr<CoaddPipeline> Ptr;
+        typedef boost::shared_ptr<CoaddPipeline const> ConstPtr;
+
+        explicit CoaddPipeline(
+            KaiserCoadd &kaiserCoadd,
+            bool normalizePsf = true,
+            CoaddComponentControl const &coaddComponentControl = CoaddComponentControl(),
+            CoaddPipelineControl const &control = CoaddPipelineControl()
+        );
+        virtual ~CoaddPipeline() {};
+
+        void addInput(
+            std::string const &exposurePath,
+            lsst::afw::math::Kernel::Ptr psfKernel
+        );
+
+        void setCheckpoint(CoaddCheckpoint::Ptr checkpoint);
+
+        /// get the checkpoint; null if none
+        CoaddCheckpoint::Ptr getCheckpoint() const { return _checkpoint; }
+
+        int run();
+
+        /// get the number of inputs
+        int getNInputs() const { return static_cast<int>(_inputList.size()); }
+
+        int getNGoodPixels(int index) const;
+
+        CoaddComponentStats getStats(int index) const;
+
+        /// get the pool of buffers for blurred exposures
+        typename MaskedImagePool<PixelT>::Ptr getBufferPool() const { return _bufferPoolPtr; }
+
+    private:
+        struct Input {
+            std::string exposurePath;
+            lsst::afw::math::Kernel::Ptr psfKernel;
+            int nGoodPixels;    ///< number of pixels added to the coadd; -1 if not added by this pipeline
+            CoaddComponentStats stats;  ///< stats of the CoaddComponent; all zero if not added by this pipeline
+        };
+
+        KaiserCoadd &_kaiserCoadd;
+        bool _normalizePsf;
+        CoaddComponentControl _coaddComponentControl;
+        CoaddPipelineControl _control;
+        std::vector<Input> _inputList;
+        int _nAdded;    ///< number of inputs already added to the coadd (including those checkpointed)
+        CoaddCheckpoint::Ptr _checkpoint;
+        typename MaskedImagePool<PixelT>::Ptr _bufferPoolPtr;
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_COADDPIPELINE_H)
@@ -0,0 +1,99 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_COADDPIPELINECONTROL_H
+#define LSST_COADD_KAISER_COADDPIPELINECONTROL_H
+/**
+* @brief Parameters controlling how a CoaddPipeline runs
+*
+* @file
+*/
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief Pass parameters to CoaddPipeline
+     *
+     * @ingroup coadd::kaiser
+     */
+    class CoaddPipelineControl {
+    public:
+        CoaddPipelineControl(
+            int nThreads = 0,   ///< number of worker threads; if <= 0 then use one per core
+            double maxInFlightMemory = 2.0e9    ///< approximate maximum memory (bytes) for inputs in flight;
+                                                ///< if <= 0 then there is no limit
+        ) :
+            _nThreads(nThreads),
+            _maxInFlightMemory(maxInFlightMemory),
+            _subtractBackground(true),
+            _backgroundCellSize(256),
+            _checkpointInterval(0),
+            _statsTraceVerbosity(4)
+        {}
+
+        int getNThreads() const { return _nThreads; }
+        void setNThreads(int nThreads) { _nThreads = nThreads; }
+
+        /**
+         * @brief get the approximate maximum memory (bytes) for inputs that have been started but not added
+         *
+         * An input is always started if no others are in flight, even if it alone exceeds this limit.
+         */
+        double getMaxInFlightMemory() const { return _maxInFlightMemory; }
+        void setMaxInFlightMemory(double maxInFlightMemory) { _maxInFlightMemory = maxInFlightMemory; }
+
+        bool getSubtractBackground() const { return _subtractBackground; }
+        /// fit and subtract the background of each exposure before computing its CoaddComponent?
+        void setSubtractBackground(bool subtractBackground) { _subtractBackground = subtractBackground; }
+
+        int getBackgroundCellSize() const { return _backgroundCellSize; }
+        /// set the approximate size (pixels) of each background cell along x and y
+        void setBackgroundCellSize(int backgroundCellSize) { _backgroundCellSize = backgroundCellSize; }
+
+        int getCheckpointInterval() const { return _checkpointInterval; }
+        /**
+         * @brief set the number of inputs added between checkpoints; if <= 0 then only checkpoint
+         * at the end of each run (ignored unless the pipeline has a CoaddCheckpoint)
+         */
+        void setCheckpointInterval(int checkpointInterval) { _checkpointInterval = checkpointInterval; }
+
+        int getStatsTraceVerbosity() const { return _statsTraceVerbosity; }
+        /// set the Trace verbosity at which the CoaddComponentStats of each input are sent
+        /// (see CoaddComponentStats::trace)
+        void setStatsTraceVerbosity(int statsTraceVerbosity) { _statsTraceVerbosity = statsTraceVerbosity; }
+
+    private:
+        int _nThreads;
+        double _maxInFlightMemory;
+        bool _subtractBackground;
+        int _backgroundCellSize;
+        int _checkpointInterval;
+        int _statsTraceVerbosity;
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_COADDPIPELINECONTROL_H)
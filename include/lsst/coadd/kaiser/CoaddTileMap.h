@@ -0,0 +1,181 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_COADDTILEMAP_H
+#define LSST_COADD_KAISER_COADDTILEMAP_H
+/**
+* @brief Coadd and depth map pixels stored in fixed-size tiles, allocated on first write
+*
+* @file
+*/
+#include <vector>
+
+#include "boost/cstdint.hpp"
+
+#include "lsst/afw/image.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief One tile of a CoaddTileMap: a region of the coadd masked image and depth map
+     *
+     * The masked image and depth map have xy0 set to the position of the tile in the coadd,
+     * and share pixels with the tile map.
+     *
+     * @ingroup coadd::kaiser
+     */
+    class CoaddTile {
+    public:
+        typedef lsst::afw::image::MaskedImage<double, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> MaskedImageD;
+        typedef lsst::afw::image::Image<boost::uint16_t> DepthMap;
+
+        CoaddTile(
+            int ix,
+            int iy,
+            lsst::afw::image::BBox const &bbox
+        );
+
+        /// get the x index of the tile in the grid of tiles
+        int getIX() const { return _ix; }
+
+        /// get the y index of the tile in the grid of tiles
+        int getIY() const { return _iy; }
+
+        /// get the bounding box of the tile, relative to the origin of the coadd
+        lsst::afw::image::BBox getBBox() const { return _bbox; }
+
+        /// get the masked image of the tile (shares pixels with the tile)
+        MaskedImageD getMaskedImage() const { return _maskedImage; }
+
+        /// get the depth map of the tile (shares pixels with the tile)
+        DepthMap getDepthMap() const { return _depthMap; }
+
+    private:
+        int _ix;
+        int _iy;
+        lsst::afw::image::BBox _bbox;
+        MaskedImageD _maskedImage;
+        DepthMap _depthMap;
+    };
+
+    /**
+     * @brief The pixels of a coadd masked image and depth map, stored in a grid of square tiles that are
+     * allocated (and zeroed) when first written
+     *
+     * Memory scales with the area of the coadd that has been written rather than with its bounding box,
+     * which matters for wide-field coadds with patchy coverage. The tile directory holds one int per tile
+     * of the grid; the populated tiles are kept in the order they were allocated.
+     *
+     * A tile size <= 0 gives a single tile covering the whole coadd, allocated at construction.
+     *
+     * @ingroup coadd::kaiser
+     */
+    class CoaddTileMap {
+    public:
+        typedef CoaddTile::MaskedImageD MaskedImageD;
+        typedef CoaddTile::DepthMap DepthMap;
+
+        explicit CoaddTileMap(
+            int width,
+            int height,
+            int tileSize
+        );
+        virtual ~CoaddTileMap() {};
+
+        int getWidth() const { return _width; }
+
+        int getHeight() const { return _height; }
+
+        /// get the tile size; <= 0 if there is a single tile covering the coadd
+        int getTileSize() const { return _tileSize; }
+
+        int getNTilesX() const { return _nTilesX; }
+
+        int getNTilesY() const { return _nTilesY; }
+
+        /// get the x index of the tile containing x (an index relative to the origin of the coadd)
+        int getTileIX(int x) const { return x / _tileWidth; }
+
+        /// get the y index of the tile containing y (an index relative to the origin of the coadd)
+        int getTileIY(int y) const { return y / _tileHeight; }
+
+        lsst::afw::image::BBox getTileBBox(int ix, int iy) const;
+
+        /// get the number of populated (allocated) tiles
+        int getNPopulatedTiles() const { return static_cast<int>(_tileList.size()); }
+
+        /// get a populated tile, in order of allocation; i must be in the range [0, getNPopulatedTiles())
+        CoaddTile const &getPopulatedTile(int i) const { return _tileList[i]; }
+
+        /// get the tile at (ix, iy) if it is populated, else null; ix and iy must be valid
+        CoaddTile const *findTile(int ix, int iy) const {
+            int const listIndex = _directory[(iy * _nTilesX) + ix];
+            return (listIndex < 0) ? 0 : &_tileList[listIndex];
+        }
+
+        CoaddTile const &getOrAddTile(int ix, int iy);
+
+        void getRegion(
+            lsst::afw::image::BBox const &bbox,
+            MaskedImageD &maskedImage,
+            DepthMap &depthMap
+        ) const;
+
+        void getRegion(
+            lsst::afw::image::BBox const &bbox,
+            MaskedImageD &maskedImage
+        ) const;
+
+        void getRegion(
+            lsst::afw::image::BBox const &bbox,
+            DepthMap &depthMap
+        ) const;
+
+        void setRegion(
+            lsst::afw::image::BBox const &bbox,
+            MaskedImageD const &maskedImage,
+            DepthMap const &depthMap
+        );
+
+    private:
+        int _width;
+        int _height;
+        int _tileSize;
+        int _tileWidth;
+        int _tileHeight;
+        int _nTilesX;
+        int _nTilesY;
+        std::vector<int> _directory;    ///< index in _tileList of each tile of the grid (x varies fastest);
+                                        ///< -1 if not populated
+        std::vector<CoaddTile> _tileList;   ///< populated tiles
+
+        void checkRegion(lsst::afw::image::BBox const &bbox, int width, int height) const;
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_COADDTILEMAP_H)
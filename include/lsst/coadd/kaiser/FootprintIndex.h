@@ -0,0 +1,133 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_FOOTPRINTINDEX_H
+#define LSST_COADD_KAISER_FOOTPRINTINDEX_H
+/**
+* @brief Spatial index of the footprints of exposures on a coadd, to find the exposures that overlap a patch
+*
+* @file
+*/
+#include <string>
+#include <vector>
+
+#include "boost/shared_ptr.hpp"
+
+#include "lsst/afw/image.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    int const NOverlapEdgeSamples = 9;  ///< number of points sampled along each edge by computeOverlapBBox
+
+    lsst::afw::image::BBox computeOverlapBBox(
+        lsst::afw::image::Wcs const &srcWcs,
+        lsst::afw::image::BBox const &srcBBox,
+        lsst::afw::image::Wcs const &coaddWcs,
+        int coaddWidth,
+        int coaddHeight
+    );
+
+    /**
+     * @brief Footprints of exposures on a coadd, indexed by an R-tree so the exposures that overlap
+     * a region (e.g. a patch) of the coadd can be found quickly
+     *
+     * Adding an exposure by path reads only the header of its image file (for its size and WCS),
+     * so the footprints of all inputs can be found before any is read, convolved or warped;
+     * inputs that do not overlap a patch need never be read.
+     *
+     * Each footprint is the bounding box (in coadd pixels) of the region of the coadd that addComponent
+     * would consider for the exposure. The R-tree is bulk loaded (sort-tile-recursive) when first searched
+     * after footprints are added.
+     *
+     * @ingroup coadd::kaiser
+     */
+    class FootprintIndex {
+    public:
+        typedef boost::shared_ptr<FootprintIndex> Ptr;
+        typedef boost::shared_ptr<FootprintIndex const> ConstPtr;
+
+        static int const NodeCapacity = 16; ///< maximum number of children of each node of the R-tree
+
+        explicit FootprintIndex(
+            lsst::afw::image::Wcs const &coaddWcs,
+            int coaddWidth,
+            int coaddHeight
+        );
+        virtual ~FootprintIndex() {};
+
+        int addFootprint(
+            lsst::afw::image::Wcs const &wcs,
+            lsst::afw::image::BBox const &bbox
+        );
+
+        int addExposure(
+            std::string const &exposurePath,
+            int hdu = 0
+        );
+
+        /// get the number of footprints added
+        int getNFootprints() const { return static_cast<int>(_footprintList.size()); }
+
+        lsst::afw::image::BBox getFootprint(int i) const;
+
+        std::vector<int> findOverlapping(lsst::afw::image::BBox const &bbox) const;
+
+        lsst::afw::image::BBox getPatchBBox(int ix, int iy, int patchSize) const;
+
+        int getCoaddWidth() const { return _coaddWidth; }
+
+        int getCoaddHeight() const { return _coaddHeight; }
+
+    private:
+        /**
+         * @brief A node of the R-tree: a bounding box and either a range of child nodes or a footprint
+         */
+        struct Node {
+            int x0;
+            int y0;
+            int x1;
+            int y1;
+            int begin;  ///< index of the first child node, or of the footprint if end < 0
+            int end;    ///< index of one past the last child node; < 0 if this is a footprint
+
+            Node(int x0_, int y0_, int x1_, int y1_, int begin_, int end_) :
+                x0(x0_), y0(y0_), x1(x1_), y1(y1_), begin(begin_), end(end_) {}
+        };
+
+        lsst::afw::image::Wcs::Ptr _coaddWcsPtr;
+        int _coaddWidth;
+        int _coaddHeight;
+        std::vector<lsst::afw::image::BBox> _footprintList;
+        mutable std::vector<Node> _nodeList;    ///< nodes of the R-tree, each level after the one below it;
+                                                ///< the root is last
+        mutable bool _isBuilt;  ///< is the R-tree up to date?
+
+        void build() const;
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_FOOTPRINTINDEX_H)
@@ -0,0 +1,137 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_KAISERCOADD_H
+#define LSST_COADD_KAISER_KAISERCOADD_H
+/**
+* @brief Accumulator for a Kaiser coadd
+*
+* @file
+*/
+#include <vector>
+
+#include "boost/cstdint.hpp"
+#include "boost/shared_ptr.hpp"
+
+#include "lsst/daf/base/Citizen.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/CoaddComponent.h"
+#include "lsst/coadd/kaiser/CoaddTileMap.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    class CoaddCheckpoint;
+
+    /**
+     * @brief A Kaiser coadd: the sum of CoaddComponents, each scaled by 1/sigmaSq and warped to the coadd WCS
+     *
+     * Each component is scaled, warped (using a Lanczos kernel), masked and added to the coadd
+     * in a single pass, without an intermediate coadd-sized image.
+     *
+     * To also avoid a component-sized blurred image, set the warp tile size: each tile of the coadd then
+     * blurs (for a lazy component) only the part of the science exposure it needs and warps it at once,
+     * mapping coadd pixels to the component with the WCS linearized over the tile.
+     *
+     * For a wide-field coadd with patchy coverage, set the coadd tile size: the coadd and depth map are then
+     * stored in tiles that are allocated when first written (see CoaddTileMap), so memory scales with
+     * the area covered rather than the bounding box, and the dense coadd is only made when asked for
+     * (e.g. to write it out).
+     *
+     * @ingroup coadd::kaiser
+     */
+    class KaiserCoadd : public lsst::daf::base::Citizen {
+    public:
+        typedef boost::shared_ptr<KaiserCoadd> Ptr;
+        typedef boost::shared_ptr<KaiserCoadd const> ConstPtr;
+        typedef lsst::afw::image::Exposure<double, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> ExposureD;
+        typedef CoaddTileMap::MaskedImageD MaskedImageD;
+        typedef CoaddTileMap::DepthMap DepthMap;
+        typedef lsst::afw::image::Image<double> PsfImage;
+
+        explicit KaiserCoadd(
+            int width,
+            int height,
+            lsst::afw::image::Wcs const &wcs,
+            lsst::afw::image::MaskPixel badPixelMask,
+            int warpingKernelOrder = 3,
+            int coaddTileSize = 0
+        );
+        virtual ~KaiserCoadd() {};
+
+        template <typename PixelT>
+        int addComponent(CoaddComponent<PixelT> const &coaddComponent);
+
+        ExposureD getExposure() const;
+
+        MaskedImageD getMaskedImage() const;
+
+        DepthMap getDepthMap() const;
+
+        /// get the tiles in which the coadd and depth map are stored
+        CoaddTileMap const &getTileMap() const { return _tileMap; }
+
+        /// are the coadd and depth map stored in tiles allocated on first write?
+        bool isSparse() const { return _tileMap.getTileSize() > 0; }
+
+        int getWidth() const { return _tileMap.getWidth(); }
+
+        int getHeight() const { return _tileMap.getHeight(); }
+
+        /// get the WCS of the coadd
+        lsst::afw::image::Wcs::Ptr getWcs() const { return _wcsPtr; }
+
+        /// get the sum of blurred PSF images, each scaled by 1/sigmaSq; empty until a component is added
+        PsfImage getBlurredPsfImage() const { return _blurredPsfImage; }
+
+        /// get the number of components added that overlap the coadd
+        int getNComponents() const { return _nComponents; }
+
+        lsst::afw::image::MaskPixel getBadPixelMask() const { return _badPixelMask; }
+
+        int getWarpingKernelOrder() const { return _warpingKernelOrder; }
+
+        int getWarpTileSize() const { return _warpTileSize; }
+        /// set the width and height (pixels) of the coadd tiles in which components are added;
+        /// if <= 0 then each component is added as one region with the exact WCS at every pixel
+        void setWarpTileSize(int warpTileSize) { _warpTileSize = warpTileSize; }
+
+    private:
+        friend class CoaddCheckpoint;
+
+        lsst::afw::image::Wcs::Ptr _wcsPtr;
+        CoaddTileMap _tileMap;
+        PsfImage _blurredPsfImage;
+        lsst::afw::image::MaskPixel _badPixelMask;
+        int _warpingKernelOrder;
+        int _warpTileSize;
+        int _nComponents;
+        std::vector<lsst::afw::image::BBox> _modifiedBBoxList; ///< regions modified since last checkpoint
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_KAISERCOADD_H)
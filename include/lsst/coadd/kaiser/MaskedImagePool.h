@@ -0,0 +1,102 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_MASKEDIMAGEPOOL_H
+#define LSST_COADD_KAISER_MASKEDIMAGEPOOL_H
+/**
+* @brief Pool of reusable masked images
+*
+* @file
+*/
+#include <vector>
+
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/mutex.hpp"
+
+#include "lsst/afw/image.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief A pool of masked images that may be reused, to avoid repeatedly allocating large images
+     *
+     * get returns a free masked image of the requested size from the pool, if there is one,
+     * else allocates a new one; release returns a masked image to the pool once its owner is done with it.
+     * Only the most recently released maxFree masked images are kept.
+     *
+     * The pool may be shared by several threads.
+     *
+     * @tparam PixelT  pixel type of the image plane
+     *
+     * @ingroup coadd::kaiser
+     */
+    template <typename PixelT>
+    class MaskedImagePool {
+    public:
+        typedef boost::shared_ptr<MaskedImagePool> Ptr;
+        typedef boost::shared_ptr<MaskedImagePool const> ConstPtr;
+        typedef lsst::afw::image::MaskedImage<PixelT, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> MaskedImageT;
+
+        explicit MaskedImagePool(
+            int maxFree = 1
+        );
+        virtual ~MaskedImagePool() {};
+
+        MaskedImageT get(
+            int width,
+            int height
+        );
+
+        void release(
+            MaskedImageT const &maskedImage
+        );
+
+        /// get the maximum number of free masked images kept
+        int getMaxFree() const { return _maxFree; }
+
+        /// get the number of free masked images
+        int getNFree() const;
+
+        /// get the number of masked images allocated by get
+        int getNAllocated() const;
+
+        /// get the number of masked images reused by get
+        int getNReused() const;
+
+        void clear();
+
+    private:
+        int _maxFree;
+        std::vector<MaskedImageT> _freeList;    ///< free masked images, oldest first
+        int _nAllocated;
+        int _nReused;
+        mutable boost::mutex _mutex;
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_MASKEDIMAGEPOOL_H)
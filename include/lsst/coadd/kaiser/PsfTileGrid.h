@@ -0,0 +1,114 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_PSFTILEGRID_H
+#define LSST_COADD_KAISER_PSFTILEGRID_H
+/**
+* @brief PSF evaluated on a grid of tiles, for fast convolution with a spatially varying PSF
+*
+* @file
+*/
+#include <vector>
+
+#include "boost/shared_ptr.hpp"
+
+#include "lsst/daf/base/Citizen.h"
+#include "lsst/afw/image.h"
+#include "lsst/afw/math.h"
+#include "lsst/coadd/kaiser/fftConvolve.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief A PSF kernel evaluated at the center of each tile of a regular grid covering an image
+     *
+     * The kernel image and the reflected kernel image of each tile are computed once and cached,
+     * so convolving with a spatially varying PSF costs about the same as convolving with a fixed PSF.
+     *
+     * @ingroup coadd::kaiser
+     */
+    class PsfTileGrid : public lsst::daf::base::Citizen {
+    public:
+        typedef boost::shared_ptr<PsfTileGrid> Ptr;
+        typedef boost::shared_ptr<PsfTileGrid const> ConstPtr;
+        typedef lsst::afw::image::Image<lsst::afw::math::Kernel::Pixel> KernelImage;
+
+        explicit PsfTileGrid(
+            lsst::afw::math::Kernel const &psfKernel,
+            lsst::afw::image::BBox const &bbox,
+            int nTilesX,
+            int nTilesY,
+            bool normalizePsf = true
+        );
+        virtual ~PsfTileGrid() {};
+
+        /// bounding box of the image covered by the grid, in parent pixel coordinates
+        lsst::afw::image::BBox getBBox() const { return _bbox; }
+
+        int getNTilesX() const { return static_cast<int>(_xBounds.size()) - 1; }
+        int getNTilesY() const { return static_cast<int>(_yBounds.size()) - 1; }
+
+        int getKernelWidth() const { return _kernelWidth; }
+        int getKernelHeight() const { return _kernelHeight; }
+
+        lsst::afw::image::BBox getTileBBox(int ix, int iy) const;
+
+        lsst::afw::image::PointD getTileCenter(int ix, int iy) const;
+
+        KernelImage::ConstPtr getKernelImage(int ix, int iy, bool reflected = false) const;
+
+        lsst::afw::math::Kernel::ConstPtr getKernel(int ix, int iy, bool reflected = false) const;
+
+    private:
+        lsst::afw::image::BBox _bbox;
+        int _kernelWidth;
+        int _kernelHeight;
+        std::vector<int> _xBounds;  ///< x index of the start of each tile, plus one past the last tile
+        std::vector<int> _yBounds;  ///< y index of the start of each tile, plus one past the last tile
+        std::vector<KernelImage::Ptr> _kernelImageList;
+        std::vector<KernelImage::Ptr> _reflKernelImageList;
+        std::vector<lsst::afw::math::Kernel::Ptr> _kernelList;
+        std::vector<lsst::afw::math::Kernel::Ptr> _reflKernelList;
+
+        int getTileIndex(int ix, int iy) const;
+    };
+
+    template <typename OutPixelT, typename InPixelT>
+    ConvolutionMethod convolveWithPsfTiles(
+        lsst::afw::image::MaskedImage<OutPixelT, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> &convolvedImage,
+        lsst::afw::image::MaskedImage<InPixelT, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> const &inImage,
+        PsfTileGrid const &psfTileGrid,
+        bool useReflectedPsf = false,
+        bool blendTiles = false,
+        ConvolutionMethod convolutionMethod = AUTO_CONVOLUTION,
+        int fftSize = 0
+    );
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_PSFTILEGRID_H)
@@ -0,0 +1,163 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_SIGMASQMAP_H
+#define LSST_COADD_KAISER_SIGMASQMAP_H
+/**
+* @brief Spatially resolved sigma squared: the median variance of the unmasked pixels in each cell of a grid
+*
+* @file
+*/
+#include <cmath>
+#include <vector>
+
+#include "boost/shared_ptr.hpp"
+
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/BinapproxSketch.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief Median variance of the unmasked pixels in each cell of a regular grid covering an image,
+     * interpolated bilinearly between cell centers
+     *
+     * Use this instead of a single sigmaSq when the noise varies across an exposure
+     * (e.g. from amplifier to amplifier, or due to vignetting).
+     *
+     * The variance is histogrammed in a single pass, one BinapproxSketch per cell, so the image may be added
+     * all at once or in strips (e.g. as read by a StripSource), and the work may be split across threads
+     * by rows of cells. The bin range of each sketch is set from the mean +/- 3 sigma of about
+     * CellSampleSize unmasked pixels on a grid spread over the cell, with bins at most 2 sigma / CellNBins
+     * wide; so each cell's median is accurate to about 1/CellNBins of the standard deviation of the variance
+     * in that cell, and each cell uses at most about 10 kB (e.g. 2.5 MB for a 16 x 16 grid). The range is set
+     * per cell rather than from a prior for the whole image because the variance of one amplifier may differ
+     * from that of the rest of the image by many times the standard deviation of the whole image.
+     * If the image is added in strips the grid covers only the part of the cell in the first strip
+     * that overlaps it, so strips that each hold whole rows of cells give the same result as adding
+     * the image all at once, and shorter strips may give a slightly different one.
+     *
+     * Call finish once all pixels have been added; that computes the median of each cell and frees
+     * the histograms. Cells with no unmasked pixels, a median that is not positive, or a median outside
+     * the binned range (if the sample of the cell was not representative) are given the median
+     * of the other cells.
+     *
+     * @ingroup coadd::kaiser
+     */
+    class SigmaSqMap {
+    public:
+        typedef boost::shared_ptr<SigmaSqMap> Ptr;
+        typedef boost::shared_ptr<SigmaSqMap const> ConstPtr;
+
+        static int const CellNBins = 200;       ///< nBins of the BinapproxSketch of each cell
+        static int const CellSampleSize = 1000; ///< sampleSize of the BinapproxSketch of each cell
+
+        explicit SigmaSqMap(
+            lsst::afw::image::BBox const &bbox,
+            int nCellsX,
+            int nCellsY
+        );
+        virtual ~SigmaSqMap() {};
+
+        template <typename PixelT>
+        void addMaskedImage(
+            lsst::afw::image::MaskedImage<PixelT, lsst::afw::image::MaskPixel,
+                lsst::afw::image::VariancePixel> const &maskedImage,
+            int nThreads = 1
+        );
+
+        void finish();
+
+        /// has finish been called?
+        bool isFinished() const { return !_sigmaSqList.empty(); }
+
+        /// bounding box of the image covered by the grid, in parent pixel coordinates
+        lsst::afw::image::BBox getBBox() const { return _bbox; }
+
+        int getNCellsX() const { return static_cast<int>(_xBounds.size()) - 1; }
+        int getNCellsY() const { return static_cast<int>(_yBounds.size()) - 1; }
+
+        lsst::afw::image::BBox getCellBBox(int ix, int iy) const;
+
+        double getCellSigmaSq(int ix, int iy) const;
+
+        int getCellCount(int ix, int iy) const;
+
+        /**
+         * @brief Get sigma squared at a point, interpolated bilinearly between cell centers
+         *
+         * Beyond the outermost cell centers the value of the nearest edge is used. Cell centers are treated
+         * as evenly spaced; for cells of unequal size (by a pixel) this shifts the interpolation by less
+         * than half a pixel. Fast enough to call for every pixel; must not be called before finish.
+         */
+        double getSigmaSq(
+            double xInd,    ///< x index, relative to the lower left corner of the bounding box
+            double yInd     ///< y index, relative to the lower left corner of the bounding box
+        ) const {
+            int ix0, ix1, iy0, iy1;
+            double xFrac, yFrac;
+            findInterpCells(xInd, _bbox.getWidth(), getNCellsX(), ix0, ix1, xFrac);
+            findInterpCells(yInd, _bbox.getHeight(), getNCellsY(), iy0, iy1, yFrac);
+            int const nCellsX = getNCellsX();
+            double const lower = _sigmaSqList[(iy0 * nCellsX) + ix0]
+                + (xFrac * (_sigmaSqList[(iy0 * nCellsX) + ix1] - _sigmaSqList[(iy0 * nCellsX) + ix0]));
+            double const upper = _sigmaSqList[(iy1 * nCellsX) + ix0]
+                + (xFrac * (_sigmaSqList[(iy1 * nCellsX) + ix1] - _sigmaSqList[(iy1 * nCellsX) + ix0]));
+            return lower + (yFrac * (upper - lower));
+        }
+
+    private:
+        lsst::afw::image::BBox _bbox;
+        std::vector<int> _xBounds;  ///< x index of the start of each cell, plus one past the last cell
+        std::vector<int> _yBounds;  ///< y index of the start of each cell, plus one past the last cell
+        std::vector<boost::shared_ptr<BinapproxSketch> > _sketchList;   ///< histogram of each cell;
+                                                                        ///< empty once finished
+        std::vector<int> _countList;        ///< number of unmasked pixels in each cell
+        std::vector<double> _sigmaSqList;   ///< sigmaSq of each cell; empty until finished
+
+        int getCellIndex(int ix, int iy) const;
+
+        /// find the two cells whose centers bracket ind along one axis, and the fractional distance from i0
+        static void findInterpCells(double ind, int size, int nCells, int &i0, int &i1, double &frac) {
+            double const pos = ((ind + 0.5) * static_cast<double>(nCells) / static_cast<double>(size)) - 0.5;
+            double const posFloor = std::floor(pos);
+            if (pos <= 0) {
+                i0 = i1 = 0;
+                frac = 0;
+            } else if (posFloor >= nCells - 1) {
+                i0 = i1 = nCells - 1;
+                frac = 0;
+            } else {
+                i0 = static_cast<int>(posFloor);
+                i1 = i0 + 1;
+                frac = pos - posFloor;
+            }
+        }
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_SIGMASQMAP_H)
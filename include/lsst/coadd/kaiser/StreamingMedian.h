@@ -0,0 +1,102 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_STREAMINGMEDIAN_H
+#define LSST_COADD_KAISER_STREAMINGMEDIAN_H
+/**
+* @brief Single-pass approximate median of a stream of values
+*
+* @file
+*/
+#include <vector>
+
+#include "boost/cstdint.hpp"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief Accumulate an approximate median of a stream of values in a single pass, using fixed memory
+     *
+     * Unlike medianBinapprox this does not need the data up front (to compute the mean and standard
+     * deviation), so it can be fed one row or strip at a time. Values are histogrammed by the leading bits
+     * of their single-precision representation, giving bins whose width is about 0.2% of the value
+     * (for any value, regardless of the range of the data); the median is then interpolated within its bin.
+     * The histogram uses about 2 MB of memory. Coarser bins use less: each increment of binShift
+     * doubles the width of the bins and halves the memory (e.g. binShift=16 gives bins about 0.8% wide
+     * in 512 kB). To accumulate many medians at once (e.g. one per cell of a grid) use BinapproxSketch,
+     * whose histogram is far smaller.
+     *
+     * Non-finite values are ignored.
+     *
+     * @ingroup coadd::kaiser
+     */
+    class StreamingMedian {
+    public:
+        static int const DefaultBinShift = 14;  ///< default number of low bits of the float representation ignored
+
+        explicit StreamingMedian(
+            int binShift = DefaultBinShift
+        );
+
+        /// add one value
+        void addValue(double value) {
+            if (!(value - value == 0)) {
+                return; // NaN or inf
+            }
+            ++_binCounts[getBin(value)];
+            ++_count;
+        }
+
+        /// add a range of values
+        template <class InputIterator>
+        void addValues(InputIterator first, InputIterator last) {
+            for (InputIterator it = first; it != last; ++it) {
+                addValue(static_cast<double>(*it));
+            }
+        }
+
+        /// get the number of (finite) values added so far
+        boost::uint64_t getCount() const { return _count; }
+
+        /// get the number of low bits of the float representation ignored when histogramming
+        int getBinShift() const { return _binShift; }
+
+        double getMedian() const;
+
+        void reset();
+
+    private:
+        int _binShift;  ///< number of low bits of the float representation ignored
+        std::vector<boost::uint64_t> _binCounts;
+        boost::uint64_t _count;
+
+        int getBin(double value) const;
+        double getBinLowerEdge(int bin) const;
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_STREAMINGMEDIAN_H)
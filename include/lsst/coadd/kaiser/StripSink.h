@@ -0,0 +1,96 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_STRIPSINK_H
+#define LSST_COADD_KAISER_STRIPSINK_H
+/**
+* @brief Sinks for horizontal strips of a blurred exposure, for streaming CoaddComponent
+*
+* @file
+*/
+#include "boost/shared_ptr.hpp"
+
+#include "lsst/afw/image.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief Abstract sink for horizontal strips of a blurred exposure
+     *
+     * Subclass this (in C++ or Python) to write strips to disk, warp them onto a coadd, etc.
+     *
+     * @tparam PixelT  pixel type of the blurred exposure
+     *
+     * @ingroup coadd::kaiser
+     */
+    template <typename PixelT>
+    class StripSink {
+    public:
+        typedef boost::shared_ptr<StripSink> Ptr;
+        typedef lsst::afw::image::MaskedImage<PixelT, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> MaskedImageT;
+
+        virtual ~StripSink() {};
+
+        /**
+         * @brief Process one strip
+         *
+         * Strips are delivered in order of increasing y and together cover the whole exposure once.
+         * The strip's xy0 is its position in parent pixel coordinates. The strip's pixels are only valid
+         * during this call; make a deep copy of anything that must be kept.
+         */
+        virtual void processStrip(
+            MaskedImageT const &strip   ///< blurred strip
+        ) = 0;
+    };
+
+    /**
+     * @brief Strip sink that copies each strip into a MaskedImage
+     *
+     * Mostly useful for testing, since it holds the whole blurred image in memory.
+     *
+     * @ingroup coadd::kaiser
+     */
+    template <typename PixelT>
+    class MaskedImageStripSink : public StripSink<PixelT> {
+    public:
+        typedef typename StripSink<PixelT>::MaskedImageT MaskedImageT;
+
+        explicit MaskedImageStripSink(MaskedImageT &maskedImage);
+        virtual ~MaskedImageStripSink() {};
+
+        virtual void processStrip(MaskedImageT const &strip);
+
+        /// get the masked image (a shallow copy of the one passed to the constructor)
+        MaskedImageT getMaskedImage() const { return _maskedImage; }
+
+    private:
+        MaskedImageT _maskedImage;
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_STRIPSINK_H)
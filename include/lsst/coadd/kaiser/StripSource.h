@@ -0,0 +1,120 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_STRIPSOURCE_H
+#define LSST_COADD_KAISER_STRIPSOURCE_H
+/**
+* @brief Sources of horizontal strips of a science exposure, for streaming CoaddComponent
+*
+* @file
+*/
+#include <string>
+
+#include "boost/shared_ptr.hpp"
+
+#include "lsst/afw/image.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief Abstract source of horizontal strips of a science exposure
+     *
+     * @ingroup coadd::kaiser
+     */
+    class StripSource {
+    public:
+        typedef boost::shared_ptr<StripSource> Ptr;
+        typedef lsst::afw::image::MaskedImage<float, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> MaskedImageF;
+
+        virtual ~StripSource() {};
+
+        /// bounding box of the whole exposure, in parent pixel coordinates
+        virtual lsst::afw::image::BBox getBBox() const = 0;
+
+        /// WCS of the whole exposure; a null pointer if none
+        virtual lsst::afw::image::Wcs::Ptr getWcs() const = 0;
+
+        /**
+         * @brief Read a strip of the exposure
+         *
+         * @return the strip, with xy0 set to its position in parent pixel coordinates
+         */
+        virtual MaskedImageF readStrip(
+            int y0,     ///< index of first row, relative to the start of the exposure
+            int height  ///< number of rows
+        ) = 0;
+    };
+
+    /**
+     * @brief Strip source for an exposure in memory
+     *
+     * Strips are views into the exposure; no pixels are copied.
+     *
+     * @ingroup coadd::kaiser
+     */
+    class ExposureStripSource : public StripSource {
+    public:
+        typedef lsst::afw::image::Exposure<float, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> ExposureF;
+
+        explicit ExposureStripSource(ExposureF const &exposure);
+        virtual ~ExposureStripSource() {};
+
+        virtual lsst::afw::image::BBox getBBox() const;
+        virtual lsst::afw::image::Wcs::Ptr getWcs() const;
+        virtual MaskedImageF readStrip(int y0, int height);
+
+    private:
+        ExposureF _exposure;
+    };
+
+    /**
+     * @brief Strip source for an exposure in a FITS file
+     *
+     * Only the requested strip is read, so the whole exposure never needs to be in memory.
+     *
+     * @ingroup coadd::kaiser
+     */
+    class FitsStripSource : public StripSource {
+    public:
+        explicit FitsStripSource(std::string const &baseName, int hdu = 0);
+        virtual ~FitsStripSource() {};
+
+        virtual lsst::afw::image::BBox getBBox() const;
+        virtual lsst::afw::image::Wcs::Ptr getWcs() const;
+        virtual MaskedImageF readStrip(int y0, int height);
+
+    private:
+        std::string _baseName;
+        int _hdu;
+        lsst::afw::image::BBox _bbox;
+        lsst::afw::image::Wcs::Ptr _wcsPtr;
+    };
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_STRIPSOURCE_H)
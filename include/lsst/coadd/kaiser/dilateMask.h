@@ -0,0 +1,51 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_DILATEMASK_H
+#define LSST_COADD_KAISER_DILATEMASK_H
+/**
+* @brief define dilateMask
+*
+* @file
+*/
+#include "lsst/afw/image.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    int const DilateMaskBandHeight = 64;    ///< minimum number of output rows processed at a time by dilateMask
+
+    void dilateMask(
+        lsst::afw::image::Mask<lsst::afw::image::MaskPixel> &outMask,
+        lsst::afw::image::Mask<lsst::afw::image::MaskPixel> const &inMask,
+        int width,
+        int height,
+        int ctrX,
+        int ctrY
+    );
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_DILATEMASK_H)
@@ -0,0 +1,110 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_FFTCONVOLVE_H
+#define LSST_COADD_KAISER_FFTCONVOLVE_H
+/**
+* @brief FFT-based and separable convolution of masked images, and selection between convolution methods
+*
+* @file
+*/
+#include <vector>
+
+#include "lsst/afw/image.h"
+#include "lsst/afw/math.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief Convolution algorithm
+     */
+    enum ConvolutionMethod {
+        AUTO_CONVOLUTION = 0,   ///< pick DIRECT_CONVOLUTION or FFT_CONVOLUTION based on estimated cost
+        DIRECT_CONVOLUTION,     ///< lsst::afw::math::convolve
+        FFT_CONVOLUTION,        ///< fftConvolve
+        SEPARABLE_CONVOLUTION   ///< separableConvolve; only for kernels that decomposeSeparable can decompose
+    };
+
+    int const DefaultMaxSeparableTerms = 3; ///< default maximum number of terms for decomposeSeparable
+
+    int decomposeSeparable(
+        std::vector<std::vector<double> > &xVectorList,
+        std::vector<std::vector<double> > &yVectorList,
+        lsst::afw::math::Kernel const &kernel,
+        bool doNormalize,
+        int maxTerms = DefaultMaxSeparableTerms
+    );
+
+    int decomposeSeparable(
+        std::vector<std::vector<double> > &xVectorList,
+        std::vector<std::vector<double> > &yVectorList,
+        lsst::afw::image::Image<lsst::afw::math::Kernel::Pixel> const &kernelImage,
+        int maxTerms = DefaultMaxSeparableTerms
+    );
+
+    ConvolutionMethod chooseConvolutionMethod(
+        int width,
+        int height,
+        lsst::afw::math::Kernel const &kernel,
+        int fftSize = 0
+    );
+
+    template <typename OutPixelT, typename InPixelT>
+    void fftConvolve(
+        lsst::afw::image::MaskedImage<OutPixelT, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> &convolvedImage,
+        lsst::afw::image::MaskedImage<InPixelT, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> const &inImage,
+        lsst::afw::math::Kernel const &kernel,
+        bool doNormalize,
+        int fftSize = 0
+    );
+
+    template <typename OutPixelT, typename InPixelT>
+    void separableConvolve(
+        lsst::afw::image::MaskedImage<OutPixelT, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> &convolvedImage,
+        lsst::afw::image::MaskedImage<InPixelT, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> const &inImage,
+        lsst::afw::math::Kernel const &kernel,
+        bool doNormalize
+    );
+
+    template <typename OutPixelT, typename InPixelT>
+    ConvolutionMethod convolveMaskedImage(
+        lsst::afw::image::MaskedImage<OutPixelT, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> &convolvedImage,
+        lsst::afw::image::MaskedImage<InPixelT, lsst::afw::image::MaskPixel,
+            lsst::afw::image::VariancePixel> const &inImage,
+        lsst::afw::math::Kernel const &kernel,
+        bool doNormalize,
+        ConvolutionMethod convolutionMethod = AUTO_CONVOLUTION,
+        int fftSize = 0
+    );
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_FFTCONVOLVE_H)
@@ -0,0 +1,48 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_IMAGEBUFFER_H
+#define LSST_COADD_KAISER_IMAGEBUFFER_H
+/**
+* @brief define getPixelAddress and getRowStride, which describe the pixel memory of an image
+*
+* @file
+*/
+#include <cstddef>
+
+#include "lsst/afw/image.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    template <typename PixelT>
+    std::size_t getPixelAddress(lsst::afw::image::ImageBase<PixelT> const &image);
+
+    template <typename PixelT>
+    int getRowStride(lsst::afw::image::ImageBase<PixelT> const &image);
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_IMAGEBUFFER_H)
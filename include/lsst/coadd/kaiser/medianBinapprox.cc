@@ -30,6 +30,8 @@
 * @author Ryan J. Tibshirani, adapted from C to C++ by Russell Owen.
 */
 #include <cmath>
+#include <cstddef>
+#include <iterator>
 #include <valarray>
 #include <stdexcept>
 
@@ -37,6 +39,181 @@
 
 namespace pexExcept = lsst::pex::exceptions;
 
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+namespace detail {
+
+    /**
+    * @brief A mask "iterator" for unmasked data: every value is good
+    */
+    struct NullMaskIterator {
+        lsst::afw::image::MaskPixel operator*() const { return 0; }
+        NullMaskIterator &operator++() { return *this; }
+    };
+
+    /**
+    * @brief Forward iterator over an nX x nY array of values in memory with arbitrary (element) strides,
+    * x varying fastest
+    *
+    * Strides may be zero or negative (as for numpy broadcast or reversed arrays), so the position is
+    * tracked by an element count rather than by the pointer.
+    */
+    template <typename T>
+    class StridedIterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T const *pointer;
+        typedef T const &reference;
+
+        StridedIterator(T const *ptr, int nX, int xStride, int yStride, long int index = 0) :
+            _ptr(ptr), _index(index), _x(0), _nX(nX), _xStride(xStride),
+            _rowStep(static_cast<std::ptrdiff_t>(yStride) - (static_cast<std::ptrdiff_t>(nX) * xStride)) {}
+
+        T const &operator*() const { return *_ptr; }
+
+        StridedIterator &operator++() {
+            _ptr += _xStride;
+            ++_index;
+            if (++_x == _nX) {
+                _x = 0;
+                _ptr += _rowStep;
+            }
+            return *this;
+        }
+
+        bool operator==(StridedIterator const &rhs) const { return _index == rhs._index; }
+        bool operator!=(StridedIterator const &rhs) const { return _index != rhs._index; }
+
+    private:
+        T const *_ptr;
+        long int _index;
+        int _x;
+        int _nX;
+        std::ptrdiff_t _xStride;
+        std::ptrdiff_t _rowStep;    ///< pointer step from one past the end of a row to the start of the next
+    };
+
+    /**
+    * @brief Compute the median of the unmasked values using the binapprox algorithm.
+    *
+    * A value is used if (mask value & badMask) == 0, where the mask value is read from a mask iterator
+    * that advances in step with the data iterator. Nothing is allocated except the bins.
+    *
+    * @throw pexExcept::RangeErrorException if there are no good values or nBins < 2
+    */
+    template <class ForwardIterator, class MaskIterator>
+    typename std::iterator_traits<ForwardIterator>::value_type medianBinapproxImpl(
+        ForwardIterator first,  ///< iterator to first element of array
+        ForwardIterator last,   ///< iterator to last+1 element of array
+        MaskIterator maskFirst, ///< iterator to mask value of first element of array
+        lsst::afw::image::MaskPixel badMask,    ///< ignore values whose mask value has any of these bits set
+        int nBins,              ///< number of bins to use; 1000 is a typical value
+        long int *nGoodPtr = 0  ///< if not null, set to the number of good values
+    ) {
+        if (nBins < 2) {
+            throw LSST_EXCEPT(pexExcept::RangeErrorException, "nBins < 2");
+        }
+
+        typedef typename std::iterator_traits<ForwardIterator>::value_type ValueType;
+
+        // Compute the number of good elements (n), mean (mu) and standard deviation (sigma)
+        long int n = 0;
+        double sum = 0;
+        MaskIterator maskIt = maskFirst;
+        for (ForwardIterator it = first; it != last; ++it, ++maskIt) {
+            if ((*maskIt & badMask) == 0) {
+                n++;
+                sum += static_cast<double>(*it);
+            }
+        }
+        if (nGoodPtr) {
+            *nGoodPtr = n;
+        }
+        if (n == 0) {
+            throw LSST_EXCEPT(pexExcept::RangeErrorException, "no good values");
+        }
+        double mu = sum/static_cast<double>(n);
+        if (n < 3) {
+            return static_cast<ValueType>(mu);
+        }
+
+        double sumSq = 0;
+        maskIt = maskFirst;
+        for (ForwardIterator it = first; it != last; ++it, ++maskIt) {
+            if ((*maskIt & badMask) == 0) {
+                double val = static_cast<double>(*it) - mu;
+                sumSq += val * val;
+            }
+        }
+        double sigma = std::sqrt(sumSq/static_cast<double>(n));
+
+        // Bin data across the interval [mu-sigma, mu+sigma]
+        int bottomcount = 0;
+        std::valarray<int> bincounts(nBins);
+
+        double scalefactor = static_cast<double>(nBins - 1)/(2.0 * sigma);
+        if (std::isinf(scalefactor)) {
+            // data are too closely spaced, just return mean
+            return static_cast<ValueType>(mu);
+        }
+        double leftend =  mu-sigma;
+        int bin;
+
+        maskIt = maskFirst;
+        for (ForwardIterator it = first; it != last; ++it, ++maskIt) {
+            if ((*maskIt & badMask) != 0) {
+                continue;
+            }
+            double val = static_cast<double>(*it);
+            if (val < leftend) {
+                bottomcount++;
+            } else {
+                bin = static_cast<int>((val -leftend) * scalefactor);
+                if (bin < nBins) {
+                    bincounts[bin]++;
+                }
+            }
+        }
+
+        // Find the bin that contains the median
+        if (n & 1) {
+            // n is odd
+            long int k = (n+1)/2;
+            long int count = bottomcount;
+
+            for (int i = 0; i < nBins; i++) {
+                count += bincounts[i];
+
+                if (count >= k) {
+                    return static_cast<ValueType>((static_cast<double>(i) + 0.5)/scalefactor + leftend);
+                }
+            }
+        } else {
+            // n is even
+            long int k = n / 2;
+            long int count = bottomcount;
+            
+            for (int i = 0; i < nBins; i++) {
+                count += bincounts[i];
+                
+                if (count >= k) {
+                    int j = i;
+                    while (count == k) {
+                        j++;
+                        count += bincounts[j];
+                    }
+                    return static_cast<ValueType>(static_cast<double>(i + j + 1)/(2.0 * scalefactor) + leftend);
+                }
+            }
+        }
+        throw LSST_EXCEPT(pexExcept::RuntimeErrorException, "Unexpectedly failed to return a value");
+    }
+
+}}}} // lsst::coadd::kaiser::detail
+
 /**
 * @brief Compute the median using the binapprox algorithm.
 *
@@ -59,87 +236,29 @@ typename std::iterator_traits<ForwardIterator>::value_type lsst::coadd::kaiser::
 ) {
     if (first >= last) {
         throw LSST_EXCEPT(pexExcept::RangeErrorException, "last <= first");
-    } else if (nBins < 2) {
-        throw LSST_EXCEPT(pexExcept::RangeErrorException, "nBins < 2");
     }
+    return detail::medianBinapproxImpl(first, last, detail::NullMaskIterator(), 0, nBins);
+} 
 
-    typedef typename std::iterator_traits<ForwardIterator>::value_type ValueType;
-
-    // Compute the number of elements (n), mean (mu) and standard deviation (sigma)
-    long int n = 0;
-    double sum = 0;
-    for (ForwardIterator it = first; it != last; ++it) {
-        n++;
-        sum += static_cast<double>(*it);
-    }
-    double mu = sum/static_cast<double>(n);
-    if (n < 3) {
-        return static_cast<ValueType>(mu);
-    }
-
-    double sumSq = 0;
-    for (ForwardIterator it = first; it != last; ++it) {
-        double val = static_cast<double>(*it) - mu;
-        sumSq += val * val;
-    }
-    double sigma = std::sqrt(sumSq/static_cast<double>(n));
-
-    // Bin data across the interval [mu-sigma, mu+sigma]
-    int bottomcount = 0;
-    std::valarray<int> bincounts(nBins);
-
-    double scalefactor = static_cast<double>(nBins - 1)/(2.0 * sigma);
-    if (std::isinf(sigma)) {
-        // data are too closely spaced, just return mean
-        return static_cast<ValueType>(mu);
-    }
-    double leftend =  mu-sigma;
-    int bin;
-
-    for (ForwardIterator it = first; it != last; ++it) {
-        double val = static_cast<double>(*it);
-        if (val < leftend) {
-            bottomcount++;
-        } else {
-            bin = static_cast<int>((val -leftend) * scalefactor);
-            if (bin < nBins) {
-                bincounts[bin]++;
-            }
-        }
-    }
-
-    // Find the bin that contains the median
-    if (n & 1) {
-        // n is odd
-        long int k = (n+1)/2;
-        long int count = bottomcount;
-
-        for (int i = 0; i < nBins; i++) {
-            count += bincounts[i];
-
-            if (count >= k) {
-                return static_cast<ValueType>((static_cast<double>(i) + 0.5)/scalefactor + leftend);
-            }
-        }
-    } else {
-        // n is even
-        long int k = n / 2;
-        long int count = bottomcount;
-        
-        for (int i = 0; i < nBins; i++) {
-            count += bincounts[i];
-            
-            if (count >= k) {
-                int j = i;
-                while (count == k) {
-                    j++;
-                    count += bincounts[j];
-                }
-                return static_cast<ValueType>(static_cast<double>(i + j + 1)/(2.0 * scalefactor) + leftend);
-            }
-        }
-    }
-    throw LSST_EXCEPT(pexExcept::RuntimeErrorException, "Unexpectedly failed to return a value");
+/**
+* @brief Compute the median of the unmasked elements using the binapprox algorithm.
+*
+* Like medianBinapprox, but an element is only used if the corresponding mask value
+* (*maskFirst, *++maskFirst...) has none of the bits in badMask set.
+*
+* @throw pexExcept::RangeErrorException if there are no unmasked elements or nBins < 2
+*
+* @return approximate median of unmasked elements
+*/
+template <class ForwardIterator, class MaskIterator>
+typename std::iterator_traits<ForwardIterator>::value_type lsst::coadd::kaiser::medianBinapproxMasked(
+    ForwardIterator first,  ///< iterator to first element of array
+    ForwardIterator last,   ///< iterator to last+1 element of array
+    MaskIterator maskFirst, ///< iterator to mask value of first element of array
+    lsst::afw::image::MaskPixel badMask,    ///< ignore elements whose mask value has any of these bits set
+    int nBins               ///< number of bins to use; 1000 is a typical value
+) {
+    return detail::medianBinapproxImpl(first, last, maskFirst, badMask, nBins);
 } 
 
 
@@ -167,3 +286,89 @@ T lsst::coadd::kaiser::medianBinapproxImage(
 ) {
     return medianBinapprox(image.begin(), image.end(), nBins);
 }
+
+/**
+* @brief Compute the median of the unmasked pixels of an lsst::afw::image::Image
+* using the binapprox algorithm.
+*
+* A pixel is used if the corresponding mask pixel has none of the bits in badMask set.
+* Unlike copying the good pixels to a vector and calling medianBinapprox,
+* this allocates nothing except the bins.
+*
+* @throw pexExcept::InvalidParameterException if image and mask are not the same size
+* @throw pexExcept::RangeErrorException if no unmasked pixels or nBins < 2
+*
+* @return approximate median of unmasked pixels
+*/
+template <typename T>
+T lsst::coadd::kaiser::medianBinapproxMaskedImage(
+    lsst::afw::image::Image<T> const &image,   ///< image for which to compute median
+    lsst::afw::image::Mask<lsst::afw::image::MaskPixel> const &mask,   ///< mask for image
+    lsst::afw::image::MaskPixel badMask,    ///< ignore pixels whose mask pixel has any of these bits set
+    int nBins,      ///< number of bins to use; 1000 is a typical value
+    long int *nGoodPtr  ///< if not null, set to the number of unmasked pixels (counted in the same pass)
+) {
+    if ((image.getWidth() != mask.getWidth()) || (image.getHeight() != mask.getHeight())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException, "image and mask are not the same size");
+    }
+    return detail::medianBinapproxImpl(image.begin(), image.end(), mask.begin(), badMask, nBins, nGoodPtr);
+}
+
+/**
+* @brief Compute the median of a 2-d array of values in memory using the binapprox algorithm.
+*
+* The array may have any strides, so it may be a non-contiguous view of a larger array (e.g. a numpy slice
+* or a subimage); it is read in place. The value at (x, y) is data[(x * xStride) + (y * yStride)].
+*
+* @throw pexExcept::RangeErrorException if nX < 1, nY < 1 or nBins < 2
+*
+* @return approximate median
+*/
+template <typename T>
+T lsst::coadd::kaiser::medianBinapproxBuffer(
+    T const *data,  ///< pointer to value at (0, 0)
+    int nX,         ///< number of values along x
+    int nY,         ///< number of values along y
+    int xStride,    ///< stride (elements, not bytes) between successive values along x
+    int yStride,    ///< stride (elements, not bytes) between successive values along y
+    int nBins       ///< number of bins to use; 1000 is a typical value
+) {
+    if ((nX < 1) || (nY < 1)) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException, "no values");
+    }
+    detail::StridedIterator<T> const first(data, nX, xStride, yStride);
+    detail::StridedIterator<T> const last(data, nX, xStride, yStride, static_cast<long int>(nX) * nY);
+    return detail::medianBinapproxImpl(first, last, detail::NullMaskIterator(), 0, nBins);
+}
+
+/**
+* @brief Compute the median of the unmasked values of a 2-d array in memory using the binapprox algorithm.
+*
+* Like medianBinapproxBuffer, but the value at (x, y) is only used if
+* mask[(x * maskXStride) + (y * maskYStride)] has none of the bits in badMask set.
+*
+* @throw pexExcept::RangeErrorException if nX < 1, nY < 1, there are no unmasked values or nBins < 2
+*
+* @return approximate median of unmasked values
+*/
+template <typename T>
+T lsst::coadd::kaiser::medianBinapproxMaskedBuffer(
+    T const *data,  ///< pointer to value at (0, 0)
+    int nX,         ///< number of values along x
+    int nY,         ///< number of values along y
+    int xStride,    ///< stride (elements, not bytes) between successive values along x
+    int yStride,    ///< stride (elements, not bytes) between successive values along y
+    lsst::afw::image::MaskPixel const *mask,    ///< pointer to mask value at (0, 0)
+    int maskXStride,    ///< stride (elements, not bytes) between successive mask values along x
+    int maskYStride,    ///< stride (elements, not bytes) between successive mask values along y
+    lsst::afw::image::MaskPixel badMask,    ///< ignore values whose mask value has any of these bits set
+    int nBins       ///< number of bins to use; 1000 is a typical value
+) {
+    if ((nX < 1) || (nY < 1)) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException, "no values");
+    }
+    detail::StridedIterator<T> const first(data, nX, xStride, yStride);
+    detail::StridedIterator<T> const last(data, nX, xStride, yStride, static_cast<long int>(nX) * nY);
+    detail::StridedIterator<lsst::afw::image::MaskPixel> const maskFirst(mask, nX, maskXStride, maskYStride);
+    return detail::medianBinapproxImpl(first, last, maskFirst, badMask, nBins);
+}
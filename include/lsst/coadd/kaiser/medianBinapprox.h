@@ -49,9 +49,51 @@ namespace kaiser {
         int nBins = 1000
     );
     
+    template <class ForwardIterator, class MaskIterator>
+    typename std::iterator_traits<ForwardIterator>::value_type medianBinapproxMasked(
+        ForwardIterator first,
+        ForwardIterator last,
+        MaskIterator maskFirst,
+        lsst::afw::image::MaskPixel badMask,
+        int nBins = 1000
+    );
+    
     template <typename T>
     T medianBinapproxImage(lsst::afw::image::Image<T> const &image, int nBins = 1000);
 
+    template <typename T>
+    T medianBinapproxMaskedImage(
+        lsst::afw::image::Image<T> const &image,
+        lsst::afw::image::Mask<lsst::afw::image::MaskPixel> const &mask,
+        lsst::afw::image::MaskPixel badMask,
+        int nBins = 1000,
+        long int *nGoodPtr = 0
+    );
+
+    template <typename T>
+    T medianBinapproxBuffer(
+        T const *data,
+        int nX,
+        int nY,
+        int xStride,
+        int yStride,
+        int nBins = 1000
+    );
+
+    template <typename T>
+    T medianBinapproxMaskedBuffer(
+        T const *data,
+        int nX,
+        int nY,
+        int xStride,
+        int yStride,
+        lsst::afw::image::MaskPixel const *mask,
+        int maskXStride,
+        int maskYStride,
+        lsst::afw::image::MaskPixel badMask,
+        int nBins = 1000
+    );
+
 }}} // lsst::coadd::kaiser
 
 #ifndef SWIG // don't bother SWIG with .cc files
@@ -0,0 +1,51 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_MEDIANBINAPPROXSTACK_H
+#define LSST_COADD_KAISER_MEDIANBINAPPROXSTACK_H
+/**
+* @brief Per-pixel median of a stack of images using binapprox
+*
+* @file
+*/
+#include <vector>
+
+#include "lsst/afw/image.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    template <typename T>
+    void medianBinapproxStack(
+        lsst::afw::image::Image<T> &medianImage,
+        std::vector<typename lsst::afw::image::Image<T>::Ptr> const &imageList,
+        std::vector<lsst::afw::image::Mask<lsst::afw::image::MaskPixel>::Ptr> const &maskList,
+        lsst::afw::image::MaskPixel badMask,
+        int nBins = 100
+    );
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_MEDIANBINAPPROXSTACK_H)
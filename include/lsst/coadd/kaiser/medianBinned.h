@@ -0,0 +1,93 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+#ifndef LSST_COADD_KAISER_MEDIANBINNED_H
+#define LSST_COADD_KAISER_MEDIANBINNED_H
+/**
+* @brief Fast binned median (binapprox or exact binmedian) of contiguous data, optionally multithreaded
+*
+* @file
+*/
+#include "lsst/afw/image.h"
+
+namespace lsst {
+namespace coadd {
+namespace kaiser {
+
+    /**
+     * @brief Algorithm used by medianBinned
+     */
+    enum BinMedianAlgorithm {
+        BINAPPROX = 0,  ///< approximate median, accurate to 1/nBins of a standard deviation
+        BINMEDIAN       ///< exact median; re-bins the median's bin until it is small enough to select from
+    };
+
+    /**
+     * @brief Parameters for medianBinned
+     *
+     * @ingroup coadd::kaiser
+     */
+    class MedianBinnedControl {
+    public:
+        MedianBinnedControl(
+            BinMedianAlgorithm algorithm = BINAPPROX,   ///< algorithm
+            int nBins = 1000,   ///< number of bins
+            int nThreads = 1    ///< number of threads; if <= 0 then use one per core
+        ) :
+            _algorithm(algorithm),
+            _nBins(nBins),
+            _nThreads(nThreads)
+        {}
+
+        BinMedianAlgorithm getAlgorithm() const { return _algorithm; }
+        void setAlgorithm(BinMedianAlgorithm algorithm) { _algorithm = algorithm; }
+
+        int getNBins() const { return _nBins; }
+        void setNBins(int nBins) { _nBins = nBins; }
+
+        int getNThreads() const { return _nThreads; }
+        void setNThreads(int nThreads) { _nThreads = nThreads; }
+
+    private:
+        BinMedianAlgorithm _algorithm;
+        int _nBins;
+        int _nThreads;
+    };
+
+    template <typename T>
+    T medianBinned(
+        T const *first,
+        T const *last,
+        MedianBinnedControl const &control = MedianBinnedControl()
+    );
+
+    template <typename T>
+    T medianBinnedImage(
+        lsst::afw::image::Image<T> const &image,
+        MedianBinnedControl const &control = MedianBinnedControl()
+    );
+
+}}} // lsst::coadd::kaiser
+
+#endif // !defined(LSST_COADD_KAISER_MEDIANBINNED_H)
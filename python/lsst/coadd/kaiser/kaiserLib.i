@@ -29,7 +29,7 @@ Python interface to lsst::coadd::kaiser functions and classes
 %enddef
 
 %feature("autodoc", "1");
-%module(package="lsst.coadd.kaiser", docstring=kaiserLib_DOCSTRING) kaiserLib
+%module(package="lsst.coadd.kaiser", docstring=kaiserLib_DOCSTRING, directors="1") kaiserLib
 
 // Everything we will need in the _wrap.cc file
 %{
@@ -45,8 +45,234 @@ Python interface to lsst::coadd::kaiser functions and classes
 
 // it is not convenient to call the C++-iterator-based medianBinapprox version from Python
 %ignore lsst::coadd::kaiser::medianBinapprox;
+%ignore lsst::coadd::kaiser::medianBinapproxMasked;
+// the buffer-based versions take the address of an array as an integer, so they read a numpy array
+// in place; they trust the address, shape and strides they are given, so they are private:
+// call them via medianBinapproxArray, which checks those against the array
+%typemap(in) float const *data, double const *data, lsst::afw::image::MaskPixel const *mask {
+    $1 = static_cast<$1_ltype>(PyLong_AsVoidPtr($input));
+    if (PyErr_Occurred()) {
+        SWIG_fail;
+    }
+}
 %include "lsst/coadd/kaiser/medianBinapprox.h"
 %template(medianBinapproxImage)  lsst::coadd::kaiser::medianBinapproxImage<float>;
+%template(medianBinapproxImage)  lsst::coadd::kaiser::medianBinapproxImage<double>;
+%template(medianBinapproxMaskedImage)  lsst::coadd::kaiser::medianBinapproxMaskedImage<float>;
+%template(medianBinapproxMaskedImage)  lsst::coadd::kaiser::medianBinapproxMaskedImage<double>;
+%template(_medianBinapproxBufferF) lsst::coadd::kaiser::medianBinapproxBuffer<float>;
+%template(_medianBinapproxBufferD) lsst::coadd::kaiser::medianBinapproxBuffer<double>;
+%template(_medianBinapproxMaskedBufferF) lsst::coadd::kaiser::medianBinapproxMaskedBuffer<float>;
+%template(_medianBinapproxMaskedBufferD) lsst::coadd::kaiser::medianBinapproxMaskedBuffer<double>;
 
-SWIG_SHARED_PTR_DERIVED(CoaddComponent, lsst::daf::base::Citizen, lsst::coadd::kaiser::CoaddComponent)
+%include "lsst/coadd/kaiser/imageBuffer.h"
+// the address of an image's pixels is only safe to use while the image is alive; use imageToArray
+%template(_getPixelAddress) lsst::coadd::kaiser::getPixelAddress<float>;
+%template(_getPixelAddress) lsst::coadd::kaiser::getPixelAddress<double>;
+%template(_getPixelAddress) lsst::coadd::kaiser::getPixelAddress<lsst::afw::image::MaskPixel>;
+%template(getRowStride) lsst::coadd::kaiser::getRowStride<float>;
+%template(getRowStride) lsst::coadd::kaiser::getRowStride<double>;
+%template(getRowStride) lsst::coadd::kaiser::getRowStride<lsst::afw::image::MaskPixel>;
+
+%pythoncode %{
+import numpy
+import lsst.afw.image as afwImage
+
+def _getBufferInfo(array, dtypeList, name):
+    """Get the address, shape and strides (in elements) of a numpy array viewed as 2-d, without copying it
+
+    A 1-d array is viewed as a single row; an array with more than 2 dimensions has all but its last
+    dimension combined, which must be possible without copying.
+    """
+    if not isinstance(array, numpy.ndarray):
+        raise TypeError("%s must be a numpy array" % (name,))
+    if array.dtype not in dtypeList or not array.dtype.isnative:
+        raise TypeError("%s has dtype %s; must be one of %s in native byte order" % (name, array.dtype, dtypeList))
+    if array.size < 1:
+        raise ValueError("%s is empty" % (name,))
+    if array.ndim == 1:
+        array = array.reshape(1, -1)
+    elif array.ndim > 2:
+        view = array.view()
+        try:
+            view.shape = (-1, array.shape[-1])
+        except AttributeError:
+            raise ValueError("%s cannot be viewed as 2-d without copying; its shape is %s" % (name, array.shape))
+        array = view
+    itemSize = array.dtype.itemsize
+    if [stride for stride in array.strides if stride % itemSize != 0]:
+        raise ValueError("%s strides %s are not a multiple of its item size" % (name, array.strides))
+    return array.__array_interface__["data"][0], array.shape, [stride // itemSize for stride in array.strides]
+
+_medianBinapproxBufferDict = {
+    numpy.dtype(numpy.float32): (_medianBinapproxBufferF, _medianBinapproxMaskedBufferF),
+    numpy.dtype(numpy.float64): (_medianBinapproxBufferD, _medianBinapproxMaskedBufferD),
+}
+
+def medianBinapproxArray(array, mask=None, badMask=0xFFFF, nBins=1000):
+    """Compute the approximate median of a numpy array of float32 or float64 using the binapprox algorithm
+
+    The array is read in place, so it may be a non-contiguous view (e.g. a slice or transpose)
+    of a larger array. If mask (a uint16 array of the same shape) is specified then values whose mask value
+    has any of the bits of badMask set are ignored.
+    """
+    address, shape, strides = _getBufferInfo(array, _medianBinapproxBufferDict.keys(), "array")
+    medianFunc, maskedMedianFunc = _medianBinapproxBufferDict[array.dtype]
+    if mask is None:
+        return medianFunc(address, shape[1], shape[0], strides[1], strides[0], nBins)
+    if mask.shape != array.shape:
+        raise ValueError("mask shape %s != array shape %s" % (mask.shape, array.shape))
+    maskAddress, maskShape, maskStrides = _getBufferInfo(mask, (numpy.dtype(numpy.uint16),), "mask")
+    return maskedMedianFunc(address, shape[1], shape[0], strides[1], strides[0],
+        maskAddress, maskStrides[1], maskStrides[0], badMask, nBins)
+
+class _ImageArrayInterface(object):
+    """Describe the pixels of an image to numpy; keeps the image (and so its pixels) alive"""
+    def __init__(self, image, dtype):
+        itemSize = dtype.itemsize
+        self.image = image
+        self.__array_interface__ = dict(
+            version=3,
+            data=(_getPixelAddress(image), False),
+            shape=(image.getWidth(), image.getHeight()),
+            typestr=dtype.str,
+            strides=(itemSize, itemSize * getRowStride(image)),
+        )
+
+_imageDtypeList = (
+    (afwImage.ImageF, numpy.dtype(numpy.float32)),
+    (afwImage.ImageD, numpy.dtype(numpy.float64)),
+    (afwImage.MaskU, numpy.dtype(numpy.uint16)),
+)
+
+def imageToArray(image):
+    """Return a numpy view (not a copy) of the pixels of an ImageF, ImageD or MaskU
+
+    The array is indexed [x, y], like lsst.afw.image.testUtils.arrayFromImage;
+    changing it changes the image. The array keeps the pixels alive.
+    """
+    for imageClass, dtype in _imageDtypeList:
+        if isinstance(image, imageClass):
+            return numpy.asarray(_ImageArrayInterface(image, dtype))
+    raise TypeError("Unsupported image type %s" % (type(image),))
+%}
+
+// the pointer-based medianBinned is not convenient to call from Python
+%ignore lsst::coadd::kaiser::medianBinned;
+%include "lsst/coadd/kaiser/medianBinned.h"
+%template(medianBinnedImage)  lsst::coadd::kaiser::medianBinnedImage<float>;
+%template(medianBinnedImage)  lsst::coadd::kaiser::medianBinnedImage<double>;
+
+%include "lsst/coadd/kaiser/medianBinapproxStack.h"
+%template(ImageFPtrVector) std::vector<boost::shared_ptr<lsst::afw::image::Image<float> > >;
+%template(ImageDPtrVector) std::vector<boost::shared_ptr<lsst::afw::image::Image<double> > >;
+%template(MaskPtrVector) std::vector<boost::shared_ptr<lsst::afw::image::Mask<lsst::afw::image::MaskPixel> > >;
+%template(medianBinapproxStack) lsst::coadd::kaiser::medianBinapproxStack<float>;
+%template(medianBinapproxStack) lsst::coadd::kaiser::medianBinapproxStack<double>;
+
+%include "lsst/coadd/kaiser/StreamingMedian.h"
+
+SWIG_SHARED_PTR(BinapproxSketch, lsst::coadd::kaiser::BinapproxSketch)
+%include "lsst/coadd/kaiser/BinapproxSketch.h"
+%template(addImage) lsst::coadd::kaiser::BinapproxSketch::addImage<float>;
+%template(addImage) lsst::coadd::kaiser::BinapproxSketch::addImage<double>;
+%template(addMaskedImage) lsst::coadd::kaiser::BinapproxSketch::addMaskedImage<float>;
+%template(addMaskedImage) lsst::coadd::kaiser::BinapproxSketch::addMaskedImage<double>;
+
+SWIG_SHARED_PTR(SigmaSqMap, lsst::coadd::kaiser::SigmaSqMap)
+%include "lsst/coadd/kaiser/SigmaSqMap.h"
+%template(addMaskedImage) lsst::coadd::kaiser::SigmaSqMap::addMaskedImage<float>;
+%template(addMaskedImage) lsst::coadd::kaiser::SigmaSqMap::addMaskedImage<double>;
+
+// allow strip sources and sinks to be written in Python
+%feature("director") lsst::coadd::kaiser::StripSource;
+%feature("director") lsst::coadd::kaiser::StripSink;
+%include "lsst/coadd/kaiser/StripSource.h"
+%include "lsst/coadd/kaiser/StripSink.h"
+%template(StripSinkF) lsst::coadd::kaiser::StripSink<float>;
+%template(StripSinkD) lsst::coadd::kaiser::StripSink<double>;
+%template(MaskedImageStripSinkF) lsst::coadd::kaiser::MaskedImageStripSink<float>;
+%template(MaskedImageStripSinkD) lsst::coadd::kaiser::MaskedImageStripSink<double>;
+
+%include "lsst/coadd/kaiser/dilateMask.h"
+
+%ignore lsst::coadd::kaiser::decomposeSeparable;
+%include "lsst/coadd/kaiser/fftConvolve.h"
+%template(fftConvolve) lsst::coadd::kaiser::fftConvolve<double, float>;
+%template(fftConvolve) lsst::coadd::kaiser::fftConvolve<double, double>;
+%template(fftConvolve) lsst::coadd::kaiser::fftConvolve<float, float>;
+%template(separableConvolve) lsst::coadd::kaiser::separableConvolve<double, float>;
+%template(separableConvolve) lsst::coadd::kaiser::separableConvolve<double, double>;
+%template(separableConvolve) lsst::coadd::kaiser::separableConvolve<float, float>;
+%template(convolveMaskedImage) lsst::coadd::kaiser::convolveMaskedImage<double, float>;
+%template(convolveMaskedImage) lsst::coadd::kaiser::convolveMaskedImage<double, double>;
+%template(convolveMaskedImage) lsst::coadd::kaiser::convolveMaskedImage<float, float>;
+
+%include "lsst/coadd/kaiser/reflectImage.h"
+%template(reflectImage) lsst::coadd::kaiser::reflectImage<float>;
+%template(reflectImage) lsst::coadd::kaiser::reflectImage<double>;
+
+SWIG_SHARED_PTR_DERIVED(PsfTileGrid, lsst::daf::base::Citizen, lsst::coadd::kaiser::PsfTileGrid)
+%include "lsst/coadd/kaiser/PsfTileGrid.h"
+%template(convolveWithPsfTiles) lsst::coadd::kaiser::convolveWithPsfTiles<double, float>;
+%template(convolveWithPsfTiles) lsst::coadd::kaiser::convolveWithPsfTiles<double, double>;
+%template(convolveWithPsfTiles) lsst::coadd::kaiser::convolveWithPsfTiles<float, float>;
+
+SWIG_SHARED_PTR(BlurredPsfCache, lsst::coadd::kaiser::BlurredPsfCache)
+%include "lsst/coadd/kaiser/BlurredPsfCache.h"
+
+SWIG_SHARED_PTR(MaskedImagePoolF, lsst::coadd::kaiser::MaskedImagePool<float>)
+SWIG_SHARED_PTR(MaskedImagePoolD, lsst::coadd::kaiser::MaskedImagePool<double>)
+%include "lsst/coadd/kaiser/MaskedImagePool.h"
+%template(MaskedImagePoolF) lsst::coadd::kaiser::MaskedImagePool<float>;
+%template(MaskedImagePoolD) lsst::coadd::kaiser::MaskedImagePool<double>;
+
+%include "lsst/coadd/kaiser/CoaddComponentControl.h"
+%include "lsst/coadd/kaiser/CoaddComponentStats.h"
+
+SWIG_SHARED_PTR_DERIVED(CoaddComponentF, lsst::daf::base::Citizen, lsst::coadd::kaiser::CoaddComponent<float>)
+SWIG_SHARED_PTR_DERIVED(CoaddComponentD, lsst::daf::base::Citizen, lsst::coadd::kaiser::CoaddComponent<double>)
 %include "lsst/coadd/kaiser/CoaddComponent.h"
+%template(CoaddComponentF) lsst::coadd::kaiser::CoaddComponent<float>;
+%template(CoaddComponentD) lsst::coadd::kaiser::CoaddComponent<double>;
+
+%pythoncode %{
+def _getBlurredArrays(self, *args):
+    """Return numpy views (image, mask, variance), indexed [x, y], of the planes of getBlurredExposure(*args)"""
+    maskedImage = self.getBlurredExposure(*args).getMaskedImage()
+    return (imageToArray(maskedImage.getImage()), imageToArray(maskedImage.getMask()),
+        imageToArray(maskedImage.getVariance()))
+
+def _getBlurredPsfArray(self):
+    """Return a numpy view, indexed [x, y], of getBlurredPsfImage()"""
+    return imageToArray(self.getBlurredPsfImage())
+
+for _coaddComponentClass in (CoaddComponentF, CoaddComponentD):
+    _coaddComponentClass.getBlurredArrays = _getBlurredArrays
+    _coaddComponentClass.getBlurredPsfArray = _getBlurredPsfArray
+del _coaddComponentClass
+%}
+
+SWIG_SHARED_PTR(FootprintIndex, lsst::coadd::kaiser::FootprintIndex)
+%include "lsst/coadd/kaiser/FootprintIndex.h"
+
+%include "lsst/coadd/kaiser/CoaddTileMap.h"
+
+SWIG_SHARED_PTR_DERIVED(KaiserCoadd, lsst::daf::base::Citizen, lsst::coadd::kaiser::KaiserCoadd)
+%include "lsst/coadd/kaiser/KaiserCoadd.h"
+%template(addComponent) lsst::coadd::kaiser::KaiserCoadd::addComponent<float>;
+%template(addComponent) lsst::coadd::kaiser::KaiserCoadd::addComponent<double>;
+
+SWIG_SHARED_PTR(CoaddCheckpoint, lsst::coadd::kaiser::CoaddCheckpoint)
+%include "lsst/coadd/kaiser/CoaddCheckpoint.h"
+
+%include "lsst/coadd/kaiser/CoaddPipelineControl.h"
+%include "lsst/coadd/kaiser/CoaddPipeline.h"
+%template(CoaddPipelineF) lsst::coadd::kaiser::CoaddPipeline<float>;
+%template(CoaddPipelineD) lsst::coadd::kaiser::CoaddPipeline<double>;
+
+%pythoncode %{
+# CoaddComponent and MaskedImageStripSink were not templated before; keep the old names working
+CoaddComponent = CoaddComponentD
+MaskedImageStripSink = MaskedImageStripSinkD
+%}
@@ -0,0 +1,75 @@
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""
+Utilities shared by the unit tests of lsst.coadd.kaiser
+"""
+import numpy
+
+import lsst.afw.image as afwImage
+import lsst.afw.math as afwMath
+import lsst.afw.image.testUtils as imTestUtils
+import kaiserLib as coaddKaiser
+
+def makeKernelList(nInputs):
+    """Make a list of nInputs Gaussian PSF kernels of increasing width, one per input
+    """
+    kernelList = []
+    for i in range(nInputs):
+        gaussFunc = afwMath.GaussianFunction2D(1.5 + (0.25 * i), 2.0)
+        kernelList.append(afwMath.AnalyticKernel(11, 11, gaussFunc))
+    return kernelList
+
+def makeKaiserCoadd(exposurePath):
+    """Make an empty KaiserCoadd with the size and WCS of the exposure at exposurePath
+    """
+    exposure = afwImage.ExposureF(exposurePath)
+    return coaddKaiser.KaiserCoadd(exposure.getWidth(), exposure.getHeight(), exposure.getWcs(), 0xFFFF)
+
+def getCoaddArrays(kaiserCoadd, includePsf=False):
+    """Get numpy arrays of the image, variance, mask and depth map of a KaiserCoadd
+    and, if includePsf, of its blurred PSF image
+    """
+    maskedImage = kaiserCoadd.getMaskedImage()
+    imageList = [maskedImage.getImage(), maskedImage.getVariance(), maskedImage.getMask(),
+        kaiserCoadd.getDepthMap()]
+    if includePsf:
+        imageList.append(kaiserCoadd.getBlurredPsfImage())
+    return [imTestUtils.arrayFromImage(image) for image in imageList]
+
+def assertMaskedImagesNearlyEqual(testCase, maskedImage1, maskedImage2, relTol=1.0e-7):
+    """Assert that two masked images match, including edge (non-finite) pixels
+
+    Image and variance pixels must match to relTol times the largest finite value; mask pixels exactly.
+    """
+    for getPlane in ("getImage", "getVariance"):
+        arr1 = imTestUtils.arrayFromImage(getattr(maskedImage1, getPlane)())
+        arr2 = imTestUtils.arrayFromImage(getattr(maskedImage2, getPlane)())
+        isFinite1 = numpy.isfinite(arr1)
+        testCase.assertTrue(numpy.all(isFinite1 == numpy.isfinite(arr2)),
+            "%s: non-finite pixels differ" % (getPlane,))
+        maxErr = relTol * numpy.abs(arr1[isFinite1]).max()
+        testCase.assertTrue(numpy.abs(arr1[isFinite1] - arr2[isFinite1]).max() <= maxErr,
+            "%s: pixel values differ" % (getPlane,))
+    maskArr1 = imTestUtils.arrayFromImage(maskedImage1.getMask())
+    maskArr2 = imTestUtils.arrayFromImage(maskedImage2.getMask())
+    testCase.assertTrue(numpy.all(maskArr1 == maskArr2), "mask pixels differ")
@@ -0,0 +1,553 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Mergeable, serializable summary of a stream of values for approximate medians and quantiles
+*
+* @file
+*/
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "boost/format.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/BinapproxSketch.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    char const SerialMagic[] = "BAS1";  ///< start of serialized data, including the format version
+    int const SerialMagicSize = 4;
+
+    /**
+     * \brief Append values to a string in a fixed (little-endian) byte order
+     */
+    class Writer {
+    public:
+        explicit Writer(std::string &data) : _data(data) {}
+
+        void putUInt(boost::uint64_t value, int nBytes) {
+            for (int i = 0; i < nBytes; ++i) {
+                _data.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+            }
+        }
+
+        void putDouble(double value) {
+            boost::uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            putUInt(bits, 8);
+        }
+
+        /// append an unsigned integer using 7 bits per byte, low bits first (small values take one byte)
+        void putVarUInt(boost::uint64_t value) {
+            while (value >= 0x80) {
+                _data.push_back(static_cast<char>((value & 0x7f) | 0x80));
+                value >>= 7;
+            }
+            _data.push_back(static_cast<char>(value));
+        }
+
+    private:
+        std::string &_data;
+    };
+
+    /**
+     * \brief Read values written by Writer
+     *
+     * \throw lsst::pex::exceptions::InvalidParameterException if the data is too short
+     */
+    class Reader {
+    public:
+        explicit Reader(std::string const &data) : _data(data), _pos(0) {}
+
+        boost::uint64_t getUInt(int nBytes) {
+            checkAvailable(nBytes);
+            boost::uint64_t value = 0;
+            for (int i = 0; i < nBytes; ++i, ++_pos) {
+                value |= static_cast<boost::uint64_t>(static_cast<unsigned char>(_data[_pos])) << (8 * i);
+            }
+            return value;
+        }
+
+        double getDouble() {
+            boost::uint64_t const bits = getUInt(8);
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        boost::uint64_t getVarUInt() {
+            boost::uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                checkAvailable(1);
+                unsigned char const byte = static_cast<unsigned char>(_data[_pos++]);
+                value |= static_cast<boost::uint64_t>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) {
+                    return value;
+                }
+            }
+            throw LSST_EXCEPT(pexExcept::InvalidParameterException, "Corrupt BinapproxSketch data");
+        }
+
+        bool isDone() const { return _pos == _data.size(); }
+
+    private:
+        std::string const &_data;
+        std::size_t _pos;
+
+        void checkAvailable(int nBytes) const {
+            if (_pos + nBytes > _data.size()) {
+                throw LSST_EXCEPT(pexExcept::InvalidParameterException, "BinapproxSketch data too short");
+            }
+        }
+    };
+
+    /// floor(a / 2^shift) for an integer-valued a
+    inline double floorShift(double a, int shift) {
+        return std::floor(std::ldexp(a, -shift));
+    }
+
+    /// ceil(a / 2^shift) for an integer-valued a
+    inline double ceilShift(double a, int shift) {
+        return std::ceil(std::ldexp(a, -shift));
+    }
+}
+
+/**
+ * \brief Construct an empty BinapproxSketch
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if nBins < 1 or sampleSize < 1
+ */
+coaddKaiser::BinapproxSketch::BinapproxSketch(
+    int nBins,      ///< number of bins per 2 sigma; quantiles are accurate to sigma / nBins
+    int sampleSize  ///< number of values used to set the bin range, if no prior is set
+) :
+    _nBins(nBins),
+    _sampleSize(sampleSize),
+    _count(0),
+    _mean(0),
+    _m2(0),
+    _min(std::numeric_limits<double>::infinity()),
+    _max(-std::numeric_limits<double>::infinity()),
+    _sample(),
+    _binExponent(0),
+    _binWidth(0),
+    _firstBin(0),
+    _binCounts(),
+    _nBelow(0),
+    _nAbove(0)
+{
+    if (nBins < 1) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("nBins = %d must be >= 1") % nBins).str());
+    }
+    if (sampleSize < 1) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("sampleSize = %d must be >= 1") % sampleSize).str());
+    }
+}
+
+/**
+ * \brief Set the bin range from a prior estimate of the mean and standard deviation of the values
+ *
+ * Values already added (fewer than sampleSize) are binned.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if sigma is not > 0 or mean is not finite
+ * \throw lsst::pex::exceptions::RuntimeErrorException if the bin range has already been set
+ */
+void coaddKaiser::BinapproxSketch::setPrior(
+    double mean,    ///< prior estimate of the mean
+    double sigma    ///< prior estimate of the standard deviation
+) {
+    if (!(sigma > 0) || !(mean - mean == 0) || !(sigma - sigma == 0)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("Invalid prior: mean = %g, sigma = %g") % mean % sigma).str());
+    }
+    if (isBinned()) {
+        throw LSST_EXCEPT(pexExcept::RuntimeErrorException, "The bin range has already been set");
+    }
+    fixRange(mean, sigma);
+}
+
+/**
+ * \brief Add the pixels of an image
+ */
+template <typename T>
+void coaddKaiser::BinapproxSketch::addImage(
+    afwImage::Image<T> const &image ///< image to add
+) {
+    for (int y = 0; y < image.getHeight(); ++y) {
+        addValues(image.row_begin(y), image.row_end(y));
+    }
+}
+
+/**
+ * \brief Add the pixels of an image for which no bits of badMask are set in a mask
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if the image and mask are not the same size
+ */
+template <typename T>
+void coaddKaiser::BinapproxSketch::addMaskedImage(
+    afwImage::Image<T> const &image,    ///< image to add
+    afwImage::Mask<afwImage::MaskPixel> const &mask,    ///< mask; same size as image
+    afwImage::MaskPixel badMask         ///< pixels with any of these mask bits set are ignored
+) {
+    typedef typename afwImage::Image<T>::x_iterator ImageXIterator;
+    typedef afwImage::Mask<afwImage::MaskPixel>::x_iterator MaskXIterator;
+
+    if ((image.getWidth() != mask.getWidth()) || (image.getHeight() != mask.getHeight())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException, "image and mask are not the same size");
+    }
+    for (int y = 0; y < image.getHeight(); ++y) {
+        MaskXIterator maskPtr = mask.row_begin(y);
+        for (ImageXIterator imPtr = image.row_begin(y), imEnd = image.row_end(y); imPtr != imEnd;
+            ++imPtr, ++maskPtr) {
+            if ((*maskPtr & badMask) == 0) {
+                addValue(static_cast<double>(*imPtr));
+            }
+        }
+    }
+}
+
+/**
+ * \brief Merge another sketch into this one
+ *
+ * The result is as if the values of the other sketch had been added to this one, except that if both are
+ * binned the bin width is the larger of the two bin widths and the binned range is the overlap
+ * of the two binned ranges (values binned by one sketch outside that range are counted as below or above it).
+ * If neither is binned the merged sketch is binned when it holds sampleSize values.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if the sketches have different nBins,
+ * or both are binned and their binned ranges do not overlap
+ */
+void coaddKaiser::BinapproxSketch::merge(
+    BinapproxSketch const &other    ///< sketch to merge into this one
+) {
+    if (other._nBins != _nBins) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("nBins = %d != %d") % other._nBins % _nBins).str());
+    }
+    if (other._count == 0) {
+        return;
+    }
+    if (!other.isBinned()) {
+        addValues(other._sample.begin(), other._sample.end());
+        return;
+    }
+    if (!isBinned()) {
+        BinapproxSketch merged(other);
+        merged._sampleSize = _sampleSize;
+        merged.addValues(_sample.begin(), _sample.end());
+        *this = merged;
+        return;
+    }
+
+    // both are binned: put both on the same grid and restrict both to the overlap of their ranges
+    BinapproxSketch otherCopy(other);
+    int const binExponent = std::max(_binExponent, other._binExponent);
+    coarsen(binExponent);
+    otherCopy.coarsen(binExponent);
+    double const firstBin = std::max(_firstBin, otherCopy._firstBin);
+    double const endBin = std::min(_firstBin + static_cast<double>(_binCounts.size()),
+        otherCopy._firstBin + static_cast<double>(otherCopy._binCounts.size()));
+    if (firstBin >= endBin) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("Binned ranges do not overlap: [%g, %g) and [%g, %g); use the same prior")
+                % getRangeMin() % getRangeMax() % other.getRangeMin() % other.getRangeMax()).str());
+    }
+    clip(firstBin, endBin);
+    otherCopy.clip(firstBin, endBin);
+    for (std::size_t i = 0; i < _binCounts.size(); ++i) {
+        _binCounts[i] += otherCopy._binCounts[i];
+    }
+    _nBelow += otherCopy._nBelow;
+    _nAbove += otherCopy._nAbove;
+
+    // combine the moments (Chan et al.)
+    double const count = static_cast<double>(_count);
+    double const otherCount = static_cast<double>(other._count);
+    double const totalCount = count + otherCount;
+    double const delta = other._mean - _mean;
+    _mean += delta * otherCount / totalCount;
+    _m2 += other._m2 + (delta * delta * count * otherCount / totalCount);
+    _count += other._count;
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+}
+
+/**
+ * \brief Serialize the sketch to a compact, platform-independent string of bytes (not text)
+ *
+ * Once binned, the size is about 60 bytes plus 1-3 bytes per bin between the lowest and highest nonempty bin,
+ * whatever the number of values.
+ */
+std::string coaddKaiser::BinapproxSketch::serialize() const {
+    std::string data(SerialMagic, SerialMagicSize);
+    Writer writer(data);
+    writer.putUInt(static_cast<boost::uint32_t>(_nBins), 4);
+    writer.putUInt(static_cast<boost::uint32_t>(_sampleSize), 4);
+    writer.putUInt(_count, 8);
+    writer.putDouble(_mean);
+    writer.putDouble(_m2);
+    writer.putDouble(_min);
+    writer.putDouble(_max);
+    writer.putUInt(isBinned() ? 1 : 0, 1);
+    if (!isBinned()) {
+        writer.putVarUInt(_sample.size());
+        for (std::vector<double>::const_iterator valPtr = _sample.begin(); valPtr != _sample.end(); ++valPtr) {
+            writer.putDouble(*valPtr);
+        }
+        return data;
+    }
+    // only save the bins from the first to the last nonzero bin
+    std::size_t const nRangeBins = _binCounts.size();
+    std::size_t first = 0;
+    while ((first < nRangeBins) && (_binCounts[first] == 0)) {
+        ++first;
+    }
+    std::size_t end = nRangeBins;
+    while ((end > first) && (_binCounts[end - 1] == 0)) {
+        --end;
+    }
+    writer.putUInt(static_cast<boost::uint32_t>(static_cast<boost::int32_t>(_binExponent)), 4);
+    writer.putUInt(static_cast<boost::uint64_t>(static_cast<boost::int64_t>(_firstBin)), 8);
+    writer.putVarUInt(nRangeBins);
+    writer.putVarUInt(_nBelow);
+    writer.putVarUInt(_nAbove);
+    writer.putVarUInt(first);
+    writer.putVarUInt(end - first);
+    for (std::size_t i = first; i < end; ++i) {
+        writer.putVarUInt(_binCounts[i]);
+    }
+    return data;
+}
+
+/**
+ * \brief Reconstruct a sketch from data returned by serialize
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if the data is not a valid serialized sketch
+ */
+coaddKaiser::BinapproxSketch coaddKaiser::BinapproxSketch::deserialize(
+    std::string const &data ///< data returned by serialize
+) {
+    if ((data.size() < static_cast<std::size_t>(SerialMagicSize))
+        || (data.compare(0, SerialMagicSize, SerialMagic) != 0)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException, "Not serialized BinapproxSketch data");
+    }
+    std::string const body = data.substr(SerialMagicSize);
+    Reader reader(body);
+    int const nBins = static_cast<boost::int32_t>(reader.getUInt(4));
+    int const sampleSize = static_cast<boost::int32_t>(reader.getUInt(4));
+    BinapproxSketch sketch(nBins, sampleSize);
+    sketch._count = reader.getUInt(8);
+    sketch._mean = reader.getDouble();
+    sketch._m2 = reader.getDouble();
+    sketch._min = reader.getDouble();
+    sketch._max = reader.getDouble();
+    boost::uint64_t nCounted = 0;
+    if (reader.getUInt(1) == 0) {
+        boost::uint64_t const nSample = reader.getVarUInt();
+        if (nSample > body.size()) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterException, "Corrupt BinapproxSketch data");
+        }
+        sketch._sample.reserve(nSample);
+        for (boost::uint64_t i = 0; i < nSample; ++i) {
+            sketch._sample.push_back(reader.getDouble());
+        }
+        nCounted = nSample;
+    } else {
+        sketch._binExponent = static_cast<boost::int32_t>(reader.getUInt(4));
+        sketch._binWidth = std::ldexp(1.0, sketch._binExponent);
+        sketch._firstBin = static_cast<double>(static_cast<boost::int64_t>(reader.getUInt(8)));
+        boost::uint64_t const nRangeBins = reader.getVarUInt();
+        sketch._nBelow = reader.getVarUInt();
+        sketch._nAbove = reader.getVarUInt();
+        boost::uint64_t const first = reader.getVarUInt();
+        boost::uint64_t const nSaved = reader.getVarUInt();
+        if ((nRangeBins < 1) || (nRangeBins > 2 * static_cast<boost::uint64_t>(RangeNSigma) * nBins)
+            || (first + nSaved > nRangeBins) || !(sketch._binWidth > 0)) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterException, "Corrupt BinapproxSketch data");
+        }
+        sketch._binCounts.resize(nRangeBins, 0);
+        for (boost::uint64_t i = first; i < first + nSaved; ++i) {
+            sketch._binCounts[i] = reader.getVarUInt();
+            nCounted += sketch._binCounts[i];
+        }
+        nCounted += sketch._nBelow + sketch._nAbove;
+    }
+    if (!reader.isDone() || (nCounted != sketch._count)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException, "Corrupt BinapproxSketch data");
+    }
+    return sketch;
+}
+
+/**
+ * \brief Get the approximate value below which a given fraction of the values lie
+ *
+ * Until the bin range is set the result is exact (the value of rank ceil(fraction * count), counting from 1).
+ * After that it is the center of the bin containing that value, which is within half a bin width
+ * (at most sigma / nBins, for the sigma used to set the range) of the true value;
+ * fractions 0 and 1 return the exact minimum and maximum.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if fraction is not in the range [0, 1]
+ * \throw lsst::pex::exceptions::RuntimeErrorException if no values have been added
+ * \throw lsst::pex::exceptions::RangeErrorException if the value lies outside the binned range
+ */
+double coaddKaiser::BinapproxSketch::getQuantile(
+    double fraction ///< fraction of values below the quantile, in the range [0, 1]; 0.5 for the median
+) const {
+    if (!(fraction >= 0) || !(fraction <= 1)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("fraction = %g not in range [0, 1]") % fraction).str());
+    }
+    if (_count == 0) {
+        throw LSST_EXCEPT(pexExcept::RuntimeErrorException, "No values have been added");
+    }
+    if (fraction == 0) {
+        return _min;
+    } else if (fraction == 1) {
+        return _max;
+    }
+    double const rank = std::max(1.0, std::ceil(fraction * static_cast<double>(_count)));
+
+    if (!isBinned()) {
+        std::vector<double> values(_sample);
+        std::vector<double>::iterator const nthPtr = values.begin() + (static_cast<std::size_t>(rank) - 1);
+        std::nth_element(values.begin(), nthPtr, values.end());
+        return *nthPtr;
+    }
+
+    if ((rank <= static_cast<double>(_nBelow)) || (rank > static_cast<double>(_count - _nAbove))) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException,
+            (boost::format("Quantile %g is outside the binned range [%g, %g)")
+                % fraction % getRangeMin() % getRangeMax()).str());
+    }
+    boost::uint64_t countBelow = _nBelow;
+    for (std::size_t bin = 0; bin < _binCounts.size(); ++bin) {
+        countBelow += _binCounts[bin];
+        if (static_cast<double>(countBelow) >= rank) {
+            double const center = (_firstBin + static_cast<double>(bin) + 0.5) * _binWidth;
+            return std::min(std::max(center, _min), _max);
+        }
+    }
+    // cannot get here, since the counts sum to _count
+    throw LSST_EXCEPT(pexExcept::LogicErrorException, "Quantile not found; bin counts are corrupt");
+}
+
+/**
+ * \brief Set the bin range and bin the sampled values
+ *
+ * The bin width is the largest power of 2 no larger than 2 sigma / nBins, and the range is
+ * 2 * RangeNSigma * nBins bins centered on the mean (so it covers at least mean +/- RangeNSigma sigma).
+ */
+void coaddKaiser::BinapproxSketch::fixRange(
+    double mean,    ///< mean of the values
+    double sigma    ///< standard deviation of the values; if not > 0 then a tiny value is used
+) {
+    if (!(sigma > 0)) {
+        sigma = std::max(std::fabs(mean), std::numeric_limits<double>::min())
+            * std::numeric_limits<float>::epsilon();
+    }
+    int exponent;
+    std::frexp(2.0 * sigma / static_cast<double>(_nBins), &exponent);
+    _binExponent = exponent - 1;    // frexp returns a mantissa in [0.5, 1)
+    _binWidth = std::ldexp(1.0, _binExponent);
+    std::size_t const nRangeBins = 2 * static_cast<std::size_t>(RangeNSigma) * static_cast<std::size_t>(_nBins);
+    _firstBin = std::floor(std::ldexp(mean, -_binExponent)) - static_cast<double>(nRangeBins / 2);
+    _binCounts.assign(nRangeBins, 0);
+    _nBelow = 0;
+    _nAbove = 0;
+    for (std::vector<double>::const_iterator valPtr = _sample.begin(); valPtr != _sample.end(); ++valPtr) {
+        addToBins(*valPtr);
+    }
+    std::vector<double>().swap(_sample);
+}
+
+/**
+ * \brief Increase the bin width to 2^binExponent (no change if the bins are already at least that wide)
+ *
+ * Each new bin is the union of old bins, so counts are exact. The range shrinks to the new bins
+ * that are completely covered by the old range; old bins outside it are counted as below or above.
+ */
+void coaddKaiser::BinapproxSketch::coarsen(
+    int binExponent ///< new bin width = 2^binExponent
+) {
+    int const shift = binExponent - _binExponent;
+    if (shift <= 0) {
+        return;
+    }
+    double const endBin = _firstBin + static_cast<double>(_binCounts.size());
+    double const newFirstBin = ceilShift(_firstBin, shift);
+    double const newEndBin = std::max(floorShift(endBin, shift), newFirstBin);
+    std::vector<boost::uint64_t> newBinCounts(static_cast<std::size_t>(newEndBin - newFirstBin), 0);
+    for (std::size_t i = 0; i < _binCounts.size(); ++i) {
+        double const newBin = floorShift(_firstBin + static_cast<double>(i), shift) - newFirstBin;
+        if (newBin < 0) {
+            _nBelow += _binCounts[i];
+        } else if (newBin >= static_cast<double>(newBinCounts.size())) {
+            _nAbove += _binCounts[i];
+        } else {
+            newBinCounts[static_cast<std::size_t>(newBin)] += _binCounts[i];
+        }
+    }
+    _binExponent = binExponent;
+    _binWidth = std::ldexp(1.0, binExponent);
+    _firstBin = newFirstBin;
+    _binCounts.swap(newBinCounts);
+}
+
+/**
+ * \brief Restrict the range to bins [firstBin, endBin), which must lie within the current range
+ */
+void coaddKaiser::BinapproxSketch::clip(
+    double firstBin,    ///< index of the first bin to keep
+    double endBin       ///< index of one past the last bin to keep
+) {
+    std::size_t const first = static_cast<std::size_t>(firstBin - _firstBin);
+    std::size_t const end = static_cast<std::size_t>(endBin - _firstBin);
+    for (std::size_t i = 0; i < first; ++i) {
+        _nBelow += _binCounts[i];
+    }
+    for (std::size_t i = end; i < _binCounts.size(); ++i) {
+        _nAbove += _binCounts[i];
+    }
+    _binCounts.erase(_binCounts.begin() + end, _binCounts.end());
+    _binCounts.erase(_binCounts.begin(), _binCounts.begin() + first);
+    _firstBin = firstBin;
+}
+
+//
+// Explicit instantiations
+//
+template void coaddKaiser::BinapproxSketch::addImage<float>(afwImage::Image<float> const &);
+template void coaddKaiser::BinapproxSketch::addImage<double>(afwImage::Image<double> const &);
+template void coaddKaiser::BinapproxSketch::addMaskedImage<float>(
+    afwImage::Image<float> const &, afwImage::Mask<afwImage::MaskPixel> const &, afwImage::MaskPixel);
+template void coaddKaiser::BinapproxSketch::addMaskedImage<double>(
+    afwImage::Image<double> const &, afwImage::Mask<afwImage::MaskPixel> const &, afwImage::MaskPixel);
@@ -0,0 +1,470 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Cache of blurred PSF images, keyed by the contents of the PSF kernel
+*
+* @file
+*/
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+#include <vector>
+
+#include <unistd.h>
+
+#include "boost/cstdint.hpp"
+#include "boost/filesystem.hpp"
+#include "boost/format.hpp"
+#include "boost/thread/tss.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/afw/math.h"
+#include "lsst/coadd/kaiser/fftConvolve.h"
+#include "lsst/coadd/kaiser/fitsMutex.h"
+#include "lsst/coadd/kaiser/BlurredPsfCache.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace afwMath = lsst::afw::math;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    /**
+     * \brief Add the bytes of a value to a 64-bit FNV-1a hash
+     */
+    template <typename T>
+    void hashBytes(boost::uint64_t &hash, T const &value) {
+        unsigned char const *bytePtr = reinterpret_cast<unsigned char const *>(&value);
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            hash ^= bytePtr[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    /**
+     * \brief Compute the cache key for a kernel image (whose xy0 is minus the kernel center)
+     */
+    std::string computeKey(coaddKaiser::BlurredPsfImage const &kernelImage, bool normalizePsf) {
+        boost::uint64_t hash = 14695981039346656037ULL;
+        hashBytes(hash, kernelImage.getWidth());
+        hashBytes(hash, kernelImage.getHeight());
+        hashBytes(hash, kernelImage.getX0());
+        hashBytes(hash, kernelImage.getY0());
+        hashBytes(hash, normalizePsf);
+        for (int y = 0; y < kernelImage.getHeight(); ++y) {
+            for (coaddKaiser::BlurredPsfImage::x_iterator ptr = kernelImage.row_begin(y),
+                end = kernelImage.row_end(y); ptr != end; ++ptr) {
+                double const value = (*ptr == 0) ? 0.0 : *ptr; // treat -0 as 0
+                hashBytes(hash, value);
+            }
+        }
+        std::ostringstream os;
+        os << std::hex << std::setw(16) << std::setfill('0') << hash << (normalizePsf ? "n" : "u");
+        return os.str();
+    }
+
+    /**
+     * \brief Scratch buffers for computeBlurredPsfImage, kept per thread and reused, so that computing
+     * a blurred PSF allocates nothing but the result
+     */
+    struct BlurredPsfScratch {
+        afwImage::Image<afwMath::Kernel::Pixel>::Ptr kernelImagePtr;   ///< marked persistent,
+                                                    ///< since it lives as long as the thread
+        std::vector<double> kernelData;
+        std::vector<std::vector<double> > xVectorList;
+        std::vector<std::vector<double> > yVectorList;
+        std::vector<double> xConv;
+        std::vector<double> yConv;
+    };
+
+    /**
+     * \brief Compute the full 1-dimensional convolution of two vectors of the same length n (length 2n - 1)
+     */
+    void convolveVectors(
+        std::vector<double> &result,        ///< convolution; resized as needed
+        std::vector<double> const &vector1,
+        std::vector<double> const &vector2
+    ) {
+        int const n = static_cast<int>(vector1.size());
+        result.assign(2 * n - 1, 0.0);
+        for (int i = 0; i < n; ++i) {
+            for (int k = 0; k < n; ++k) {
+                result[i + k] += vector1[i] * vector2[k];
+            }
+        }
+    }
+
+    /**
+     * \brief Compute the blurred PSF image of a kernel that is a sum of separable terms
+     *
+     * The blurred PSF is the convolution of the kernel with itself (flipped, to match computeBlurredPsfImage),
+     * which is a sum over pairs of terms of the product of 1-dimensional convolutions,
+     * costing O(nTerms^2 * kernel width * kernel height) instead of O(kernel width^2 * kernel height^2).
+     * The terms are accumulated directly into the result.
+     */
+    coaddKaiser::BlurredPsfImage::Ptr computeSeparableBlurredPsfImage(
+        BlurredPsfScratch &scratch, ///< scratch buffers; xVectorList and yVectorList hold the x and y vectors
+                                    ///< of each term of the unnormalized kernel
+        bool normalizePsf
+    ) {
+        std::vector<std::vector<double> > const &xVectorList = scratch.xVectorList;
+        std::vector<std::vector<double> > const &yVectorList = scratch.yVectorList;
+        int const nTerms = static_cast<int>(xVectorList.size());
+        int const width = 2 * static_cast<int>(xVectorList[0].size()) - 1;
+        int const height = 2 * static_cast<int>(yVectorList[0].size()) - 1;
+        double kernelSum = 0;
+        for (int t = 0; t < nTerms; ++t) {
+            kernelSum += std::accumulate(xVectorList[t].begin(), xVectorList[t].end(), 0.0)
+                * std::accumulate(yVectorList[t].begin(), yVectorList[t].end(), 0.0);
+        }
+        // the reflected PSF is always normalized; the other is only normalized if normalizePsf
+        double const scale = normalizePsf ? 1.0 / (kernelSum * kernelSum) : 1.0 / kernelSum;
+
+        coaddKaiser::BlurredPsfImage::Ptr blurredPsfImagePtr(new coaddKaiser::BlurredPsfImage(width, height));
+        for (int y = 0; y < height; ++y) {
+            std::fill(blurredPsfImagePtr->row_begin(y), blurredPsfImagePtr->row_end(y), 0.0);
+        }
+        for (int t = 0; t < nTerms; ++t) {
+            for (int u = 0; u < nTerms; ++u) {
+                convolveVectors(scratch.xConv, xVectorList[t], xVectorList[u]);
+                convolveVectors(scratch.yConv, yVectorList[t], yVectorList[u]);
+                for (int y = 0; y < height; ++y) {
+                    double const yValue = scale * scratch.yConv[height - 1 - y];
+                    std::vector<double>::const_reverse_iterator xConvPtr = scratch.xConv.rbegin();
+                    for (coaddKaiser::BlurredPsfImage::x_iterator ptr = blurredPsfImagePtr->row_begin(y),
+                        end = blurredPsfImagePtr->row_end(y); ptr != end; ++ptr, ++xConvPtr) {
+                        *ptr += yValue * *xConvPtr;
+                    }
+                }
+            }
+        }
+        return blurredPsfImagePtr;
+    }
+
+    /**
+     * \brief Compute the blurred PSF image of an arbitrary kernel image directly
+     *
+     * Each output pixel is scale * sum over p of kernel(p) kernel(d - p), where d runs from
+     * (2 * (width - 1), 2 * (height - 1)) down to (0, 0) (the order used by computeBlurredPsfImage).
+     * Only the overlap of the kernel with itself is visited, and each sum is symmetric under p <-> d - p,
+     * so each product is formed once and doubled; there are no padded images and nothing is discarded.
+     */
+    coaddKaiser::BlurredPsfImage::Ptr computeDirectBlurredPsfImage(
+        std::vector<double> const &kernelData,  ///< kernel image, row-major
+        int kWidth,     ///< kernel width
+        int kHeight,    ///< kernel height
+        double scale    ///< scale factor
+    ) {
+        int const width = 2 * kWidth - 1;
+        int const height = 2 * kHeight - 1;
+        coaddKaiser::BlurredPsfImage::Ptr blurredPsfImagePtr(new coaddKaiser::BlurredPsfImage(width, height));
+        for (int y = 0; y < height; ++y) {
+            int const dy = height - 1 - y;
+            int const jBegin = std::max(0, dy - (kHeight - 1));
+            coaddKaiser::BlurredPsfImage::x_iterator outPtr = blurredPsfImagePtr->row_begin(y);
+            for (int x = 0; x < width; ++x, ++outPtr) {
+                int const dx = width - 1 - x;
+                int const iBegin = std::max(0, dx - (kWidth - 1));
+                int const iEnd = std::min(kWidth - 1, dx) + 1;
+                double pairSum = 0;
+                for (int j = jBegin; 2 * j < dy; ++j) {
+                    double const *rowPtr = &kernelData[j * kWidth];
+                    double const *mirrorRowPtr = &kernelData[(dy - j) * kWidth + dx];
+                    for (int i = iBegin; i < iEnd; ++i) {
+                        pairSum += rowPtr[i] * mirrorRowPtr[-i];
+                    }
+                }
+                double centerSum = 0;
+                if (dy % 2 == 0) {
+                    // the middle row pairs with itself
+                    double const *rowPtr = &kernelData[(dy / 2) * kWidth];
+                    for (int i = iBegin; 2 * i < dx; ++i) {
+                        pairSum += rowPtr[i] * rowPtr[dx - i];
+                    }
+                    if (dx % 2 == 0) {
+                        centerSum = rowPtr[dx / 2] * rowPtr[dx / 2];
+                    }
+                }
+                *outPtr = scale * ((2.0 * pairSum) + centerSum);
+            }
+        }
+        return blurredPsfImagePtr;
+    }
+
+    boost::thread_specific_ptr<BlurredPsfScratch> blurredPsfScratchPtr;
+
+    /**
+     * \brief Rename a file, atomically replacing any existing file of the new name
+     *
+     * \throw lsst::pex::exceptions::RuntimeErrorException if the file cannot be renamed
+     */
+    void renameFile(std::string const &fromPath, std::string const &toPath) {
+        if (std::rename(fromPath.c_str(), toPath.c_str()) != 0) {
+            throw LSST_EXCEPT(pexExcept::RuntimeErrorException,
+                (boost::format("Could not rename %s to %s") % fromPath % toPath).str());
+        }
+    }
+
+    /**
+     * \brief Return true if two kernel images have the same dimensions, xy0 and pixel values
+     */
+    bool kernelImagesEqual(coaddKaiser::BlurredPsfImage const &image1, coaddKaiser::BlurredPsfImage const &image2) {
+        if ((image1.getWidth() != image2.getWidth()) || (image1.getHeight() != image2.getHeight())
+            || (image1.getX0() != image2.getX0()) || (image1.getY0() != image2.getY0())) {
+            return false;
+        }
+        for (int y = 0; y < image1.getHeight(); ++y) {
+            if (!std::equal(image1.row_begin(y), image1.row_end(y), image2.row_begin(y))) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+/**
+ * \brief Compute the blurred PSF image: psfKernel convolved with psfKernel(-r)
+ *
+ * The result is (2 * kernel width - 1) by (2 * kernel height - 1) pixels, with the center at the center.
+ *
+ * The kernel image is computed once (at the origin, even for a spatially varying kernel).
+ * Kernels that are sums of a few separable terms (e.g. Gaussians and double Gaussians; see decomposeSeparable)
+ * are computed from 1-dimensional convolutions of their terms; other kernels are computed directly
+ * (see computeDirectBlurredPsfImage). Scratch buffers are kept per thread and reused,
+ * so only the result is allocated.
+ *
+ * \ingroup coadd::kaiser
+ */
+coaddKaiser::BlurredPsfImage::Ptr coaddKaiser::computeBlurredPsfImage(
+    lsst::afw::math::Kernel const &psfKernel,   ///< PSF kernel
+    bool normalizePsf                           ///< normalize the PSF?
+) {
+    if (!blurredPsfScratchPtr.get()) {
+        blurredPsfScratchPtr.reset(new BlurredPsfScratch());
+    }
+    BlurredPsfScratch &scratch = *blurredPsfScratchPtr;
+    int const psfWidth = psfKernel.getWidth();
+    int const psfHeight = psfKernel.getHeight();
+    if (!scratch.kernelImagePtr || (scratch.kernelImagePtr->getWidth() != psfWidth)
+        || (scratch.kernelImagePtr->getHeight() != psfHeight)) {
+        scratch.kernelImagePtr.reset(new afwImage::Image<afwMath::Kernel::Pixel>(psfWidth, psfHeight));
+        // the scratch image outlives any one caller, so it is not a leak
+        scratch.kernelImagePtr->markPersistent();
+    }
+    double const kernelSum = psfKernel.computeImage(*scratch.kernelImagePtr, false);
+    if (kernelSum == 0) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException, "PSF kernel sums to zero");
+    }
+
+    if (decomposeSeparable(scratch.xVectorList, scratch.yVectorList, *scratch.kernelImagePtr) > 0) {
+        return computeSeparableBlurredPsfImage(scratch, normalizePsf);
+    }
+
+    scratch.kernelData.resize(psfWidth * psfHeight);
+    for (int j = 0; j < psfHeight; ++j) {
+        std::copy(scratch.kernelImagePtr->row_begin(j), scratch.kernelImagePtr->row_end(j),
+            scratch.kernelData.begin() + (j * psfWidth));
+    }
+    // the reflected PSF is always normalized; the other is only normalized if normalizePsf
+    double const scale = normalizePsf ? 1.0 / (kernelSum * kernelSum) : 1.0 / kernelSum;
+    return computeDirectBlurredPsfImage(scratch.kernelData, psfWidth, psfHeight, scale);
+}
+
+/**
+ * \brief Construct a BlurredPsfCache
+ *
+ * \ingroup coadd::kaiser
+ */
+coaddKaiser::BlurredPsfCache::BlurredPsfCache(
+    std::string const &dirPath  ///< directory in which to store entries (created if it does not exist);
+                                ///< if "" then entries are only kept in memory
+) :
+    _dirPath(dirPath),
+    _entryMap(),
+    _nHits(0),
+    _nDiskHits(0),
+    _nMisses(0),
+    _mutex()
+{
+    if (!dirPath.empty()) {
+        boost::filesystem::create_directories(boost::filesystem::path(dirPath));
+    }
+}
+
+/**
+ * \brief Get the blurred PSF image for a PSF kernel, computing it if it is not in the cache
+ *
+ * \return the blurred PSF image (see computeBlurredPsfImage); do not modify it
+ *
+ * \ingroup coadd::kaiser
+ */
+coaddKaiser::BlurredPsfImage::ConstPtr coaddKaiser::BlurredPsfCache::get(
+    lsst::afw::math::Kernel const &psfKernel,   ///< PSF kernel
+    bool normalizePsf                           ///< normalize the PSF?
+) {
+    if (psfKernel.isSpatiallyVarying()) {
+        BlurredPsfImage::ConstPtr blurredPsfImagePtr = computeBlurredPsfImage(psfKernel, normalizePsf);
+        boost::mutex::scoped_lock lock(_mutex);
+        ++_nMisses;
+        return blurredPsfImagePtr;
+    }
+
+    BlurredPsfImage::Ptr kernelImagePtr(new BlurredPsfImage(psfKernel.getWidth(), psfKernel.getHeight()));
+    psfKernel.computeImage(*kernelImagePtr, false);
+    kernelImagePtr->setXY0(afwImage::PointI(-psfKernel.getCtrX(), -psfKernel.getCtrY()));
+    std::string const key = computeKey(*kernelImagePtr, normalizePsf);
+
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        EntryMap::const_iterator const entryIter = _entryMap.find(key);
+        if ((entryIter != _entryMap.end()) && kernelImagesEqual(*entryIter->second.kernelImage, *kernelImagePtr)) {
+            ++_nHits;
+            return entryIter->second.blurredPsfImage;
+        }
+    }
+
+    // compute (or read) the entry without holding the lock, so other threads are not blocked
+    Entry entry;
+    bool const isDiskHit = readEntry(key, *kernelImagePtr, entry);
+    if (!isDiskHit) {
+        entry.kernelImage = kernelImagePtr;
+        entry.blurredPsfImage = computeBlurredPsfImage(psfKernel, normalizePsf);
+    }
+
+    if (!isDiskHit) {
+        writeEntry(key, entry);
+    }
+
+    boost::mutex::scoped_lock lock(_mutex);
+    if (isDiskHit) {
+        ++_nHits;
+        ++_nDiskHits;
+    } else {
+        ++_nMisses;
+    }
+    _entryMap[key] = entry;
+    return entry.blurredPsfImage;
+}
+
+int coaddKaiser::BlurredPsfCache::getSize() const {
+    boost::mutex::scoped_lock lock(_mutex);
+    return static_cast<int>(_entryMap.size());
+}
+
+int coaddKaiser::BlurredPsfCache::getNHits() const {
+    boost::mutex::scoped_lock lock(_mutex);
+    return _nHits;
+}
+
+int coaddKaiser::BlurredPsfCache::getNDiskHits() const {
+    boost::mutex::scoped_lock lock(_mutex);
+    return _nDiskHits;
+}
+
+int coaddKaiser::BlurredPsfCache::getNMisses() const {
+    boost::mutex::scoped_lock lock(_mutex);
+    return _nMisses;
+}
+
+/**
+ * \brief Remove all entries from memory and reset the counters; entries in the directory are kept
+ *
+ * \ingroup coadd::kaiser
+ */
+void coaddKaiser::BlurredPsfCache::clear() {
+    boost::mutex::scoped_lock lock(_mutex);
+    _entryMap.clear();
+    _nHits = 0;
+    _nDiskHits = 0;
+    _nMisses = 0;
+}
+
+/**
+ * \brief Read an entry from the directory
+ *
+ * The files are read with getFitsMutex() held.
+ *
+ * \return true if the entry was found and its kernel image matches kernelImage
+ */
+bool coaddKaiser::BlurredPsfCache::readEntry(
+    std::string const &key,
+    BlurredPsfImage const &kernelImage,
+    Entry &entry
+) const {
+    if (_dirPath.empty()) {
+        return false;
+    }
+    std::string const basePath = _dirPath + "/" + key;
+    boost::mutex::scoped_lock ioLock(getFitsMutex());
+    if (!boost::filesystem::exists(boost::filesystem::path(basePath + "_kernel.fits"))
+        || !boost::filesystem::exists(boost::filesystem::path(basePath + ".fits"))) {
+        return false;
+    }
+    try {
+        BlurredPsfImage::Ptr storedKernelImagePtr(new BlurredPsfImage(basePath + "_kernel.fits"));
+        if (!kernelImagesEqual(*storedKernelImagePtr, kernelImage)) {
+            return false;
+        }
+        BlurredPsfImage::Ptr blurredPsfImagePtr(new BlurredPsfImage(basePath + ".fits"));
+        if ((blurredPsfImagePtr->getWidth() != 2 * kernelImage.getWidth() - 1)
+            || (blurredPsfImagePtr->getHeight() != 2 * kernelImage.getHeight() - 1)) {
+            return false;
+        }
+        blurredPsfImagePtr->setXY0(afwImage::PointI(0, 0));
+        entry.kernelImage = storedKernelImagePtr;
+        entry.blurredPsfImage = blurredPsfImagePtr;
+    } catch (pexExcept::Exception &) {
+        // an unreadable entry (e.g. one being written by another process) is treated as missing
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Write an entry to the directory, if there is one
+ *
+ * Each file is written to a temporary name (unique to this process) and renamed into place,
+ * so a reader in another thread or process never opens a partially written file; the blurred PSF image
+ * is renamed last, so readEntry ignores an entry whose kernel image is not yet in place.
+ * The files are written with getFitsMutex() held.
+ */
+void coaddKaiser::BlurredPsfCache::writeEntry(
+    std::string const &key,
+    Entry const &entry
+) const {
+    if (_dirPath.empty()) {
+        return;
+    }
+    std::string const basePath = _dirPath + "/" + key;
+    std::string const tempSuffix = (boost::format(".%d.tmp") % getpid()).str();
+    boost::mutex::scoped_lock ioLock(getFitsMutex());
+    entry.kernelImage->writeFits(basePath + "_kernel.fits" + tempSuffix);
+    entry.blurredPsfImage->writeFits(basePath + ".fits" + tempSuffix);
+    renameFile(basePath + "_kernel.fits" + tempSuffix, basePath + "_kernel.fits");
+    renameFile(basePath + ".fits" + tempSuffix, basePath + ".fits");
+}
@@ -0,0 +1,457 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Incremental checkpoints of a KaiserCoadd
+*
+* The journal is a text file containing one block per complete checkpoint:
+* \verbatim
+checkpoint <n>
+size <coadd width> <coadd height> <tile size>
+nComponents <number of components in the coadd>
+input <input>          (one line per input added since the previous checkpoint)
+tile <ix> <iy>         (one line per tile written)
+psf                    (if the blurred PSF image was written)
+end <n>
+\endverbatim
+*
+* @file
+*/
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "boost/filesystem.hpp"
+#include "boost/format.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/CoaddCheckpoint.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    /**
+     * \brief Remove a file, ignoring errors
+     *
+     * Used to delete superseded checkpoint files; leaving one behind wastes space but is otherwise harmless.
+     */
+    void removeFile(std::string const &path) {
+        try {
+            boost::filesystem::remove(boost::filesystem::path(path));
+        } catch (boost::filesystem::filesystem_error &) {
+        }
+    }
+
+    /**
+     * \brief Flush a file (or directory) to stable storage with fsync
+     *
+     * Syncing a directory makes the creation of the files in it durable.
+     *
+     * \throw lsst::pex::exceptions::RuntimeErrorException if the file cannot be opened or synced
+     */
+    void syncFile(std::string const &path) {
+        int const fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw LSST_EXCEPT(pexExcept::RuntimeErrorException,
+                (boost::format("Could not open %s to sync it") % path).str());
+        }
+        int const result = ::fsync(fd);
+        ::close(fd);
+        if (result != 0) {
+            throw LSST_EXCEPT(pexExcept::RuntimeErrorException,
+                (boost::format("Could not sync %s") % path).str());
+        }
+    }
+
+    /**
+     * \brief Get the bounding box of a tile
+     */
+    afwImage::BBox getTileBBox(int ix, int iy, int tileSize, int width, int height) {
+        int const x0 = ix * tileSize;
+        int const y0 = iy * tileSize;
+        return afwImage::BBox(afwImage::PointI(x0, y0),
+            std::min(tileSize, width - x0), std::min(tileSize, height - y0));
+    }
+}
+
+/**
+ * \brief Construct a CoaddCheckpoint, reading the journal if the checkpoint directory has one
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if tileSize < 1
+ * or does not match that of existing checkpoints
+ * \throw lsst::pex::exceptions::RuntimeErrorException if the journal is malformed
+ *
+ * \ingroup coadd::kaiser
+ */
+coaddKaiser::CoaddCheckpoint::CoaddCheckpoint(
+    std::string const &dirPath, ///< path of checkpoint directory; created if it does not exist
+    int tileSize                ///< size of each tile along x and y; must match existing checkpoints
+) :
+    _dirPath(dirPath),
+    _tileSize(tileSize),
+    _width(0),
+    _height(0),
+    _nCheckpoints(0),
+    _nComponents(0),
+    _psfCheckpoint(0),
+    _tileCheckpointMap(),
+    _inputList(),
+    _pendingInputList()
+{
+    if (tileSize < 1) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("tileSize=%d must be positive") % tileSize).str());
+    }
+    boost::filesystem::create_directories(boost::filesystem::path(dirPath));
+    if (boost::filesystem::exists(boost::filesystem::path(getJournalPath()))) {
+        readJournal();
+    }
+}
+
+/**
+ * \brief Get an input recorded in a complete checkpoint
+ *
+ * \throw lsst::pex::exceptions::RangeErrorException if index is out of range
+ *
+ * \ingroup coadd::kaiser
+ */
+std::string coaddKaiser::CoaddCheckpoint::getInput(
+    int index   ///< index of input, in the order recorded
+) const {
+    if ((index < 0) || (index >= getNInputs())) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException,
+            (boost::format("index=%d not in range [0, %d)") % index % getNInputs()).str());
+    }
+    return _inputList[index];
+}
+
+/**
+ * \brief Record an input (e.g. the path of an exposure) that has been added to the coadd
+ *
+ * The input is recorded in the journal by the next call to write.
+ *
+ * \ingroup coadd::kaiser
+ */
+void coaddKaiser::CoaddCheckpoint::addInput(
+    std::string const &input    ///< input; must not contain a newline
+) {
+    if (input.find('\n') != std::string::npos) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException, "input contains a newline");
+    }
+    _pendingInputList.push_back(input);
+}
+
+/**
+ * \brief Restore a KaiserCoadd from the last complete checkpoint
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if kaiserCoadd already has components
+ * or is not the size of the checkpointed coadd
+ *
+ * \ingroup coadd::kaiser
+ */
+void coaddKaiser::CoaddCheckpoint::restore(
+    KaiserCoadd &kaiserCoadd    ///< an empty coadd, constructed as for the checkpointed coadd
+) const {
+    if (kaiserCoadd.getNComponents() != 0) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException, "kaiserCoadd is not empty");
+    }
+    if (_nCheckpoints == 0) {
+        return;
+    }
+    if ((kaiserCoadd.getWidth() != _width) || (kaiserCoadd.getHeight() != _height)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("kaiserCoadd is %dx%d; checkpointed coadd is %dx%d") %
+            kaiserCoadd.getWidth() % kaiserCoadd.getHeight() % _width % _height).str());
+    }
+    for (TileCheckpointMap::const_iterator tileIter = _tileCheckpointMap.begin();
+        tileIter != _tileCheckpointMap.end(); ++tileIter) {
+        TileIndex const &tileIndex = tileIter->first;
+        std::string const tilePath = getTilePath(tileIndex, tileIter->second);
+        afwImage::BBox const bbox = getTileBBox(tileIndex.first, tileIndex.second, _tileSize, _width, _height);
+
+        kaiserCoadd._tileMap.setRegion(bbox, KaiserCoadd::MaskedImageD(tilePath),
+            KaiserCoadd::DepthMap(tilePath + "_depth.fits"));
+    }
+    if (_psfCheckpoint > 0) {
+        kaiserCoadd._blurredPsfImage = KaiserCoadd::PsfImage(getPsfPath(_psfCheckpoint));
+    }
+    kaiserCoadd._nComponents = _nComponents;
+    kaiserCoadd._modifiedBBoxList.clear();
+}
+
+/**
+ * \brief Write a checkpoint: the tiles of kaiserCoadd modified since the last checkpoint, and pending inputs
+ *
+ * Does nothing if nothing has changed since the last checkpoint.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if kaiserCoadd is not the size
+ * of the checkpointed coadd
+ * \throw lsst::pex::exceptions::RuntimeErrorException if the journal cannot be written
+ *
+ * \ingroup coadd::kaiser
+ */
+void coaddKaiser::CoaddCheckpoint::write(
+    KaiserCoadd &kaiserCoadd    ///< coadd to checkpoint; its record of modified regions is cleared
+) {
+    int const width = kaiserCoadd.getWidth();
+    int const height = kaiserCoadd.getHeight();
+    if ((_nCheckpoints > 0) && ((width != _width) || (height != _height))) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("kaiserCoadd is %dx%d; checkpointed coadd is %dx%d") %
+            width % height % _width % _height).str());
+    }
+    if (_pendingInputList.empty() && kaiserCoadd._modifiedBBoxList.empty()
+        && (kaiserCoadd.getNComponents() == _nComponents)) {
+        return;
+    }
+    int const checkpoint = _nCheckpoints + 1;
+
+    // find the modified tiles
+    std::set<TileIndex> tileIndexSet;
+    for (std::vector<afwImage::BBox>::const_iterator bboxIter = kaiserCoadd._modifiedBBoxList.begin();
+        bboxIter != kaiserCoadd._modifiedBBoxList.end(); ++bboxIter) {
+        int const ixEnd = ((bboxIter->getX0() + bboxIter->getWidth() - 1) / _tileSize) + 1;
+        int const iyEnd = ((bboxIter->getY0() + bboxIter->getHeight() - 1) / _tileSize) + 1;
+        for (int iy = bboxIter->getY0() / _tileSize; iy < iyEnd; ++iy) {
+            for (int ix = bboxIter->getX0() / _tileSize; ix < ixEnd; ++ix) {
+                tileIndexSet.insert(TileIndex(ix, iy));
+            }
+        }
+    }
+
+    // write the tiles and blurred PSF image to new files, so a crash leaves the previous checkpoint intact
+    for (std::set<TileIndex>::const_iterator tileIter = tileIndexSet.begin();
+        tileIter != tileIndexSet.end(); ++tileIter) {
+        std::string const tilePath = getTilePath(*tileIter, checkpoint);
+        afwImage::BBox const bbox = getTileBBox(tileIter->first, tileIter->second, _tileSize, width, height);
+        KaiserCoadd::MaskedImageD tileMI(bbox.getWidth(), bbox.getHeight());
+        KaiserCoadd::DepthMap tileDepthMap(bbox.getWidth(), bbox.getHeight());
+        kaiserCoadd.getTileMap().getRegion(bbox, tileMI, tileDepthMap);
+        tileMI.writeFits(tilePath);
+        tileDepthMap.writeFits(tilePath + "_depth.fits");
+        syncFile(tilePath + "_img.fits");
+        syncFile(tilePath + "_msk.fits");
+        syncFile(tilePath + "_var.fits");
+        syncFile(tilePath + "_depth.fits");
+    }
+    bool const writePsf = kaiserCoadd.getNComponents() > 0;
+    if (writePsf) {
+        kaiserCoadd.getBlurredPsfImage().writeFits(getPsfPath(checkpoint));
+        syncFile(getPsfPath(checkpoint));
+    }
+    syncFile(_dirPath);
+
+    // append the block to the journal; the checkpoint is complete once the "end" line is written
+    std::ostringstream block;
+    block << "checkpoint " << checkpoint << "\n";
+    block << "size " << width << " " << height << " " << _tileSize << "\n";
+    block << "nComponents " << kaiserCoadd.getNComponents() << "\n";
+    for (std::vector<std::string>::const_iterator inputIter = _pendingInputList.begin();
+        inputIter != _pendingInputList.end(); ++inputIter) {
+        block << "input " << *inputIter << "\n";
+    }
+    for (std::set<TileIndex>::const_iterator tileIter = tileIndexSet.begin();
+        tileIter != tileIndexSet.end(); ++tileIter) {
+        block << "tile " << tileIter->first << " " << tileIter->second << "\n";
+    }
+    if (writePsf) {
+        block << "psf\n";
+    }
+    block << "end " << checkpoint << "\n";
+    {
+        std::ofstream journal(getJournalPath().c_str(), std::ios::out | std::ios::app);
+        journal << block.str();
+        journal.flush();
+        if (!journal) {
+            throw LSST_EXCEPT(pexExcept::RuntimeErrorException,
+                (boost::format("Could not write checkpoint journal %s") % getJournalPath()).str());
+        }
+    }
+    // the new files and the journal must be on stable storage before the files they supersede are removed,
+    // else a crash of the OS could leave a journal that names deleted files
+    syncFile(getJournalPath());
+    syncFile(_dirPath);
+
+    // update state and delete superseded files
+    for (std::set<TileIndex>::const_iterator tileIter = tileIndexSet.begin();
+        tileIter != tileIndexSet.end(); ++tileIter) {
+        TileCheckpointMap::iterator const mapIter = _tileCheckpointMap.find(*tileIter);
+        if (mapIter != _tileCheckpointMap.end()) {
+            std::string const oldTilePath = getTilePath(*tileIter, mapIter->second);
+            removeFile(oldTilePath + "_img.fits");
+            removeFile(oldTilePath + "_msk.fits");
+            removeFile(oldTilePath + "_var.fits");
+            removeFile(oldTilePath + "_depth.fits");
+        }
+        _tileCheckpointMap[*tileIter] = checkpoint;
+    }
+    if (writePsf) {
+        if (_psfCheckpoint > 0) {
+            removeFile(getPsfPath(_psfCheckpoint));
+        }
+        _psfCheckpoint = checkpoint;
+    }
+    _width = width;
+    _height = height;
+    _nCheckpoints = checkpoint;
+    _nComponents = kaiserCoadd.getNComponents();
+    _inputList.insert(_inputList.end(), _pendingInputList.begin(), _pendingInputList.end());
+    _pendingInputList.clear();
+    kaiserCoadd._modifiedBBoxList.clear();
+}
+
+std::string coaddKaiser::CoaddCheckpoint::getJournalPath() const {
+    return _dirPath + "/journal.txt";
+}
+
+std::string coaddKaiser::CoaddCheckpoint::getTilePath(TileIndex const &tileIndex, int checkpoint) const {
+    return (boost::format("%s/tile_%d_%d_%d") % _dirPath % tileIndex.first % tileIndex.second % checkpoint).str();
+}
+
+std::string coaddKaiser::CoaddCheckpoint::getPsfPath(int checkpoint) const {
+    return (boost::format("%s/psf_%d.fits") % _dirPath % checkpoint).str();
+}
+
+/**
+ * \brief Read the journal, ignoring a final incomplete block
+ *
+ * A block is complete once its "end" line, including the newline, has been written; a crash while
+ * appending a block leaves an incomplete block, which is removed from the journal.
+ */
+void coaddKaiser::CoaddCheckpoint::readJournal() {
+    std::ifstream journal(getJournalPath().c_str());
+    if (!journal) {
+        throw LSST_EXCEPT(pexExcept::RuntimeErrorException,
+            (boost::format("Could not read checkpoint journal %s") % getJournalPath()).str());
+    }
+    // state of the block being read; a block that is cut short by a crash may have a malformed last line,
+    // so malformed lines are only an error if the block is complete
+    int checkpoint = 0;
+    int width = 0;
+    int height = 0;
+    int tileSize = 0;
+    int nComponents = 0;
+    bool hasPsf = false;
+    bool isMalformed = false;
+    std::vector<std::string> inputList;
+    std::vector<TileIndex> tileIndexList;
+    std::string completeText;   // text of complete blocks
+    std::string blockText;      // text of the block being read
+
+    std::string line;
+    while (std::getline(journal, line)) {
+        blockText += line + "\n";
+        std::string::size_type const sepInd = line.find(' ');
+        std::string const key = line.substr(0, sepInd);
+        std::string const value = (sepInd == std::string::npos) ? std::string() : line.substr(sepInd + 1);
+        std::istringstream valueStream(value);
+        if (key == "checkpoint") {
+            valueStream >> checkpoint;
+            inputList.clear();
+            tileIndexList.clear();
+            hasPsf = false;
+            isMalformed = false;
+        } else if (key == "size") {
+            valueStream >> width >> height >> tileSize;
+        } else if (key == "nComponents") {
+            valueStream >> nComponents;
+        } else if (key == "input") {
+            inputList.push_back(value);
+        } else if (key == "tile") {
+            int ix, iy;
+            valueStream >> ix >> iy;
+            tileIndexList.push_back(TileIndex(ix, iy));
+        } else if (key == "psf") {
+            hasPsf = true;
+        } else if (key == "end") {
+            if (journal.eof()) {
+                // the line was not terminated by a newline, so it (e.g. "end 1" of "end 12") was cut short
+                break;
+            }
+            int endCheckpoint = 0;
+            valueStream >> endCheckpoint;
+            if (isMalformed || !valueStream || (endCheckpoint != checkpoint) || (checkpoint != _nCheckpoints + 1)) {
+                throw LSST_EXCEPT(pexExcept::RuntimeErrorException,
+                    (boost::format("Checkpoint journal %s is malformed at checkpoint %d") %
+                    getJournalPath() % endCheckpoint).str());
+            }
+            if (tileSize != _tileSize) {
+                throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+                    (boost::format("tileSize=%d does not match checkpoint tile size %d") %
+                    _tileSize % tileSize).str());
+            }
+            _width = width;
+            _height = height;
+            _nComponents = nComponents;
+            _inputList.insert(_inputList.end(), inputList.begin(), inputList.end());
+            for (std::vector<TileIndex>::const_iterator tileIter = tileIndexList.begin();
+                tileIter != tileIndexList.end(); ++tileIter) {
+                _tileCheckpointMap[*tileIter] = checkpoint;
+            }
+            if (hasPsf) {
+                _psfCheckpoint = checkpoint;
+            }
+            _nCheckpoints = checkpoint;
+            completeText += blockText;
+            blockText.clear();
+            continue;
+        } else {
+            isMalformed = true;
+        }
+        if (!valueStream) {
+            isMalformed = true;
+        }
+    }
+
+    journal.close();
+
+    // discard an incomplete final block, so the next checkpoint is appended to a well-formed journal
+    if (!blockText.empty()) {
+        std::string const tempPath = getJournalPath() + ".tmp";
+        {
+            std::ofstream tempJournal(tempPath.c_str(), std::ios::out | std::ios::trunc);
+            tempJournal << completeText;
+            tempJournal.flush();
+            if (!tempJournal) {
+                throw LSST_EXCEPT(pexExcept::RuntimeErrorException,
+                    (boost::format("Could not write checkpoint journal %s") % tempPath).str());
+            }
+        }
+        // as in write, the new journal must be on stable storage before it replaces the old one
+        syncFile(tempPath);
+        if (std::rename(tempPath.c_str(), getJournalPath().c_str()) != 0) {
+            throw LSST_EXCEPT(pexExcept::RuntimeErrorException,
+                (boost::format("Could not rename %s to %s") % tempPath % getJournalPath()).str());
+        }
+        syncFile(_dirPath);
+    }
+}
@@ -29,7 +29,11 @@
 *
 * @author Russell Owen
 */
-#include <algorithm> // for swap
+#include <algorithm>
+
+#include <sys/time.h>
+
+#include "boost/format.hpp"
 
 #include "lsst/pex/exceptions.h"
 #include "lsst/afw/math.h"
@@ -41,96 +45,380 @@ namespace afwMath = lsst::afw::math;
 namespace afwImage = lsst::afw::image;
 namespace coaddKaiser = lsst::coadd::kaiser;
 
-// local functions
 namespace {
+    int const DefaultStripHeight = 256;  ///< default number of rows per strip for streaming CoaddComponent
 
-    /**
-     * \brief Reflect an image in place.
-     */
-    void reflectImage(afwImage::Image<coaddKaiser::CoaddComponent::pixelType> &image) {
-        typedef coaddKaiser::CoaddComponent::ImageCC::x_iterator XIteratorCC;
-        
-        if ((image.getHeight() < 1) || (image.getWidth() < 1)) {
-            throw LSST_EXCEPT(pexExcept::RangeErrorException, "Image width and/or height is 0");
-        }
-        
-        const int nRows = static_cast<int>(image.getHeight());
-        const int nFullRowsToSwap = nRows / 2;
-        const bool isOddNRows = (nRows % 2 != 0);
-         // use x_at(xLast, y) instead of row_end(y) to get the reverse row iterator
-         // because row_end(y) starts one beyond the last pixel
-        const int xLast = static_cast<int>(image.getWidth()) - 1;
-        for (int yFwd = 0, yRev = nRows - 1; yFwd < nFullRowsToSwap; ++yFwd, --yRev) {
-            for (XIteratorCC fwdPtr = image.row_begin(yFwd), revPtr = image.x_at(xLast, yRev);
-                fwdPtr != image.row_end(yFwd); ++fwdPtr, --revPtr) {
-                std::swap(*fwdPtr, *revPtr);
-            }
-        }
-        if (isOddNRows) {
-            const unsigned int yCtr = nFullRowsToSwap;
-            const unsigned int halfCols = image.getWidth() / 2;
-            XIteratorCC const fwdEndCtr = image.x_at(halfCols + 1, yCtr); // +1 for 1 after last pixel to swap
-            XIteratorCC fwdPtr = image.row_begin(yCtr);
-            XIteratorCC revPtr = image.x_at(xLast, yCtr);
-            for ( ; fwdPtr != fwdEndCtr; ++fwdPtr, --revPtr) {
-                std::swap(*fwdPtr, *revPtr);
-            }
-        }
+    /// return the wall time (sec)
+    double getTime() {
+        timeval tv;
+        gettimeofday(&tv, 0);
+        return static_cast<double>(tv.tv_sec) + (1.0e-6 * static_cast<double>(tv.tv_usec));
     }
 
-} // anonymous namespace
+    /// return the number of bytes used by the pixels of a masked image of the specified size
+    template <typename PixelT>
+    double getMaskedImageBytes(int width, int height) {
+        return static_cast<double>(width) * static_cast<double>(height)
+            * static_cast<double>(sizeof(PixelT) + sizeof(afwImage::MaskPixel) + sizeof(afwImage::VariancePixel));
+    }
+}
 
 /**
  * \brief CoaddComponent constructor
  *
- * \todo: handle asymmetric kernels properly. scienceExposure should be convolved with the *reflected* PSF,
- * but this requires significant extra work (perhaps new convolution functions or kernels) to handle
- * spatially varying kernels. For now, for expediency, I allow spatially varying kernels but convolve with
- * the un-reflected PSF.
+ * For a proper Kaiser coadd scienceExposure should be convolved with the *reflected* PSF;
+ * to do this call control.setReflectPsf(true). A spatially varying PSF can only be reflected if it is
+ * evaluated on a grid of tiles (see CoaddComponentControl::setNPsfTiles). By default the un-reflected
+ * PSF is used, for backwards compatibility.
+ *
+ * If control.getLazy() then only the PSF tile grid (if any) is computed here; sigmaSq, the blurred PSF
+ * and the blurred exposure are computed when first requested.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if a reflected PSF is requested for a spatially
+ * varying kernel without PSF tiles.
  *
  * \ingroup coadd::kaiser
  */ 
-coaddKaiser::CoaddComponent::CoaddComponent(
+template <typename PixelT>
+coaddKaiser::CoaddComponent<PixelT>::CoaddComponent(
     ExposureF const &scienceExposure,   ///< science Exposure with the background subtracted
     lsst::afw::math::Kernel const &psfKernel,   ///< PSF of science Exposure
-    bool normalizePsf                   ///< normalize psf
+    bool normalizePsf,                  ///< normalize psf
+    CoaddComponentControl const &control    ///< control parameters, e.g. convolution method
 ) :
     lsst::daf::base::Citizen(typeid(this)),
     _sigmaSq(0),
-    _blurredExposure(scienceExposure.getWidth(), scienceExposure.getHeight()),
+    _blurredExposure(control.getLazy() ? 0 : scienceExposure.getWidth(),
+        control.getLazy() ? 0 : scienceExposure.getHeight()),
     _blurredPsfImage(psfKernel.getWidth() * 2 - 1, psfKernel.getHeight() * 2 - 1, 0),
-    _normalizePsf(normalizePsf)
+    _normalizePsf(normalizePsf),
+    _control(control),
+    _psfTileGridPtr(),
+    _isLazy(control.getLazy()),
+    _bbox(afwImage::PointI(0, 0), scienceExposure.getWidth(), scienceExposure.getHeight()),
+    _wcsPtr(),
+    _scienceExposure(control.getLazy() ? ExposureF(scienceExposure) : ExposureF(0, 0)),
+    _psfKernelPtr(),
+    _haveSigmaSq(false),
+    _haveBlurredPsf(false),
+    _lastBlurredRegionPtr(),
+    _stats(),
+    _sigmaSqMapPtr()
 {
+    _stats.kernelWidth = psfKernel.getWidth();
+    _stats.kernelHeight = psfKernel.getHeight();
+    if (scienceExposure.hasWcs()) {
+        _wcsPtr.reset(new afwImage::Wcs(*scienceExposure.getWcs()));
+    }
+    if (_isLazy) {
+        _psfKernelPtr = psfKernel.clone();
+        typename ExposureF::MaskedImageT const scienceMI = scienceExposure.getMaskedImage();
+        double const startTime = getTime();
+        makePsfTileGrid(psfKernel,
+            afwImage::BBox(scienceMI.getXY0(), scienceMI.getWidth(), scienceMI.getHeight()));
+        _stats.blurredExposureTime += getTime() - startTime;
+        return;
+    }
+    _stats.nBytesAllocated += getMaskedImageBytes<PixelT>(scienceExposure.getWidth(), scienceExposure.getHeight());
     computeSigmaSq(scienceExposure);
+    _haveSigmaSq = true;
     computeBlurredPsf(psfKernel);
+    _haveBlurredPsf = true;
     computeBlurredExposure(scienceExposure, psfKernel);
 };
 
 /**
- * \brief compute _sigmaSq
+ * \brief CoaddComponent constructor that blurs the science exposure into a caller-provided exposure
+ *
+ * Use this to reuse the pixels of blurredExposure (e.g. from a MaskedImagePool) rather than allocating
+ * a new blurred exposure. The pixels of blurredExposure are overwritten, its xy0 is set to (0, 0)
+ * and its WCS is set to that of the science exposure; getBlurredExposure returns an exposure
+ * that shares its pixels. The CoaddComponent is never lazy (control.getLazy() is ignored).
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if blurredExposure is not the same size as
+ * scienceExposure, or if a reflected PSF is requested for a spatially varying kernel without PSF tiles.
  *
  * \ingroup coadd::kaiser
  */
-void coaddKaiser::CoaddComponent::computeSigmaSq(
-    ExposureF const &scienceExposure    ///< science Exposure
-) {
-    typedef ExposureF::MaskedImageT::x_iterator XIteratorF;
-
-    ExposureF::MaskedImageT scienceMI = scienceExposure.getMaskedImage();
-    // compute a vector containing only the good pixels, then take the median of that
-    std::vector<double> varianceList(scienceMI.getHeight() * scienceMI.getWidth());
-    std::vector<double>::iterator varIter = varianceList.begin();
-    for (int y = 0, yEnd = scienceMI.getHeight(); y < yEnd; ++y) {
-        for (XIteratorF ptr = scienceMI.row_begin(y); ptr != scienceMI.row_end(y); ++ptr) {
-            if (ptr.mask() != 0) {
-                continue;
+template <typename PixelT>
+coaddKaiser::CoaddComponent<PixelT>::CoaddComponent(
+    ExposureF const &scienceExposure,   ///< science Exposure with the background subtracted
+    lsst::afw::math::Kernel const &psfKernel,   ///< PSF of science Exposure
+    ExposureCC &blurredExposure,        ///< blurred science Exposure; must be the same size as scienceExposure
+    bool normalizePsf,                  ///< normalize psf
+    CoaddComponentControl const &control    ///< control parameters, e.g. convolution method
+) :
+    lsst::daf::base::Citizen(typeid(this)),
+    _sigmaSq(0),
+    _blurredExposure(blurredExposure),
+    _blurredPsfImage(psfKernel.getWidth() * 2 - 1, psfKernel.getHeight() * 2 - 1, 0),
+    _normalizePsf(normalizePsf),
+    _control(control),
+    _psfTileGridPtr(),
+    _isLazy(false),
+    _bbox(afwImage::PointI(0, 0), scienceExposure.getWidth(), scienceExposure.getHeight()),
+    _wcsPtr(),
+    _scienceExposure(0, 0),
+    _psfKernelPtr(),
+    _haveSigmaSq(false),
+    _haveBlurredPsf(false),
+    _lastBlurredRegionPtr(),
+    _stats(),
+    _sigmaSqMapPtr()
+{
+    _stats.kernelWidth = psfKernel.getWidth();
+    _stats.kernelHeight = psfKernel.getHeight();
+    if ((blurredExposure.getWidth() != scienceExposure.getWidth())
+        || (blurredExposure.getHeight() != scienceExposure.getHeight())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("blurredExposure is %dx%d; scienceExposure is %dx%d") %
+            blurredExposure.getWidth() % blurredExposure.getHeight() %
+            scienceExposure.getWidth() % scienceExposure.getHeight()).str());
+    }
+    if (scienceExposure.hasWcs()) {
+        _wcsPtr.reset(new afwImage::Wcs(*scienceExposure.getWcs()));
+        blurredExposure.setWcs(*_wcsPtr);
+    }
+    typename ExposureCC::MaskedImageT blurredMI = blurredExposure.getMaskedImage();
+    blurredMI.setXY0(afwImage::PointI(0, 0));
+    computeSigmaSq(scienceExposure);
+    _haveSigmaSq = true;
+    computeBlurredPsf(psfKernel);
+    _haveBlurredPsf = true;
+    computeBlurredExposure(scienceExposure, psfKernel);
+};
+
+/**
+ * \brief Streaming CoaddComponent constructor
+ *
+ * Reads the science exposure from scienceSource in horizontal strips (of control.getStripHeight() rows,
+ * plus a halo of about half a kernel height above and below) and sends each blurred strip to blurredSink,
+ * so peak memory is proportional to the strip height times the exposure width rather than to the size
+ * of the exposure. getBlurredExposure returns an empty exposure.
+ *
+ * sigmaSq is accumulated strip by strip using StreamingMedian, so it is only available after construction
+ * (the strips are not scaled by it) and may differ from that of the non-streaming constructor by about 0.1%.
+ *
+ * The blurred strips match the corresponding rows of the non-streaming blurred exposure, except that
+ * FFT convolution evaluates a spatially varying PSF once per FFT tile, and those tiles depend on the strip
+ * height; use PSF tiles (CoaddComponentControl::setNPsfTiles) if exact agreement matters.
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+coaddKaiser::CoaddComponent<PixelT>::CoaddComponent(
+    StripSource &scienceSource,         ///< source of strips of science Exposure with the background subtracted
+    lsst::afw::math::Kernel const &psfKernel,   ///< PSF of science Exposure
+    StripSink<PixelT> &blurredSink,     ///< sink for strips of blurred science Exposure
+    bool normalizePsf,                  ///< normalize psf
+    CoaddComponentControl const &control    ///< control parameters, e.g. convolution method and strip height
+) :
+    lsst::daf::base::Citizen(typeid(this)),
+    _sigmaSq(0),
+    _blurredExposure(0, 0),
+    _blurredPsfImage(psfKernel.getWidth() * 2 - 1, psfKernel.getHeight() * 2 - 1, 0),
+    _normalizePsf(normalizePsf),
+    _control(control),
+    _psfTileGridPtr(),
+    _isLazy(false),
+    _bbox(),
+    _wcsPtr(),
+    _scienceExposure(0, 0),
+    _psfKernelPtr(),
+    _haveSigmaSq(false),
+    _haveBlurredPsf(false),
+    _lastBlurredRegionPtr(),
+    _stats(),
+    _sigmaSqMapPtr()
+{
+    _stats.kernelWidth = psfKernel.getWidth();
+    _stats.kernelHeight = psfKernel.getHeight();
+    computeBlurredPsf(psfKernel);
+    _haveBlurredPsf = true;
+    computeBlurredStrips(scienceSource, psfKernel, blurredSink);
+    _haveSigmaSq = true;
+};
+
+/**
+ * \brief Get sigma squared: the median variance of the unmasked pixels of the science exposure
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+double coaddKaiser::CoaddComponent<PixelT>::getSigmaSq() const {
+    if (!_haveSigmaSq) {
+        computeSigmaSq(_scienceExposure);
+        _haveSigmaSq = true;
+    }
+    return _sigmaSq;
+};
+
+/**
+ * \brief Get the map of sigma squared across the science exposure
+ *
+ * \return the map, or a null pointer if the control object did not specify sigmaSq cells
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+coaddKaiser::SigmaSqMap::ConstPtr coaddKaiser::CoaddComponent<PixelT>::getSigmaSqMap() const {
+    getSigmaSq(); // the map is computed with sigmaSq
+    return _sigmaSqMapPtr;
+};
+
+/**
+ * \brief Get the blurred PSF image: the PSF convolved with the reflected PSF
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+typename coaddKaiser::CoaddComponent<PixelT>::ImageCC
+coaddKaiser::CoaddComponent<PixelT>::getBlurredPsfImage() const {
+    if (!_haveBlurredPsf) {
+        computeBlurredPsf(*_psfKernelPtr);
+        _haveBlurredPsf = true;
+    }
+    return _blurredPsfImage;
+};
+
+/**
+ * \brief Get the blurred exposure
+ *
+ * In lazy mode this blurs the whole science exposure the first time it is called.
+ *
+ * \return the blurred exposure; empty if the CoaddComponent was computed in strips
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+typename coaddKaiser::CoaddComponent<PixelT>::ExposureCC
+coaddKaiser::CoaddComponent<PixelT>::getBlurredExposure() const {
+    if (_isLazy && _bbox) {
+        return getBlurredExposure(_bbox);
+    }
+    return _blurredExposure;
+};
+
+/**
+ * \brief Get a region of the blurred exposure
+ *
+ * The returned exposure has xy0 = the corner of bbox and the WCS of the science exposure, so its pixels map
+ * to the sky just as the corresponding pixels of the whole blurred exposure do.
+ *
+ * In lazy mode only the region (plus a halo of about half a kernel) of the science exposure is convolved,
+ * and the result is saved in place of the previously saved region: a later request for the same region,
+ * or for a region inside it, returns the saved pixels. Only one region is saved, so memory use does not grow
+ * with the number of regions requested. Pixels whose kernel extends past the science exposure are edge
+ * pixels, just as in the whole blurred exposure, and all other pixels match it, except that FFT convolution
+ * evaluates a spatially varying PSF once per FFT tile, and those tiles depend on the region; use PSF tiles
+ * (CoaddComponentControl::setNPsfTiles) if exact agreement matters.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if bbox is empty or is not contained in getBBox()
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+typename coaddKaiser::CoaddComponent<PixelT>::ExposureCC
+coaddKaiser::CoaddComponent<PixelT>::getBlurredExposure(
+    afwImage::BBox const &bbox      ///< region of interest, relative to the origin of the science exposure
+) const {
+    checkRegion(bbox);
+    if (!_isLazy) {
+        ExposureCC blurredExposure(_blurredExposure, bbox, false);
+        if (_wcsPtr) {
+            blurredExposure.setWcs(*_wcsPtr);
+        }
+        return blurredExposure;
+    }
+    if (_lastBlurredRegionPtr) {
+        typename ExposureCC::MaskedImageT const regionMI = _lastBlurredRegionPtr->getMaskedImage();
+        if ((bbox.getX0() >= regionMI.getX0()) && (bbox.getY0() >= regionMI.getY0())
+            && (bbox.getX1() < regionMI.getX0() + regionMI.getWidth())
+            && (bbox.getY1() < regionMI.getY0() + regionMI.getHeight())) {
+            afwImage::BBox subBBox(bbox);
+            subBBox.shift(-regionMI.getX0(), -regionMI.getY0());
+            ExposureCC blurredExposure(*_lastBlurredRegionPtr, subBBox, false);
+            if (_wcsPtr) {
+                blurredExposure.setWcs(*_wcsPtr);
             }
-            *varIter = ptr.variance();
-            ++varIter;
+            return blurredExposure;
         }
     }
-    // varIter now points to the end of the list
-    _sigmaSq = coaddKaiser::medianBinapprox(varianceList.begin(), varIter);
+    ExposureCC blurredExposure = computeBlurredRegion(bbox);
+    _lastBlurredRegionPtr.reset(new ExposureCC(blurredExposure));
+    return blurredExposure;
+};
+
+/**
+ * \brief Get a region of the blurred exposure without saving it
+ *
+ * As getBlurredExposure(bbox), except that in lazy mode the blurred region is not saved (nor looked for
+ * in the saved region) and the region saved by getBlurredExposure(bbox) is kept. Intended for callers that
+ * use each region once, such as KaiserCoadd::addComponent with warp tiles.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if bbox is empty or is not contained in getBBox()
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+typename coaddKaiser::CoaddComponent<PixelT>::ExposureCC
+coaddKaiser::CoaddComponent<PixelT>::blurRegion(
+    afwImage::BBox const &bbox      ///< region of interest, relative to the origin of the science exposure
+) const {
+    if (!_isLazy) {
+        return getBlurredExposure(bbox);
+    }
+    checkRegion(bbox);
+    return computeBlurredRegion(bbox);
+};
+
+/**
+ * \brief Check that a region is not empty and is contained in the science exposure
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if bbox is empty or is not contained in getBBox()
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+void coaddKaiser::CoaddComponent<PixelT>::checkRegion(
+    afwImage::BBox const &bbox      ///< region of interest, relative to the origin of the science exposure
+) const {
+    if (!bbox || (bbox.getX0() < _bbox.getX0()) || (bbox.getY0() < _bbox.getY0())
+        || (bbox.getX1() > _bbox.getX1()) || (bbox.getY1() > _bbox.getY1())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("bbox (%d, %d) - (%d, %d) is empty or not contained in (%d, %d) - (%d, %d)") %
+            bbox.getX0() % bbox.getY0() % bbox.getX1() % bbox.getY1() %
+            _bbox.getX0() % _bbox.getY0() % _bbox.getX1() % _bbox.getY1()).str());
+    }
+};
+
+/**
+ * \brief compute _sigmaSq, and _sigmaSqMapPtr if the control object specifies sigmaSq cells
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+void coaddKaiser::CoaddComponent<PixelT>::computeSigmaSq(
+    ExposureF const &scienceExposure    ///< science Exposure
+) const {
+    double const startTime = getTime();
+    typename ExposureF::MaskedImageT scienceMI = scienceExposure.getMaskedImage();
+    // take the median of the variance of the good pixels (those with no mask bits set),
+    // counting them in the same pass
+    long int nUnmaskedPixels = 0;
+    _sigmaSq = coaddKaiser::medianBinapproxMaskedImage(*(scienceMI.getVariance()), *(scienceMI.getMask()),
+        ~static_cast<afwImage::MaskPixel>(0), 1000, &nUnmaskedPixels);
+    _stats.nUnmaskedPixels = static_cast<int>(nUnmaskedPixels);
+    _stats.nMaskedPixels = (scienceMI.getWidth() * scienceMI.getHeight()) - _stats.nUnmaskedPixels;
+    if ((_control.getNSigmaSqCellsX() > 0) && (_control.getNSigmaSqCellsY() > 0)) {
+        SigmaSqMap::Ptr sigmaSqMapPtr(new SigmaSqMap(
+            afwImage::BBox(scienceMI.getXY0(), scienceMI.getWidth(), scienceMI.getHeight()),
+            _control.getNSigmaSqCellsX(), _control.getNSigmaSqCellsY()));
+        sigmaSqMapPtr->addMaskedImage(scienceMI, _control.getNSigmaSqThreads());
+        sigmaSqMapPtr->finish();
+        _sigmaSqMapPtr = sigmaSqMapPtr;
+    }
+    _stats.sigmaSqTime += getTime() - startTime;
 // eventually something like the following will work directly on the variance image,
 // but for now makeStatistics does not ignore masked pixels so is not usable; see PR #749
 //     afwMath::Statistics varStats = afwMath::makeStatistics(*(scienceMI.getVariance()), afwMath::MEDIAN);
@@ -140,48 +428,238 @@ void coaddKaiser::CoaddComponent::computeSigmaSq(
 /**
  * \brief Compute _blurredPsfImage = psfKernel convolved with psfKernel(-r)
  *
+ * Uses the blurred PSF cache, if control has one.
+ *
  * \ingroup coadd::kaiser
  */
-void coaddKaiser::CoaddComponent::computeBlurredPsf(
+template <typename PixelT>
+void coaddKaiser::CoaddComponent<PixelT>::computeBlurredPsf(
     lsst::afw::math::Kernel const &psfKernel    ///< PSF kernel
-) {
-    int const psfWidth = psfKernel.getWidth();
-    int const psfHeight = psfKernel.getHeight();
-    int const paddedWidth =  3 * psfWidth - 2;
-    int const paddedHeight = 3 * psfHeight - 2;
-    // initialize padded reflected psf image to 0 because only the center is set by computeImage
-    afwImage::Image<double> paddedReflPsfImage(paddedWidth, paddedHeight, 0);
-    afwImage::BBox reflPsfBBox(afwImage::PointI(psfWidth-1, psfHeight-1), psfWidth, psfHeight);
-    afwImage::Image<double> reflPsfImage(paddedReflPsfImage, reflPsfBBox);
-    psfKernel.computeImage(reflPsfImage, true);
-    reflectImage(reflPsfImage);
-    // no need to initialize padded blurred PSF image because all pixels are set
-    afwImage::Image<double> paddedBlurredPsfImage(paddedWidth, paddedHeight);
-    afwMath::convolve(paddedBlurredPsfImage, paddedReflPsfImage, psfKernel, _normalizePsf);
-    afwImage::BBox blurredPsfBBox(afwImage::PointI(psfKernel.getCtrX(), psfKernel.getCtrY()),
-        _blurredPsfImage.getWidth(), _blurredPsfImage.getHeight());
-    _blurredPsfImage <<= afwImage::Image<double>(paddedBlurredPsfImage, blurredPsfBBox);
+) const {
+    double const startTime = getTime();
+    BlurredPsfCache::Ptr const blurredPsfCachePtr = _control.getBlurredPsfCache();
+    BlurredPsfImage::ConstPtr const blurredPsfImagePtr = blurredPsfCachePtr ?
+        blurredPsfCachePtr->get(psfKernel, _normalizePsf) : computeBlurredPsfImage(psfKernel, _normalizePsf);
+    // blurred PSF images are always double; convert to the pixel type of the blurred PSF image
+    _blurredPsfImage <<= ImageCC(*blurredPsfImagePtr, true);
+    _stats.nBytesAllocated += static_cast<double>(_blurredPsfImage.getWidth())
+        * static_cast<double>(_blurredPsfImage.getHeight()) * static_cast<double>(sizeof(PixelT));
+    _stats.blurredPsfTime += getTime() - startTime;
 };
 
 /**
  * \brief Compute _blurredEposure = scienceExposure convolved with psfKernel
  *
- * \warning If you want scienceExposure convolved with psfKernel(-r)
- * (the standard Kaiser thing to do) then feed in psfKernel(-r)
- *
  * \ingroup coadd::kaiser
  */
-void coaddKaiser::CoaddComponent::computeBlurredExposure(
+template <typename PixelT>
+void coaddKaiser::CoaddComponent<PixelT>::computeBlurredExposure(
     ExposureF const &scienceExposure,   ///< science exposure
     lsst::afw::math::Kernel const &psfKernel    ///< PSF kernel
 ) {
-    ExposureCC::MaskedImageT blurredMI = _blurredExposure.getMaskedImage();
-    ExposureF::MaskedImageT const scienceMI = scienceExposure.getMaskedImage();
+    double const startTime = getTime();
+    typename ExposureCC::MaskedImageT blurredMI = _blurredExposure.getMaskedImage();
+    typename ExposureF::MaskedImageT const scienceMI = scienceExposure.getMaskedImage();
 //     scienceExposure.writeFits("scienceExposure");
-    afwMath::convolve(blurredMI, scienceMI, psfKernel, _normalizePsf);
+    makePsfTileGrid(psfKernel,
+        afwImage::BBox(scienceMI.getXY0(), scienceMI.getWidth(), scienceMI.getHeight()));
+    blurMaskedImage(blurredMI, scienceMI, psfKernel);
 //     _blurredExposure.writeFits("blurredExposure");
     if (scienceExposure.hasWcs()) {
         afwImage::Wcs::Ptr scienceWcsPtr = scienceExposure.getWcs();
         _blurredExposure.setWcs(*scienceWcsPtr);
     }
+    _stats.blurredExposureTime += getTime() - startTime;
+};
+
+/**
+ * \brief Blur one region of the science exposure (lazy mode)
+ *
+ * The region is grown by the kernel halo (clipped to the science exposure) before convolving,
+ * so the result matches the corresponding region of the whole blurred exposure.
+ *
+ * \return the blurred region, with xy0 = the corner of bbox and the WCS of the science exposure
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+typename coaddKaiser::CoaddComponent<PixelT>::ExposureCC
+coaddKaiser::CoaddComponent<PixelT>::computeBlurredRegion(
+    afwImage::BBox const &bbox          ///< region, relative to the origin of the science exposure
+) const {
+    double const startTime = getTime();
+    afwMath::Kernel const &psfKernel = *_psfKernelPtr;
+    // the PSF may be reflected, so allow for the kernel center being on either side
+    int const haloX = std::max(psfKernel.getCtrX(), psfKernel.getWidth() - 1 - psfKernel.getCtrX());
+    int const haloY = std::max(psfKernel.getCtrY(), psfKernel.getHeight() - 1 - psfKernel.getCtrY());
+    afwImage::BBox grownBBox(afwImage::PointI(bbox.getX0() - haloX, bbox.getY0() - haloY),
+        bbox.getWidth() + (2 * haloX), bbox.getHeight() + (2 * haloY));
+    grownBBox.clip(_bbox);
+
+    MaskedImageF const scienceMI(_scienceExposure.getMaskedImage(), grownBBox, false);
+    typename ExposureCC::MaskedImageT grownMI(grownBBox.getWidth(), grownBBox.getHeight());
+    grownMI.setXY0(scienceMI.getXY0());
+    blurMaskedImage(grownMI, scienceMI, psfKernel);
+
+    typename ExposureCC::MaskedImageT blurredMI(grownMI,
+        afwImage::BBox(afwImage::PointI(bbox.getX0() - grownBBox.getX0(), bbox.getY0() - grownBBox.getY0()),
+            bbox.getWidth(), bbox.getHeight()),
+        true);
+    blurredMI.setXY0(bbox.getLLC());
+    ExposureCC blurredExposure(blurredMI);
+    if (_wcsPtr) {
+        blurredExposure.setWcs(*_wcsPtr);
+    }
+    _stats.nBytesAllocated += getMaskedImageBytes<PixelT>(bbox.getWidth(), bbox.getHeight());
+    _stats.blurredExposureTime += getTime() - startTime;
+    return blurredExposure;
 };
+
+/**
+ * \brief Compute _sigmaSq and blur the science exposure one strip at a time
+ *
+ * Each strip of the science exposure is read with enough extra rows above and below that the blurred
+ * strip matches the corresponding rows of the whole blurred exposure. sigmaSq (and the SigmaSqMap, if wanted)
+ * is computed from the unmasked pixels of each strip (excluding the extra rows, so each pixel is counted once).
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+void coaddKaiser::CoaddComponent<PixelT>::computeBlurredStrips(
+    StripSource &scienceSource,         ///< source of strips of science exposure
+    lsst::afw::math::Kernel const &psfKernel,   ///< PSF kernel
+    StripSink<PixelT> &blurredSink      ///< sink for strips of blurred science exposure
+) {
+    typedef typename MaskedImageF::x_iterator XIteratorF;
+
+    afwImage::BBox const bbox = scienceSource.getBBox();
+    int const width = bbox.getWidth();
+    int const height = bbox.getHeight();
+    int const stripHeight = (_control.getStripHeight() > 0) ? _control.getStripHeight() : DefaultStripHeight;
+    // the PSF may be reflected, so allow for the kernel center being on either side
+    int const halo = std::max(psfKernel.getCtrY(), psfKernel.getHeight() - 1 - psfKernel.getCtrY());
+    double startTime = getTime();
+    makePsfTileGrid(psfKernel, bbox);
+    _stats.blurredExposureTime += getTime() - startTime;
+
+    SigmaSqMap::Ptr sigmaSqMapPtr;
+    if ((_control.getNSigmaSqCellsX() > 0) && (_control.getNSigmaSqCellsY() > 0)) {
+        sigmaSqMapPtr.reset(new SigmaSqMap(bbox, _control.getNSigmaSqCellsX(), _control.getNSigmaSqCellsY()));
+    }
+
+    // reading strips and sending them to the sink is not counted in the stage times
+    StreamingMedian varianceMedian;
+    int nUnmaskedPixels = 0;
+    for (int y0 = 0; y0 < height; y0 += stripHeight) {
+        int const y1 = std::min(height, y0 + stripHeight); // one past the end
+        int const grownY0 = std::max(0, y0 - halo);
+        int const grownY1 = std::min(height, y1 + halo);
+        MaskedImageF const scienceMI = scienceSource.readStrip(grownY0, grownY1 - grownY0);
+
+        startTime = getTime();
+        for (int y = y0 - grownY0, yEnd = y1 - grownY0; y < yEnd; ++y) {
+            for (XIteratorF ptr = scienceMI.row_begin(y), end = scienceMI.row_end(y); ptr != end; ++ptr) {
+                if (ptr.mask() == 0) {
+                    varianceMedian.addValue(ptr.variance());
+                    ++nUnmaskedPixels;
+                }
+            }
+        }
+        if (sigmaSqMapPtr) {
+            sigmaSqMapPtr->addMaskedImage(MaskedImageF(scienceMI,
+                afwImage::BBox(afwImage::PointI(0, y0 - grownY0), width, y1 - y0), false));
+        }
+        _stats.sigmaSqTime += getTime() - startTime;
+
+        startTime = getTime();
+        typename ExposureCC::MaskedImageT blurredMI(width, grownY1 - grownY0);
+        blurredMI.setXY0(scienceMI.getXY0());
+        blurMaskedImage(blurredMI, scienceMI, psfKernel);
+        typename ExposureCC::MaskedImageT const blurredStrip(blurredMI,
+            afwImage::BBox(afwImage::PointI(0, y0 - grownY0), width, y1 - y0));
+        _stats.blurredExposureTime += getTime() - startTime;
+        blurredSink.processStrip(blurredStrip);
+    }
+    startTime = getTime();
+    _sigmaSq = varianceMedian.getMedian();
+    if (sigmaSqMapPtr) {
+        sigmaSqMapPtr->finish();
+        _sigmaSqMapPtr = sigmaSqMapPtr;
+    }
+    _stats.sigmaSqTime += getTime() - startTime;
+    _stats.nUnmaskedPixels = nUnmaskedPixels;
+    _stats.nMaskedPixels = (width * height) - nUnmaskedPixels;
+};
+
+/**
+ * \brief Make _psfTileGridPtr, if PSF tiles are wanted
+ *
+ * PSF tiles are used if the control object specifies them, or if the reflected PSF is wanted.
+ * A fixed kernel is always evaluated on a single tile, whatever grid the control object specifies,
+ * so it costs one convolution per pixel even if blending is enabled.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if a reflected PSF is requested for a spatially
+ * varying kernel without PSF tiles.
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+void coaddKaiser::CoaddComponent<PixelT>::makePsfTileGrid(
+    lsst::afw::math::Kernel const &psfKernel,   ///< PSF kernel
+    afwImage::BBox const &bbox          ///< bounding box of science exposure, in parent pixel coordinates
+) {
+    int nPsfTilesX = _control.getNPsfTilesX();
+    int nPsfTilesY = _control.getNPsfTilesY();
+    bool const useTiles = (nPsfTilesX > 0) && (nPsfTilesY > 0);
+    if (_control.getReflectPsf() && !useTiles && psfKernel.isSpatiallyVarying()) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            "Cannot reflect a spatially varying PSF without PSF tiles; see CoaddComponentControl");
+    }
+    if ((useTiles || _control.getReflectPsf()) && !psfKernel.isSpatiallyVarying()) {
+        // the PSF is the same everywhere, so a single tile suffices (and there is nothing to blend)
+        nPsfTilesX = 1;
+        nPsfTilesY = 1;
+    }
+    if ((nPsfTilesX > 0) && (nPsfTilesY > 0)) {
+        _psfTileGridPtr.reset(new PsfTileGrid(psfKernel, bbox, nPsfTilesX, nPsfTilesY, _normalizePsf));
+        // each tile holds a kernel image and its reflection
+        _stats.nBytesAllocated += 2.0 * static_cast<double>(nPsfTilesX * nPsfTilesY)
+            * static_cast<double>(psfKernel.getWidth() * psfKernel.getHeight())
+            * static_cast<double>(sizeof(afwMath::Kernel::Pixel));
+    } else {
+        _psfTileGridPtr.reset();
+    }
+};
+
+/**
+ * \brief Convolve scienceMI with psfKernel (or the PSF tiles, if any) and put the result in blurredMI
+ *
+ * Uses direct or FFT convolution as specified by the control object; by default the faster method is chosen
+ * based on the size of the kernel and the exposure.
+ *
+ * If there is a PSF tile grid then the PSF is evaluated once per tile (and optionally blended
+ * between tiles) and each tile is convolved with its own PSF; the reflected PSF is used if requested.
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+void coaddKaiser::CoaddComponent<PixelT>::blurMaskedImage(
+    typename ExposureCC::MaskedImageT &blurredMI,   ///< blurred masked image; same size as scienceMI
+    MaskedImageF const &scienceMI,      ///< science masked image (all or part of the science exposure)
+    lsst::afw::math::Kernel const &psfKernel    ///< PSF kernel
+) const {
+    if (_psfTileGridPtr) {
+        _stats.convolutionMethod = coaddKaiser::convolveWithPsfTiles(blurredMI, scienceMI, *_psfTileGridPtr,
+            _control.getReflectPsf(), _control.getBlendPsfTiles(), _control.getConvolutionMethod(),
+            _control.getFftSize());
+    } else {
+        _stats.convolutionMethod = coaddKaiser::convolveMaskedImage(blurredMI, scienceMI, psfKernel,
+            _normalizePsf, _control.getConvolutionMethod(), _control.getFftSize());
+    }
+};
+
+//
+// Explicit instantiations
+//
+template class coaddKaiser::CoaddComponent<float>;
+template class coaddKaiser::CoaddComponent<double>;
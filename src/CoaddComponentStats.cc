@@ -0,0 +1,79 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Timing and counters recorded while computing a CoaddComponent
+*
+* @file
+*/
+#include "boost/format.hpp"
+
+#include "lsst/pex/logging/Trace.h"
+#include "lsst/coadd/kaiser/CoaddComponentStats.h"
+
+namespace pexLog = lsst::pex::logging;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    char const * const TraceName = "lsst.coadd.kaiser.CoaddComponent";   ///< name of Trace for stats
+
+    char const *getConvolutionMethodName(coaddKaiser::ConvolutionMethod convolutionMethod) {
+        switch (convolutionMethod) {
+            case coaddKaiser::DIRECT_CONVOLUTION:
+                return "DIRECT";
+            case coaddKaiser::FFT_CONVOLUTION:
+                return "FFT";
+            case coaddKaiser::SEPARABLE_CONVOLUTION:
+                return "SEPARABLE";
+            default:
+                return "AUTO";
+        }
+    }
+}
+
+/**
+ * \brief Format the stats as a single line of text
+ *
+ * \ingroup coadd::kaiser
+ */
+std::string coaddKaiser::CoaddComponentStats::toString() const {
+    return (boost::format("sigmaSq %.3f s, blurred PSF %.3f s, blurred exposure %.3f s; "
+        "%d masked and %d unmasked pixels; %s convolution with a %dx%d kernel; %.1f MB allocated") %
+        sigmaSqTime % blurredPsfTime % blurredExposureTime %
+        nMaskedPixels % nUnmaskedPixels %
+        getConvolutionMethodName(convolutionMethod) % kernelWidth % kernelHeight %
+        (nBytesAllocated / 1.0e6)).str();
+}
+
+/**
+ * \brief Send the stats to pex_logging Trace "lsst.coadd.kaiser.CoaddComponent"
+ *
+ * \ingroup coadd::kaiser
+ */
+void coaddKaiser::CoaddComponentStats::trace(
+    std::string const &label,   ///< label identifying the CoaddComponent, e.g. the path of the exposure
+    int verbosity               ///< Trace verbosity at which to send the stats
+) const {
+    pexLog::Trace(TraceName, verbosity, (boost::format("%s: %s") % label % toString()).str());
+}
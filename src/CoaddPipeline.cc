@@ -0,0 +1,495 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Build a Kaiser coadd from many exposures using a pool of worker threads
+*
+* @file
+*/
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "boost/format.hpp"
+#include "boost/ref.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/thread.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/daf/base.h"
+#include "lsst/afw/image.h"
+#include "lsst/afw/math.h"
+#include "lsst/coadd/kaiser/fitsMutex.h"
+#include "lsst/coadd/kaiser/CoaddPipeline.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace afwMath = lsst::afw::math;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    typedef afwImage::Exposure<float, afwImage::MaskPixel, afwImage::VariancePixel> ExposureF;
+
+    /**
+     * \brief State shared between the worker threads and the thread that adds components to the coadd
+     */
+    template <typename PixelT>
+    struct PipelineState {
+        typedef typename coaddKaiser::CoaddComponent<PixelT>::Ptr CoaddComponentPtr;
+
+        boost::mutex mutex;
+        boost::condition_variable condition;    ///< notified whenever any of the following changes
+        std::size_t nextToStart;                ///< index of next input to start
+        std::size_t nToStart;                   ///< number of inputs that may be started
+        double inFlightMemory;                  ///< estimated memory of inputs started but not yet added
+        bool abort;                             ///< stop starting inputs
+        std::vector<double> memoryList;         ///< estimated memory of each input
+        std::vector<CoaddComponentPtr> componentList;   ///< component of each input; null until done
+        std::vector<std::string> errorList;     ///< error message for each input; empty if none
+        std::vector<bool> doneList;             ///< has each input been processed?
+
+        explicit PipelineState(std::size_t nInputs) :
+            nextToStart(0), nToStart(nInputs), inFlightMemory(0), abort(false),
+            memoryList(nInputs, 0), componentList(nInputs), errorList(nInputs), doneList(nInputs, false)
+        {}
+    };
+
+    /**
+     * \brief Estimate the memory needed to process an exposure: the science exposure and blurred exposure
+     */
+    template <typename PixelT>
+    double estimateMemory(std::string const &exposurePath) {
+        lsst::daf::base::PropertySet::Ptr metadataPtr = afwImage::readMetadata(exposurePath + "_img.fits");
+        double const nPixels = static_cast<double>(metadataPtr->getAsInt("NAXIS1"))
+            * static_cast<double>(metadataPtr->getAsInt("NAXIS2"));
+        return nPixels * static_cast<double>(sizeof(float) + sizeof(PixelT)
+            + 2 * (sizeof(afwImage::MaskPixel) + sizeof(afwImage::VariancePixel)));
+    }
+
+    /**
+     * \brief Subtract the background from a masked image
+     *
+     * Fits a natural spline to the 3-sigma-clipped (3 iterations) background of cells of about
+     * cellSize x cellSize pixels. The mask and variance are ignored.
+     */
+    void subtractBackground(
+        ExposureF::MaskedImageT &maskedImage,
+        int cellSize
+    ) {
+        afwMath::BackgroundControl bkgControl(afwMath::Interpolate::NATURAL_SPLINE);
+        bkgControl.setNxSample((maskedImage.getWidth() / cellSize) + 1);
+        bkgControl.setNySample((maskedImage.getHeight() / cellSize) + 1);
+        bkgControl.sctrl.setNumSigmaClip(3);
+        bkgControl.sctrl.setNumIter(3);
+        afwMath::Background bkg = afwMath::makeBackground(*maskedImage.getImage(), bkgControl);
+        *maskedImage.getImage() -= *bkg.getImage<float>();
+    }
+
+    /**
+     * \brief Return the number of worker threads specified by control (resolving 0 to the number of cores)
+     */
+    int getNThreads(coaddKaiser::CoaddPipelineControl const &control) {
+        int const nThreads = control.getNThreads();
+        if (nThreads <= 0) {
+            return std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+        }
+        return nThreads;
+    }
+
+    /**
+     * \brief A worker thread: repeatedly start the next input, if memory permits, and compute its component
+     *
+     * Reading an exposure (cfitsio, which is not built thread-safe, and which updates afw's static
+     * dictionary of mask planes) is done with getFitsMutex() held, as are the BlurredPsfCache's reads and
+     * writes; the thread that adds components holds it while writing checkpoints. Each input's PSF kernel is cloned before it is evaluated, since
+     * Kernel::computeImage sets parameters of the kernel's functions, and one kernel may be shared
+     * by several inputs. The rest of the work is assumed to be reentrant when each thread has its own
+     * images and kernels: afwMath::makeBackground, afwMath::convolve, Kernel::computeImage
+     * and constructing images and masks (which only reads the mask plane dictionary).
+     */
+    template <typename PixelT>
+    struct PipelineWorker {
+        PipelineState<PixelT> &state;
+        std::vector<std::string> const &pathList;
+        std::vector<afwMath::Kernel::Ptr> const &kernelList;
+        bool normalizePsf;
+        coaddKaiser::CoaddComponentControl const &coaddComponentControl;
+        coaddKaiser::CoaddPipelineControl const &control;
+        coaddKaiser::MaskedImagePool<PixelT> &bufferPool;
+
+        PipelineWorker(
+            PipelineState<PixelT> &state_,
+            std::vector<std::string> const &pathList_,
+            std::vector<afwMath::Kernel::Ptr> const &kernelList_,
+            bool normalizePsf_,
+            coaddKaiser::CoaddComponentControl const &coaddComponentControl_,
+            coaddKaiser::CoaddPipelineControl const &control_,
+            coaddKaiser::MaskedImagePool<PixelT> &bufferPool_
+        ) :
+            state(state_), pathList(pathList_), kernelList(kernelList_), normalizePsf(normalizePsf_),
+            coaddComponentControl(coaddComponentControl_), control(control_), bufferPool(bufferPool_)
+        {}
+
+        void operator()() {
+            double const maxInFlightMemory = control.getMaxInFlightMemory();
+            for (;;) {
+                std::size_t ind;
+                {
+                    boost::mutex::scoped_lock lock(state.mutex);
+                    for (;;) {
+                        if (state.abort || (state.nextToStart >= state.nToStart)) {
+                            return;
+                        }
+                        double const memory = state.memoryList[state.nextToStart];
+                        if ((maxInFlightMemory <= 0) || (state.inFlightMemory <= 0)
+                            || (state.inFlightMemory + memory <= maxInFlightMemory)) {
+                            break;
+                        }
+                        state.condition.wait(lock);
+                    }
+                    ind = state.nextToStart++;
+                    state.inFlightMemory += state.memoryList[ind];
+                }
+
+                typename PipelineState<PixelT>::CoaddComponentPtr componentPtr;
+                std::string errorMessage;
+                try {
+                    boost::shared_ptr<ExposureF> exposurePtr;
+                    {
+                        boost::mutex::scoped_lock ioLock(coaddKaiser::getFitsMutex());
+                        exposurePtr.reset(new ExposureF(pathList[ind]));
+                    }
+                    ExposureF &exposure = *exposurePtr;
+                    afwMath::Kernel::Ptr psfKernelPtr = kernelList[ind]->clone();
+                    if (control.getSubtractBackground()) {
+                        ExposureF::MaskedImageT maskedImage = exposure.getMaskedImage();
+                        subtractBackground(maskedImage, control.getBackgroundCellSize());
+                    }
+                    if (coaddComponentControl.getLazy()) {
+                        componentPtr.reset(new coaddKaiser::CoaddComponent<PixelT>(
+                            exposure, *psfKernelPtr, normalizePsf, coaddComponentControl));
+                    } else {
+                        // blur into a buffer from the pool; it is returned to the pool once the component is added
+                        typename coaddKaiser::CoaddComponent<PixelT>::ExposureCC::MaskedImageT blurredMI =
+                            bufferPool.get(exposure.getWidth(), exposure.getHeight());
+                        try {
+                            typename coaddKaiser::CoaddComponent<PixelT>::ExposureCC blurredExposure(blurredMI);
+                            componentPtr.reset(new coaddKaiser::CoaddComponent<PixelT>(
+                                exposure, *psfKernelPtr, blurredExposure, normalizePsf, coaddComponentControl));
+                        } catch (...) {
+                            bufferPool.release(blurredMI);
+                            throw;
+                        }
+                    }
+                } catch (std::exception &e) {
+                    errorMessage = e.what();
+                } catch (...) {
+                    errorMessage = "unknown error";
+                }
+
+                boost::mutex::scoped_lock lock(state.mutex);
+                state.componentList[ind] = componentPtr;
+                state.errorList[ind] = errorMessage;
+                state.doneList[ind] = true;
+                state.condition.notify_all();
+            }
+        }
+    };
+}
+
+/**
+ * \brief Construct a CoaddPipeline
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if control.getBackgroundCellSize() < 1
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+coaddKaiser::CoaddPipeline<PixelT>::CoaddPipeline(
+    KaiserCoadd &kaiserCoadd,       ///< coadd to which to add the inputs; must outlive the pipeline
+    bool normalizePsf,              ///< normalize psf (see CoaddComponent)
+    CoaddComponentControl const &coaddComponentControl, ///< parameters for computing each CoaddComponent
+    CoaddPipelineControl const &control ///< parameters for the pipeline
+) :
+    _kaiserCoadd(kaiserCoadd),
+    _normalizePsf(normalizePsf),
+    _coaddComponentControl(coaddComponentControl),
+    _control(control),
+    _inputList(),
+    _nAdded(0),
+    _checkpoint(),
+    _bufferPoolPtr()
+{
+    if (control.getBackgroundCellSize() < 1) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("backgroundCellSize=%d must be positive") % control.getBackgroundCellSize()).str());
+    }
+    // one free buffer per worker thread suffices for a steady stream of same-sized exposures
+    _bufferPoolPtr.reset(new MaskedImagePool<PixelT>(getNThreads(control)));
+}
+
+/**
+ * \brief Add an input to be processed by the next call to run
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if psfKernel is null
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+void coaddKaiser::CoaddPipeline<PixelT>::addInput(
+    std::string const &exposurePath,    ///< path of exposure (without the final _img.fits)
+    lsst::afw::math::Kernel::Ptr psfKernel  ///< PSF kernel of exposure; it is not copied, so do not modify it
+) {
+    if (!psfKernel) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("psfKernel for %s is null") % exposurePath).str());
+    }
+    Input input;
+    input.exposurePath = exposurePath;
+    input.psfKernel = psfKernel;
+    input.nGoodPixels = -1;
+    input.stats = CoaddComponentStats();
+    _inputList.push_back(input);
+}
+
+/**
+ * \brief Checkpoint the coadd as inputs are added, restoring it from the checkpoint if that has data
+ *
+ * Inputs recorded in the checkpoint are skipped by run, so rerunning a pipeline that was interrupted
+ * resumes where the last checkpoint left off. Checkpoints are written every
+ * control.getCheckpointInterval() inputs and at the end of each call to run.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if inputs have already been added,
+ * or if checkpoint is null
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+void coaddKaiser::CoaddPipeline<PixelT>::setCheckpoint(
+    CoaddCheckpoint::Ptr checkpoint ///< checkpoint; the coadd must be empty if it has data
+) {
+    if (!checkpoint) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException, "checkpoint is null");
+    }
+    if (_nAdded > 0) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("%d inputs have already been added") % _nAdded).str());
+    }
+    checkpoint->restore(_kaiserCoadd);
+    _checkpoint = checkpoint;
+}
+
+/**
+ * \brief Process all inputs not yet added to the coadd, adding them in order
+ *
+ * Inputs already recorded in the checkpoint (if any) are skipped.
+ *
+ * \return the number of inputs added, not counting those skipped
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if the inputs do not start with
+ * those recorded in the checkpoint
+ * \throw lsst::pex::exceptions::RuntimeErrorException if an input cannot be processed
+ * or a checkpoint cannot be written.
+ * Inputs before it have been added to the coadd (and checkpointed, if possible),
+ * and a later call to run resumes with the failed input.
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+int coaddKaiser::CoaddPipeline<PixelT>::run() {
+    if (_checkpoint) {
+        for ( ; (_nAdded < _checkpoint->getNInputs()) && (_nAdded < getNInputs()); ++_nAdded) {
+            if (_inputList[_nAdded].exposurePath != _checkpoint->getInput(_nAdded)) {
+                throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+                    (boost::format("Input %d is %s but checkpoint recorded %s") %
+                    _nAdded % _inputList[_nAdded].exposurePath % _checkpoint->getInput(_nAdded)).str());
+            }
+        }
+    }
+    std::size_t const nInputs = _inputList.size() - _nAdded;
+    if (nInputs == 0) {
+        return 0;
+    }
+    std::vector<std::string> pathList;
+    std::vector<afwMath::Kernel::Ptr> kernelList;
+    for (std::size_t i = _nAdded; i < _inputList.size(); ++i) {
+        pathList.push_back(_inputList[i].exposurePath);
+        kernelList.push_back(_inputList[i].psfKernel);
+    }
+    PipelineState<PixelT> state(nInputs);
+    for (std::size_t i = 0; i < nInputs; ++i) {
+        // an input whose header cannot be read fails like any other; the inputs before it are still added
+        try {
+            boost::mutex::scoped_lock ioLock(getFitsMutex());
+            state.memoryList[i] = estimateMemory<PixelT>(pathList[i]);
+        } catch (std::exception &e) {
+            state.errorList[i] = e.what();
+            state.doneList[i] = true;
+            state.nToStart = i;
+            break;
+        }
+    }
+
+    int const nThreads = std::min(getNThreads(_control), static_cast<int>(nInputs));
+    PipelineWorker<PixelT> worker(state, pathList, kernelList, _normalizePsf, _coaddComponentControl, _control,
+        *_bufferPoolPtr);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nThreads; ++i) {
+        threadGroup.create_thread(boost::ref(worker));
+    }
+
+    // add the components in order, as each becomes available
+    std::string errorMessage;
+    std::string errorInput;
+    int const checkpointInterval = _control.getCheckpointInterval();
+    int nAddedNow = 0;
+    for (std::size_t i = 0; i < nInputs; ++i) {
+        typename PipelineState<PixelT>::CoaddComponentPtr componentPtr;
+        {
+            boost::mutex::scoped_lock lock(state.mutex);
+            while (!state.doneList[i]) {
+                state.condition.wait(lock);
+            }
+            componentPtr.swap(state.componentList[i]);
+            errorMessage = state.errorList[i];
+        }
+        std::string const &exposurePath = _inputList[_nAdded].exposurePath;
+        if (errorMessage.empty()) {
+            try {
+                _inputList[_nAdded].nGoodPixels = _kaiserCoadd.addComponent(*componentPtr);
+                // record stats after adding, so they include lazily computed items
+                _inputList[_nAdded].stats = componentPtr->getStats();
+                _inputList[_nAdded].stats.trace(exposurePath, _control.getStatsTraceVerbosity());
+            } catch (std::exception &e) {
+                errorMessage = e.what();
+            }
+        }
+        if (componentPtr && !componentPtr->isLazy()) {
+            _bufferPoolPtr->release(componentPtr->getBlurredExposure().getMaskedImage());
+        }
+        componentPtr.reset();
+        if (errorMessage.empty() && _checkpoint) {
+            _checkpoint->addInput(exposurePath);
+            if ((checkpointInterval > 0) && ((nAddedNow + 1) % checkpointInterval == 0)) {
+                try {
+                    boost::mutex::scoped_lock ioLock(getFitsMutex());
+                    _checkpoint->write(_kaiserCoadd);
+                } catch (std::exception &e) {
+                    errorMessage = (boost::format("checkpoint failed: %s") % e.what()).str();
+                    ++_nAdded;
+                    ++nAddedNow;
+                }
+            }
+        }
+        if (!errorMessage.empty()) {
+            errorInput = exposurePath;
+        }
+        {
+            boost::mutex::scoped_lock lock(state.mutex);
+            state.inFlightMemory -= state.memoryList[i];
+            if (!errorMessage.empty()) {
+                state.abort = true;
+            }
+            state.condition.notify_all();
+        }
+        if (!errorMessage.empty()) {
+            break;
+        }
+        ++_nAdded;
+        ++nAddedNow;
+    }
+    threadGroup.join_all();
+    // return the buffers of components finished for inputs after the one that failed
+    for (std::size_t i = 0; i < nInputs; ++i) {
+        typename PipelineState<PixelT>::CoaddComponentPtr const &componentPtr = state.componentList[i];
+        if (componentPtr && !componentPtr->isLazy()) {
+            _bufferPoolPtr->release(componentPtr->getBlurredExposure().getMaskedImage());
+        }
+    }
+    state.componentList.clear();
+    if (_checkpoint) {
+        try {
+            boost::mutex::scoped_lock ioLock(getFitsMutex());
+            _checkpoint->write(_kaiserCoadd);
+        } catch (std::exception &e) {
+            if (errorMessage.empty()) {
+                errorMessage = (boost::format("checkpoint failed: %s") % e.what()).str();
+                errorInput = _inputList[_nAdded - 1].exposurePath;
+            }
+        }
+    }
+    if (!errorMessage.empty()) {
+        throw LSST_EXCEPT(pexExcept::RuntimeErrorException,
+            (boost::format("Failed on input %s: %s") % errorInput % errorMessage).str());
+    }
+    return nAddedNow;
+}
+
+/**
+ * \brief Get the number of pixels added to the coadd for an input
+ *
+ * \return the number of pixels added, or -1 if the input has not been added by this pipeline
+ * (e.g. it was skipped because it was recorded in the checkpoint)
+ *
+ * \throw lsst::pex::exceptions::RangeErrorException if index is out of range
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+int coaddKaiser::CoaddPipeline<PixelT>::getNGoodPixels(
+    int index   ///< index of input, in the order added
+) const {
+    if ((index < 0) || (index >= getNInputs())) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException,
+            (boost::format("index=%d not in range [0, %d)") % index % getNInputs()).str());
+    }
+    return _inputList[index].nGoodPixels;
+}
+
+/**
+ * \brief Get the stats of the CoaddComponent of an input
+ *
+ * \return the stats, recorded after the component was added to the coadd;
+ * all zero if the input has not been added by this pipeline
+ *
+ * \throw lsst::pex::exceptions::RangeErrorException if index is out of range
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+coaddKaiser::CoaddComponentStats coaddKaiser::CoaddPipeline<PixelT>::getStats(
+    int index   ///< index of input, in the order added
+) const {
+    if ((index < 0) || (index >= getNInputs())) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException,
+            (boost::format("index=%d not in range [0, %d)") % index % getNInputs()).str());
+    }
+    return _inputList[index].stats;
+}
+
+//
+// Explicit instantiations
+//
+template class coaddKaiser::CoaddPipeline<float>;
+template class coaddKaiser::CoaddPipeline<double>;
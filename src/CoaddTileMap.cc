@@ -0,0 +1,304 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Coadd and depth map pixels stored in fixed-size tiles, allocated on first write
+*
+* @file
+*/
+#include <algorithm>
+
+#include "boost/format.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/CoaddTileMap.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    /**
+     * \brief Compute the overlap of two bounding boxes; the result may be empty
+     */
+    afwImage::BBox intersectBBoxes(afwImage::BBox const &bbox1, afwImage::BBox const &bbox2) {
+        int const x0 = std::max(bbox1.getX0(), bbox2.getX0());
+        int const y0 = std::max(bbox1.getY0(), bbox2.getY0());
+        int const x1 = std::min(bbox1.getX1(), bbox2.getX1());
+        int const y1 = std::min(bbox1.getY1(), bbox2.getY1());
+        if ((x0 > x1) || (y0 > y1)) {
+            return afwImage::BBox();
+        }
+        return afwImage::BBox(afwImage::PointI(x0, y0), afwImage::PointI(x1, y1));
+    }
+
+    /**
+     * \brief Is any pixel of a depth map nonzero?
+     */
+    bool hasDepth(coaddKaiser::CoaddTileMap::DepthMap const &depthMap) {
+        for (int y = 0; y < depthMap.getHeight(); ++y) {
+            for (coaddKaiser::CoaddTileMap::DepthMap::x_iterator depthPtr = depthMap.row_begin(y),
+                depthEnd = depthMap.row_end(y); depthPtr != depthEnd; ++depthPtr) {
+                if (*depthPtr != 0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+}
+
+/**
+ * \brief Construct a CoaddTile with zeroed pixels
+ */
+coaddKaiser::CoaddTile::CoaddTile(
+    int ix,     ///< x index of the tile in the grid of tiles
+    int iy,     ///< y index of the tile in the grid of tiles
+    afwImage::BBox const &bbox  ///< bounding box of the tile, relative to the origin of the coadd
+) :
+    _ix(ix),
+    _iy(iy),
+    _bbox(bbox),
+    _maskedImage(bbox.getWidth(), bbox.getHeight()),
+    _depthMap(bbox.getWidth(), bbox.getHeight(), 0)
+{
+    *_maskedImage.getImage() = 0;
+    *_maskedImage.getMask() = 0;
+    *_maskedImage.getVariance() = 0;
+    _maskedImage.setXY0(bbox.getLLC());
+    _depthMap.setXY0(bbox.getLLC());
+}
+
+/**
+ * \brief Construct a CoaddTileMap with no populated tiles (unless tileSize <= 0)
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if width or height < 1
+ *
+ * \ingroup coadd::kaiser
+ */
+coaddKaiser::CoaddTileMap::CoaddTileMap(
+    int width,      ///< width of coadd (pixels)
+    int height,     ///< height of coadd (pixels)
+    int tileSize    ///< width and height of each tile (pixels); if <= 0 then use one tile for the whole coadd
+) :
+    _width(width),
+    _height(height),
+    _tileSize(tileSize),
+    _tileWidth(tileSize > 0 ? tileSize : width),
+    _tileHeight(tileSize > 0 ? tileSize : height),
+    _nTilesX(0),
+    _nTilesY(0),
+    _directory(),
+    _tileList()
+{
+    if ((width < 1) || (height < 1)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("width=%d and height=%d must both be positive") % width % height).str());
+    }
+    _nTilesX = (width + _tileWidth - 1) / _tileWidth;
+    _nTilesY = (height + _tileHeight - 1) / _tileHeight;
+    _directory.resize(_nTilesX * _nTilesY, -1);
+    if (tileSize <= 0) {
+        getOrAddTile(0, 0);
+    }
+}
+
+/**
+ * \brief Get the bounding box of a tile, relative to the origin of the coadd
+ *
+ * Tiles in the last column and row are truncated by the edge of the coadd.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if ix or iy is out of range
+ */
+afwImage::BBox coaddKaiser::CoaddTileMap::getTileBBox(
+    int ix,     ///< x index of tile
+    int iy      ///< y index of tile
+) const {
+    if ((ix < 0) || (ix >= _nTilesX) || (iy < 0) || (iy >= _nTilesY)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("tile (%d, %d) not in range [0, %d) x [0, %d)") % ix % iy % _nTilesX % _nTilesY).str());
+    }
+    int const x0 = ix * _tileWidth;
+    int const y0 = iy * _tileHeight;
+    return afwImage::BBox(afwImage::PointI(x0, y0),
+        std::min(_tileWidth, _width - x0), std::min(_tileHeight, _height - y0));
+}
+
+/**
+ * \brief Get a tile, allocating it (with zeroed pixels) if it is not yet populated
+ *
+ * The returned reference (and any from findTile or getPopulatedTile) is only valid until the next tile
+ * is allocated; the masked image and depth map obtained from it remain valid.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if ix or iy is out of range
+ */
+coaddKaiser::CoaddTile const &coaddKaiser::CoaddTileMap::getOrAddTile(
+    int ix,     ///< x index of tile
+    int iy      ///< y index of tile
+) {
+    afwImage::BBox const bbox = getTileBBox(ix, iy);
+    int &listIndex = _directory[(iy * _nTilesX) + ix];
+    if (listIndex < 0) {
+        listIndex = static_cast<int>(_tileList.size());
+        _tileList.push_back(CoaddTile(ix, iy, bbox));
+    }
+    return _tileList[listIndex];
+}
+
+/**
+ * \brief Copy a region of the coadd into a masked image and depth map; pixels of tiles that are not
+ * populated are set to 0
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if the region is not contained in the coadd
+ * or the masked image or depth map is not the size of the region
+ */
+void coaddKaiser::CoaddTileMap::getRegion(
+    afwImage::BBox const &bbox,     ///< region of the coadd, relative to its origin
+    MaskedImageD &maskedImage,      ///< masked image to fill; must be the size of bbox
+    DepthMap &depthMap              ///< depth map to fill; must be the size of bbox
+) const {
+    checkRegion(bbox, depthMap.getWidth(), depthMap.getHeight());
+    getRegion(bbox, maskedImage);
+    getRegion(bbox, depthMap);
+}
+
+/**
+ * \brief Copy a region of the coadd into a masked image; pixels of tiles that are not populated are set to 0
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if the region is not contained in the coadd
+ * or the masked image is not the size of the region
+ */
+void coaddKaiser::CoaddTileMap::getRegion(
+    afwImage::BBox const &bbox,     ///< region of the coadd, relative to its origin
+    MaskedImageD &maskedImage       ///< masked image to fill; must be the size of bbox
+) const {
+    checkRegion(bbox, maskedImage.getWidth(), maskedImage.getHeight());
+    *maskedImage.getImage() = 0;
+    *maskedImage.getMask() = 0;
+    *maskedImage.getVariance() = 0;
+    for (int iy = getTileIY(bbox.getY0()), iyEnd = getTileIY(bbox.getY1()) + 1; iy < iyEnd; ++iy) {
+        for (int ix = getTileIX(bbox.getX0()), ixEnd = getTileIX(bbox.getX1()) + 1; ix < ixEnd; ++ix) {
+            CoaddTile const *tilePtr = findTile(ix, iy);
+            if (!tilePtr) {
+                continue;
+            }
+            afwImage::BBox const overlapBBox = intersectBBoxes(tilePtr->getBBox(), bbox);
+            afwImage::BBox tileSubBBox(overlapBBox);
+            tileSubBBox.shift(-tilePtr->getBBox().getX0(), -tilePtr->getBBox().getY0());
+            afwImage::BBox regionSubBBox(overlapBBox);
+            regionSubBBox.shift(-bbox.getX0(), -bbox.getY0());
+            MaskedImageD regionMI(maskedImage, regionSubBBox, false);
+            regionMI <<= MaskedImageD(tilePtr->getMaskedImage(), tileSubBBox, false);
+        }
+    }
+}
+
+/**
+ * \brief Copy a region of the depth map of the coadd; pixels of tiles that are not populated are set to 0
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if the region is not contained in the coadd
+ * or the depth map is not the size of the region
+ */
+void coaddKaiser::CoaddTileMap::getRegion(
+    afwImage::BBox const &bbox,     ///< region of the coadd, relative to its origin
+    DepthMap &depthMap              ///< depth map to fill; must be the size of bbox
+) const {
+    checkRegion(bbox, depthMap.getWidth(), depthMap.getHeight());
+    depthMap = 0;
+    for (int iy = getTileIY(bbox.getY0()), iyEnd = getTileIY(bbox.getY1()) + 1; iy < iyEnd; ++iy) {
+        for (int ix = getTileIX(bbox.getX0()), ixEnd = getTileIX(bbox.getX1()) + 1; ix < ixEnd; ++ix) {
+            CoaddTile const *tilePtr = findTile(ix, iy);
+            if (!tilePtr) {
+                continue;
+            }
+            afwImage::BBox const overlapBBox = intersectBBoxes(tilePtr->getBBox(), bbox);
+            afwImage::BBox tileSubBBox(overlapBBox);
+            tileSubBBox.shift(-tilePtr->getBBox().getX0(), -tilePtr->getBBox().getY0());
+            afwImage::BBox regionSubBBox(overlapBBox);
+            regionSubBBox.shift(-bbox.getX0(), -bbox.getY0());
+            DepthMap regionDepth(depthMap, regionSubBBox, false);
+            regionDepth <<= DepthMap(tilePtr->getDepthMap(), tileSubBBox, false);
+        }
+    }
+}
+
+/**
+ * \brief Set a region of the coadd from a masked image and depth map
+ *
+ * Tiles that are not populated are only allocated if the depth map is nonzero somewhere in their overlap
+ * with the region (elsewhere the coadd has not been written, so the masked image is assumed to be 0).
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if the region is not contained in the coadd
+ * or the masked image or depth map is not the size of the region
+ */
+void coaddKaiser::CoaddTileMap::setRegion(
+    afwImage::BBox const &bbox,         ///< region of the coadd, relative to its origin
+    MaskedImageD const &maskedImage,    ///< masked image; must be the size of bbox
+    DepthMap const &depthMap            ///< depth map; must be the size of bbox
+) {
+    checkRegion(bbox, maskedImage.getWidth(), maskedImage.getHeight());
+    checkRegion(bbox, depthMap.getWidth(), depthMap.getHeight());
+    for (int iy = getTileIY(bbox.getY0()), iyEnd = getTileIY(bbox.getY1()) + 1; iy < iyEnd; ++iy) {
+        for (int ix = getTileIX(bbox.getX0()), ixEnd = getTileIX(bbox.getX1()) + 1; ix < ixEnd; ++ix) {
+            afwImage::BBox const overlapBBox = intersectBBoxes(getTileBBox(ix, iy), bbox);
+            afwImage::BBox regionSubBBox(overlapBBox);
+            regionSubBBox.shift(-bbox.getX0(), -bbox.getY0());
+            DepthMap const regionDepth(depthMap, regionSubBBox, false);
+            if (!findTile(ix, iy) && !hasDepth(regionDepth)) {
+                continue;
+            }
+            CoaddTile const &tile = getOrAddTile(ix, iy);
+            afwImage::BBox tileSubBBox(overlapBBox);
+            tileSubBBox.shift(-tile.getBBox().getX0(), -tile.getBBox().getY0());
+            MaskedImageD tileMI(tile.getMaskedImage(), tileSubBBox, false);
+            tileMI <<= MaskedImageD(maskedImage, regionSubBBox, false);
+            DepthMap tileDepth(tile.getDepthMap(), tileSubBBox, false);
+            tileDepth <<= regionDepth;
+        }
+    }
+}
+
+/**
+ * \brief Check that a region is contained in the coadd and that an image of size width x height matches it
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if not
+ */
+void coaddKaiser::CoaddTileMap::checkRegion(
+    afwImage::BBox const &bbox, ///< region of the coadd, relative to its origin
+    int width,                  ///< width of image
+    int height                  ///< height of image
+) const {
+    if (!bbox || (bbox.getX0() < 0) || (bbox.getY0() < 0) || (bbox.getX1() >= _width)
+        || (bbox.getY1() >= _height)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("region %dx%d at (%d, %d) is not contained in the %dx%d coadd") %
+            bbox.getWidth() % bbox.getHeight() % bbox.getX0() % bbox.getY0() % _width % _height).str());
+    }
+    if ((width != bbox.getWidth()) || (height != bbox.getHeight())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("image is %dx%d; region is %dx%d") %
+            width % height % bbox.getWidth() % bbox.getHeight()).str());
+    }
+}
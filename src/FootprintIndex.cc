@@ -0,0 +1,328 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Spatial index of the footprints of exposures on a coadd, to find the exposures that overlap a patch
+*
+* @file
+*/
+#include <algorithm>
+#include <cmath>
+
+#include "boost/format.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/daf/base.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/FootprintIndex.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    /**
+     * \brief Order R-tree nodes by the x or y center of their bounding box (times 2)
+     */
+    template <typename NodeT>
+    class CenterLess {
+    public:
+        explicit CenterLess(bool useX) : _useX(useX) {}
+
+        bool operator()(NodeT const &a, NodeT const &b) const {
+            if (_useX) {
+                return (a.x0 + a.x1) < (b.x0 + b.x1);
+            }
+            return (a.y0 + a.y1) < (b.y0 + b.y1);
+        }
+
+    private:
+        bool _useX;
+    };
+
+    /**
+     * \brief Sort nodes into sort-tile-recursive order, so that each run of nodeCapacity consecutive nodes
+     * is a compact group
+     *
+     * The nodes are sorted by x into about sqrt(number of groups) vertical slices,
+     * then each slice is sorted by y.
+     */
+    template <typename NodeT>
+    void sortTileRecursive(
+        std::vector<NodeT> &nodeList,   ///< nodes to sort
+        int nodeCapacity                ///< number of nodes per group
+    ) {
+        int const nNodes = static_cast<int>(nodeList.size());
+        int const nGroups = (nNodes + nodeCapacity - 1) / nodeCapacity;
+        int const nSlices = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(nGroups))));
+        int const sliceSize = nSlices * nodeCapacity;
+        std::sort(nodeList.begin(), nodeList.end(), CenterLess<NodeT>(true));
+        for (int i = 0; i < nNodes; i += sliceSize) {
+            std::sort(nodeList.begin() + i, nodeList.begin() + std::min(i + sliceSize, nNodes),
+                CenterLess<NodeT>(false));
+        }
+    }
+}
+
+/**
+ * \brief Compute the region of a coadd that an exposure may overlap
+ *
+ * Samples points along the edges of the exposure and maps them to the coadd, then grows the result
+ * by a pixel or two of slack (the edges of the exposure need not map to straight lines on the coadd).
+ *
+ * \return the region, relative to the origin of the coadd, clipped to the coadd; empty if no overlap
+ *
+ * \ingroup coadd::kaiser
+ */
+afwImage::BBox coaddKaiser::computeOverlapBBox(
+    afwImage::Wcs const &srcWcs,        ///< WCS of exposure
+    afwImage::BBox const &srcBBox,      ///< bounding box of exposure (including xy0)
+    afwImage::Wcs const &coaddWcs,      ///< WCS of coadd
+    int coaddWidth,                     ///< width of coadd (pixels)
+    int coaddHeight                     ///< height of coadd (pixels)
+) {
+    double minX = coaddWidth;
+    double maxX = -1;
+    double minY = coaddHeight;
+    double maxY = -1;
+    for (int i = 0; i < NOverlapEdgeSamples; ++i) {
+        double const frac = static_cast<double>(i) / static_cast<double>(NOverlapEdgeSamples - 1);
+        double const xInd = -0.5 + (frac * srcBBox.getWidth());
+        double const yInd = -0.5 + (frac * srcBBox.getHeight());
+        afwImage::PointD edgeIndList[4] = {
+            afwImage::PointD(xInd, -0.5),
+            afwImage::PointD(xInd, srcBBox.getHeight() - 0.5),
+            afwImage::PointD(-0.5, yInd),
+            afwImage::PointD(srcBBox.getWidth() - 0.5, yInd)
+        };
+        for (int j = 0; j < 4; ++j) {
+            afwImage::PointD const srcPos(
+                edgeIndList[j].getX() + afwImage::PixelZeroPos + srcBBox.getX0(),
+                edgeIndList[j].getY() + afwImage::PixelZeroPos + srcBBox.getY0());
+            afwImage::PointD const coaddPos = coaddWcs.raDecToXY(srcWcs.xyToRaDec(srcPos));
+            double const coaddXInd = coaddPos.getX() - afwImage::PixelZeroPos;
+            double const coaddYInd = coaddPos.getY() - afwImage::PixelZeroPos;
+            minX = std::min(minX, coaddXInd);
+            maxX = std::max(maxX, coaddXInd);
+            minY = std::min(minY, coaddYInd);
+            maxY = std::max(maxY, coaddYInd);
+        }
+    }
+    int const xBegin = std::max(0, static_cast<int>(std::floor(minX)) - 1);
+    int const xEnd = std::min(coaddWidth, static_cast<int>(std::ceil(maxX)) + 2);
+    int const yBegin = std::max(0, static_cast<int>(std::floor(minY)) - 1);
+    int const yEnd = std::min(coaddHeight, static_cast<int>(std::ceil(maxY)) + 2);
+    if ((xBegin >= xEnd) || (yBegin >= yEnd)) {
+        return afwImage::BBox();
+    }
+    return afwImage::BBox(afwImage::PointI(xBegin, yBegin), xEnd - xBegin, yEnd - yBegin);
+}
+
+/**
+ * \brief Construct an empty FootprintIndex
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if coaddWidth or coaddHeight < 1
+ */
+coaddKaiser::FootprintIndex::FootprintIndex(
+    afwImage::Wcs const &coaddWcs,  ///< WCS of coadd
+    int coaddWidth,                 ///< width of coadd (pixels)
+    int coaddHeight                 ///< height of coadd (pixels)
+) :
+    _coaddWcsPtr(coaddWcs.clone()),
+    _coaddWidth(coaddWidth),
+    _coaddHeight(coaddHeight),
+    _footprintList(),
+    _nodeList(),
+    _isBuilt(false)
+{
+    if ((coaddWidth < 1) || (coaddHeight < 1)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("coaddWidth=%d and coaddHeight=%d must both be positive") %
+            coaddWidth % coaddHeight).str());
+    }
+}
+
+/**
+ * \brief Add the footprint of an exposure given its WCS and bounding box
+ *
+ * \return the index of the footprint (the number of footprints added before it)
+ */
+int coaddKaiser::FootprintIndex::addFootprint(
+    afwImage::Wcs const &wcs,       ///< WCS of exposure
+    afwImage::BBox const &bbox      ///< bounding box of exposure (including xy0)
+) {
+    _footprintList.push_back(computeOverlapBBox(wcs, bbox, *_coaddWcsPtr, _coaddWidth, _coaddHeight));
+    _isBuilt = false;
+    return static_cast<int>(_footprintList.size()) - 1;
+}
+
+/**
+ * \brief Add the footprint of an exposure on disk, reading only the header of its image file
+ *
+ * The size of the exposure is read from NAXIS1 and NAXIS2, its xy0 from LTV1 and LTV2 (if present)
+ * and its WCS from the remaining keywords.
+ *
+ * \return the index of the footprint (the number of footprints added before it)
+ */
+int coaddKaiser::FootprintIndex::addExposure(
+    std::string const &exposurePath,    ///< path of exposure (without _img.fits, etc.)
+    int hdu                             ///< HDU to read
+) {
+    lsst::daf::base::PropertySet::Ptr metadataPtr = afwImage::readMetadata(exposurePath + "_img.fits", hdu);
+    int const width = metadataPtr->getAsInt("NAXIS1");
+    int const height = metadataPtr->getAsInt("NAXIS2");
+    int x0 = 0;
+    int y0 = 0;
+    if (metadataPtr->exists("LTV1")) {
+        x0 = -metadataPtr->getAsInt("LTV1");
+        y0 = -metadataPtr->getAsInt("LTV2");
+    }
+    afwImage::Wcs::Ptr wcsPtr = afwImage::makeWcs(metadataPtr);
+    return addFootprint(*wcsPtr, afwImage::BBox(afwImage::PointI(x0, y0), width, height));
+}
+
+/**
+ * \brief Get a footprint: the region of the coadd (relative to its origin) that an exposure may overlap
+ *
+ * \return the footprint; empty if the exposure does not overlap the coadd
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if i is out of range
+ */
+afwImage::BBox coaddKaiser::FootprintIndex::getFootprint(
+    int i   ///< index of footprint
+) const {
+    if ((i < 0) || (i >= getNFootprints())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("footprint %d not in range [0, %d)") % i % getNFootprints()).str());
+    }
+    return _footprintList[i];
+}
+
+/**
+ * \brief Find the footprints that overlap a region of the coadd
+ *
+ * \return the indices of the overlapping footprints, in increasing order (the order they were added)
+ */
+std::vector<int> coaddKaiser::FootprintIndex::findOverlapping(
+    afwImage::BBox const &bbox  ///< region of the coadd, relative to its origin
+) const {
+    std::vector<int> indexList;
+    if (!bbox) {
+        return indexList;
+    }
+    if (!_isBuilt) {
+        build();
+    }
+    if (_nodeList.empty()) {
+        return indexList;
+    }
+    std::vector<int> stack(1, static_cast<int>(_nodeList.size()) - 1);
+    while (!stack.empty()) {
+        Node const &node = _nodeList[stack.back()];
+        stack.pop_back();
+        if ((node.x0 > bbox.getX1()) || (node.x1 < bbox.getX0())
+            || (node.y0 > bbox.getY1()) || (node.y1 < bbox.getY0())) {
+            continue;
+        }
+        if (node.end < 0) {
+            indexList.push_back(node.begin);
+        } else {
+            for (int i = node.begin; i < node.end; ++i) {
+                stack.push_back(i);
+            }
+        }
+    }
+    std::sort(indexList.begin(), indexList.end());
+    return indexList;
+}
+
+/**
+ * \brief Get the bounding box of a patch of a grid of square patches covering the coadd
+ *
+ * Patches in the last column and row are truncated by the edge of the coadd.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if patchSize < 1 or ix or iy is out of range
+ */
+afwImage::BBox coaddKaiser::FootprintIndex::getPatchBBox(
+    int ix,         ///< x index of patch
+    int iy,         ///< y index of patch
+    int patchSize   ///< width and height of each patch (pixels)
+) const {
+    if (patchSize < 1) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("patchSize=%d must be positive") % patchSize).str());
+    }
+    int const nPatchesX = (_coaddWidth + patchSize - 1) / patchSize;
+    int const nPatchesY = (_coaddHeight + patchSize - 1) / patchSize;
+    if ((ix < 0) || (ix >= nPatchesX) || (iy < 0) || (iy >= nPatchesY)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("patch (%d, %d) not in range [0, %d) x [0, %d)") % ix % iy % nPatchesX % nPatchesY).str());
+    }
+    int const x0 = ix * patchSize;
+    int const y0 = iy * patchSize;
+    return afwImage::BBox(afwImage::PointI(x0, y0),
+        std::min(patchSize, _coaddWidth - x0), std::min(patchSize, _coaddHeight - y0));
+}
+
+/**
+ * \brief Bulk load the R-tree from the footprints
+ *
+ * Each level is sorted into sort-tile-recursive order and appended to the node list, then grouped
+ * NodeCapacity at a time into the nodes of the next level up, until one node (the root) remains.
+ * Empty footprints are left out.
+ */
+void coaddKaiser::FootprintIndex::build() const {
+    _nodeList.clear();
+    std::vector<Node> levelList;
+    for (int i = 0, nFootprints = getNFootprints(); i < nFootprints; ++i) {
+        afwImage::BBox const &footprint = _footprintList[i];
+        if (footprint) {
+            levelList.push_back(Node(footprint.getX0(), footprint.getY0(), footprint.getX1(), footprint.getY1(),
+                i, -1));
+        }
+    }
+    while (!levelList.empty()) {
+        sortTileRecursive(levelList, NodeCapacity);
+        int const levelBegin = static_cast<int>(_nodeList.size());
+        _nodeList.insert(_nodeList.end(), levelList.begin(), levelList.end());
+        if (levelList.size() == 1) {
+            break;
+        }
+        std::vector<Node> parentList;
+        for (int i = 0, nNodes = static_cast<int>(levelList.size()); i < nNodes; i += NodeCapacity) {
+            int const end = std::min(i + NodeCapacity, nNodes);
+            Node parent(levelList[i].x0, levelList[i].y0, levelList[i].x1, levelList[i].y1,
+                levelBegin + i, levelBegin + end);
+            for (int j = i + 1; j < end; ++j) {
+                parent.x0 = std::min(parent.x0, levelList[j].x0);
+                parent.y0 = std::min(parent.y0, levelList[j].y0);
+                parent.x1 = std::max(parent.x1, levelList[j].x1);
+                parent.y1 = std::max(parent.y1, levelList[j].y1);
+            }
+            parentList.push_back(parent);
+        }
+        levelList.swap(parentList);
+    }
+    _isBuilt = true;
+}
@@ -0,0 +1,535 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Accumulator for a Kaiser coadd
+*
+* @file
+*/
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "boost/format.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/FootprintIndex.h"
+#include "lsst/coadd/kaiser/KaiserCoadd.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    int const NEdgeSamples = 9; ///< number of points sampled along each edge of a coadd region to find its source
+
+    /**
+     * Maximum error (pixels on the component) of the affine map used within a warp tile;
+     * tiles whose map is less accurate use the exact WCS at every pixel
+     */
+    double const MaxLinearWcsError = 0.001;
+
+    /**
+     * \brief Compute normalized 1-d Lanczos warping kernel weights
+     *
+     * Weight i applies to the pixel at index floor(pos) - order + 1 + i
+     */
+    void computeLanczosWeights(
+        std::vector<double> &weights,   ///< weights; must have 2 * order elements
+        double frac,                    ///< pos - floor(pos), where pos is the position at which to warp
+        int order                       ///< order of Lanczos kernel
+    ) {
+        // sin(pi (m - frac)) = -(-1)^m sin(pi frac) for integer m; this is exactly 0 at the other pixels if frac = 0
+        double const sinPiFrac = std::sin(M_PI * frac);
+        double sum = 0;
+        for (int i = 0; i < 2 * order; ++i) {
+            int const m = i - order + 1;
+            double const dist = static_cast<double>(m) - frac;
+            double weight = 1.0;
+            if (dist != 0) {
+                double const piDist = M_PI * dist;
+                double const sinPiDist = ((m % 2) != 0) ? sinPiFrac : -sinPiFrac;
+                weight = sinPiDist * std::sin(piDist / static_cast<double>(order))
+                    / (piDist * piDist / static_cast<double>(order));
+            }
+            weights[i] = weight;
+            sum += weight;
+        }
+        for (int i = 0; i < 2 * order; ++i) {
+            weights[i] /= sum;
+        }
+    }
+
+    /**
+     * \brief Map coadd pixel indices to component pixel indices, exactly (using both WCSs)
+     * or using an affine approximation fit over a region of the coadd
+     */
+    class CoaddToSourceMap {
+    public:
+        CoaddToSourceMap(
+            afwImage::Wcs const &srcWcs,    ///< WCS of component
+            afwImage::Wcs const &coaddWcs,  ///< WCS of coadd
+            afwImage::PointI const &coaddXY0    ///< xy0 of coadd
+        ) :
+            _srcWcs(srcWcs),
+            _coaddWcs(coaddWcs),
+            _coaddXY0(coaddXY0),
+            _isLinear(false)
+        {}
+
+        /**
+         * \brief Get the index on the component (relative to the origin of the science exposure)
+         * of an index on the coadd (relative to its origin)
+         */
+        afwImage::PointD operator()(double xInd, double yInd) const {
+            if (_isLinear) {
+                double const dx = xInd - _xRef;
+                double const dy = yInd - _yRef;
+                return afwImage::PointD(_srcXRef + (_dxdx * dx) + (_dxdy * dy),
+                    _srcYRef + (_dydx * dx) + (_dydy * dy));
+            }
+            return computeExact(xInd, yInd);
+        }
+
+        /**
+         * \brief Fit an affine map over a region of the coadd and use it if it is accurate enough
+         *
+         * The map is fit to three corners of the region and checked at the fourth corner and the center.
+         *
+         * \return true if the affine map is used; false if the exact map is used
+         */
+        bool linearize(
+            afwImage::BBox const &coaddBBox     ///< region of coadd, relative to its origin
+        ) {
+            _isLinear = false;
+            _xRef = coaddBBox.getX0();
+            _yRef = coaddBBox.getY0();
+            double const xSpan = std::max(coaddBBox.getWidth() - 1, 1);
+            double const ySpan = std::max(coaddBBox.getHeight() - 1, 1);
+            afwImage::PointD const srcRef = computeExact(_xRef, _yRef);
+            afwImage::PointD const srcX = computeExact(_xRef + xSpan, _yRef);
+            afwImage::PointD const srcY = computeExact(_xRef, _yRef + ySpan);
+            _srcXRef = srcRef.getX();
+            _srcYRef = srcRef.getY();
+            _dxdx = (srcX.getX() - _srcXRef) / xSpan;
+            _dydx = (srcX.getY() - _srcYRef) / xSpan;
+            _dxdy = (srcY.getX() - _srcXRef) / ySpan;
+            _dydy = (srcY.getY() - _srcYRef) / ySpan;
+
+            _isLinear = true;
+            afwImage::PointD const testIndList[2] = {
+                afwImage::PointD(_xRef + xSpan, _yRef + ySpan),
+                afwImage::PointD(_xRef + (0.5 * xSpan), _yRef + (0.5 * ySpan))
+            };
+            for (int i = 0; i < 2; ++i) {
+                afwImage::PointD const exactPos = computeExact(testIndList[i].getX(), testIndList[i].getY());
+                afwImage::PointD const linearPos = (*this)(testIndList[i].getX(), testIndList[i].getY());
+                if ((std::fabs(exactPos.getX() - linearPos.getX()) > MaxLinearWcsError)
+                    || (std::fabs(exactPos.getY() - linearPos.getY()) > MaxLinearWcsError)) {
+                    _isLinear = false;
+                }
+            }
+            return _isLinear;
+        }
+
+    private:
+        afwImage::Wcs const &_srcWcs;
+        afwImage::Wcs const &_coaddWcs;
+        afwImage::PointI _coaddXY0;
+        bool _isLinear;
+        double _xRef;       ///< coadd x index at which the affine map is referenced
+        double _yRef;       ///< coadd y index at which the affine map is referenced
+        double _srcXRef;    ///< component x index at (_xRef, _yRef)
+        double _srcYRef;    ///< component y index at (_xRef, _yRef)
+        double _dxdx;       ///< d(component x index) / d(coadd x index)
+        double _dxdy;       ///< d(component x index) / d(coadd y index)
+        double _dydx;       ///< d(component y index) / d(coadd x index)
+        double _dydy;       ///< d(component y index) / d(coadd y index)
+
+        afwImage::PointD computeExact(double xInd, double yInd) const {
+            afwImage::PointD const coaddPos(
+                xInd + afwImage::PixelZeroPos + _coaddXY0.getX(),
+                yInd + afwImage::PixelZeroPos + _coaddXY0.getY());
+            afwImage::PointD const srcPos = _srcWcs.raDecToXY(_coaddWcs.xyToRaDec(coaddPos));
+            return afwImage::PointD(srcPos.getX() - afwImage::PixelZeroPos, srcPos.getY() - afwImage::PixelZeroPos);
+        }
+    };
+
+    /**
+     * \brief Find the region of a component's blurred exposure needed to warp a region of the coadd
+     *
+     * Samples the edges of the coadd region, maps them to the component, and grows the result by the
+     * warping kernel (plus a pixel or two of slack, as for the overlap computed in addComponent).
+     *
+     * \return the region, relative to the origin of the science exposure, clipped to srcBBox; may be empty
+     */
+    afwImage::BBox findSourceBBox(
+        CoaddToSourceMap const &coaddToSource,  ///< map from coadd to component
+        afwImage::BBox const &srcBBox,  ///< bounding box of component, relative to its origin
+        afwImage::BBox const &coaddBBox,    ///< region of coadd, relative to its origin
+        int order                       ///< order of Lanczos warping kernel
+    ) {
+        double minX = srcBBox.getX1() + 1;
+        double maxX = srcBBox.getX0() - 1;
+        double minY = srcBBox.getY1() + 1;
+        double maxY = srcBBox.getY0() - 1;
+        for (int i = 0; i < NEdgeSamples; ++i) {
+            double const frac = static_cast<double>(i) / static_cast<double>(NEdgeSamples - 1);
+            double const xInd = coaddBBox.getX0() - 0.5 + (frac * coaddBBox.getWidth());
+            double const yInd = coaddBBox.getY0() - 0.5 + (frac * coaddBBox.getHeight());
+            afwImage::PointD edgeIndList[4] = {
+                afwImage::PointD(xInd, coaddBBox.getY0() - 0.5),
+                afwImage::PointD(xInd, coaddBBox.getY1() + 0.5),
+                afwImage::PointD(coaddBBox.getX0() - 0.5, yInd),
+                afwImage::PointD(coaddBBox.getX1() + 0.5, yInd)
+            };
+            for (int j = 0; j < 4; ++j) {
+                afwImage::PointD const srcInd = coaddToSource(edgeIndList[j].getX(), edgeIndList[j].getY());
+                minX = std::min(minX, srcInd.getX());
+                maxX = std::max(maxX, srcInd.getX());
+                minY = std::min(minY, srcInd.getY());
+                maxY = std::max(maxY, srcInd.getY());
+            }
+        }
+        // clip as doubles to avoid overflowing int far off the component
+        int const x0 = static_cast<int>(std::max(std::floor(minX) - order - 1, double(srcBBox.getX0())));
+        int const x1 = static_cast<int>(std::min(std::ceil(maxX) + order + 1, double(srcBBox.getX1())));
+        int const y0 = static_cast<int>(std::max(std::floor(minY) - order - 1, double(srcBBox.getY0())));
+        int const y1 = static_cast<int>(std::min(std::ceil(maxY) + order + 1, double(srcBBox.getY1())));
+        if ((x0 > x1) || (y0 > y1)) {
+            return afwImage::BBox();
+        }
+        return afwImage::BBox(afwImage::PointI(x0, y0), afwImage::PointI(x1, y1));
+    }
+
+    /**
+     * \brief Warp a blurred exposure (or region of one) into a region of the coadd and add the good pixels
+     *
+     * See KaiserCoadd::addComponent for details. Coadd tiles are allocated when the first good pixel
+     * is added to them.
+     *
+     * \return the number of pixels added
+     */
+    template <typename SrcMaskedImageT>
+    int warpRegion(
+        coaddKaiser::CoaddTileMap &tileMap, ///< coadd masked image and depth map
+        SrcMaskedImageT const &srcMI,   ///< blurred exposure or region of it; xy0 relative to science exposure
+        CoaddToSourceMap const &coaddToSource,  ///< map from coadd to component
+        afwImage::BBox const &coaddBBox,    ///< region of coadd to warp, relative to its origin
+        int order,                      ///< order of Lanczos warping kernel
+        afwImage::MaskPixel badPixelMask,   ///< warped pixels with any of these bits set are not added
+        double weight,                  ///< 1/sigmaSq; ignored if sigmaSqMapPtr is not null
+        coaddKaiser::SigmaSqMap const *sigmaSqMapPtr    ///< map of sigmaSq; null if none
+    ) {
+        int const kSize = 2 * order;
+        int const srcWidth = srcMI.getWidth();
+        int const srcHeight = srcMI.getHeight();
+        std::vector<double> xWeights(kSize);
+        std::vector<double> yWeights(kSize);
+        int nGood = 0;
+        for (int iy = tileMap.getTileIY(coaddBBox.getY0()), iyEnd = tileMap.getTileIY(coaddBBox.getY1()) + 1;
+            iy < iyEnd; ++iy) {
+            for (int ix = tileMap.getTileIX(coaddBBox.getX0()), ixEnd = tileMap.getTileIX(coaddBBox.getX1()) + 1;
+                ix < ixEnd; ++ix) {
+                afwImage::BBox const tileBBox = tileMap.getTileBBox(ix, iy);
+                coaddKaiser::CoaddTile const *tilePtr = tileMap.findTile(ix, iy);
+                coaddKaiser::KaiserCoadd::MaskedImageD tileMI;
+                coaddKaiser::KaiserCoadd::DepthMap tileDepthMap;
+                if (tilePtr) {
+                    tileMI = tilePtr->getMaskedImage();
+                    tileDepthMap = tilePtr->getDepthMap();
+                }
+                int const xBegin = std::max(coaddBBox.getX0(), tileBBox.getX0());
+                int const xEnd = std::min(coaddBBox.getX1(), tileBBox.getX1()) + 1;
+                int const yBegin = std::max(coaddBBox.getY0(), tileBBox.getY0());
+                int const yEnd = std::min(coaddBBox.getY1(), tileBBox.getY1()) + 1;
+                for (int y = yBegin; y < yEnd; ++y) {
+                    for (int x = xBegin; x < xEnd; ++x) {
+                        afwImage::PointD const srcInd = coaddToSource(x, y);
+                        double const srcXInd = srcInd.getX() - srcMI.getX0();
+                        double const srcYInd = srcInd.getY() - srcMI.getY0();
+                        double const srcXFloor = std::floor(srcXInd);
+                        double const srcYFloor = std::floor(srcYInd);
+                        // test as doubles to avoid overflowing int far off the component
+                        if ((srcXFloor - order + 1 < 0) || (srcXFloor + order >= srcWidth)
+                            || (srcYFloor - order + 1 < 0) || (srcYFloor + order >= srcHeight)) {
+                            continue;
+                        }
+                        int const srcXStart = static_cast<int>(srcXFloor) - order + 1;
+                        int const srcYStart = static_cast<int>(srcYFloor) - order + 1;
+                        computeLanczosWeights(xWeights, srcXInd - srcXFloor, order);
+                        computeLanczosWeights(yWeights, srcYInd - srcYFloor, order);
+
+                        double imageSum = 0;
+                        double varianceSum = 0;
+                        afwImage::MaskPixel maskOr = 0;
+                        for (int j = 0; j < kSize; ++j) {
+                            double const yWeight = yWeights[j];
+                            typename SrcMaskedImageT::x_iterator srcPtr = srcMI.x_at(srcXStart, srcYStart + j);
+                            for (int i = 0; i < kSize; ++i, ++srcPtr) {
+                                double const kWeight = xWeights[i] * yWeight;
+                                if (kWeight == 0) {
+                                    continue;
+                                }
+                                imageSum += kWeight * static_cast<double>(srcPtr.image());
+                                varianceSum += kWeight * kWeight * static_cast<double>(srcPtr.variance());
+                                maskOr |= srcPtr.mask();
+                            }
+                        }
+                        if ((maskOr & badPixelMask) != 0) {
+                            continue;
+                        }
+                        if (!tilePtr) {
+                            tilePtr = &tileMap.getOrAddTile(ix, iy);
+                            tileMI = tilePtr->getMaskedImage();
+                            tileDepthMap = tilePtr->getDepthMap();
+                        }
+                        // the map is indexed relative to the origin of the science exposure, as is srcMI's xy0
+                        double const pixelWeight = sigmaSqMapPtr ?
+                            1.0 / sigmaSqMapPtr->getSigmaSq(srcXInd + srcMI.getX0(), srcYInd + srcMI.getY0())
+                            : weight;
+                        coaddKaiser::KaiserCoadd::MaskedImageD::x_iterator coaddPtr =
+                            tileMI.x_at(x - tileBBox.getX0(), y - tileBBox.getY0());
+                        coaddPtr.image() += imageSum * pixelWeight;
+                        coaddPtr.variance() += varianceSum * (pixelWeight * pixelWeight);
+                        coaddPtr.mask() |= maskOr;
+                        *tileDepthMap.x_at(x - tileBBox.getX0(), y - tileBBox.getY0()) += 1;
+                        ++nGood;
+                    }
+                }
+            }
+        }
+        return nGood;
+    }
+}
+
+/**
+ * \brief Construct an empty KaiserCoadd
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if width, height or warpingKernelOrder < 1
+ *
+ * \ingroup coadd::kaiser
+ */
+coaddKaiser::KaiserCoadd::KaiserCoadd(
+    int width,      ///< width of coadd (pixels)
+    int height,     ///< height of coadd (pixels)
+    afwImage::Wcs const &wcs,   ///< WCS of coadd
+    afwImage::MaskPixel badPixelMask,   ///< warped pixels with any of these mask bits set are not added
+    int warpingKernelOrder,     ///< order of Lanczos warping kernel
+    int coaddTileSize           ///< width and height (pixels) of the tiles in which the coadd is stored,
+                                ///< allocated when first written; if <= 0 then the coadd is stored densely
+) :
+    lsst::daf::base::Citizen(typeid(this)),
+    _wcsPtr(wcs.clone()),
+    _tileMap(width, height, coaddTileSize),
+    _blurredPsfImage(0, 0),
+    _badPixelMask(badPixelMask),
+    _warpingKernelOrder(warpingKernelOrder),
+    _warpTileSize(0),
+    _nComponents(0),
+    _modifiedBBoxList()
+{
+    if (warpingKernelOrder < 1) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("warpingKernelOrder=%d must be positive") % warpingKernelOrder).str());
+    }
+}
+
+/**
+ * \brief Get the coadd exposure
+ *
+ * If the coadd is stored densely this shares pixels with the coadd; otherwise it is a new dense copy
+ * (with 0 where no tile has been written).
+ */
+coaddKaiser::KaiserCoadd::ExposureD coaddKaiser::KaiserCoadd::getExposure() const {
+    MaskedImageD coaddMI = getMaskedImage();
+    return ExposureD(coaddMI, *_wcsPtr);
+}
+
+/**
+ * \brief Get the coadd masked image
+ *
+ * If the coadd is stored densely this shares pixels with the coadd; otherwise it is a new dense copy
+ * (with 0 where no tile has been written).
+ */
+coaddKaiser::KaiserCoadd::MaskedImageD coaddKaiser::KaiserCoadd::getMaskedImage() const {
+    if (!isSparse()) {
+        return _tileMap.getPopulatedTile(0).getMaskedImage();
+    }
+    MaskedImageD coaddMI(getWidth(), getHeight());
+    _tileMap.getRegion(afwImage::BBox(afwImage::PointI(0, 0), getWidth(), getHeight()), coaddMI);
+    return coaddMI;
+}
+
+/**
+ * \brief Get the number of components that contributed to each pixel
+ *
+ * If the coadd is stored densely this shares pixels with the coadd; otherwise it is a new dense copy.
+ */
+coaddKaiser::KaiserCoadd::DepthMap coaddKaiser::KaiserCoadd::getDepthMap() const {
+    if (!isSparse()) {
+        return _tileMap.getPopulatedTile(0).getDepthMap();
+    }
+    DepthMap depthMap(getWidth(), getHeight());
+    _tileMap.getRegion(afwImage::BBox(afwImage::PointI(0, 0), getWidth(), getHeight()), depthMap);
+    return depthMap;
+}
+
+/**
+ * \brief Add a CoaddComponent to the coadd
+ *
+ * In one pass over the overlapping region of the coadd: warp the blurred exposure to the coadd WCS
+ * using a Lanczos kernel (the variance is warped with the squared kernel and the mask is the OR of the
+ * mask pixels under the kernel), scale it by 1/sigmaSq (1/sigmaSq^2 for the variance),
+ * and add each pixel that has no bits of badPixelMask set to the coadd (ORing the mask)
+ * and increment the depth map. Pixels for which the warping kernel would extend past the blurred exposure
+ * are skipped. If the component overlaps the coadd, also add its blurred PSF image, scaled by 1/sigmaSq,
+ * to the blurred PSF image of the coadd and count it in getNComponents; a component that does not overlap
+ * the coadd leaves the coadd unchanged.
+ *
+ * This is equivalent to dividing the blurred exposure by sigmaSq, warping it into a new coadd-sized
+ * exposure with afwMath::warpExposure and adding that with coaddUtils::addToCoadd.
+ *
+ * If the component has a SigmaSqMap then each warped pixel is instead scaled by 1/sigmaSq interpolated
+ * from the map at the position of that pixel on the component (the blurred PSF image is still scaled
+ * by the single sigmaSq); this is done in the same pass.
+ *
+ * If the component is lazy then only the part of its blurred exposure that overlaps the coadd is computed.
+ *
+ * If the warp tile size is set then the overlapping region of the coadd is processed in tiles. For each tile
+ * the map from coadd to component pixels is fit by an affine map (if that is accurate to MaxLinearWcsError;
+ * otherwise the exact WCS is used for the tile), and the region of the blurred exposure that the tile needs
+ * is obtained and warped at once; for a lazy component that region is blurred just for the tile
+ * (see CoaddComponent::blurRegion), so no blurred image larger than a tile plus its halo is ever held.
+ * The halo is blurred once per tile it overlaps, so very small tiles cost more.
+ *
+ * If the coadd is stored in tiles (see CoaddTileMap), a tile is allocated when the first pixel is added to it.
+ *
+ * \return the number of pixels added
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if the component has no blurred exposure
+ * (it was computed in strips), the blurred exposure has no WCS, or the blurred PSF image does not match
+ * the size of those already added.
+ * \throw lsst::pex::exceptions::RangeErrorException if sigmaSq is not positive
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+int coaddKaiser::KaiserCoadd::addComponent(
+    CoaddComponent<PixelT> const &coaddComponent    ///< component to add
+) {
+    typedef typename CoaddComponent<PixelT>::ExposureCC ExposureCC;
+
+    afwImage::BBox const srcBBox = coaddComponent.getBBox();
+    if (!srcBBox) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            "coaddComponent has no blurred exposure (was it computed in strips?)");
+    }
+    afwImage::Wcs::Ptr srcWcsPtr = coaddComponent.getWcs();
+    if (!srcWcsPtr) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException, "blurred exposure has no WCS");
+    }
+    double const sigmaSq = coaddComponent.getSigmaSq();
+    if (!(sigmaSq > 0)) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException,
+            (boost::format("sigmaSq=%g must be positive") % sigmaSq).str());
+    }
+    double const weight = 1.0 / sigmaSq;
+    SigmaSqMap::ConstPtr const sigmaSqMapPtr = coaddComponent.getSigmaSqMap();
+
+    // check the blurred PSF image first, so a mismatch leaves the coadd unchanged
+    typename CoaddComponent<PixelT>::ImageCC blurredPsfImage = coaddComponent.getBlurredPsfImage();
+    if ((_nComponents > 0) && ((blurredPsfImage.getWidth() != _blurredPsfImage.getWidth())
+        || (blurredPsfImage.getHeight() != _blurredPsfImage.getHeight()))) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("blurred PSF image is %dx%d; expected %dx%d") %
+            blurredPsfImage.getWidth() % blurredPsfImage.getHeight() %
+            _blurredPsfImage.getWidth() % _blurredPsfImage.getHeight()).str());
+    }
+
+    afwImage::Wcs::Ptr coaddWcsPtr = _wcsPtr;
+    int const order = _warpingKernelOrder;
+
+    // find the region of the coadd that the component may overlap by sampling the component's edges
+    afwImage::BBox const overlapBBox = computeOverlapBBox(*srcWcsPtr, srcBBox, *coaddWcsPtr,
+        getWidth(), getHeight());
+    if (!overlapBBox) {
+        return 0;
+    }
+
+    // a component that overlaps the coadd contributes to the coadd PSF
+    if (_nComponents == 0) {
+        _blurredPsfImage = PsfImage(blurredPsfImage.getWidth(), blurredPsfImage.getHeight(), 0);
+    }
+    for (int y = 0; y < blurredPsfImage.getHeight(); ++y) {
+        typename CoaddComponent<PixelT>::ImageCC::x_iterator inPtr = blurredPsfImage.row_begin(y);
+        for (PsfImage::x_iterator psfPtr = _blurredPsfImage.row_begin(y), psfEnd = _blurredPsfImage.row_end(y);
+            psfPtr != psfEnd; ++psfPtr, ++inPtr) {
+            *psfPtr += static_cast<double>(*inPtr) * weight;
+        }
+    }
+    ++_nComponents;
+    _modifiedBBoxList.push_back(overlapBBox);
+    CoaddToSourceMap coaddToSource(*srcWcsPtr, *coaddWcsPtr, afwImage::PointI(0, 0));
+
+    if (_warpTileSize <= 0) {
+        // a lazy component only blurs the part of the science exposure that this region of the coadd needs
+        afwImage::BBox const neededBBox = coaddComponent.isLazy() ?
+            findSourceBBox(coaddToSource, srcBBox, overlapBBox, order) : srcBBox;
+        if (!neededBBox) {
+            return 0;
+        }
+        ExposureCC const blurredExposure = coaddComponent.isLazy() ?
+            coaddComponent.getBlurredExposure(neededBBox) : coaddComponent.getBlurredExposure();
+        return warpRegion(_tileMap, blurredExposure.getMaskedImage(), coaddToSource, overlapBBox,
+            order, _badPixelMask, weight, sigmaSqMapPtr.get());
+    }
+
+    // warp one tile at a time, blurring just the region of the science exposure that each tile needs
+    int const xEnd = overlapBBox.getX1() + 1;
+    int const yEnd = overlapBBox.getY1() + 1;
+    int nGood = 0;
+    for (int tileY0 = overlapBBox.getY0(); tileY0 < yEnd; tileY0 += _warpTileSize) {
+        for (int tileX0 = overlapBBox.getX0(); tileX0 < xEnd; tileX0 += _warpTileSize) {
+            afwImage::BBox const tileBBox(afwImage::PointI(tileX0, tileY0),
+                std::min(_warpTileSize, xEnd - tileX0), std::min(_warpTileSize, yEnd - tileY0));
+            coaddToSource.linearize(tileBBox);
+            afwImage::BBox const tileSrcBBox = findSourceBBox(coaddToSource, srcBBox, tileBBox, order);
+            if (!tileSrcBBox) {
+                continue;
+            }
+            ExposureCC const blurredExposure = coaddComponent.blurRegion(tileSrcBBox);
+            nGood += warpRegion(_tileMap, blurredExposure.getMaskedImage(), coaddToSource, tileBBox,
+                order, _badPixelMask, weight, sigmaSqMapPtr.get());
+        }
+    }
+    return nGood;
+}
+
+//
+// Explicit instantiations
+//
+template int coaddKaiser::KaiserCoadd::addComponent<float>(CoaddComponent<float> const &);
+template int coaddKaiser::KaiserCoadd::addComponent<double>(CoaddComponent<double> const &);
@@ -0,0 +1,156 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Pool of reusable masked images
+*
+* @file
+*/
+#include "boost/format.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/coadd/kaiser/MaskedImagePool.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+/**
+ * \brief Construct an empty MaskedImagePool
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if maxFree < 0
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+coaddKaiser::MaskedImagePool<PixelT>::MaskedImagePool(
+    int maxFree     ///< maximum number of free masked images to keep; 0 to keep none
+) :
+    _maxFree(maxFree),
+    _freeList(),
+    _nAllocated(0),
+    _nReused(0),
+    _mutex()
+{
+    if (maxFree < 0) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("maxFree=%d must not be negative") % maxFree).str());
+    }
+}
+
+/**
+ * \brief Get a masked image of the specified size
+ *
+ * Reuses the most recently released free masked image of that size, if any, else allocates a new one.
+ *
+ * \return the masked image, with xy0 = (0, 0); the pixel values are undefined
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if width or height < 1
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+typename coaddKaiser::MaskedImagePool<PixelT>::MaskedImageT coaddKaiser::MaskedImagePool<PixelT>::get(
+    int width,      ///< width of masked image (pixels)
+    int height      ///< height of masked image (pixels)
+) {
+    if ((width < 1) || (height < 1)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("width=%d and height=%d must both be positive") % width % height).str());
+    }
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        for (typename std::vector<MaskedImageT>::size_type i = _freeList.size(); i > 0; --i) {
+            MaskedImageT maskedImage = _freeList[i - 1];
+            if ((maskedImage.getWidth() == width) && (maskedImage.getHeight() == height)) {
+                _freeList.erase(_freeList.begin() + (i - 1));
+                ++_nReused;
+                maskedImage.setXY0(afwImage::PointI(0, 0));
+                return maskedImage;
+            }
+        }
+        ++_nAllocated;
+    }
+    return MaskedImageT(width, height);
+}
+
+/**
+ * \brief Return a masked image to the pool
+ *
+ * The caller must not use maskedImage (or anything sharing its pixels) afterwards, and maskedImage
+ * must be a whole masked image, not a subimage. If the pool is full then the oldest free masked image
+ * is discarded.
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+void coaddKaiser::MaskedImagePool<PixelT>::release(
+    MaskedImageT const &maskedImage     ///< masked image to return
+) {
+    if ((_maxFree == 0) || (maskedImage.getWidth() < 1) || (maskedImage.getHeight() < 1)) {
+        return;
+    }
+    boost::mutex::scoped_lock lock(_mutex);
+    if (static_cast<int>(_freeList.size()) >= _maxFree) {
+        _freeList.erase(_freeList.begin());
+    }
+    _freeList.push_back(maskedImage);
+}
+
+template <typename PixelT>
+int coaddKaiser::MaskedImagePool<PixelT>::getNFree() const {
+    boost::mutex::scoped_lock lock(_mutex);
+    return static_cast<int>(_freeList.size());
+}
+
+template <typename PixelT>
+int coaddKaiser::MaskedImagePool<PixelT>::getNAllocated() const {
+    boost::mutex::scoped_lock lock(_mutex);
+    return _nAllocated;
+}
+
+template <typename PixelT>
+int coaddKaiser::MaskedImagePool<PixelT>::getNReused() const {
+    boost::mutex::scoped_lock lock(_mutex);
+    return _nReused;
+}
+
+/**
+ * \brief Discard all free masked images and reset the statistics
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+void coaddKaiser::MaskedImagePool<PixelT>::clear() {
+    boost::mutex::scoped_lock lock(_mutex);
+    _freeList.clear();
+    _nAllocated = 0;
+    _nReused = 0;
+}
+
+//
+// Explicit instantiations
+//
+template class coaddKaiser::MaskedImagePool<float>;
+template class coaddKaiser::MaskedImagePool<double>;
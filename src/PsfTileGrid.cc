@@ -0,0 +1,467 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief PSF evaluated on a grid of tiles.
+*
+* @file
+*/
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "boost/format.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/afw/math.h"
+#include "lsst/coadd/kaiser/reflectImage.h"
+#include "lsst/coadd/kaiser/PsfTileGrid.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwMath = lsst::afw::math;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+// local functions and classes
+namespace {
+
+    /**
+     * \brief A range of pixels along one axis that is convolved with the PSF of one tile,
+     * or with a linear blend of the PSFs of two adjacent tiles
+     */
+    struct BlendSegment {
+        int start;          ///< index of first pixel
+        int end;            ///< index of one past the last pixel
+        int tile0;          ///< index of first tile
+        int tile1;          ///< index of second tile; equal to tile0 if there is no blending
+        double center0;     ///< pixel index of center of first tile
+        double center1;     ///< pixel index of center of second tile
+
+        BlendSegment(int start_, int end_, int tile0_, int tile1_, double center0_, double center1_) :
+            start(start_), end(end_), tile0(tile0_), tile1(tile1_), center0(center0_), center1(center1_)
+        {}
+
+        /// return the weight of the specified tile (tile0 or tile1) at the specified pixel
+        double getWeight(int tile, int ind) const {
+            if (tile0 == tile1) {
+                return 1.0;
+            }
+            double const weight1 = (static_cast<double>(ind) - center0) / (center1 - center0);
+            return (tile == tile1) ? weight1 : 1.0 - weight1;
+        }
+    };
+
+    /**
+     * \brief Make a list of blend segments along one axis
+     *
+     * Without blending each tile is one segment. With blending, the segments run between adjacent tile
+     * centers, plus a segment from the edge of the image to the first (and from the last) tile center
+     * which uses just that tile.
+     */
+    std::vector<BlendSegment> makeBlendSegmentList(
+        std::vector<int> const &bounds, ///< index of the start of each tile, plus one past the last tile
+        bool blendTiles                 ///< blend between tiles?
+    ) {
+        int const nTiles = static_cast<int>(bounds.size()) - 1;
+        std::vector<BlendSegment> segmentList;
+        if (!blendTiles || (nTiles == 1)) {
+            for (int i = 0; i < nTiles; ++i) {
+                segmentList.push_back(BlendSegment(bounds[i], bounds[i + 1], i, i, 0.0, 0.0));
+            }
+            return segmentList;
+        }
+
+        std::vector<double> centerList;
+        std::vector<int> segmentStartList;  // first pixel at or above each tile center
+        for (int i = 0; i < nTiles; ++i) {
+            double const center = 0.5 * static_cast<double>(bounds[i] + bounds[i + 1] - 1);
+            centerList.push_back(center);
+            segmentStartList.push_back(static_cast<int>(std::ceil(center)));
+        }
+        if (segmentStartList[0] > bounds[0]) {
+            segmentList.push_back(BlendSegment(bounds[0], segmentStartList[0], 0, 0, centerList[0], centerList[0]));
+        }
+        for (int i = 0; i < nTiles - 1; ++i) {
+            if (segmentStartList[i + 1] > segmentStartList[i]) {
+                segmentList.push_back(BlendSegment(segmentStartList[i], segmentStartList[i + 1], i, i + 1,
+                    centerList[i], centerList[i + 1]));
+            }
+        }
+        int const last = nTiles - 1;
+        if (bounds[nTiles] > segmentStartList[last]) {
+            segmentList.push_back(BlendSegment(segmentStartList[last], bounds[nTiles], last, last,
+                centerList[last], centerList[last]));
+        }
+        return segmentList;
+    }
+
+    /**
+     * \brief Shift a list of blend segments by -offset and clip them to [0, size)
+     *
+     * Used to convolve an image that covers only part of the grid, such as a strip.
+     */
+    std::vector<BlendSegment> clipBlendSegmentList(
+        std::vector<BlendSegment> const &segmentList,   ///< blend segments in grid coordinates
+        int offset, ///< index of start of image relative to the grid
+        int size    ///< size of image
+    ) {
+        std::vector<BlendSegment> clippedList;
+        for (std::vector<BlendSegment>::const_iterator segIter = segmentList.begin();
+            segIter != segmentList.end(); ++segIter) {
+            int const start = std::max(0, segIter->start - offset);
+            int const end = std::min(size, segIter->end - offset);
+            if (end > start) {
+                clippedList.push_back(BlendSegment(start, end, segIter->tile0, segIter->tile1,
+                    segIter->center0 - offset, segIter->center1 - offset));
+            }
+        }
+        return clippedList;
+    }
+
+} // anonymous namespace
+
+/**
+ * \brief Construct a PsfTileGrid
+ *
+ * The image is divided into nTilesX by nTilesY tiles of nearly equal size and the PSF kernel is evaluated
+ * at the center of each tile.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if nTilesX or nTilesY < 1
+ * or larger than the bbox width or height.
+ *
+ * \ingroup coadd::kaiser
+ */
+coaddKaiser::PsfTileGrid::PsfTileGrid(
+    afwMath::Kernel const &psfKernel,   ///< PSF kernel; may be spatially varying
+    afwImage::BBox const &bbox,         ///< bounding box of image, in parent pixel coordinates
+    int nTilesX,                        ///< number of tiles in x
+    int nTilesY,                        ///< number of tiles in y
+    bool normalizePsf                   ///< normalize the PSF of each tile?
+) :
+    lsst::daf::base::Citizen(typeid(this)),
+    _bbox(bbox),
+    _kernelWidth(psfKernel.getWidth()),
+    _kernelHeight(psfKernel.getHeight()),
+    _xBounds(),
+    _yBounds(),
+    _kernelImageList(),
+    _reflKernelImageList(),
+    _kernelList(),
+    _reflKernelList()
+{
+    if ((nTilesX < 1) || (nTilesY < 1)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("nTilesX=%d and nTilesY=%d must both be >= 1") % nTilesX % nTilesY).str());
+    }
+    if ((nTilesX > bbox.getWidth()) || (nTilesY > bbox.getHeight())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("%d x %d tiles will not fit in a %d x %d image")
+                % nTilesX % nTilesY % bbox.getWidth() % bbox.getHeight()).str());
+    }
+    for (int i = 0; i <= nTilesX; ++i) {
+        _xBounds.push_back((i * bbox.getWidth()) / nTilesX);
+    }
+    for (int i = 0; i <= nTilesY; ++i) {
+        _yBounds.push_back((i * bbox.getHeight()) / nTilesY);
+    }
+
+    int const reflCtrX = _kernelWidth - 1 - psfKernel.getCtrX();
+    int const reflCtrY = _kernelHeight - 1 - psfKernel.getCtrY();
+    for (int iy = 0; iy < nTilesY; ++iy) {
+        for (int ix = 0; ix < nTilesX; ++ix) {
+            afwImage::PointD const ctr = getTileCenter(ix, iy);
+            KernelImage::Ptr kernelImagePtr(new KernelImage(_kernelWidth, _kernelHeight));
+            psfKernel.computeImage(*kernelImagePtr, normalizePsf, ctr.getX(), ctr.getY());
+            KernelImage::Ptr reflKernelImagePtr(new KernelImage(*kernelImagePtr, true));
+            coaddKaiser::reflectImage(*reflKernelImagePtr);
+
+            afwMath::Kernel::Ptr kernelPtr(new afwMath::FixedKernel(*kernelImagePtr));
+            kernelPtr->setCtrX(psfKernel.getCtrX());
+            kernelPtr->setCtrY(psfKernel.getCtrY());
+            afwMath::Kernel::Ptr reflKernelPtr(new afwMath::FixedKernel(*reflKernelImagePtr));
+            reflKernelPtr->setCtrX(reflCtrX);
+            reflKernelPtr->setCtrY(reflCtrY);
+
+            _kernelImageList.push_back(kernelImagePtr);
+            _reflKernelImageList.push_back(reflKernelImagePtr);
+            _kernelList.push_back(kernelPtr);
+            _reflKernelList.push_back(reflKernelPtr);
+        }
+    }
+}
+
+/**
+ * \brief Get the bounding box of a tile, relative to the lower left corner of the image
+ *
+ * \throw lsst::pex::exceptions::RangeErrorException if ix or iy is out of range
+ */
+afwImage::BBox coaddKaiser::PsfTileGrid::getTileBBox(
+    int ix, ///< x index of tile
+    int iy  ///< y index of tile
+) const {
+    getTileIndex(ix, iy); // check range
+    return afwImage::BBox(afwImage::PointI(_xBounds[ix], _yBounds[iy]),
+        _xBounds[ix + 1] - _xBounds[ix], _yBounds[iy + 1] - _yBounds[iy]);
+}
+
+/**
+ * \brief Get the position (in parent pixel coordinates) at which the PSF of a tile is evaluated
+ *
+ * \throw lsst::pex::exceptions::RangeErrorException if ix or iy is out of range
+ */
+afwImage::PointD coaddKaiser::PsfTileGrid::getTileCenter(
+    int ix, ///< x index of tile
+    int iy  ///< y index of tile
+) const {
+    getTileIndex(ix, iy); // check range
+    return afwImage::PointD(
+        afwImage::indexToPosition(_bbox.getX0() + _xBounds[ix])
+            + (0.5 * static_cast<double>(_xBounds[ix + 1] - _xBounds[ix] - 1)),
+        afwImage::indexToPosition(_bbox.getY0() + _yBounds[iy])
+            + (0.5 * static_cast<double>(_yBounds[iy + 1] - _yBounds[iy] - 1)));
+}
+
+/**
+ * \brief Get the PSF kernel image of a tile
+ *
+ * \throw lsst::pex::exceptions::RangeErrorException if ix or iy is out of range
+ */
+coaddKaiser::PsfTileGrid::KernelImage::ConstPtr coaddKaiser::PsfTileGrid::getKernelImage(
+    int ix,         ///< x index of tile
+    int iy,         ///< y index of tile
+    bool reflected  ///< if true, return the reflected PSF image, psf(-r)
+) const {
+    int const ind = getTileIndex(ix, iy);
+    return reflected ? _reflKernelImageList[ind] : _kernelImageList[ind];
+}
+
+/**
+ * \brief Get the PSF of a tile as a fixed kernel
+ *
+ * \throw lsst::pex::exceptions::RangeErrorException if ix or iy is out of range
+ */
+afwMath::Kernel::ConstPtr coaddKaiser::PsfTileGrid::getKernel(
+    int ix,         ///< x index of tile
+    int iy,         ///< y index of tile
+    bool reflected  ///< if true, return the reflected PSF, psf(-r)
+) const {
+    int const ind = getTileIndex(ix, iy);
+    return reflected ? _reflKernelList[ind] : _kernelList[ind];
+}
+
+int coaddKaiser::PsfTileGrid::getTileIndex(int ix, int iy) const {
+    if ((ix < 0) || (ix >= getNTilesX()) || (iy < 0) || (iy >= getNTilesY())) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException,
+            (boost::format("tile index (%d, %d) out of range [0-%d, 0-%d]")
+                % ix % iy % (getNTilesX() - 1) % (getNTilesY() - 1)).str());
+    }
+    return (iy * getNTilesX()) + ix;
+}
+
+/**
+ * \brief Convolve a MaskedImage with the PSF of each tile of a PsfTileGrid
+ *
+ * Without blending, each tile of the image is convolved with the PSF evaluated at the center of that tile.
+ * With blending, the convolved image is interpolated bilinearly between the tile centers; this is exactly
+ * equivalent to convolving with a bilinearly interpolated PSF for the image plane, and a slight overestimate
+ * for the variance plane. Blending costs up to four convolutions per pixel instead of one.
+ *
+ * \return the convolution method used (never AUTO_CONVOLUTION)
+ *
+ * inImage may be any part of the region covered by psfTileGrid (e.g. a horizontal strip); its xy0 is used
+ * to locate it on the grid, so each pixel is convolved with the same PSF as if the whole image were
+ * convolved at once (apart from edge pixels of inImage, which are set as usual for convolution).
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if inImage is not contained in the bounding box
+ * of psfTileGrid or convolvedImage is not the same size as inImage.
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename OutPixelT, typename InPixelT>
+coaddKaiser::ConvolutionMethod coaddKaiser::convolveWithPsfTiles(
+    afwImage::MaskedImage<OutPixelT, afwImage::MaskPixel, afwImage::VariancePixel>
+        &convolvedImage,    ///< convolved image; must be the same size as inImage
+    afwImage::MaskedImage<InPixelT, afwImage::MaskPixel, afwImage::VariancePixel> const
+        &inImage,           ///< image to convolve
+    PsfTileGrid const &psfTileGrid, ///< PSF evaluated on a grid of tiles covering inImage
+    bool useReflectedPsf,   ///< convolve with psf(-r) instead of psf(r)?
+    bool blendTiles,        ///< blend the PSF between tiles?
+    ConvolutionMethod convolutionMethod,    ///< convolution method
+    int fftSize             ///< FFT size along each axis, for FFT convolution; if <= 0 then a default is used
+) {
+    typedef afwImage::MaskedImage<OutPixelT, afwImage::MaskPixel, afwImage::VariancePixel> OutMaskedImage;
+    typedef afwImage::MaskedImage<InPixelT, afwImage::MaskPixel, afwImage::VariancePixel> InMaskedImage;
+    typedef typename OutMaskedImage::x_iterator OutXIterator;
+
+    int const width = inImage.getWidth();
+    int const height = inImage.getHeight();
+    afwImage::BBox const gridBBox = psfTileGrid.getBBox();
+    // offset of inImage relative to the grid, in pixels
+    int const xOffset = inImage.getX0() - gridBBox.getX0();
+    int const yOffset = inImage.getY0() - gridBBox.getY0();
+    if ((xOffset < 0) || (yOffset < 0)
+        || (xOffset + width > gridBBox.getWidth()) || (yOffset + height > gridBBox.getHeight())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            "inImage is not contained in the bounding box of psfTileGrid");
+    }
+    if ((convolvedImage.getWidth() != width) || (convolvedImage.getHeight() != height)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            "convolvedImage not the same size as inImage");
+    }
+
+    std::vector<int> xBounds;
+    for (int ix = 0; ix < psfTileGrid.getNTilesX(); ++ix) {
+        xBounds.push_back(psfTileGrid.getTileBBox(ix, 0).getX0());
+    }
+    xBounds.push_back(gridBBox.getWidth());
+    std::vector<int> yBounds;
+    for (int iy = 0; iy < psfTileGrid.getNTilesY(); ++iy) {
+        yBounds.push_back(psfTileGrid.getTileBBox(0, iy).getY0());
+    }
+    yBounds.push_back(gridBBox.getHeight());
+    std::vector<BlendSegment> const xSegmentList = clipBlendSegmentList(
+        makeBlendSegmentList(xBounds, blendTiles), xOffset, width);
+    std::vector<BlendSegment> const ySegmentList = clipBlendSegmentList(
+        makeBlendSegmentList(yBounds, blendTiles), yOffset, height);
+
+    afwMath::Kernel::ConstPtr kernel0Ptr = psfTileGrid.getKernel(0, 0, useReflectedPsf);
+    int const kWidth = kernel0Ptr->getWidth();
+    int const kHeight = kernel0Ptr->getHeight();
+    int const haloLeft = kernel0Ptr->getCtrX();
+    int const haloRight = kWidth - 1 - haloLeft;
+    int const haloBottom = kernel0Ptr->getCtrY();
+    int const haloTop = kHeight - 1 - haloBottom;
+
+    int maxSegmentWidth = 0;
+    for (std::vector<BlendSegment>::const_iterator segIter = xSegmentList.begin();
+        segIter != xSegmentList.end(); ++segIter) {
+        maxSegmentWidth = std::max(maxSegmentWidth, segIter->end - segIter->start);
+    }
+    int maxSegmentHeight = 0;
+    for (std::vector<BlendSegment>::const_iterator segIter = ySegmentList.begin();
+        segIter != ySegmentList.end(); ++segIter) {
+        maxSegmentHeight = std::max(maxSegmentHeight, segIter->end - segIter->start);
+    }
+    int const scratchWidth = std::min(width, maxSegmentWidth + kWidth - 1);
+    int const scratchHeight = std::min(height, maxSegmentHeight + kHeight - 1);
+    if (convolutionMethod == AUTO_CONVOLUTION) {
+        convolutionMethod = chooseConvolutionMethod(scratchWidth, scratchHeight, *kernel0Ptr, fftSize);
+    }
+    if ((xSegmentList.size() == 1) && (ySegmentList.size() == 1)
+        && (xSegmentList[0].tile1 == xSegmentList[0].tile0) && (ySegmentList[0].tile1 == ySegmentList[0].tile0)) {
+        // one unblended tile covers inImage, so convolve straight into convolvedImage without a scratch image
+        afwMath::Kernel::ConstPtr kernelPtr =
+            psfTileGrid.getKernel(xSegmentList[0].tile0, ySegmentList[0].tile0, useReflectedPsf);
+        convolveMaskedImage(convolvedImage, inImage, *kernelPtr, false, convolutionMethod, fftSize);
+        return convolutionMethod;
+    }
+    OutMaskedImage scratchImage(scratchWidth, scratchHeight);
+
+    for (std::vector<BlendSegment>::const_iterator ySegIter = ySegmentList.begin();
+        ySegIter != ySegmentList.end(); ++ySegIter) {
+        int const grownY0 = std::max(0, ySegIter->start - haloBottom);
+        int const grownY1 = std::min(height, ySegIter->end + haloTop);   // one past the end
+        std::vector<int> yTileList(1, ySegIter->tile0);
+        if (ySegIter->tile1 != ySegIter->tile0) {
+            yTileList.push_back(ySegIter->tile1);
+        }
+
+        for (std::vector<BlendSegment>::const_iterator xSegIter = xSegmentList.begin();
+            xSegIter != xSegmentList.end(); ++xSegIter) {
+            int const grownX0 = std::max(0, xSegIter->start - haloLeft);
+            int const grownX1 = std::min(width, xSegIter->end + haloRight); // one past the end
+            std::vector<int> xTileList(1, xSegIter->tile0);
+            if (xSegIter->tile1 != xSegIter->tile0) {
+                xTileList.push_back(xSegIter->tile1);
+            }
+            bool const isBlended = (xTileList.size() > 1) || (yTileList.size() > 1);
+
+            afwImage::BBox const grownBBox(afwImage::PointI(grownX0, grownY0),
+                grownX1 - grownX0, grownY1 - grownY0);
+            InMaskedImage const inSubImage(inImage, grownBBox);
+            OutMaskedImage scratchSubImage(scratchImage,
+                afwImage::BBox(afwImage::PointI(0, 0), grownBBox.getWidth(), grownBBox.getHeight()));
+
+            if (isBlended) {
+                for (int y = ySegIter->start; y < ySegIter->end; ++y) {
+                    for (OutXIterator outPtr = convolvedImage.x_at(xSegIter->start, y),
+                        outEnd = convolvedImage.x_at(xSegIter->end, y); outPtr != outEnd; ++outPtr) {
+                        outPtr.image() = 0;
+                        outPtr.mask() = 0;
+                        outPtr.variance() = 0;
+                    }
+                }
+            }
+
+            for (std::vector<int>::const_iterator yTileIter = yTileList.begin();
+                yTileIter != yTileList.end(); ++yTileIter) {
+                for (std::vector<int>::const_iterator xTileIter = xTileList.begin();
+                    xTileIter != xTileList.end(); ++xTileIter) {
+                    afwMath::Kernel::ConstPtr kernelPtr =
+                        psfTileGrid.getKernel(*xTileIter, *yTileIter, useReflectedPsf);
+                    // the kernel images are already normalized, if requested
+                    convolveMaskedImage(scratchSubImage, inSubImage, *kernelPtr, false,
+                        convolutionMethod, fftSize);
+
+                    for (int y = ySegIter->start; y < ySegIter->end; ++y) {
+                        double const yWeight = ySegIter->getWeight(*yTileIter, y);
+                        OutXIterator outPtr = convolvedImage.x_at(xSegIter->start, y);
+                        OutXIterator scratchPtr = scratchSubImage.x_at(xSegIter->start - grownX0, y - grownY0);
+                        for (int x = xSegIter->start; x < xSegIter->end; ++x, ++outPtr, ++scratchPtr) {
+                            if (!isBlended) {
+                                outPtr.image() = scratchPtr.image();
+                                outPtr.mask() = scratchPtr.mask();
+                                outPtr.variance() = scratchPtr.variance();
+                                continue;
+                            }
+                            double const weight = yWeight * xSegIter->getWeight(*xTileIter, x);
+                            if (weight <= 0) {
+                                continue;
+                            }
+                            outPtr.image() += static_cast<OutPixelT>(weight * scratchPtr.image());
+                            outPtr.mask() |= scratchPtr.mask();
+                            outPtr.variance() += static_cast<afwImage::VariancePixel>(
+                                weight * scratchPtr.variance());
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return convolutionMethod;
+}
+
+//
+// Explicit instantiations
+//
+#define INSTANTIATE(OUTPIXELT, INPIXELT) \
+    template coaddKaiser::ConvolutionMethod coaddKaiser::convolveWithPsfTiles( \
+        afwImage::MaskedImage<OUTPIXELT, afwImage::MaskPixel, afwImage::VariancePixel> &, \
+        afwImage::MaskedImage<INPIXELT, afwImage::MaskPixel, afwImage::VariancePixel> const &, \
+        coaddKaiser::PsfTileGrid const &, bool, bool, coaddKaiser::ConvolutionMethod, int);
+
+INSTANTIATE(double, float);
+INSTANTIATE(double, double);
+INSTANTIATE(float, float);
@@ -0,0 +1,373 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Spatially resolved sigma squared
+*
+* @file
+*/
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "boost/format.hpp"
+#include "boost/ref.hpp"
+#include "boost/thread.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/SigmaSqMap.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    typedef boost::shared_ptr<coaddKaiser::BinapproxSketch> BinapproxSketchPtr;
+
+    /**
+     * \brief Set the bin range of the sketch of a cell from the variance of a sample spread over the part
+     * of the cell in a masked image
+     *
+     * The sample is the unmasked pixels on a grid of about CellSampleSize points, so a gradient across
+     * the cell is represented. If the sample has fewer than two values or they are all equal, the range
+     * is left to be set from the first values added, as usual.
+     */
+    template <typename MaskedImageT>
+    void setCellPrior(
+        coaddKaiser::BinapproxSketch &sketch,   ///< sketch of the cell; its range must not be set
+        MaskedImageT const &maskedImage,        ///< masked image
+        int xBegin, ///< x of first column of the cell in maskedImage
+        int xEnd,   ///< x of column just past the cell
+        int yBegin, ///< y of first row of the cell in maskedImage
+        int yEnd    ///< y of row just past the cell
+    ) {
+        double const nPixels = static_cast<double>(xEnd - xBegin) * static_cast<double>(yEnd - yBegin);
+        int const sampleSize = coaddKaiser::SigmaSqMap::CellSampleSize;
+        int const step = std::max(1, static_cast<int>(std::sqrt(nPixels / static_cast<double>(sampleSize))));
+        int count = 0;
+        double mean = 0;
+        double m2 = 0;
+        for (int y = yBegin + (step / 2); y < yEnd; y += step) {
+            for (int x = xBegin + (step / 2); x < xEnd; x += step) {
+                typename MaskedImageT::x_iterator const ptr = maskedImage.x_at(x, y);
+                double const value = ptr.variance();
+                if ((ptr.mask() != 0) || !(value - value == 0)) {
+                    continue;
+                }
+                ++count;
+                double const delta = value - mean;
+                mean += delta / static_cast<double>(count);
+                m2 += delta * (value - mean);
+            }
+        }
+        if ((count > 1) && (m2 > 0)) {
+            sketch.setPrior(mean, std::sqrt(m2 / static_cast<double>(count - 1)));
+        }
+    }
+
+    /**
+     * \brief Histogram the variance of the unmasked pixels of some rows of cells of a masked image
+     *
+     * Each thread handles every nThreads'th row of cells (starting at firstCellRow), so no two threads
+     * touch the same histogram.
+     */
+    template <typename PixelT>
+    struct CellRowHistogrammer {
+        typedef afwImage::MaskedImage<PixelT, afwImage::MaskPixel, afwImage::VariancePixel> MaskedImageT;
+
+        MaskedImageT const &maskedImage;
+        std::vector<int> const &xBounds;    ///< x bounds of cells, relative to maskedImage
+        std::vector<int> const &yBounds;    ///< y bounds of cells, relative to maskedImage
+        std::vector<BinapproxSketchPtr> &sketchList;
+        std::vector<int> &countList;
+        int firstCellRow;
+        int nThreads;
+
+        CellRowHistogrammer(
+            MaskedImageT const &maskedImage_,
+            std::vector<int> const &xBounds_,
+            std::vector<int> const &yBounds_,
+            std::vector<BinapproxSketchPtr> &sketchList_,
+            std::vector<int> &countList_,
+            int firstCellRow_,
+            int nThreads_
+        ) :
+            maskedImage(maskedImage_), xBounds(xBounds_), yBounds(yBounds_), sketchList(sketchList_),
+            countList(countList_), firstCellRow(firstCellRow_), nThreads(nThreads_)
+        {}
+
+        void operator()() {
+            int const nCellsX = static_cast<int>(xBounds.size()) - 1;
+            int const nCellsY = static_cast<int>(yBounds.size()) - 1;
+            for (int iy = firstCellRow; iy < nCellsY; iy += nThreads) {
+                int const yBegin = std::max(0, yBounds[iy]);
+                int const yEnd = std::min(maskedImage.getHeight(), yBounds[iy + 1]);
+                for (int ix = 0; ix < nCellsX; ++ix) {
+                    int const xBegin = std::max(0, xBounds[ix]);
+                    int const xEnd = std::min(maskedImage.getWidth(), xBounds[ix + 1]);
+                    if ((xBegin >= xEnd) || (yBegin >= yEnd)) {
+                        continue;
+                    }
+                    coaddKaiser::BinapproxSketch &sketch = *sketchList[(iy * nCellsX) + ix];
+                    if (!sketch.isBinned()) {
+                        setCellPrior(sketch, maskedImage, xBegin, xEnd, yBegin, yEnd);
+                    }
+                    int nUnmasked = 0;
+                    for (int y = yBegin; y < yEnd; ++y) {
+                        for (typename MaskedImageT::x_iterator ptr = maskedImage.x_at(xBegin, y),
+                            end = maskedImage.x_at(xEnd, y); ptr != end; ++ptr) {
+                            if (ptr.mask() == 0) {
+                                sketch.addValue(ptr.variance());
+                                ++nUnmasked;
+                            }
+                        }
+                    }
+                    countList[(iy * nCellsX) + ix] += nUnmasked;
+                }
+            }
+        }
+    };
+}
+
+/**
+ * \brief Construct an empty SigmaSqMap
+ *
+ * The image is divided into nCellsX by nCellsY cells of nearly equal size.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if nCellsX or nCellsY < 1
+ * or larger than the bbox width or height.
+ *
+ * \ingroup coadd::kaiser
+ */
+coaddKaiser::SigmaSqMap::SigmaSqMap(
+    afwImage::BBox const &bbox, ///< bounding box of image, in parent pixel coordinates
+    int nCellsX,                ///< number of cells in x
+    int nCellsY                 ///< number of cells in y
+) :
+    _bbox(bbox),
+    _xBounds(),
+    _yBounds(),
+    _sketchList(),
+    _countList(),
+    _sigmaSqList()
+{
+    if ((nCellsX < 1) || (nCellsY < 1)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("nCellsX=%d and nCellsY=%d must both be >= 1") % nCellsX % nCellsY).str());
+    }
+    if ((nCellsX > bbox.getWidth()) || (nCellsY > bbox.getHeight())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("%d x %d cells will not fit in a %d x %d image")
+                % nCellsX % nCellsY % bbox.getWidth() % bbox.getHeight()).str());
+    }
+    for (int i = 0; i <= nCellsX; ++i) {
+        _xBounds.push_back((i * bbox.getWidth()) / nCellsX);
+    }
+    for (int i = 0; i <= nCellsY; ++i) {
+        _yBounds.push_back((i * bbox.getHeight()) / nCellsY);
+    }
+    for (int i = 0; i < nCellsX * nCellsY; ++i) {
+        _sketchList.push_back(BinapproxSketchPtr(new BinapproxSketch(CellNBins, CellSampleSize)));
+    }
+    _countList.resize(nCellsX * nCellsY, 0);
+}
+
+/**
+ * \brief Add the variance of the unmasked pixels (those with no mask bits set) of a masked image
+ *
+ * maskedImage may be any part of the image covered by the map (e.g. a horizontal strip); its xy0
+ * is used to locate it on the grid. Each pixel should be added only once.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if maskedImage is not contained in the bounding box
+ * of the map
+ * \throw lsst::pex::exceptions::LogicErrorException if finish has been called
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+void coaddKaiser::SigmaSqMap::addMaskedImage(
+    afwImage::MaskedImage<PixelT, afwImage::MaskPixel, afwImage::VariancePixel> const &maskedImage,
+        ///< masked image to add
+    int nThreads    ///< number of threads; rows of cells are divided among them
+) {
+    if (isFinished()) {
+        throw LSST_EXCEPT(pexExcept::LogicErrorException, "finish has already been called");
+    }
+    int const x0 = maskedImage.getX0() - _bbox.getX0();
+    int const y0 = maskedImage.getY0() - _bbox.getY0();
+    if ((x0 < 0) || (y0 < 0) || (x0 + maskedImage.getWidth() > _bbox.getWidth())
+        || (y0 + maskedImage.getHeight() > _bbox.getHeight())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("maskedImage (%d, %d) - (%d, %d) is not contained in (%d, %d) - (%d, %d)") %
+            maskedImage.getX0() % maskedImage.getY0() %
+            (maskedImage.getX0() + maskedImage.getWidth() - 1) %
+            (maskedImage.getY0() + maskedImage.getHeight() - 1) %
+            _bbox.getX0() % _bbox.getY0() % _bbox.getX1() % _bbox.getY1()).str());
+    }
+
+    // shift the cell bounds to be relative to maskedImage
+    std::vector<int> xBounds(_xBounds);
+    for (std::vector<int>::iterator boundIter = xBounds.begin(); boundIter != xBounds.end(); ++boundIter) {
+        *boundIter -= x0;
+    }
+    std::vector<int> yBounds(_yBounds);
+    for (std::vector<int>::iterator boundIter = yBounds.begin(); boundIter != yBounds.end(); ++boundIter) {
+        *boundIter -= y0;
+    }
+    int nCellRows = 0;  // number of rows of cells that overlap maskedImage
+    for (int iy = 0; iy < getNCellsY(); ++iy) {
+        if ((yBounds[iy] < maskedImage.getHeight()) && (yBounds[iy + 1] > 0)) {
+            ++nCellRows;
+        }
+    }
+
+    int const nThreadsUsed = std::max(1, std::min(nThreads, nCellRows));
+    if (nThreadsUsed == 1) {
+        CellRowHistogrammer<PixelT> histogrammer(maskedImage, xBounds, yBounds, _sketchList, _countList, 0, 1);
+        histogrammer();
+        return;
+    }
+    std::vector<CellRowHistogrammer<PixelT> > histogrammerList;
+    for (int i = 0; i < nThreadsUsed; ++i) {
+        histogrammerList.push_back(CellRowHistogrammer<PixelT>(maskedImage, xBounds, yBounds,
+            _sketchList, _countList, i, nThreadsUsed));
+    }
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nThreadsUsed; ++i) {
+        threadGroup.create_thread(boost::ref(histogrammerList[i]));
+    }
+    threadGroup.join_all();
+}
+
+/**
+ * \brief Compute the median of each cell and free the histograms
+ *
+ * Cells with no unmasked pixels, whose median is not positive, or whose median is outside the binned range
+ * of its histogram, are given the median sigmaSq of the other cells.
+ *
+ * \throw lsst::pex::exceptions::RuntimeErrorException if no cell has a positive median
+ * \throw lsst::pex::exceptions::LogicErrorException if finish has already been called
+ *
+ * \ingroup coadd::kaiser
+ */
+void coaddKaiser::SigmaSqMap::finish() {
+    if (isFinished()) {
+        throw LSST_EXCEPT(pexExcept::LogicErrorException, "finish has already been called");
+    }
+    int const nCells = static_cast<int>(_sketchList.size());
+    std::vector<double> sigmaSqList(nCells, 0);
+    std::vector<double> goodSigmaSqList;
+    for (int i = 0; i < nCells; ++i) {
+        if (_sketchList[i]->getCount() > 0) {
+            try {
+                sigmaSqList[i] = _sketchList[i]->getMedian();
+            } catch (pexExcept::RangeErrorException &) {
+                continue;   // the median is outside the binned range
+            }
+            if (sigmaSqList[i] > 0) {
+                goodSigmaSqList.push_back(sigmaSqList[i]);
+            }
+        }
+    }
+    if (goodSigmaSqList.empty()) {
+        throw LSST_EXCEPT(pexExcept::RuntimeErrorException, "No cell has unmasked pixels with positive variance");
+    }
+    std::vector<double>::iterator midIter = goodSigmaSqList.begin() + (goodSigmaSqList.size() / 2);
+    std::nth_element(goodSigmaSqList.begin(), midIter, goodSigmaSqList.end());
+    double const fillSigmaSq = *midIter;
+    for (int i = 0; i < nCells; ++i) {
+        if (!(sigmaSqList[i] > 0)) {
+            sigmaSqList[i] = fillSigmaSq;
+        }
+    }
+    _sigmaSqList.swap(sigmaSqList);
+    _sketchList.clear();
+}
+
+/**
+ * \brief Get the bounding box of a cell, relative to the lower left corner of the image
+ *
+ * \throw lsst::pex::exceptions::RangeErrorException if ix or iy is out of range
+ *
+ * \ingroup coadd::kaiser
+ */
+afwImage::BBox coaddKaiser::SigmaSqMap::getCellBBox(
+    int ix, ///< x index of cell
+    int iy  ///< y index of cell
+) const {
+    getCellIndex(ix, iy); // check range
+    return afwImage::BBox(afwImage::PointI(_xBounds[ix], _yBounds[iy]),
+        _xBounds[ix + 1] - _xBounds[ix], _yBounds[iy + 1] - _yBounds[iy]);
+}
+
+/**
+ * \brief Get sigma squared of a cell: the median variance of its unmasked pixels
+ *
+ * \throw lsst::pex::exceptions::RangeErrorException if ix or iy is out of range
+ * \throw lsst::pex::exceptions::LogicErrorException if finish has not been called
+ *
+ * \ingroup coadd::kaiser
+ */
+double coaddKaiser::SigmaSqMap::getCellSigmaSq(
+    int ix, ///< x index of cell
+    int iy  ///< y index of cell
+) const {
+    int const ind = getCellIndex(ix, iy);
+    if (!isFinished()) {
+        throw LSST_EXCEPT(pexExcept::LogicErrorException, "finish has not been called");
+    }
+    return _sigmaSqList[ind];
+}
+
+/**
+ * \brief Get the number of unmasked pixels added to a cell
+ *
+ * \throw lsst::pex::exceptions::RangeErrorException if ix or iy is out of range
+ *
+ * \ingroup coadd::kaiser
+ */
+int coaddKaiser::SigmaSqMap::getCellCount(
+    int ix, ///< x index of cell
+    int iy  ///< y index of cell
+) const {
+    return _countList[getCellIndex(ix, iy)];
+}
+
+int coaddKaiser::SigmaSqMap::getCellIndex(int ix, int iy) const {
+    if ((ix < 0) || (ix >= getNCellsX()) || (iy < 0) || (iy >= getNCellsY())) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException,
+            (boost::format("cell index (%d, %d) out of range [0-%d, 0-%d]")
+                % ix % iy % (getNCellsX() - 1) % (getNCellsY() - 1)).str());
+    }
+    return (iy * getNCellsX()) + ix;
+}
+
+//
+// Explicit instantiations
+//
+template void coaddKaiser::SigmaSqMap::addMaskedImage<float>(
+    afwImage::MaskedImage<float, afwImage::MaskPixel, afwImage::VariancePixel> const &, int);
+template void coaddKaiser::SigmaSqMap::addMaskedImage<double>(
+    afwImage::MaskedImage<double, afwImage::MaskPixel, afwImage::VariancePixel> const &, int);
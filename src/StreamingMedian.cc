@@ -0,0 +1,131 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Single-pass approximate median of a stream of values.
+*
+* @file
+*/
+#include <algorithm>
+#include <cstring>
+
+#include "boost/format.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/coadd/kaiser/StreamingMedian.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    int const NBits = 32;
+    int const MinBinShift = 8;      ///< smallest binShift: 16 M bins
+    int const MaxBinShift = 23;     ///< largest binShift: one bin per power of 2 (all mantissa bits ignored)
+    boost::uint32_t const SignBit = 0x80000000u;
+}
+
+/**
+ * \brief Construct a StreamingMedian
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if binShift < 8 (more than 16 M bins)
+ * or binShift > 23 (bins wider than a factor of 2)
+ */
+coaddKaiser::StreamingMedian::StreamingMedian(
+    int binShift    ///< number of low bits of the float representation ignored; the bin width
+                    ///< is about 2^(binShift - 23) of the value
+) :
+    _binShift(binShift),
+    _binCounts(),
+    _count(0)
+{
+    if ((binShift < MinBinShift) || (binShift > MaxBinShift)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("binShift=%d not in range [%d, %d]") % binShift % MinBinShift % MaxBinShift).str());
+    }
+    _binCounts.resize(1 << (NBits - binShift), 0);
+}
+
+/**
+ * \brief Get the approximate median of the values added so far
+ *
+ * \throw lsst::pex::exceptions::RuntimeErrorException if no values have been added
+ */
+double coaddKaiser::StreamingMedian::getMedian() const {
+    if (_count == 0) {
+        throw LSST_EXCEPT(pexExcept::RuntimeErrorException, "No values have been added");
+    }
+    // find the bin containing the value of rank count/2, then interpolate within that bin
+    double const midRank = 0.5 * static_cast<double>(_count);
+    boost::uint64_t countBelow = 0;
+    int const nBins = static_cast<int>(_binCounts.size());
+    for (int bin = 0; bin < nBins; ++bin) {
+        boost::uint64_t const binCount = _binCounts[bin];
+        if (static_cast<double>(countBelow + binCount) >= midRank) {
+            double const frac = (midRank - static_cast<double>(countBelow)) / static_cast<double>(binCount);
+            double const lowerEdge = getBinLowerEdge(bin);
+            double const upperEdge = (bin + 1 < nBins) ? getBinLowerEdge(bin + 1) : lowerEdge;
+            return lowerEdge + (frac * (upperEdge - lowerEdge));
+        }
+        countBelow += binCount;
+    }
+    // cannot get here, since the bin counts sum to _count
+    throw LSST_EXCEPT(pexExcept::LogicErrorException, "Median not found; bin counts are corrupt");
+}
+
+/**
+ * \brief Discard all values
+ */
+void coaddKaiser::StreamingMedian::reset() {
+    std::fill(_binCounts.begin(), _binCounts.end(), 0);
+    _count = 0;
+}
+
+/**
+ * \brief Get the bin index of a value
+ *
+ * The bits of an IEEE float are mapped to an unsigned integer that increases monotonically with the value,
+ * and the low binShift bits are discarded.
+ */
+int coaddKaiser::StreamingMedian::getBin(double value) const {
+    float const floatValue = static_cast<float>(value);
+    boost::uint32_t bits;
+    std::memcpy(&bits, &floatValue, sizeof(bits));
+    bits = (bits & SignBit) ? ~bits : (bits | SignBit);
+    return static_cast<int>(bits >> _binShift);
+}
+
+/**
+ * \brief Get the smallest value that falls in a bin (the inverse of getBin)
+ */
+double coaddKaiser::StreamingMedian::getBinLowerEdge(int bin) const {
+    boost::uint32_t bits = static_cast<boost::uint32_t>(bin) << _binShift;
+    if (bits & SignBit) {
+        bits &= ~SignBit;
+    } else {
+        bits = ~bits;
+    }
+    float floatValue;
+    std::memcpy(&floatValue, &bits, sizeof(bits));
+    return static_cast<double>(floatValue);
+}
@@ -0,0 +1,67 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Sinks for horizontal strips of a blurred exposure.
+*
+* @file
+*/
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/StripSink.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+template <typename PixelT>
+coaddKaiser::MaskedImageStripSink<PixelT>::MaskedImageStripSink(
+    MaskedImageT &maskedImage   ///< masked image to fill; xy0 must match the exposure being blurred
+) :
+    _maskedImage(maskedImage)
+{}
+
+/**
+ * \brief Copy a strip into the masked image
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if the strip does not fit in the masked image
+ */
+template <typename PixelT>
+void coaddKaiser::MaskedImageStripSink<PixelT>::processStrip(MaskedImageT const &strip) {
+    int const x0 = strip.getX0() - _maskedImage.getX0();
+    int const y0 = strip.getY0() - _maskedImage.getY0();
+    if ((x0 < 0) || (y0 < 0) || (x0 + strip.getWidth() > _maskedImage.getWidth())
+        || (y0 + strip.getHeight() > _maskedImage.getHeight())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException, "strip does not fit in masked image");
+    }
+    MaskedImageT subImage(_maskedImage,
+        afwImage::BBox(afwImage::PointI(x0, y0), strip.getWidth(), strip.getHeight()));
+    subImage <<= strip;
+}
+
+//
+// Explicit instantiations
+//
+template class coaddKaiser::MaskedImageStripSink<float>;
+template class coaddKaiser::MaskedImageStripSink<double>;
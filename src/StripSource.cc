@@ -0,0 +1,126 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Sources of horizontal strips of a science exposure.
+*
+* @file
+*/
+#include "boost/format.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/daf/base.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/StripSource.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    /**
+     * \brief Check that a strip is within the bounding box of a strip source
+     *
+     * \throw lsst::pex::exceptions::InvalidParameterException if the strip is empty or out of range
+     */
+    void assertStripInBBox(int y0, int height, afwImage::BBox const &bbox) {
+        if ((y0 < 0) || (height < 1) || (y0 + height > bbox.getHeight())) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+                (boost::format("strip y0=%d, height=%d is not within an exposure of height %d")
+                    % y0 % height % bbox.getHeight()).str());
+        }
+    }
+}
+
+coaddKaiser::ExposureStripSource::ExposureStripSource(
+    ExposureF const &exposure   ///< exposure; the pixels are shared, not copied
+) :
+    _exposure(exposure)
+{}
+
+afwImage::BBox coaddKaiser::ExposureStripSource::getBBox() const {
+    MaskedImageF const maskedImage = _exposure.getMaskedImage();
+    return afwImage::BBox(maskedImage.getXY0(), maskedImage.getWidth(), maskedImage.getHeight());
+}
+
+afwImage::Wcs::Ptr coaddKaiser::ExposureStripSource::getWcs() const {
+    if (!_exposure.hasWcs()) {
+        return afwImage::Wcs::Ptr();
+    }
+    return _exposure.getWcs();
+}
+
+coaddKaiser::StripSource::MaskedImageF coaddKaiser::ExposureStripSource::readStrip(int y0, int height) {
+    MaskedImageF const maskedImage = _exposure.getMaskedImage();
+    assertStripInBBox(y0, height, getBBox());
+    return MaskedImageF(maskedImage, afwImage::BBox(afwImage::PointI(0, y0), maskedImage.getWidth(), height));
+}
+
+/**
+ * \brief Construct a FitsStripSource
+ *
+ * Reads the header of the image file to get the size of the exposure, and the first row of the exposure
+ * to get the WCS.
+ */
+coaddKaiser::FitsStripSource::FitsStripSource(
+    std::string const &baseName,    ///< base name of exposure files (without _img.fits, etc.)
+    int hdu                         ///< HDU to read
+) :
+    _baseName(baseName),
+    _hdu(hdu),
+    _bbox(),
+    _wcsPtr()
+{
+    lsst::daf::base::PropertySet::Ptr metadataPtr = afwImage::readMetadata(baseName + "_img.fits", hdu);
+    int const width = metadataPtr->getAsInt("NAXIS1");
+    int const height = metadataPtr->getAsInt("NAXIS2");
+    int x0 = 0;
+    int y0 = 0;
+    if (metadataPtr->exists("LTV1")) {
+        x0 = -metadataPtr->getAsInt("LTV1");
+        y0 = -metadataPtr->getAsInt("LTV2");
+    }
+    _bbox = afwImage::BBox(afwImage::PointI(x0, y0), width, height);
+    afwImage::Exposure<float, afwImage::MaskPixel, afwImage::VariancePixel> const firstRow(
+        baseName, hdu, afwImage::BBox(afwImage::PointI(0, 0), width, 1));
+    if (firstRow.hasWcs()) {
+        _wcsPtr = firstRow.getWcs();
+    }
+}
+
+afwImage::BBox coaddKaiser::FitsStripSource::getBBox() const {
+    return _bbox;
+}
+
+afwImage::Wcs::Ptr coaddKaiser::FitsStripSource::getWcs() const {
+    return _wcsPtr;
+}
+
+coaddKaiser::StripSource::MaskedImageF coaddKaiser::FitsStripSource::readStrip(int y0, int height) {
+    assertStripInBBox(y0, height, _bbox);
+    MaskedImageF strip(_baseName, _hdu, lsst::daf::base::PropertySet::Ptr(),
+        afwImage::BBox(afwImage::PointI(0, y0), _bbox.getWidth(), height));
+    strip.setXY0(afwImage::PointI(_bbox.getX0(), _bbox.getY0() + y0));
+    return strip;
+}
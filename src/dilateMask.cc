@@ -0,0 +1,224 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief OR a mask over a rectangular footprint at a cost nearly independent of the footprint size.
+*
+* Each output pixel is the OR of the input mask over a width x height rectangle, which is what convolution
+* does to the mask with a kernel that has no zero pixels. The OR is separable (a pass along each row
+* followed by a pass along each column) and each pass uses the van Herk/Gil-Werman method, which takes
+* about three ORs per pixel whatever the window size. All mask planes are processed at once,
+* since OR acts on each bit of a mask pixel independently.
+*
+* The output is computed in bands of at least DilateMaskBandHeight rows. The row pass is run once
+* on each full input row; the rows it shares with the next band are kept rather than recomputed.
+* The column pass of a band must also read the height - 1 input rows that follow the band, so it costs
+* (bandHeight + height - 1) / bandHeight times as much as a single pass. Bands are at least 4 (height - 1)
+* rows tall, so this factor is at most 1.25, and the total is at most about seven ORs per pixel.
+* The column pass runs along rows of the band buffer (one van Herk step for a whole row at a time),
+* so all memory access is sequential. Rows (and bands) whose input pixels all have the same mask value
+* (most often all clean) are filled with that value without ORing.
+*
+* @file
+*/
+#include <algorithm>
+#include <vector>
+
+#include "boost/format.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/dilateMask.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+// local functions and classes
+namespace {
+
+    /**
+     * \brief OR each run of window consecutive values of a 1-dimensional array
+     *
+     * Sets outPtr[i * outStride] = OR of inPtr[(i + k) * inStride] for k = 0, ..., window - 1,
+     * for i = 0, ..., n - window.
+     *
+     * Uses the van Herk/Gil-Werman method: the array is split into blocks of window values,
+     * so each run is the OR of a suffix of one block and a prefix of the next.
+     */
+    void orRuns(
+        afwImage::MaskPixel *outPtr,        ///< output; n + 1 - window values are set
+        int outStride,                      ///< stride of output
+        afwImage::MaskPixel const *inPtr,   ///< input; n values
+        int inStride,                       ///< stride of input
+        int n,                              ///< number of input values
+        int window,                         ///< number of values to OR together
+        std::vector<afwImage::MaskPixel> &prefix,   ///< scratch buffer
+        std::vector<afwImage::MaskPixel> &suffix    ///< scratch buffer
+    ) {
+        prefix.resize(n);
+        suffix.resize(n);
+        for (int i = 0; i < n; ++i) {
+            afwImage::MaskPixel const val = inPtr[i * inStride];
+            prefix[i] = (i % window == 0) ? val : (prefix[i - 1] | val);
+        }
+        for (int i = n - 1; i >= 0; --i) {
+            afwImage::MaskPixel const val = inPtr[i * inStride];
+            suffix[i] = ((i == n - 1) || ((i + 1) % window == 0)) ? val : (suffix[i + 1] | val);
+        }
+        for (int i = 0; i + window <= n; ++i) {
+            outPtr[i * outStride] = suffix[i] | prefix[i + window - 1];
+        }
+    }
+
+} // anonymous namespace
+
+/**
+ * \brief Set each pixel of a mask to the OR of an input mask over a rectangle
+ *
+ * outMask(x, y) = OR of inMask(x - ctrX + i, y - ctrY + j) for 0 <= i < width, 0 <= j < height;
+ * this matches the mask computed by lsst::afw::math::convolve for a width x height kernel with center
+ * (ctrX, ctrY) and no zero pixels. Output pixels for which the rectangle extends off the input mask
+ * (the edge pixels of a convolved image) are not changed.
+ *
+ * Working memory is about 2 (bandHeight + height) rows of the mask.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if outMask is not the same size as inMask,
+ * width or height < 1, or the center is not inside the rectangle
+ *
+ * \ingroup coadd::kaiser
+ */
+void coaddKaiser::dilateMask(
+    afwImage::Mask<afwImage::MaskPixel> &outMask,       ///< output mask; must be the same size as inMask
+    afwImage::Mask<afwImage::MaskPixel> const &inMask,  ///< input mask
+    int width,      ///< width of rectangle
+    int height,     ///< height of rectangle
+    int ctrX,       ///< x index of center of rectangle
+    int ctrY        ///< y index of center of rectangle
+) {
+    typedef afwImage::Mask<afwImage::MaskPixel>::x_iterator XIterator;
+
+    if ((outMask.getWidth() != inMask.getWidth()) || (outMask.getHeight() != inMask.getHeight())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException, "outMask not the same size as inMask");
+    }
+    if ((width < 1) || (height < 1)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("width = %d and height = %d must both be >= 1") % width % height).str());
+    }
+    if ((ctrX < 0) || (ctrX >= width) || (ctrY < 0) || (ctrY >= height)) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("center (%d, %d) not in %d x %d rectangle") % ctrX % ctrY % width % height).str());
+    }
+    int const inWidth = inMask.getWidth();
+    int const goodWidth = inWidth + 1 - width;
+    int const goodHeight = inMask.getHeight() + 1 - height;
+    if ((goodWidth < 1) || (goodHeight < 1)) {
+        return;
+    }
+    int const bandHeight = std::max(DilateMaskBandHeight, 4 * (height - 1));
+    int const maxInRows = bandHeight + height - 1;
+
+    std::vector<afwImage::MaskPixel> inRow(inWidth);
+    std::vector<int> rowValueList(maxInRows);       // value of each input row of a band, or -1 if it varies
+    std::vector<afwImage::MaskPixel> rowData;       // row pass of the input rows of a band
+    std::vector<afwImage::MaskPixel> prefixData;    // prefix ORs of rowData along each column
+    std::vector<afwImage::MaskPixel> suffixRow(goodWidth);  // suffix ORs of rowData along each column
+    std::vector<afwImage::MaskPixel> prefix;
+    std::vector<afwImage::MaskPixel> suffix;
+    rowData.reserve(maxInRows * goodWidth);
+    for (int gy0 = 0; gy0 < goodHeight; gy0 += bandHeight) {
+        int const nOutRows = std::min(bandHeight, goodHeight - gy0);
+        int const nInRows = nOutRows + height - 1;
+
+        // pass along each row; the last height - 1 input rows of the previous (full) band
+        // are the first input rows of this band, so move them rather than recompute them
+        int nKeptRows = 0;
+        if (gy0 > 0) {
+            nKeptRows = height - 1;
+            std::copy(rowData.begin() + ((maxInRows - nKeptRows) * goodWidth),
+                rowData.begin() + (maxInRows * goodWidth), rowData.begin());
+            std::copy(rowValueList.begin() + (maxInRows - nKeptRows), rowValueList.end(), rowValueList.begin());
+        }
+        rowData.resize(nInRows * goodWidth);
+        for (int row = nKeptRows; row < nInRows; ++row) {
+            XIterator inPtr = inMask.row_begin(gy0 + row);
+            afwImage::MaskPixel orBits = 0;
+            afwImage::MaskPixel andBits = static_cast<afwImage::MaskPixel>(~0);
+            for (int x = 0; x < inWidth; ++x, ++inPtr) {
+                inRow[x] = *inPtr;
+                orBits |= *inPtr;
+                andBits &= *inPtr;
+            }
+            if (orBits == andBits) {
+                // every pixel of the row has the same value (most often 0), and so does the result
+                std::fill(rowData.begin() + (row * goodWidth), rowData.begin() + ((row + 1) * goodWidth), orBits);
+                rowValueList[row] = orBits;
+            } else {
+                orRuns(&rowData[row * goodWidth], 1, &inRow[0], 1, inWidth, width, prefix, suffix);
+                rowValueList[row] = -1;
+            }
+        }
+        if ((rowValueList[0] >= 0)
+            && (std::count(rowValueList.begin(), rowValueList.begin() + nInRows, rowValueList[0]) == nInRows)) {
+            // every input pixel of the band has the same value, and so does every output pixel
+            for (int row = 0; row < nOutRows; ++row) {
+                XIterator outPtr = outMask.x_at(ctrX, ctrY + gy0 + row);
+                std::fill(outPtr, outPtr + goodWidth, static_cast<afwImage::MaskPixel>(rowValueList[0]));
+            }
+            continue;
+        }
+
+        // pass along each column (van Herk/Gil-Werman, as in orRuns), a whole row at a time
+        prefixData.resize(nInRows * goodWidth);
+        for (int row = 0; row < nInRows; ++row) {
+            afwImage::MaskPixel const *inPtr = &rowData[row * goodWidth];
+            afwImage::MaskPixel *prefixPtr = &prefixData[row * goodWidth];
+            if (row % height == 0) {
+                std::copy(inPtr, inPtr + goodWidth, prefixPtr);
+            } else {
+                afwImage::MaskPixel const *prevPtr = prefixPtr - goodWidth;
+                for (int x = 0; x < goodWidth; ++x) {
+                    prefixPtr[x] = prevPtr[x] | inPtr[x];
+                }
+            }
+        }
+        for (int row = nInRows - 1; row >= 0; --row) {
+            afwImage::MaskPixel const *inPtr = &rowData[row * goodWidth];
+            if ((row == nInRows - 1) || ((row + 1) % height == 0)) {
+                std::copy(inPtr, inPtr + goodWidth, suffixRow.begin());
+            } else {
+                for (int x = 0; x < goodWidth; ++x) {
+                    suffixRow[x] |= inPtr[x];
+                }
+            }
+            if (row < nOutRows) {
+                afwImage::MaskPixel const *prefixPtr = &prefixData[(row + height - 1) * goodWidth];
+                XIterator outPtr = outMask.x_at(ctrX, ctrY + gy0 + row);
+                for (int x = 0; x < goodWidth; ++x, ++outPtr) {
+                    *outPtr = suffixRow[x] | prefixPtr[x];
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,1086 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief FFT-based and separable convolution of masked images.
+*
+* The image is convolved in tiles using the overlap-save method: each tile of the output is computed from
+* the matching patch of the input plus a halo of the kernel size, so memory use is bounded by the FFT size
+* rather than the image size. A spatially varying kernel is evaluated once at the center of each tile.
+*
+* Kernels that are sums of a few separable terms (e.g. Gaussians and double Gaussians) may instead be
+* convolved as a pass along each row followed by a pass along each column, which costs
+* O(kernel width + kernel height) per pixel per term rather than O(kernel width * kernel height).
+*
+* Both match lsst::afw::math::convolve with copyEdge = false:
+* - image = sum of input image * kernel
+* - variance = sum of input variance * kernel^2
+* - mask = OR of the input mask over all pixels at which the kernel is nonzero
+*   (computed by dilateMask, whose cost barely depends on kernel size, if the kernel has no zero pixels)
+* - edge pixels (those for which the kernel extends off the input image) have image = NaN,
+*   mask = EDGE and variance = infinity
+*
+* @file
+*/
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "boost/format.hpp"
+#include "boost/noncopyable.hpp"
+#include "gsl/gsl_errno.h"
+#include "gsl/gsl_fft_complex.h"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/afw/math.h"
+#include "lsst/coadd/kaiser/dilateMask.h"
+#include "lsst/coadd/kaiser/fftConvolve.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwMath = lsst::afw::math;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+// local functions and classes
+namespace {
+
+    int const DefaultFftSize = 256; ///< default FFT size along each axis, if not specified by the user
+
+    /**
+     * Approximate cost of FFT convolution per FFT pixel, divided by log2(number of FFT pixels),
+     * in units of the cost of one kernel pixel of direct convolution. This includes the forward and inverse
+     * transform of the image and variance plus a few mask planes.
+     */
+    double const FftCostPerLog2 = 6.0;
+
+    /**
+     * Approximate cost of direct convolution with a spatially varying kernel,
+     * relative to direct convolution with a fixed kernel of the same size
+     */
+    double const SpatiallyVaryingDirectCostFactor = 2.0;
+
+    /**
+     * Approximate cost of separable convolution per separable term (image, variance and mask)
+     * per kernel pixel along x plus y, in units of the cost of one kernel pixel of direct convolution
+     */
+    double const SeparableCostPerTerm = 1.0;
+
+    /**
+     * Residual (relative to the largest kernel pixel) below which decomposeSeparable considers
+     * a kernel image fully decomposed; well above roundoff but far below any real PSF structure
+     */
+    double const SeparableTolerance = 1.0e-12;
+
+    int const SeparableStripHeight = 64;    ///< number of output rows per strip for separableConvolve
+
+    int const NonFiniteImagePlane = -1;     ///< pseudo mask plane: image pixel is not finite
+    int const NonFiniteVariancePlane = -2;  ///< pseudo mask plane: variance pixel is not finite
+
+    /**
+     * \brief Return true if the only prime factors of n are 2, 3 and 5
+     *
+     * GSL's mixed-radix FFT is efficient for such sizes.
+     */
+    bool isFastFftSize(int n) {
+        int const factors[] = {2, 3, 5};
+        for (int i = 0; i < 3; ++i) {
+            while (n % factors[i] == 0) {
+                n /= factors[i];
+            }
+        }
+        return n == 1;
+    }
+
+    /**
+     * \brief Return the smallest fast FFT size >= n
+     */
+    int nextFastFftSize(int n) {
+        n = std::max(n, 1);
+        while (!isFastFftSize(n)) {
+            ++n;
+        }
+        return n;
+    }
+
+    /**
+     * \brief Compute the FFT size along one axis
+     */
+    int computeFftSize(
+        int imageSize,      ///< size of image along this axis
+        int kernelSize,     ///< size of kernel along this axis
+        int fftSize         ///< desired FFT size; if <= 0 then a default is used
+    ) {
+        if (fftSize <= 0) {
+            fftSize = std::max(DefaultFftSize, 4 * kernelSize);
+        }
+        // each tile must produce at least as many good pixels as the kernel is wide
+        fftSize = nextFastFftSize(std::max(fftSize, (2 * kernelSize) - 1));
+        // a tile larger than the image is wasted effort
+        return std::min(fftSize, nextFastFftSize(imageSize));
+    }
+
+    template <typename T>
+    inline bool isFinite(T val) {
+        return (val == val) && (std::abs(val) <= std::numeric_limits<T>::max());
+    }
+
+    template <typename T>
+    inline double finiteOrZero(T val) {
+        return isFinite(val) ? static_cast<double>(val) : 0.0;
+    }
+
+    /**
+     * \brief 2-dimensional complex FFT of a fixed size, computed using GSL's mixed-radix routines
+     *
+     * Data is packed complex (real, imaginary pairs) in row-major order.
+     */
+    class Fft2D : private boost::noncopyable {
+    public:
+        Fft2D(int nx, int ny);
+        ~Fft2D();
+
+        int getNX() const { return _nx; }
+        int getNY() const { return _ny; }
+
+        void forward(std::vector<double> &data) const { transform(data, true); }
+
+        /// inverse transform, including the 1/(nx*ny) normalization
+        void inverse(std::vector<double> &data) const { transform(data, false); }
+
+    private:
+        int _nx;
+        int _ny;
+        gsl_fft_complex_wavetable *_xWavetable;
+        gsl_fft_complex_wavetable *_yWavetable;
+        gsl_fft_complex_workspace *_xWorkspace;
+        gsl_fft_complex_workspace *_yWorkspace;
+
+        void transform(std::vector<double> &data, bool isForward) const;
+        void freeTables();
+    };
+
+    Fft2D::Fft2D(int nx, int ny) :
+        _nx(nx),
+        _ny(ny),
+        _xWavetable(gsl_fft_complex_wavetable_alloc(nx)),
+        _yWavetable(gsl_fft_complex_wavetable_alloc(ny)),
+        _xWorkspace(gsl_fft_complex_workspace_alloc(nx)),
+        _yWorkspace(gsl_fft_complex_workspace_alloc(ny))
+    {
+        if (!_xWavetable || !_yWavetable || !_xWorkspace || !_yWorkspace) {
+            freeTables();
+            throw LSST_EXCEPT(pexExcept::MemoryException,
+                (boost::format("Could not allocate GSL FFT tables for %d x %d") % nx % ny).str());
+        }
+    }
+
+    Fft2D::~Fft2D() {
+        freeTables();
+    }
+
+    void Fft2D::freeTables() {
+        if (_xWavetable) { gsl_fft_complex_wavetable_free(_xWavetable); _xWavetable = 0; }
+        if (_yWavetable) { gsl_fft_complex_wavetable_free(_yWavetable); _yWavetable = 0; }
+        if (_xWorkspace) { gsl_fft_complex_workspace_free(_xWorkspace); _xWorkspace = 0; }
+        if (_yWorkspace) { gsl_fft_complex_workspace_free(_yWorkspace); _yWorkspace = 0; }
+    }
+
+    void Fft2D::transform(std::vector<double> &data, bool isForward) const {
+        double *dataPtr = &data[0];
+        int status = GSL_SUCCESS;
+        for (int y = 0; (y < _ny) && (status == GSL_SUCCESS); ++y) {
+            double *rowPtr = dataPtr + (2 * y * _nx);
+            status = isForward ?
+                gsl_fft_complex_forward(rowPtr, 1, _nx, _xWavetable, _xWorkspace) :
+                gsl_fft_complex_inverse(rowPtr, 1, _nx, _xWavetable, _xWorkspace);
+        }
+        for (int x = 0; (x < _nx) && (status == GSL_SUCCESS); ++x) {
+            double *colPtr = dataPtr + (2 * x);
+            status = isForward ?
+                gsl_fft_complex_forward(colPtr, _nx, _ny, _yWavetable, _yWorkspace) :
+                gsl_fft_complex_inverse(colPtr, _nx, _ny, _yWavetable, _yWorkspace);
+        }
+        if (status != GSL_SUCCESS) {
+            throw LSST_EXCEPT(pexExcept::RuntimeErrorException,
+                (boost::format("GSL FFT failed: %s") % gsl_strerror(status)).str());
+        }
+    }
+
+    /**
+     * \brief Fourier transforms of one kernel image, as needed by fftConvolve
+     *
+     * The kernel is stored reflected and wrapped so that the product with the transform of an input patch
+     * yields afwMath::convolve's sum over in(x - ctrX + i, y - ctrY + j) * kernel(i, j)
+     * at the lower left corner of the patch.
+     */
+    struct KernelSpectra {
+        std::vector<double> kernel;     ///< transform of the kernel, for the image
+        std::vector<double> kernelSq;   ///< transform of the kernel squared, for the variance
+        std::vector<double> footprint;  ///< transform of the nonzero kernel pixels, for the mask
+
+        void compute(afwImage::Image<afwMath::Kernel::Pixel> const &kernelImage, Fft2D const &fft);
+    };
+
+    void KernelSpectra::compute(afwImage::Image<afwMath::Kernel::Pixel> const &kernelImage, Fft2D const &fft) {
+        int const nx = fft.getNX();
+        int const ny = fft.getNY();
+        kernel.assign(2 * nx * ny, 0.0);
+        kernelSq.assign(2 * nx * ny, 0.0);
+        footprint.assign(2 * nx * ny, 0.0);
+        for (int j = 0; j < kernelImage.getHeight(); ++j) {
+            int const rowInd = ((ny - j) % ny) * nx;
+            for (int i = 0; i < kernelImage.getWidth(); ++i) {
+                int const ind = 2 * (rowInd + ((nx - i) % nx));
+                double const val = kernelImage(i, j);
+                kernel[ind] = val;
+                kernelSq[ind] = val * val;
+                footprint[ind] = (val != 0) ? 1.0 : 0.0;
+            }
+        }
+        fft.forward(kernel);
+        fft.forward(kernelSq);
+        fft.forward(footprint);
+    }
+
+    /**
+     * \brief Multiply the transform of (a + i b), where a and b are real, by two different spectra:
+     * product = FT(a) * realSpectrum + i FT(b) * imagSpectrum
+     *
+     * The inverse transform of the product has a convolved with one kernel in its real part
+     * and b convolved with the other kernel in its imaginary part.
+     */
+    void multiplySeparately(
+        std::vector<double> &product,               ///< output product
+        std::vector<double> const &data,            ///< transform of a + i b
+        std::vector<double> const &realSpectrum,    ///< spectrum by which to multiply FT(a)
+        std::vector<double> const &imagSpectrum,    ///< spectrum by which to multiply FT(b)
+        int nx,
+        int ny
+    ) {
+        for (int ky = 0; ky < ny; ++ky) {
+            int const rowInd = ky * nx;
+            int const mirrorRowInd = ((ny - ky) % ny) * nx;
+            for (int kx = 0; kx < nx; ++kx) {
+                int const ind = 2 * (rowInd + kx);
+                int const mirrorInd = 2 * (mirrorRowInd + ((nx - kx) % nx));
+                double const zr = data[ind];
+                double const zi = data[ind + 1];
+                double const mr = data[mirrorInd];
+                double const mi = data[mirrorInd + 1];
+                // FT(a) = (Z(k) + conj(Z(-k))) / 2; FT(b) = (Z(k) - conj(Z(-k))) / 2i
+                double const ar = 0.5 * (zr + mr);
+                double const ai = 0.5 * (zi - mi);
+                double const br = 0.5 * (zi + mi);
+                double const bi = -0.5 * (zr - mr);
+                double const pr = ar * realSpectrum[ind] - ai * realSpectrum[ind + 1];
+                double const pi = ar * realSpectrum[ind + 1] + ai * realSpectrum[ind];
+                double const qr = br * imagSpectrum[ind] - bi * imagSpectrum[ind + 1];
+                double const qi = br * imagSpectrum[ind + 1] + bi * imagSpectrum[ind];
+                product[ind] = pr - qi;
+                product[ind + 1] = pi + qr;
+            }
+        }
+    }
+
+    /**
+     * \brief Multiply data by spectrum in place
+     */
+    void multiply(std::vector<double> &data, std::vector<double> const &spectrum) {
+        for (std::vector<double>::size_type ind = 0; ind < data.size(); ind += 2) {
+            double const dr = data[ind];
+            double const di = data[ind + 1];
+            data[ind] = dr * spectrum[ind] - di * spectrum[ind + 1];
+            data[ind + 1] = dr * spectrum[ind + 1] + di * spectrum[ind];
+        }
+    }
+
+    /**
+     * \brief Does a kernel image have no zero pixels?
+     *
+     * If so, the mask of the convolved image may be computed by dilateMask.
+     */
+    bool hasFullFootprint(afwImage::Image<afwMath::Kernel::Pixel> const &kernelImage) {
+        for (int y = 0, yEnd = kernelImage.getHeight(); y < yEnd; ++y) {
+            for (afwImage::Image<afwMath::Kernel::Pixel>::x_iterator ptr = kernelImage.row_begin(y),
+                end = kernelImage.row_end(y); ptr != end; ++ptr) {
+                if (*ptr == 0) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * \brief Is a pixel in the specified mask plane (or non-finite pseudo plane)?
+     */
+    template <typename XIteratorT>
+    inline double isInPlane(XIteratorT const &ptr, int plane) {
+        if (plane == NonFiniteImagePlane) {
+            return isFinite(ptr.image()) ? 0.0 : 1.0;
+        } else if (plane == NonFiniteVariancePlane) {
+            return isFinite(ptr.variance()) ? 0.0 : 1.0;
+        }
+        return (ptr.mask() & (1 << plane)) ? 1.0 : 0.0;
+    }
+
+    /**
+     * \brief Set a pixel in the specified mask plane (or make the pixel non-finite for a pseudo plane)
+     */
+    template <typename XIteratorT>
+    inline void setPlane(XIteratorT const &ptr, int plane) {
+        if (plane == NonFiniteImagePlane) {
+            ptr.image() = std::numeric_limits<double>::quiet_NaN();
+        } else if (plane == NonFiniteVariancePlane) {
+            ptr.variance() = std::numeric_limits<afwImage::VariancePixel>::quiet_NaN();
+        } else {
+            ptr.mask() |= (1 << plane);
+        }
+    }
+
+    /**
+     * \brief Set the edge pixels of a convolved image to the values used by afwMath::convolve
+     *
+     * Edge pixels are those for which the kernel extends off the edge of the input image.
+     */
+    template <typename OutPixelT>
+    void setEdgePixels(
+        afwImage::MaskedImage<OutPixelT, afwImage::MaskPixel, afwImage::VariancePixel> &image,
+        afwMath::Kernel const &kernel
+    ) {
+        typedef typename afwImage::MaskedImage<OutPixelT, afwImage::MaskPixel,
+            afwImage::VariancePixel>::x_iterator XIterator;
+
+        OutPixelT const edgeImage = std::numeric_limits<OutPixelT>::has_quiet_NaN ?
+            std::numeric_limits<OutPixelT>::quiet_NaN() : 0;
+        afwImage::MaskPixel const edgeMask = afwImage::Mask<afwImage::MaskPixel>::getPlaneBitMask("EDGE");
+        afwImage::VariancePixel const edgeVariance = std::numeric_limits<afwImage::VariancePixel>::infinity();
+
+        int const goodXStart = kernel.getCtrX();
+        int const goodXEnd = image.getWidth() + 1 + kernel.getCtrX() - kernel.getWidth();
+        int const goodYStart = kernel.getCtrY();
+        int const goodYEnd = image.getHeight() + 1 + kernel.getCtrY() - kernel.getHeight();
+        for (int y = 0, yEnd = image.getHeight(); y < yEnd; ++y) {
+            bool const isEdgeRow = (y < goodYStart) || (y >= goodYEnd);
+            int x = 0;
+            for (XIterator ptr = image.row_begin(y), end = image.row_end(y); ptr != end; ++ptr, ++x) {
+                if (isEdgeRow || (x < goodXStart) || (x >= goodXEnd)) {
+                    ptr.image() = edgeImage;
+                    ptr.mask() = edgeMask;
+                    ptr.variance() = edgeVariance;
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief One separable term of a kernel, as lists of the nonzero elements along x and y
+     */
+    struct SeparableFilter {
+        std::vector<int> xIndexList;    ///< x index of each nonzero element of the x vector
+        std::vector<double> xValueList; ///< value of each nonzero element of the x vector
+        std::vector<int> yIndexList;    ///< y index of each nonzero element of the y vector
+        std::vector<double> yValueList; ///< value of each nonzero element of the y vector
+
+        SeparableFilter(std::vector<double> const &xVector, std::vector<double> const &yVector) {
+            for (int i = 0, iEnd = static_cast<int>(xVector.size()); i < iEnd; ++i) {
+                if (xVector[i] != 0) {
+                    xIndexList.push_back(i);
+                    xValueList.push_back(xVector[i]);
+                }
+            }
+            for (int j = 0, jEnd = static_cast<int>(yVector.size()); j < jEnd; ++j) {
+                if (yVector[j] != 0) {
+                    yIndexList.push_back(j);
+                    yValueList.push_back(yVector[j]);
+                }
+            }
+        }
+
+        /// are the nonzero elements (though not necessarily their values) the same as those of another filter?
+        bool hasSameFootprint(SeparableFilter const &other) const {
+            return (xIndexList == other.xIndexList) && (yIndexList == other.yIndexList);
+        }
+    };
+
+    /**
+     * \brief Convolve one plane of a strip of rows with a list of separable filters and sum the results
+     *
+     * The output holds goodWidth * nOutRows values, for output pixels (kCtrX + gx, kCtrY + gy0 + gy);
+     * the input holds the rows from gy0 through gy0 + nOutRows + kernel height - 2, each of full width.
+     */
+    void convolveSeparableStrip(
+        std::vector<double> &outData,       ///< output strip, row-major; set, not accumulated
+        std::vector<double> &rowData,       ///< scratch buffer
+        std::vector<double> const &inData,  ///< input strip, row-major
+        int inWidth,                        ///< width of input rows
+        int goodWidth,                      ///< width of output rows
+        int nInRows,                        ///< number of input rows
+        int nOutRows,                       ///< number of output rows
+        std::vector<SeparableFilter> const &filterList  ///< filters whose results to sum
+    ) {
+        outData.assign(goodWidth * nOutRows, 0.0);
+        rowData.resize(goodWidth * nInRows);
+        for (std::vector<SeparableFilter>::const_iterator filterIter = filterList.begin();
+            filterIter != filterList.end(); ++filterIter) {
+            int const nX = static_cast<int>(filterIter->xIndexList.size());
+            int const nY = static_cast<int>(filterIter->yIndexList.size());
+            // pass along each row
+            for (int row = 0; row < nInRows; ++row) {
+                double const *inRowPtr = &inData[row * inWidth];
+                double *rowPtr = &rowData[row * goodWidth];
+                for (int gx = 0; gx < goodWidth; ++gx) {
+                    double sum = 0;
+                    for (int k = 0; k < nX; ++k) {
+                        sum += filterIter->xValueList[k] * inRowPtr[gx + filterIter->xIndexList[k]];
+                    }
+                    rowPtr[gx] = sum;
+                }
+            }
+            // pass along each column, a row at a time for sequential memory access
+            for (int gy = 0; gy < nOutRows; ++gy) {
+                double *outPtr = &outData[gy * goodWidth];
+                for (int k = 0; k < nY; ++k) {
+                    double const yValue = filterIter->yValueList[k];
+                    double const *rowPtr = &rowData[(gy + filterIter->yIndexList[k]) * goodWidth];
+                    for (int gx = 0; gx < goodWidth; ++gx) {
+                        outPtr[gx] += yValue * rowPtr[gx];
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief OR the mask of a strip of rows over the footprint of each of a list of separable filters
+     *
+     * Arguments are as for convolveSeparableStrip.
+     */
+    void orMaskSeparableStrip(
+        std::vector<afwImage::MaskPixel> &outData,
+        std::vector<afwImage::MaskPixel> &rowData,
+        std::vector<afwImage::MaskPixel> const &inData,
+        int inWidth,
+        int goodWidth,
+        int nInRows,
+        int nOutRows,
+        std::vector<SeparableFilter> const &filterList
+    ) {
+        outData.assign(goodWidth * nOutRows, 0);
+        rowData.resize(goodWidth * nInRows);
+        for (std::vector<SeparableFilter>::const_iterator filterIter = filterList.begin();
+            filterIter != filterList.end(); ++filterIter) {
+            int const nX = static_cast<int>(filterIter->xIndexList.size());
+            int const nY = static_cast<int>(filterIter->yIndexList.size());
+            for (int row = 0; row < nInRows; ++row) {
+                afwImage::MaskPixel const *inRowPtr = &inData[row * inWidth];
+                afwImage::MaskPixel *rowPtr = &rowData[row * goodWidth];
+                for (int gx = 0; gx < goodWidth; ++gx) {
+                    afwImage::MaskPixel bits = 0;
+                    for (int k = 0; k < nX; ++k) {
+                        bits |= inRowPtr[gx + filterIter->xIndexList[k]];
+                    }
+                    rowPtr[gx] = bits;
+                }
+            }
+            for (int gy = 0; gy < nOutRows; ++gy) {
+                afwImage::MaskPixel *outPtr = &outData[gy * goodWidth];
+                for (int k = 0; k < nY; ++k) {
+                    afwImage::MaskPixel const *rowPtr = &rowData[(gy + filterIter->yIndexList[k]) * goodWidth];
+                    for (int gx = 0; gx < goodWidth; ++gx) {
+                        outPtr[gx] |= rowPtr[gx];
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief Convolve a MaskedImage with a kernel using lsst::afw::math::convolve
+     *
+     * If the kernel is not spatially varying and has no zero pixels then only the image and variance
+     * are convolved directly (the variance with the kernel squared) and the mask is computed by dilateMask,
+     * rather than ORing the mask over the kernel footprint at every pixel.
+     */
+    template <typename OutPixelT, typename InPixelT>
+    void directConvolve(
+        afwImage::MaskedImage<OutPixelT, afwImage::MaskPixel, afwImage::VariancePixel> &convolvedImage,
+        afwImage::MaskedImage<InPixelT, afwImage::MaskPixel, afwImage::VariancePixel> const &inImage,
+        afwMath::Kernel const &kernel,
+        bool doNormalize
+    ) {
+        typedef afwImage::Image<afwMath::Kernel::Pixel>::x_iterator KernelXIterator;
+
+        afwImage::Image<afwMath::Kernel::Pixel> kernelImage(kernel.getWidth(), kernel.getHeight());
+        if (!kernel.isSpatiallyVarying()) {
+            kernel.computeImage(kernelImage, doNormalize);
+        }
+        if (kernel.isSpatiallyVarying() || !hasFullFootprint(kernelImage)) {
+            afwMath::convolve(convolvedImage, inImage, kernel, doNormalize);
+            return;
+        }
+
+        afwMath::convolve(*convolvedImage.getImage(), *inImage.getImage(), kernel, doNormalize);
+        for (int y = 0, yEnd = kernelImage.getHeight(); y < yEnd; ++y) {
+            for (KernelXIterator ptr = kernelImage.row_begin(y), end = kernelImage.row_end(y); ptr != end; ++ptr) {
+                *ptr = (*ptr) * (*ptr);
+            }
+        }
+        afwMath::FixedKernel varianceKernel(kernelImage);
+        varianceKernel.setCtrX(kernel.getCtrX());
+        varianceKernel.setCtrY(kernel.getCtrY());
+        afwMath::convolve(*convolvedImage.getVariance(), *inImage.getVariance(), varianceKernel, false);
+        setEdgePixels(convolvedImage, kernel);
+        coaddKaiser::dilateMask(*convolvedImage.getMask(), *inImage.getMask(),
+            kernel.getWidth(), kernel.getHeight(), kernel.getCtrX(), kernel.getCtrY());
+    }
+
+} // anonymous namespace
+
+/**
+ * \brief Choose the fastest of direct, FFT and separable convolution
+ *
+ * The cost of direct convolution is taken to be proportional to the number of kernel pixels;
+ * the cost of FFT convolution is taken to be proportional to log2 of the number of pixels in one FFT tile,
+ * scaled up by the amount of tile overlap required for the kernel halo; the cost of separable convolution
+ * (only possible if decomposeSeparable can decompose the kernel) is taken to be proportional
+ * to the kernel width plus height times the number of separable terms for the image, variance and mask.
+ *
+ * \return DIRECT_CONVOLUTION, FFT_CONVOLUTION or SEPARABLE_CONVOLUTION
+ *
+ * \ingroup coadd::kaiser
+ */
+coaddKaiser::ConvolutionMethod coaddKaiser::chooseConvolutionMethod(
+    int width,          ///< width of image to convolve
+    int height,         ///< height of image to convolve
+    afwMath::Kernel const &kernel,  ///< convolution kernel
+    int fftSize         ///< FFT size along each axis; if <= 0 then a default is used
+) {
+    int const goodWidth = width + 1 - kernel.getWidth();
+    int const goodHeight = height + 1 - kernel.getHeight();
+    if ((goodWidth < 1) || (goodHeight < 1)) {
+        // nothing to convolve; all pixels are edge pixels
+        return DIRECT_CONVOLUTION;
+    }
+
+    double directCost = static_cast<double>(kernel.getWidth() * kernel.getHeight());
+    if (kernel.isSpatiallyVarying()) {
+        directCost *= SpatiallyVaryingDirectCostFactor;
+    }
+
+    int const nx = computeFftSize(width, kernel.getWidth(), fftSize);
+    int const ny = computeFftSize(height, kernel.getHeight(), fftSize);
+    int const tileWidth = nx + 1 - kernel.getWidth();
+    int const tileHeight = ny + 1 - kernel.getHeight();
+    double const nTiles = static_cast<double>(((goodWidth + tileWidth - 1) / tileWidth)
+        * ((goodHeight + tileHeight - 1) / tileHeight));
+    double const nFftPix = static_cast<double>(nx * ny);
+    double const fftCost = FftCostPerLog2 * (std::log(nFftPix) / std::log(2.0)) * nTiles * nFftPix
+        / static_cast<double>(goodWidth * goodHeight);
+
+    ConvolutionMethod convolutionMethod = (fftCost < directCost) ? FFT_CONVOLUTION : DIRECT_CONVOLUTION;
+
+    std::vector<std::vector<double> > xVectorList;
+    std::vector<std::vector<double> > yVectorList;
+    int const nTerms = decomposeSeparable(xVectorList, yVectorList, kernel, true);
+    if (nTerms > 0) {
+        // image and mask need nTerms passes; variance needs one per pair of terms
+        double const nPasses = static_cast<double>((2 * nTerms) + ((nTerms * (nTerms + 1)) / 2)) / 3.0;
+        double const separableCost = SeparableCostPerTerm * nPasses
+            * static_cast<double>(kernel.getWidth() + kernel.getHeight());
+        if (separableCost < std::min(directCost, fftCost)) {
+            convolutionMethod = SEPARABLE_CONVOLUTION;
+        }
+    }
+    return convolutionMethod;
+}
+
+/**
+ * \brief Decompose a kernel image into a sum of separable terms: sum over t of xVector_t(i) yVector_t(j)
+ *
+ * Uses cross approximation with full pivoting, which finds an exact decomposition of a kernel image
+ * of rank r in r steps (apart from roundoff). A Gaussian with axes along x and y is one term;
+ * a double Gaussian is two.
+ *
+ * \return the number of terms, or 0 if the kernel is spatially varying, all zero, or needs more than
+ * maxTerms terms (in which case xVectorList and yVectorList are empty)
+ *
+ * \ingroup coadd::kaiser
+ */
+int coaddKaiser::decomposeSeparable(
+    std::vector<std::vector<double> > &xVectorList, ///< x vector of each term; length = kernel width
+    std::vector<std::vector<double> > &yVectorList, ///< y vector of each term; length = kernel height
+    afwMath::Kernel const &kernel,  ///< kernel to decompose
+    bool doNormalize,       ///< normalize the kernel?
+    int maxTerms            ///< maximum number of terms
+) {
+    xVectorList.clear();
+    yVectorList.clear();
+    if (kernel.isSpatiallyVarying()) {
+        return 0;
+    }
+    afwImage::Image<afwMath::Kernel::Pixel> kernelImage(kernel.getWidth(), kernel.getHeight());
+    kernel.computeImage(kernelImage, doNormalize);
+    return decomposeSeparable(xVectorList, yVectorList, kernelImage, maxTerms);
+}
+
+/**
+ * \brief Decompose a kernel image into a sum of separable terms: sum over t of xVector_t(i) yVector_t(j)
+ *
+ * As decomposeSeparable for a kernel, but for an image that has already been computed.
+ *
+ * \ingroup coadd::kaiser
+ */
+int coaddKaiser::decomposeSeparable(
+    std::vector<std::vector<double> > &xVectorList, ///< x vector of each term; length = image width
+    std::vector<std::vector<double> > &yVectorList, ///< y vector of each term; length = image height
+    afwImage::Image<afwMath::Kernel::Pixel> const &kernelImage, ///< kernel image to decompose
+    int maxTerms            ///< maximum number of terms
+) {
+    xVectorList.clear();
+    yVectorList.clear();
+    int const kWidth = kernelImage.getWidth();
+    int const kHeight = kernelImage.getHeight();
+    std::vector<double> residual(kWidth * kHeight);
+    double maxAbsValue = 0;
+    for (int j = 0; j < kHeight; ++j) {
+        for (int i = 0; i < kWidth; ++i) {
+            residual[(j * kWidth) + i] = kernelImage(i, j);
+            maxAbsValue = std::max(maxAbsValue, std::abs(residual[(j * kWidth) + i]));
+        }
+    }
+    if (maxAbsValue == 0) {
+        return 0;
+    }
+    double const tolerance = SeparableTolerance * maxAbsValue;
+    for (;;) {
+        // find the largest remaining element
+        int pivotInd = 0;
+        for (int ind = 1, indEnd = kWidth * kHeight; ind < indEnd; ++ind) {
+            if (std::abs(residual[ind]) > std::abs(residual[pivotInd])) {
+                pivotInd = ind;
+            }
+        }
+        if (std::abs(residual[pivotInd]) <= tolerance) {
+            return static_cast<int>(xVectorList.size());
+        }
+        if (static_cast<int>(xVectorList.size()) >= maxTerms) {
+            xVectorList.clear();
+            yVectorList.clear();
+            return 0;
+        }
+        int const pivotI = pivotInd % kWidth;
+        int const pivotJ = pivotInd / kWidth;
+        double const pivot = residual[pivotInd];
+        std::vector<double> xVector(residual.begin() + (pivotJ * kWidth),
+            residual.begin() + ((pivotJ + 1) * kWidth));
+        std::vector<double> yVector(kHeight);
+        for (int j = 0; j < kHeight; ++j) {
+            yVector[j] = residual[(j * kWidth) + pivotI] / pivot;
+        }
+        for (int j = 0; j < kHeight; ++j) {
+            for (int i = 0; i < kWidth; ++i) {
+                residual[(j * kWidth) + i] -= yVector[j] * xVector[i];
+            }
+        }
+        xVectorList.push_back(xVector);
+        yVectorList.push_back(yVector);
+    }
+}
+
+/**
+ * \brief Convolve a MaskedImage with a kernel using FFTs
+ *
+ * The image is processed in tiles using overlap-save, so memory use depends only on the FFT size.
+ * A spatially varying kernel is evaluated at the center of each tile, so the FFT size should be small
+ * compared to the scale over which the kernel varies.
+ *
+ * Non-finite input image or variance pixels are excluded from the transforms (to avoid contaminating
+ * the whole tile); output pixels whose kernel footprint includes such a pixel are set to NaN,
+ * as direct convolution would.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if convolvedImage is not the same size as inImage
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename OutPixelT, typename InPixelT>
+void coaddKaiser::fftConvolve(
+    afwImage::MaskedImage<OutPixelT, afwImage::MaskPixel, afwImage::VariancePixel>
+        &convolvedImage,    ///< convolved image; must be the same size as inImage
+    afwImage::MaskedImage<InPixelT, afwImage::MaskPixel, afwImage::VariancePixel> const
+        &inImage,           ///< image to convolve
+    afwMath::Kernel const &kernel,  ///< convolution kernel
+    bool doNormalize,       ///< normalize the kernel?
+    int fftSize             ///< FFT size along each axis; if <= 0 then a default is used
+) {
+    typedef typename afwImage::MaskedImage<InPixelT, afwImage::MaskPixel,
+        afwImage::VariancePixel>::x_iterator InXIterator;
+    typedef typename afwImage::MaskedImage<OutPixelT, afwImage::MaskPixel,
+        afwImage::VariancePixel>::x_iterator OutXIterator;
+
+    if ((convolvedImage.getWidth() != inImage.getWidth())
+        || (convolvedImage.getHeight() != inImage.getHeight())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            "convolvedImage not the same size as inImage");
+    }
+
+    int const kWidth = kernel.getWidth();
+    int const kHeight = kernel.getHeight();
+    int const kCtrX = kernel.getCtrX();
+    int const kCtrY = kernel.getCtrY();
+    int const goodWidth = inImage.getWidth() + 1 - kWidth;
+    int const goodHeight = inImage.getHeight() + 1 - kHeight;
+
+    setEdgePixels(convolvedImage, kernel);
+    if ((goodWidth < 1) || (goodHeight < 1)) {
+        return;
+    }
+
+    // find which mask planes need to be propagated and whether any input pixels are non-finite
+    afwImage::MaskPixel usedMaskBits = 0;
+    bool hasNonFiniteImage = false;
+    bool hasNonFiniteVariance = false;
+    for (int y = 0, yEnd = inImage.getHeight(); y < yEnd; ++y) {
+        for (InXIterator ptr = inImage.row_begin(y), end = inImage.row_end(y); ptr != end; ++ptr) {
+            usedMaskBits |= ptr.mask();
+            hasNonFiniteImage |= !isFinite(ptr.image());
+            hasNonFiniteVariance |= !isFinite(ptr.variance());
+        }
+    }
+    // planeList holds every plane to propagate by FFT; nonFinitePlaneList only the pseudo planes,
+    // for tiles whose kernel has no zero pixels (so the mask may be computed by dilateMask instead)
+    std::vector<int> planeList;
+    std::vector<int> nonFinitePlaneList;
+    for (int plane = 0; plane < static_cast<int>(8 * sizeof(afwImage::MaskPixel)); ++plane) {
+        if (usedMaskBits & (1 << plane)) {
+            planeList.push_back(plane);
+        }
+    }
+    if (hasNonFiniteImage) {
+        planeList.push_back(NonFiniteImagePlane);
+        nonFinitePlaneList.push_back(NonFiniteImagePlane);
+    }
+    if (hasNonFiniteVariance) {
+        planeList.push_back(NonFiniteVariancePlane);
+        nonFinitePlaneList.push_back(NonFiniteVariancePlane);
+    }
+
+    int const nx = computeFftSize(inImage.getWidth(), kWidth, fftSize);
+    int const ny = computeFftSize(inImage.getHeight(), kHeight, fftSize);
+    int const tileWidth = nx + 1 - kWidth;
+    int const tileHeight = ny + 1 - kHeight;
+    Fft2D const fft(nx, ny);
+
+    bool const isSpatiallyVarying = kernel.isSpatiallyVarying();
+    afwImage::Image<afwMath::Kernel::Pixel> kernelImage(kWidth, kHeight);
+    KernelSpectra spectra;
+    bool isFullFootprint = false;
+    if (!isSpatiallyVarying) {
+        kernel.computeImage(kernelImage, doNormalize);
+        spectra.compute(kernelImage, fft);
+        isFullFootprint = hasFullFootprint(kernelImage);
+    }
+
+    std::vector<double> data(2 * nx * ny);
+    std::vector<double> product(2 * nx * ny);
+    for (int tileY0 = kCtrY; tileY0 < kCtrY + goodHeight; tileY0 += tileHeight) {
+        int const tileH = std::min(tileHeight, kCtrY + goodHeight - tileY0);
+        int const inH = tileH + kHeight - 1;
+        for (int tileX0 = kCtrX; tileX0 < kCtrX + goodWidth; tileX0 += tileWidth) {
+            int const tileW = std::min(tileWidth, kCtrX + goodWidth - tileX0);
+            int const inW = tileW + kWidth - 1;
+            int const inX0 = tileX0 - kCtrX;
+            int const inY0 = tileY0 - kCtrY;
+
+            if (isSpatiallyVarying) {
+                kernel.computeImage(kernelImage, doNormalize,
+                    afwImage::indexToPosition(tileX0 + inImage.getX0()) + (0.5 * (tileW - 1)),
+                    afwImage::indexToPosition(tileY0 + inImage.getY0()) + (0.5 * (tileH - 1)));
+                spectra.compute(kernelImage, fft);
+                isFullFootprint = hasFullFootprint(kernelImage);
+            }
+
+            // convolve image (real part) and variance (imaginary part) together
+            std::fill(data.begin(), data.end(), 0.0);
+            for (int y = 0; y < inH; ++y) {
+                double *dataPtr = &data[2 * y * nx];
+                InXIterator inPtr = inImage.x_at(inX0, inY0 + y);
+                for (int x = 0; x < inW; ++x, ++inPtr, dataPtr += 2) {
+                    dataPtr[0] = finiteOrZero(inPtr.image());
+                    dataPtr[1] = finiteOrZero(inPtr.variance());
+                }
+            }
+            fft.forward(data);
+            multiplySeparately(product, data, spectra.kernel, spectra.kernelSq, nx, ny);
+            fft.inverse(product);
+            for (int y = 0; y < tileH; ++y) {
+                double const *productPtr = &product[2 * y * nx];
+                OutXIterator outPtr = convolvedImage.x_at(tileX0, tileY0 + y);
+                for (int x = 0; x < tileW; ++x, ++outPtr, productPtr += 2) {
+                    outPtr.image() = static_cast<OutPixelT>(productPtr[0]);
+                    outPtr.variance() = static_cast<afwImage::VariancePixel>(productPtr[1]);
+                    outPtr.mask() = 0;
+                }
+            }
+
+            if (isFullFootprint && (usedMaskBits != 0)) {
+                afwImage::BBox const inBBox(afwImage::PointI(inX0, inY0), inW, inH);
+                afwImage::Mask<afwImage::MaskPixel> const inMask(*inImage.getMask(), inBBox);
+                afwImage::Mask<afwImage::MaskPixel> outMask(*convolvedImage.getMask(), inBBox);
+                dilateMask(outMask, inMask, kWidth, kHeight, kCtrX, kCtrY);
+            }
+
+            // propagate the remaining mask planes two at a time, using the real and imaginary parts
+            std::vector<int> const &tilePlaneList = isFullFootprint ? nonFinitePlaneList : planeList;
+            for (std::vector<int>::size_type planeInd = 0; planeInd < tilePlaneList.size(); planeInd += 2) {
+                int const realPlane = tilePlaneList[planeInd];
+                bool const hasImagPlane = planeInd + 1 < tilePlaneList.size();
+                int const imagPlane = hasImagPlane ? tilePlaneList[planeInd + 1] : 0;
+                std::fill(data.begin(), data.end(), 0.0);
+                for (int y = 0; y < inH; ++y) {
+                    double *dataPtr = &data[2 * y * nx];
+                    InXIterator inPtr = inImage.x_at(inX0, inY0 + y);
+                    for (int x = 0; x < inW; ++x, ++inPtr, dataPtr += 2) {
+                        dataPtr[0] = isInPlane(inPtr, realPlane);
+                        if (hasImagPlane) {
+                            dataPtr[1] = isInPlane(inPtr, imagPlane);
+                        }
+                    }
+                }
+                fft.forward(data);
+                multiply(data, spectra.footprint);
+                fft.inverse(data);
+                for (int y = 0; y < tileH; ++y) {
+                    double const *dataPtr = &data[2 * y * nx];
+                    OutXIterator outPtr = convolvedImage.x_at(tileX0, tileY0 + y);
+                    for (int x = 0; x < tileW; ++x, ++outPtr, dataPtr += 2) {
+                        // the convolved indicator is a count of contributing pixels; allow for roundoff
+                        if (dataPtr[0] > 0.5) {
+                            setPlane(outPtr, realPlane);
+                        }
+                        if (hasImagPlane && (dataPtr[1] > 0.5)) {
+                            setPlane(outPtr, imagPlane);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * \brief Convolve a MaskedImage with a kernel that is a sum of a few separable terms
+ *
+ * Each term is applied as a pass along each row followed by a pass along each column, working on strips
+ * of rows so memory use is proportional to the image width. The variance is convolved with the square
+ * of the kernel, which is also separable: one term for each pair of kernel terms.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if convolvedImage is not the same size as inImage
+ * or if the kernel cannot be decomposed (see decomposeSeparable)
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename OutPixelT, typename InPixelT>
+void coaddKaiser::separableConvolve(
+    afwImage::MaskedImage<OutPixelT, afwImage::MaskPixel, afwImage::VariancePixel>
+        &convolvedImage,    ///< convolved image; must be the same size as inImage
+    afwImage::MaskedImage<InPixelT, afwImage::MaskPixel, afwImage::VariancePixel> const
+        &inImage,           ///< image to convolve
+    afwMath::Kernel const &kernel,  ///< convolution kernel
+    bool doNormalize        ///< normalize the kernel?
+) {
+    typedef typename afwImage::MaskedImage<InPixelT, afwImage::MaskPixel,
+        afwImage::VariancePixel>::x_iterator InXIterator;
+    typedef typename afwImage::MaskedImage<OutPixelT, afwImage::MaskPixel,
+        afwImage::VariancePixel>::x_iterator OutXIterator;
+
+    if ((convolvedImage.getWidth() != inImage.getWidth())
+        || (convolvedImage.getHeight() != inImage.getHeight())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            "convolvedImage not the same size as inImage");
+    }
+    std::vector<std::vector<double> > xVectorList;
+    std::vector<std::vector<double> > yVectorList;
+    int const nTerms = decomposeSeparable(xVectorList, yVectorList, kernel, doNormalize);
+    if (nTerms == 0) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("Kernel is not a sum of at most %d separable terms") % DefaultMaxSeparableTerms).str());
+    }
+
+    int const kHeight = kernel.getHeight();
+    int const kCtrX = kernel.getCtrX();
+    int const kCtrY = kernel.getCtrY();
+    int const inWidth = inImage.getWidth();
+    int const goodWidth = inWidth + 1 - kernel.getWidth();
+    int const goodHeight = inImage.getHeight() + 1 - kHeight;
+
+    setEdgePixels(convolvedImage, kernel);
+    if ((goodWidth < 1) || (goodHeight < 1)) {
+        return;
+    }
+
+    std::vector<SeparableFilter> imageFilterList;
+    std::vector<SeparableFilter> varianceFilterList;
+    std::vector<SeparableFilter> maskFilterList;    // only the footprints matter, so omit duplicates
+    bool isFullFootprint = false;   // if true the mask is computed by dilateMask
+    for (int t = 0; t < nTerms; ++t) {
+        SeparableFilter const filter(xVectorList[t], yVectorList[t]);
+        imageFilterList.push_back(filter);
+        isFullFootprint |= (static_cast<int>(filter.xIndexList.size()) == kernel.getWidth())
+            && (static_cast<int>(filter.yIndexList.size()) == kHeight);
+        bool isNewFootprint = true;
+        for (std::vector<SeparableFilter>::const_iterator maskFilterIter = maskFilterList.begin();
+            maskFilterIter != maskFilterList.end(); ++maskFilterIter) {
+            isNewFootprint &= !maskFilterIter->hasSameFootprint(filter);
+        }
+        if (isNewFootprint) {
+            maskFilterList.push_back(filter);
+        }
+        // kernel^2 = sum over t, u of (x_t x_u)(i) (y_t y_u)(j); combine the (t, u) and (u, t) terms
+        for (int u = t; u < nTerms; ++u) {
+            std::vector<double> xVector(xVectorList[t].size());
+            std::vector<double> yVector(yVectorList[t].size());
+            double const factor = (u == t) ? 1.0 : 2.0;
+            for (std::size_t i = 0; i < xVector.size(); ++i) {
+                xVector[i] = xVectorList[t][i] * xVectorList[u][i];
+            }
+            for (std::size_t j = 0; j < yVector.size(); ++j) {
+                yVector[j] = factor * yVectorList[t][j] * yVectorList[u][j];
+            }
+            varianceFilterList.push_back(SeparableFilter(xVector, yVector));
+        }
+    }
+
+    std::vector<double> inImageData;
+    std::vector<double> inVarianceData;
+    std::vector<afwImage::MaskPixel> inMaskData;
+    std::vector<double> outImageData;
+    std::vector<double> outVarianceData;
+    std::vector<afwImage::MaskPixel> outMaskData;
+    std::vector<double> rowData;
+    std::vector<afwImage::MaskPixel> rowMaskData;
+    for (int gy0 = 0; gy0 < goodHeight; gy0 += SeparableStripHeight) {
+        int const nOutRows = std::min(SeparableStripHeight, goodHeight - gy0);
+        int const nInRows = nOutRows + kHeight - 1;
+        inImageData.resize(inWidth * nInRows);
+        inVarianceData.resize(inWidth * nInRows);
+        inMaskData.resize(inWidth * nInRows);
+        for (int row = 0; row < nInRows; ++row) {
+            int ind = row * inWidth;
+            for (InXIterator inPtr = inImage.row_begin(gy0 + row), end = inImage.row_end(gy0 + row);
+                inPtr != end; ++inPtr, ++ind) {
+                inImageData[ind] = static_cast<double>(inPtr.image());
+                inVarianceData[ind] = static_cast<double>(inPtr.variance());
+                inMaskData[ind] = inPtr.mask();
+            }
+        }
+
+        convolveSeparableStrip(outImageData, rowData, inImageData, inWidth, goodWidth, nInRows, nOutRows,
+            imageFilterList);
+        convolveSeparableStrip(outVarianceData, rowData, inVarianceData, inWidth, goodWidth, nInRows, nOutRows,
+            varianceFilterList);
+        if (isFullFootprint) {
+            outMaskData.assign(goodWidth * nOutRows, 0);    // replaced by dilateMask below
+        } else {
+            orMaskSeparableStrip(outMaskData, rowMaskData, inMaskData, inWidth, goodWidth, nInRows, nOutRows,
+                maskFilterList);
+        }
+
+        for (int gy = 0; gy < nOutRows; ++gy) {
+            int ind = gy * goodWidth;
+            OutXIterator outPtr = convolvedImage.x_at(kCtrX, kCtrY + gy0 + gy);
+            for (int gx = 0; gx < goodWidth; ++gx, ++outPtr, ++ind) {
+                outPtr.image() = static_cast<OutPixelT>(outImageData[ind]);
+                outPtr.variance() = static_cast<afwImage::VariancePixel>(outVarianceData[ind]);
+                outPtr.mask() = outMaskData[ind];
+            }
+        }
+    }
+    if (isFullFootprint) {
+        dilateMask(*convolvedImage.getMask(), *inImage.getMask(), kernel.getWidth(), kHeight, kCtrX, kCtrY);
+    }
+}
+
+/**
+ * \brief Convolve a MaskedImage with a kernel using the specified (or automatically chosen) method
+ *
+ * \return the convolution method actually used (never AUTO_CONVOLUTION)
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if convolutionMethod is unknown
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename OutPixelT, typename InPixelT>
+coaddKaiser::ConvolutionMethod coaddKaiser::convolveMaskedImage(
+    afwImage::MaskedImage<OutPixelT, afwImage::MaskPixel, afwImage::VariancePixel>
+        &convolvedImage,    ///< convolved image; must be the same size as inImage
+    afwImage::MaskedImage<InPixelT, afwImage::MaskPixel, afwImage::VariancePixel> const
+        &inImage,           ///< image to convolve
+    afwMath::Kernel const &kernel,  ///< convolution kernel
+    bool doNormalize,       ///< normalize the kernel?
+    ConvolutionMethod convolutionMethod,    ///< convolution method
+    int fftSize             ///< FFT size along each axis, for FFT convolution; if <= 0 then a default is used
+) {
+    if (convolutionMethod == AUTO_CONVOLUTION) {
+        convolutionMethod = chooseConvolutionMethod(inImage.getWidth(), inImage.getHeight(), kernel, fftSize);
+    }
+    switch (convolutionMethod) {
+        case DIRECT_CONVOLUTION:
+            directConvolve(convolvedImage, inImage, kernel, doNormalize);
+            break;
+        case FFT_CONVOLUTION:
+            fftConvolve(convolvedImage, inImage, kernel, doNormalize, fftSize);
+            break;
+        case SEPARABLE_CONVOLUTION:
+            separableConvolve(convolvedImage, inImage, kernel, doNormalize);
+            break;
+        default:
+            throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+                (boost::format("Unknown convolution method %d") % convolutionMethod).str());
+    }
+    return convolutionMethod;
+}
+
+//
+// Explicit instantiations
+//
+#define INSTANTIATE(OUTPIXELT, INPIXELT) \
+    template void coaddKaiser::fftConvolve( \
+        afwImage::MaskedImage<OUTPIXELT, afwImage::MaskPixel, afwImage::VariancePixel> &, \
+        afwImage::MaskedImage<INPIXELT, afwImage::MaskPixel, afwImage::VariancePixel> const &, \
+        afwMath::Kernel const &, bool, int); \
+    template void coaddKaiser::separableConvolve( \
+        afwImage::MaskedImage<OUTPIXELT, afwImage::MaskPixel, afwImage::VariancePixel> &, \
+        afwImage::MaskedImage<INPIXELT, afwImage::MaskPixel, afwImage::VariancePixel> const &, \
+        afwMath::Kernel const &, bool); \
+    template coaddKaiser::ConvolutionMethod coaddKaiser::convolveMaskedImage( \
+        afwImage::MaskedImage<OUTPIXELT, afwImage::MaskPixel, afwImage::VariancePixel> &, \
+        afwImage::MaskedImage<INPIXELT, afwImage::MaskPixel, afwImage::VariancePixel> const &, \
+        afwMath::Kernel const &, bool, coaddKaiser::ConvolutionMethod, int);
+
+INSTANTIATE(double, float);
+INSTANTIATE(double, double);
+INSTANTIATE(float, float);
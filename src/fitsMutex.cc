@@ -0,0 +1,51 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief A process-wide mutex to serialize reading and writing FITS files
+*
+* @file
+*/
+#include "boost/thread/mutex.hpp"
+
+#include "lsst/coadd/kaiser/fitsMutex.h"
+
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    boost::mutex fitsMutex;
+}
+
+/**
+ * \brief Get the mutex that must be held while reading or writing a FITS file from a thread
+ *
+ * cfitsio is not built thread-safe, and reading a mask updates afw's static dictionary of mask planes,
+ * so all FITS I/O done by threads that may run concurrently (e.g. CoaddPipeline workers and the
+ * BlurredPsfCache they use) must hold this mutex. It is not recursive.
+ *
+ * \ingroup coadd::kaiser
+ */
+boost::mutex &coaddKaiser::getFitsMutex() {
+    return fitsMutex;
+}
@@ -0,0 +1,93 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Describe the pixel memory of an image, so other code (e.g. numpy) can use it in place
+*
+* @file
+*/
+#include <cstddef>
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/imageBuffer.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+/**
+ * \brief Get the address of pixel (0, 0) of an image, as an integer
+ *
+ * Pixels within a row are contiguous; see getRowStride for the spacing of rows.
+ * The address is only valid while the image (or another image sharing its pixels) exists.
+ *
+ * \throw pexExcept::RangeErrorException if image width and/or height is 0
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+std::size_t coaddKaiser::getPixelAddress(
+    afwImage::ImageBase<PixelT> const &image    ///< image
+) {
+    if ((image.getWidth() < 1) || (image.getHeight() < 1)) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException, "image has no pixels");
+    }
+    return reinterpret_cast<std::size_t>(&(*image.row_begin(0)));
+}
+
+/**
+ * \brief Get the number of pixels (not bytes) from the start of one row of an image to the start of the next
+ *
+ * This is the width of the image unless it is a subimage, in which case it is the width of the parent.
+ *
+ * \throw pexExcept::RangeErrorException if image width and/or height is 0
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+int coaddKaiser::getRowStride(
+    afwImage::ImageBase<PixelT> const &image    ///< image
+) {
+    if ((image.getWidth() < 1) || (image.getHeight() < 1)) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException, "image has no pixels");
+    }
+    if (image.getHeight() < 2) {
+        return image.getWidth();
+    }
+    PixelT const *row0Ptr = reinterpret_cast<PixelT const *>(&(*image.row_begin(0)));
+    PixelT const *row1Ptr = reinterpret_cast<PixelT const *>(&(*image.row_begin(1)));
+    return static_cast<int>(row1Ptr - row0Ptr);
+}
+
+//
+// Explicit instantiations
+//
+#define INSTANTIATE(PIXELT) \
+    template std::size_t coaddKaiser::getPixelAddress(afwImage::ImageBase<PIXELT> const &); \
+    template int coaddKaiser::getRowStride(afwImage::ImageBase<PIXELT> const &);
+
+INSTANTIATE(float);
+INSTANTIATE(double);
+INSTANTIATE(afwImage::MaskPixel);
@@ -0,0 +1,233 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Per-pixel median of a stack of images using binapprox
+*
+* Each pixel's median is computed with the binapprox algorithm of Ryan J. Tibshirani:
+* "Fast computation of the median by successive binning", June 23, 2008
+* <http://stat.stanford.edu/~ryantibs/median/medianpaper.pdf>
+*
+* A stack typically has few images but many pixels, so the loops that compute the mean, standard deviation
+* and bin of each value run across pixels (a chunk of one row at a time) rather than across the stack;
+* each is branch-free so the compiler can vectorize it. Rather than histogramming each pixel's values
+* and scanning all nBins bins for the central value(s), the bins containing the central values are found
+* by selecting among the pixel's N bin indices (std::nth_element), so the cost per pixel is O(N),
+* not O(nBins); the result is the same.
+*
+* @file
+*/
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "boost/format.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/medianBinapproxStack.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+    int const ChunkWidth = 256; ///< number of pixels processed at a time; sets the size of the bin index array
+}
+
+/**
+ * \brief Compute the per-pixel median of a stack of images, ignoring masked pixels
+ *
+ * The median of each pixel is accurate to 1/nBins of the standard deviation of that pixel's values
+ * (as for medianBinapprox). If a pixel has fewer than 3 good values, or they are all equal,
+ * the mean is used. If a pixel has no good values its median is NaN (0 for integer types).
+ * All good values must be finite.
+ *
+ * Working memory is proportional to the number of images (not to their size or to nBins), and each row is
+ * handled independently. Thus to avoid having an entire stack in memory, call this once per
+ * block of rows: pass row-block subimages of the inputs and of medianImage.
+ *
+ * \throw lsst::pex::exceptions::InvalidParameterException if imageList is empty,
+ * the images (or masks) do not all match medianImage in size,
+ * or maskList is neither empty nor the same length as imageList.
+ * \throw lsst::pex::exceptions::RangeErrorException if nBins < 2
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename T>
+void coaddKaiser::medianBinapproxStack(
+    afwImage::Image<T> &medianImage,    ///< median image; must be the same size as the input images
+    std::vector<typename afwImage::Image<T>::Ptr> const &imageList, ///< stack of images
+    std::vector<afwImage::Mask<afwImage::MaskPixel>::Ptr> const &maskList,
+        ///< mask of each image; if empty then all pixels are used
+    afwImage::MaskPixel badMask,    ///< ignore pixels with any of these mask bits set
+    int nBins                       ///< number of bins
+) {
+    if (imageList.empty()) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException, "no images");
+    }
+    if (!maskList.empty() && (maskList.size() != imageList.size())) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+            (boost::format("maskList has %d elements; must be empty or match imageList (%d elements)") %
+            maskList.size() % imageList.size()).str());
+    }
+    if (nBins < 2) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException, "nBins < 2");
+    }
+    int const width = medianImage.getWidth();
+    int const height = medianImage.getHeight();
+    for (std::size_t i = 0; i < imageList.size(); ++i) {
+        if ((imageList[i]->getWidth() != width) || (imageList[i]->getHeight() != height)) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+                (boost::format("image %d is %dx%d; medianImage is %dx%d") %
+                i % imageList[i]->getWidth() % imageList[i]->getHeight() % width % height).str());
+        }
+        if (!maskList.empty() && ((maskList[i]->getWidth() != width) || (maskList[i]->getHeight() != height))) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterException,
+                (boost::format("mask %d is %dx%d; medianImage is %dx%d") %
+                i % maskList[i]->getWidth() % maskList[i]->getHeight() % width % height).str());
+        }
+    }
+
+    int const nImages = static_cast<int>(imageList.size());
+    double const maxT = static_cast<double>(nBins + 1);
+    double const noDataValue = std::numeric_limits<T>::has_quiet_NaN ?
+        std::numeric_limits<T>::quiet_NaN() : 0;
+
+    // per-pixel working arrays for one chunk of a row
+    std::vector<int> nArr(ChunkWidth);
+    std::vector<double> meanArr(ChunkWidth);
+    std::vector<double> leftEndArr(ChunkWidth);
+    std::vector<double> scaleArr(ChunkWidth);
+    std::vector<double> goodArr(ChunkWidth);
+    // bin index of each value: 0 (below), 1...nBins, nBins + 1 (above), or nBins + 2 if the value is masked
+    // (so masked values sort after all good values); the image index varies fastest
+    std::vector<int> binArr(nImages * ChunkWidth);
+
+    std::vector<T const *> imagePtrList(nImages);
+    std::vector<afwImage::MaskPixel const *> maskPtrList(maskList.empty() ? 0 : nImages);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x0 = 0; x0 < width; x0 += ChunkWidth) {
+            int const cw = std::min(ChunkWidth, width - x0);
+            for (int i = 0; i < nImages; ++i) {
+                imagePtrList[i] = &(*imageList[i])(x0, y);
+                if (!maskList.empty()) {
+                    maskPtrList[i] = &(*maskList[i])(x0, y);
+                }
+            }
+
+            // compute the number of good values and their mean
+            std::fill(nArr.begin(), nArr.begin() + cw, 0);
+            std::fill(meanArr.begin(), meanArr.begin() + cw, 0.0);
+            for (int i = 0; i < nImages; ++i) {
+                T const *imPtr = imagePtrList[i];
+                if (maskList.empty()) {
+                    for (int x = 0; x < cw; ++x) {
+                        nArr[x] += 1;
+                        meanArr[x] += static_cast<double>(imPtr[x]);
+                    }
+                } else {
+                    afwImage::MaskPixel const *maskPtr = maskPtrList[i];
+                    for (int x = 0; x < cw; ++x) {
+                        int const isGood = ((maskPtr[x] & badMask) == 0) ? 1 : 0;
+                        nArr[x] += isGood;
+                        meanArr[x] += isGood ? static_cast<double>(imPtr[x]) : 0.0;
+                    }
+                }
+            }
+            for (int x = 0; x < cw; ++x) {
+                meanArr[x] = (nArr[x] > 0) ? meanArr[x] / static_cast<double>(nArr[x]) : noDataValue;
+            }
+
+            // compute the standard deviation, and from it the bin parameters
+            std::fill(scaleArr.begin(), scaleArr.begin() + cw, 0.0);
+            for (int i = 0; i < nImages; ++i) {
+                T const *imPtr = imagePtrList[i];
+                afwImage::MaskPixel const *maskPtr = maskList.empty() ? 0 : maskPtrList[i];
+                for (int x = 0; x < cw; ++x) {
+                    goodArr[x] = (!maskPtr || ((maskPtr[x] & badMask) == 0)) ? 1.0 : 0.0;
+                }
+                for (int x = 0; x < cw; ++x) {
+                    double const diff = (static_cast<double>(imPtr[x]) - meanArr[x]) * goodArr[x];
+                    scaleArr[x] += diff * diff;
+                }
+            }
+            for (int x = 0; x < cw; ++x) {
+                double const sigma = std::sqrt(scaleArr[x] / static_cast<double>(std::max(nArr[x], 1)));
+                leftEndArr[x] = meanArr[x] - sigma;
+                scaleArr[x] = static_cast<double>(nBins - 1) / (2.0 * sigma);
+            }
+
+            // compute the bin index of each value
+            for (int i = 0; i < nImages; ++i) {
+                T const *imPtr = imagePtrList[i];
+                afwImage::MaskPixel const *maskPtr = maskList.empty() ? 0 : maskPtrList[i];
+                int *binPtr = &binArr[i];
+                for (int x = 0; x < cw; ++x) {
+                    double t = ((static_cast<double>(imPtr[x]) - leftEndArr[x]) * scaleArr[x]) + 1.0;
+                    t = (t > 0.0) ? t : 0.0;    // also handles NaN from sigma = 0
+                    t = (t < maxT) ? t : maxT;
+                    int const isGood = (!maskPtr || ((maskPtr[x] & badMask) == 0)) ? 1 : 0;
+                    binPtr[x * nImages] = isGood ? static_cast<int>(t) : nBins + 2;
+                }
+            }
+
+            typename afwImage::Image<T>::x_iterator medPtr = medianImage.row_begin(y) + x0;
+            for (int x = 0; x < cw; ++x, ++medPtr) {
+                if ((nArr[x] < 3) || std::isinf(scaleArr[x]) || std::isnan(scaleArr[x])) {
+                    *medPtr = static_cast<T>(meanArr[x]);
+                } else {
+                    // find the bins containing the central value(s): if n is odd these are the same bin
+                    int const lowTarget = (nArr[x] + 1) / 2;
+                    int const highTarget = (nArr[x] / 2) + 1;
+                    int *binBegin = &binArr[x * nImages];
+                    int *binEnd = binBegin + nImages;
+                    std::nth_element(binBegin, binBegin + (lowTarget - 1), binEnd);
+                    int const lowBin = binBegin[lowTarget - 1];
+                    int const highBin = (highTarget == lowTarget) ?
+                        lowBin : *std::min_element(binBegin + lowTarget, binEnd);
+                    // bin index 1 is the first bin of binapprox
+                    *medPtr = static_cast<T>(
+                        (static_cast<double>(lowBin + highBin - 1) / (2.0 * scaleArr[x])) + leftEndArr[x]);
+                }
+            }
+        }
+    }
+}
+
+//
+// Explicit instantiations
+//
+#define INSTANTIATE(T) \
+    template void coaddKaiser::medianBinapproxStack<T>( \
+        afwImage::Image<T> &, \
+        std::vector<afwImage::Image<T>::Ptr> const &, \
+        std::vector<afwImage::Mask<afwImage::MaskPixel>::Ptr> const &, \
+        afwImage::MaskPixel, \
+        int);
+
+INSTANTIATE(float);
+INSTANTIATE(double);
@@ -0,0 +1,613 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Fast binned median of contiguous data.
+*
+* Implements the binapprox and binmedian algorithms described in Ryan J. Tibshirani's paper:
+* "Fast computation of the median by successive binning", June 23, 2008
+* <http://stat.stanford.edu/~ryantibs/median/medianpaper.pdf>
+*
+* Compared to medianBinapprox this computes the mean and standard deviation in a single pass,
+* computes bin indices a block at a time with a branch-free loop that the compiler can vectorize,
+* and can split the data among threads, each with its own histogram.
+*
+* The speed does not rely on vectorization: bin indices are clamped with arithmetic rather than comparisons,
+* so the loop has no data-dependent branches; the moments are accumulated in NLanes independent sums;
+* and each histogram is split into NLanes interleaved sub-histograms (so runs of values in the same bin,
+* which are common near the median, do not serialize on one counter).
+*
+* @file
+*/
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "boost/ref.hpp"
+#include "boost/thread.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/medianBinned.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+namespace {
+
+    int const BlockSize = 256;              ///< number of bin indices computed at a time; a multiple of NLanes
+    int const NLanes = 4;                   ///< number of independent accumulators and sub-histograms
+    std::ptrdiff_t const ChunkSize = 65536; ///< maximum span length, so 1-d data can be split among threads
+    long int const MaxSelectSize = 65536;   ///< binmedian re-bins until at most this many values remain
+
+    /**
+     * \brief A contiguous range of values
+     */
+    template <typename T>
+    struct Span {
+        T const *begin;
+        T const *end;
+        Span(T const *begin_, T const *end_) : begin(begin_), end(end_) {}
+    };
+
+    /**
+     * \brief Clamp t to [0, maxT] and truncate it to an int
+     *
+     * The clamps use fabs rather than comparisons: gcc compiles comparisons to branches unless it vectorizes
+     * the loop, and values outside the bins (typically a third of them) make those branches unpredictable.
+     */
+    inline int clampIndex(double t, double maxT) {
+        double const below = maxT - t;
+        t = maxT - (0.5 * (below + std::fabs(below)));  // min(t, maxT)
+        return static_cast<int>(0.5 * (t + std::fabs(t))); // max(t, 0)
+    }
+
+    /**
+     * \brief One level of binning: the histogram parameters and the bin of interest
+     *
+     * Bin index 0 is for values below leftEnd, 1 through nBins cover [leftEnd, leftEnd + nBins/scale)
+     * and nBins + 1 is for values above that.
+     */
+    struct BinLevel {
+        double leftEnd;
+        double scale;   ///< bins per unit value
+        int nBins;
+        int bin;        ///< bin of interest
+
+        BinLevel(double leftEnd_, double scale_, int nBins_) :
+            leftEnd(leftEnd_), scale(scale_), nBins(nBins_), bin(0)
+        {}
+
+        /// get the offset such that (value * scale) + offset is 1 at leftEnd
+        double getOffset() const { return 1.0 - (leftEnd * scale); }
+
+        /// compute the bin index of a value
+        int getIndex(double value) const {
+            return clampIndex((value * scale) + getOffset(), static_cast<double>(nBins + 1));
+        }
+    };
+
+    /// Is value in the bin of interest of every level?
+    bool isInBins(double value, std::vector<BinLevel> const &levelList) {
+        for (std::vector<BinLevel>::const_iterator levIter = levelList.begin();
+            levIter != levelList.end(); ++levIter) {
+            if (levIter->getIndex(value) != levIter->bin) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * \brief Compute the number, minimum, maximum and shifted sum and sum of squares of a range of spans
+     *
+     * The values are shifted to reduce roundoff error in the variance.
+     */
+    template <typename T>
+    struct MomentsTask {
+        Span<T> const *spanBegin;
+        Span<T> const *spanEnd;
+        double shift;
+        long int n;
+        double sum;
+        double sumSq;
+        double minValue;
+        double maxValue;
+
+        MomentsTask(Span<T> const *spanBegin_, Span<T> const *spanEnd_, double shift_) :
+            spanBegin(spanBegin_), spanEnd(spanEnd_), shift(shift_), n(0), sum(0), sumSq(0),
+            minValue(std::numeric_limits<double>::infinity()),
+            maxValue(-std::numeric_limits<double>::infinity())
+        {}
+
+        void operator()() {
+            for (Span<T> const *span = spanBegin; span != spanEnd; ++span) {
+                // NLanes independent sets of accumulators, combined at the end of the span
+                double laneSum[NLanes];
+                double laneSumSq[NLanes];
+                double laneMin[NLanes];
+                double laneMax[NLanes];
+                for (int lane = 0; lane < NLanes; ++lane) {
+                    laneSum[lane] = 0;
+                    laneSumSq[lane] = 0;
+                    laneMin[lane] = minValue;
+                    laneMax[lane] = maxValue;
+                }
+                T const *ptr = span->begin;
+                for ( ; ptr + NLanes <= span->end; ptr += NLanes) {
+                    for (int lane = 0; lane < NLanes; ++lane) {
+                        double const value = static_cast<double>(ptr[lane]);
+                        double const diff = value - shift;
+                        laneSum[lane] += diff;
+                        laneSumSq[lane] += diff * diff;
+                        laneMin[lane] = (value < laneMin[lane]) ? value : laneMin[lane];
+                        laneMax[lane] = (value > laneMax[lane]) ? value : laneMax[lane];
+                    }
+                }
+                for (int lane = 0; ptr != span->end; ++ptr, ++lane) {
+                    double const value = static_cast<double>(*ptr);
+                    double const diff = value - shift;
+                    laneSum[lane] += diff;
+                    laneSumSq[lane] += diff * diff;
+                    laneMin[lane] = (value < laneMin[lane]) ? value : laneMin[lane];
+                    laneMax[lane] = (value > laneMax[lane]) ? value : laneMax[lane];
+                }
+                for (int lane = 0; lane < NLanes; ++lane) {
+                    sum += laneSum[lane];
+                    sumSq += laneSumSq[lane];
+                    minValue = (laneMin[lane] < minValue) ? laneMin[lane] : minValue;
+                    maxValue = (laneMax[lane] > maxValue) ? laneMax[lane] : maxValue;
+                }
+                n += static_cast<long int>(span->end - span->begin);
+            }
+        }
+    };
+
+    /**
+     * \brief Histogram a range of spans
+     *
+     * If constraintList is not empty then only values in the bin of interest of every constraint level
+     * are histogrammed (a slower, scalar code path used by binmedian).
+     */
+    template <typename T>
+    struct HistogramTask {
+        Span<T> const *spanBegin;
+        Span<T> const *spanEnd;
+        BinLevel level;
+        std::vector<BinLevel> const *constraintListPtr;
+        std::vector<long int> counts;
+
+        HistogramTask(Span<T> const *spanBegin_, Span<T> const *spanEnd_, BinLevel const &level_,
+            std::vector<BinLevel> const &constraintList) :
+            spanBegin(spanBegin_), spanEnd(spanEnd_), level(level_), constraintListPtr(&constraintList),
+            counts(level_.nBins + 2, 0)
+        {}
+
+        void operator()() {
+            if (!constraintListPtr->empty()) {
+                for (Span<T> const *span = spanBegin; span != spanEnd; ++span) {
+                    for (T const *ptr = span->begin; ptr != span->end; ++ptr) {
+                        double const value = static_cast<double>(*ptr);
+                        if (isInBins(value, *constraintListPtr)) {
+                            ++counts[level.getIndex(value)];
+                        }
+                    }
+                }
+                return;
+            }
+
+            // compute a block of indices in a loop with no branches or stores to the histogram,
+            // so the compiler can vectorize it, then increment the histogram;
+            // value i of a block goes to sub-histogram i % NLanes, whose bins are interleaved:
+            // bin b of sub-histogram lane is laneCounts[(b * NLanes) + lane]
+            double const scale = level.scale;
+            double const offset = level.getOffset();
+            double const maxT = static_cast<double>(level.nBins + 1);
+            int indexBlock[BlockSize];
+            std::vector<long int> laneCounts((level.nBins + 2) * NLanes, 0);
+            long int *countPtr = &laneCounts[0];
+            for (Span<T> const *span = spanBegin; span != spanEnd; ++span) {
+                for (T const *blockPtr = span->begin; blockPtr < span->end; blockPtr += BlockSize) {
+                    int const blockSize = static_cast<int>(std::min(
+                        static_cast<std::ptrdiff_t>(BlockSize), span->end - blockPtr));
+                    for (int i = 0; i < blockSize; ++i) {
+                        indexBlock[i] = clampIndex((static_cast<double>(blockPtr[i]) * scale) + offset, maxT)
+                            * NLanes;
+                    }
+                    int i = 0;
+                    for ( ; i + NLanes <= blockSize; i += NLanes) {
+                        for (int lane = 0; lane < NLanes; ++lane) {
+                            ++countPtr[indexBlock[i + lane] + lane];
+                        }
+                    }
+                    for (int lane = 0; i < blockSize; ++i, ++lane) {
+                        ++countPtr[indexBlock[i] + lane];
+                    }
+                }
+            }
+            for (std::size_t bin = 0; bin < counts.size(); ++bin) {
+                for (int lane = 0; lane < NLanes; ++lane) {
+                    counts[bin] += countPtr[(bin * NLanes) + lane];
+                }
+            }
+        }
+    };
+
+    /**
+     * \brief Gather the values of a range of spans that are in the bin of interest of every level
+     */
+    template <typename T>
+    struct GatherTask {
+        Span<T> const *spanBegin;
+        Span<T> const *spanEnd;
+        std::vector<BinLevel> const *levelListPtr;
+        std::vector<T> values;
+
+        GatherTask(Span<T> const *spanBegin_, Span<T> const *spanEnd_, std::vector<BinLevel> const &levelList) :
+            spanBegin(spanBegin_), spanEnd(spanEnd_), levelListPtr(&levelList), values()
+        {}
+
+        void operator()() {
+            for (Span<T> const *span = spanBegin; span != spanEnd; ++span) {
+                for (T const *ptr = span->begin; ptr != span->end; ++ptr) {
+                    if (isInBins(static_cast<double>(*ptr), *levelListPtr)) {
+                        values.push_back(*ptr);
+                    }
+                }
+            }
+        }
+    };
+
+    /**
+     * \brief Run a list of tasks, each in its own thread if there is more than one
+     */
+    template <class Task>
+    void runTasks(std::vector<Task> &taskList) {
+        if (taskList.size() == 1) {
+            taskList[0]();
+            return;
+        }
+        boost::thread_group threadGroup;
+        for (typename std::vector<Task>::iterator taskIter = taskList.begin();
+            taskIter != taskList.end(); ++taskIter) {
+            threadGroup.create_thread(boost::ref(*taskIter));
+        }
+        threadGroup.join_all();
+    }
+
+    /**
+     * \brief Divide a list of spans into nearly equal ranges, one per thread
+     *
+     * \return the index of the first span of each range, plus one past the last span
+     */
+    std::vector<std::size_t> divideSpans(std::size_t nSpans, int nThreads) {
+        std::size_t const nRanges = std::min(nSpans, static_cast<std::size_t>(std::max(nThreads, 1)));
+        std::vector<std::size_t> boundList;
+        for (std::size_t i = 0; i <= nRanges; ++i) {
+            boundList.push_back((i * nSpans) / nRanges);
+        }
+        return boundList;
+    }
+
+    /**
+     * \brief Histogram a list of spans, using multiple threads if requested
+     */
+    template <typename T>
+    std::vector<long int> computeHistogram(
+        std::vector<Span<T> > const &spanList,
+        std::vector<std::size_t> const &boundList,
+        BinLevel const &level,
+        std::vector<BinLevel> const &constraintList
+    ) {
+        std::vector<HistogramTask<T> > taskList;
+        for (std::size_t i = 0; i + 1 < boundList.size(); ++i) {
+            taskList.push_back(HistogramTask<T>(&spanList[boundList[i]], &spanList[0] + boundList[i + 1],
+                level, constraintList));
+        }
+        runTasks(taskList);
+        std::vector<long int> counts(level.nBins + 2, 0);
+        for (typename std::vector<HistogramTask<T> >::const_iterator taskIter = taskList.begin();
+            taskIter != taskList.end(); ++taskIter) {
+            for (std::size_t i = 0; i < counts.size(); ++i) {
+                counts[i] += taskIter->counts[i];
+            }
+        }
+        return counts;
+    }
+
+    /**
+     * \brief Find the bin containing the value of a given rank
+     *
+     * \return bin index; rank is reduced by the number of values in lower bins
+     */
+    int findRankBin(std::vector<long int> const &counts, long int &rank) {
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            if (rank < counts[i]) {
+                return static_cast<int>(i);
+            }
+            rank -= counts[i];
+        }
+        throw LSST_EXCEPT(pexExcept::RuntimeErrorException, "rank exceeds number of values");
+    }
+
+    /**
+     * \brief Compute the exact value of a given rank (and optionally the next rank) using binmedian
+     *
+     * Starting with a histogram of all values, repeatedly re-bin the bin containing the desired rank
+     * until it holds at most MaxSelectSize values (or cannot be split further because the values are equal),
+     * then select from those values.
+     *
+     * \return the value of the given rank; if nextValuePtr is not null then *nextValuePtr is set to the
+     * value of the next rank
+     */
+    template <typename T>
+    T selectRank(
+        std::vector<Span<T> > const &spanList,
+        std::vector<std::size_t> const &boundList,
+        long int rank,              ///< desired rank (0 for the smallest value)
+        long int n,                 ///< number of values
+        BinLevel const &level0,     ///< histogram parameters of counts0
+        std::vector<long int> const &counts0,   ///< histogram of all values
+        double minValue,            ///< minimum value
+        double maxValue,            ///< maximum value
+        T *nextValuePtr             ///< if not null, set to the value of rank + 1
+    ) {
+        std::vector<BinLevel> levelList;
+        long int binRank = rank;
+        long int binCount = n;
+        double lo = minValue;
+        double hi = maxValue;
+        if (!counts0.empty()) {
+            levelList.push_back(level0);
+            levelList.back().bin = findRankBin(counts0, binRank);
+            binCount = counts0[levelList.back().bin];
+        }
+        while (binCount > MaxSelectSize) {
+            if (!levelList.empty()) {
+                BinLevel const &prevLevel = levelList.back();
+                if (prevLevel.bin > 0) {
+                    lo = std::max(lo, prevLevel.leftEnd + (prevLevel.bin - 1) / prevLevel.scale);
+                }
+                if (prevLevel.bin <= prevLevel.nBins) {
+                    hi = std::min(hi, prevLevel.leftEnd + prevLevel.bin / prevLevel.scale);
+                }
+            }
+            if (!(hi > lo)) {
+                break;
+            }
+            BinLevel level(lo, static_cast<double>(level0.nBins) / (hi - lo), level0.nBins);
+            if (std::isinf(level.scale)) {
+                break;
+            }
+            std::vector<long int> const counts = computeHistogram(spanList, boundList, level, levelList);
+            long int newBinRank = binRank;
+            level.bin = findRankBin(counts, newBinRank);
+            if (counts[level.bin] == binCount) {
+                break; // could not split the values; they are (nearly) all equal
+            }
+            binRank = newBinRank;
+            binCount = counts[level.bin];
+            levelList.push_back(level);
+        }
+
+        std::vector<GatherTask<T> > taskList;
+        for (std::size_t i = 0; i + 1 < boundList.size(); ++i) {
+            taskList.push_back(GatherTask<T>(&spanList[boundList[i]], &spanList[0] + boundList[i + 1],
+                levelList));
+        }
+        runTasks(taskList);
+        std::vector<T> values;
+        values.reserve(binCount);
+        for (typename std::vector<GatherTask<T> >::const_iterator taskIter = taskList.begin();
+            taskIter != taskList.end(); ++taskIter) {
+            values.insert(values.end(), taskIter->values.begin(), taskIter->values.end());
+        }
+        if (static_cast<long int>(values.size()) != binCount) {
+            throw LSST_EXCEPT(pexExcept::RuntimeErrorException, "Bin counts inconsistent; is there a NaN?");
+        }
+
+        typename std::vector<T>::iterator const rankIter = values.begin() + binRank;
+        std::nth_element(values.begin(), rankIter, values.end());
+        T const value = *rankIter;
+        if (nextValuePtr) {
+            if (rankIter + 1 != values.end()) {
+                *nextValuePtr = *std::min_element(rankIter + 1, values.end());
+            } else {
+                // the next value is in a higher bin
+                *nextValuePtr = selectRank(spanList, boundList, rank + 1, n, level0, counts0,
+                    minValue, maxValue, static_cast<T *>(0));
+            }
+        }
+        return value;
+    }
+
+    /**
+     * \brief Compute the median of a list of spans
+     */
+    template <typename T>
+    T medianBinnedSpans(
+        std::vector<Span<T> > const &spanList,
+        coaddKaiser::MedianBinnedControl const &control
+    ) {
+        int const nBins = control.getNBins();
+        if (nBins < 2) {
+            throw LSST_EXCEPT(pexExcept::RangeErrorException, "nBins < 2");
+        }
+        if (spanList.empty()) {
+            throw LSST_EXCEPT(pexExcept::RangeErrorException, "no data");
+        }
+        int nThreads = control.getNThreads();
+        if (nThreads <= 0) {
+            nThreads = std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+        }
+        std::vector<std::size_t> const boundList = divideSpans(spanList.size(), nThreads);
+
+        // Compute the number of elements (n), mean (mu) and standard deviation (sigma) in one pass
+        std::vector<MomentsTask<T> > momentsTaskList;
+        double const shift = static_cast<double>(*spanList[0].begin);
+        for (std::size_t i = 0; i + 1 < boundList.size(); ++i) {
+            momentsTaskList.push_back(MomentsTask<T>(&spanList[boundList[i]], &spanList[0] + boundList[i + 1],
+                shift));
+        }
+        runTasks(momentsTaskList);
+        MomentsTask<T> moments(0, 0, shift);
+        for (typename std::vector<MomentsTask<T> >::const_iterator taskIter = momentsTaskList.begin();
+            taskIter != momentsTaskList.end(); ++taskIter) {
+            moments.n += taskIter->n;
+            moments.sum += taskIter->sum;
+            moments.sumSq += taskIter->sumSq;
+            moments.minValue = std::min(moments.minValue, taskIter->minValue);
+            moments.maxValue = std::max(moments.maxValue, taskIter->maxValue);
+        }
+        long int const n = moments.n;
+        double const meanDiff = moments.sum / static_cast<double>(n);
+        double const mu = shift + meanDiff;
+        if (n < 3) {
+            return static_cast<T>(mu);
+        }
+        if (moments.minValue == moments.maxValue) {
+            return static_cast<T>(moments.minValue);
+        }
+        double const sigma = std::sqrt(std::max(0.0, (moments.sumSq / static_cast<double>(n))
+            - (meanDiff * meanDiff)));
+
+        // Bin data across the interval [mu-sigma, mu+sigma]
+        double const scalefactor = static_cast<double>(nBins - 1)/(2.0 * sigma);
+        BinLevel const level0(mu - sigma, scalefactor, nBins);
+        std::vector<long int> counts;
+        if (!std::isinf(scalefactor)) {
+            counts = computeHistogram(spanList, boundList, level0, std::vector<BinLevel>());
+        } else if (control.getAlgorithm() == coaddKaiser::BINAPPROX) {
+            // data are too closely spaced, just return mean
+            return static_cast<T>(mu);
+        }
+
+        if (control.getAlgorithm() == coaddKaiser::BINMEDIAN) {
+            if (n & 1) {
+                return selectRank(spanList, boundList, (n - 1) / 2, n, level0, counts,
+                    moments.minValue, moments.maxValue, static_cast<T *>(0));
+            }
+            T upperValue;
+            T const lowerValue = selectRank(spanList, boundList, (n / 2) - 1, n, level0, counts,
+                moments.minValue, moments.maxValue, &upperValue);
+            return static_cast<T>(0.5 * (static_cast<double>(lowerValue) + static_cast<double>(upperValue)));
+        }
+
+        // Find the bin that contains the median, as for medianBinapprox
+        double const leftend = level0.leftEnd;
+        long int count = counts[0];
+        if (n & 1) {
+            long int const k = (n + 1) / 2;
+            for (int i = 0; i < nBins; ++i) {
+                count += counts[i + 1];
+                if (count >= k) {
+                    return static_cast<T>((static_cast<double>(i) + 0.5) / scalefactor + leftend);
+                }
+            }
+        } else {
+            long int const k = n / 2;
+            for (int i = 0; i < nBins; ++i) {
+                count += counts[i + 1];
+                if (count >= k) {
+                    int j = i;
+                    while ((count == k) && (j < nBins)) {
+                        ++j;
+                        count += counts[j + 1];
+                    }
+                    return static_cast<T>(static_cast<double>(i + j + 1) / (2.0 * scalefactor) + leftend);
+                }
+            }
+        }
+        throw LSST_EXCEPT(pexExcept::RuntimeErrorException, "Unexpectedly failed to return a value");
+    }
+
+} // anonymous namespace
+
+/**
+ * \brief Compute the median of a contiguous array using the binapprox or binmedian algorithm
+ *
+ * BINAPPROX gives the same answer as medianBinapprox (to within roundoff), accurate to 1/nBins
+ * of a standard deviation. BINMEDIAN gives the exact median (the mean of the two central values
+ * if the number of values is even) at the cost of one or more extra passes through the data.
+ *
+ * All values must be finite.
+ *
+ * \throw lsst::pex::exceptions::RangeErrorException if last <= first or nBins < 2
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename T>
+T coaddKaiser::medianBinned(
+    T const *first,     ///< pointer to first element of array
+    T const *last,      ///< pointer to last+1 element of array
+    MedianBinnedControl const &control  ///< algorithm, number of bins and number of threads
+) {
+    if (first >= last) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException, "last <= first");
+    }
+    std::vector<Span<T> > spanList;
+    for (T const *spanBegin = first; spanBegin < last; spanBegin += ChunkSize) {
+        spanList.push_back(Span<T>(spanBegin, spanBegin + std::min(ChunkSize, last - spanBegin)));
+    }
+    return medianBinnedSpans(spanList, control);
+}
+
+/**
+ * \brief Compute the median of an image using the binapprox or binmedian algorithm
+ *
+ * See medianBinned for details. Each row of the image is processed as a contiguous array,
+ * so this works for subimages.
+ *
+ * \throw lsst::pex::exceptions::RangeErrorException if the image has no pixels or nBins < 2
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename T>
+T coaddKaiser::medianBinnedImage(
+    afwImage::Image<T> const &image,    ///< image for which to compute median
+    MedianBinnedControl const &control  ///< algorithm, number of bins and number of threads
+) {
+    if ((image.getWidth() < 1) || (image.getHeight() < 1)) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException, "image has no pixels");
+    }
+    std::vector<Span<T> > spanList;
+    for (int y = 0; y < image.getHeight(); ++y) {
+        T const *rowBegin = &image(0, y);
+        spanList.push_back(Span<T>(rowBegin, rowBegin + image.getWidth()));
+    }
+    return medianBinnedSpans(spanList, control);
+}
+
+//
+// Explicit instantiations
+//
+#define INSTANTIATE(T) \
+    template T coaddKaiser::medianBinned(T const *, T const *, coaddKaiser::MedianBinnedControl const &); \
+    template T coaddKaiser::medianBinnedImage(afwImage::Image<T> const &, \
+        coaddKaiser::MedianBinnedControl const &);
+
+INSTANTIATE(float);
+INSTANTIATE(double);
@@ -0,0 +1,87 @@
+// -*- LSST-C++ -*-
+
+/* 
+ * LSST Data Management System
+ * Copyright 2008, 2009, 2010 LSST Corporation.
+ * 
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the LSST License Statement and 
+ * the GNU General Public License along with this program.  If not, 
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+ 
+/**
+* \brief Reflect an image through its center.
+*
+* @file
+*
+* @author Russell Owen
+*/
+#include <algorithm> // for swap
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image.h"
+#include "lsst/coadd/kaiser/reflectImage.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+namespace afwImage = lsst::afw::image;
+namespace coaddKaiser = lsst::coadd::kaiser;
+
+/**
+ * \brief Reflect an image in place: image(x, y) becomes image(width - 1 - x, height - 1 - y).
+ *
+ * \throw pexExcept::RangeErrorException if image width and/or height is 0
+ *
+ * \ingroup coadd::kaiser
+ */
+template <typename PixelT>
+void coaddKaiser::reflectImage(
+    afwImage::Image<PixelT> &image  ///< image to reflect
+) {
+    typedef typename afwImage::Image<PixelT>::x_iterator XIterator;
+    
+    if ((image.getHeight() < 1) || (image.getWidth() < 1)) {
+        throw LSST_EXCEPT(pexExcept::RangeErrorException, "Image width and/or height is 0");
+    }
+    
+    const int nRows = static_cast<int>(image.getHeight());
+    const int nFullRowsToSwap = nRows / 2;
+    const bool isOddNRows = (nRows % 2 != 0);
+     // use x_at(xLast, y) instead of row_end(y) to get the reverse row iterator
+     // because row_end(y) starts one beyond the last pixel
+    const int xLast = static_cast<int>(image.getWidth()) - 1;
+    for (int yFwd = 0, yRev = nRows - 1; yFwd < nFullRowsToSwap; ++yFwd, --yRev) {
+        for (XIterator fwdPtr = image.row_begin(yFwd), revPtr = image.x_at(xLast, yRev);
+            fwdPtr != image.row_end(yFwd); ++fwdPtr, --revPtr) {
+            std::swap(*fwdPtr, *revPtr);
+        }
+    }
+    if (isOddNRows) {
+        const unsigned int yCtr = nFullRowsToSwap;
+        const unsigned int halfCols = image.getWidth() / 2;
+        XIterator const fwdEndCtr = image.x_at(halfCols, yCtr); // end of the left half of the center row
+        XIterator fwdPtr = image.row_begin(yCtr);
+        XIterator revPtr = image.x_at(xLast, yCtr);
+        for ( ; fwdPtr != fwdEndCtr; ++fwdPtr, --revPtr) {
+            std::swap(*fwdPtr, *revPtr);
+        }
+    }
+}
+
+//
+// Explicit instantiations
+//
+template void coaddKaiser::reflectImage(afwImage::Image<float> &);
+template void coaddKaiser::reflectImage(afwImage::Image<double> &);
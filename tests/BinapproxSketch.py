@@ -0,0 +1,196 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""
+Test lsst.coadd.kaiser.BinapproxSketch
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import unittest
+
+import numpy
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests") 
+
+InputMaskedImageNameSmall = "small_MI"
+
+currDir = os.path.abspath(os.path.dirname(__file__))
+inFilePathSmall = os.path.join(dataDir, InputMaskedImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def exactQuantile(arr, fraction):
+    """Return the value of rank ceil(fraction * len(arr)), counting from 1"""
+    sortedArr = numpy.sort(arr.flatten())
+    rank = max(1, int(math.ceil(fraction * len(sortedArr))))
+    return sortedArr[rank - 1]
+
+def makeStrips(image, stripHeight):
+    """Return a list of strips of an image"""
+    stripList = []
+    for y0 in range(0, image.getHeight(), stripHeight):
+        height = min(stripHeight, image.getHeight() - y0)
+        bbox = afwImage.BBox(afwImage.PointI(0, y0), image.getWidth(), height)
+        stripList.append(image.Factory(image, bbox, False))
+    return stripList
+
+class BinapproxSketchTestCase(unittest.TestCase):
+    """
+    A test case for BinapproxSketch
+    """
+    def testQuantiles(self):
+        """Make sure quantiles are exact before binning and accurate to half a bin width after"""
+        maskedImage = afwImage.ExposureF(inFilePathSmall).getMaskedImage()
+        imArr = imTestUtils.arrayFromImage(maskedImage.getImage())
+        maskArr = imTestUtils.arrayFromImage(maskedImage.getMask())
+        goodArr = imArr[maskArr == 0]
+
+        exactSketch = coaddKaiser.BinapproxSketch(1000, imArr.size + 1)
+        exactSketch.addImage(maskedImage.getImage())
+        self.assertFalse(exactSketch.isBinned())
+        self.assertEqual(exactSketch.getCount(), imArr.size)
+        self.assertEqual(exactSketch.getMedian(), exactQuantile(imArr, 0.5))
+        self.assertAlmostEqual(exactSketch.getMean() / imArr.mean(), 1.0, 6)
+        self.assertAlmostEqual(exactSketch.getSigma() / imArr.std(), 1.0, 6)
+
+        for nBins in (100, 1000):
+            sketch = coaddKaiser.BinapproxSketch(nBins, 1000)
+            sketch.addMaskedImage(maskedImage.getImage(), maskedImage.getMask(), 0xFFFF)
+            self.assertTrue(sketch.isBinned())
+            self.assertEqual(sketch.getCount(), len(goodArr))
+            self.assertEqual(sketch.getMin(), goodArr.min())
+            self.assertEqual(sketch.getMax(), goodArr.max())
+            self.assertEqual(sketch.getQuantile(0.0), goodArr.min())
+            for fraction in (0.2, 0.5, 0.8):
+                self.assertTrue(abs(sketch.getQuantile(fraction) - exactQuantile(goodArr, fraction)) \
+                    <= 0.5 * sketch.getBinWidth())
+        self.assertRaises(pexEx.LsstCppException, sketch.getQuantile, 1.5)
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.BinapproxSketch().getMedian)
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.BinapproxSketch, 0)
+
+    def testPrior(self):
+        """Make sure a prior sets the bin range and quantiles outside it are rejected"""
+        varArr = imTestUtils.arrayFromImage(afwImage.ExposureF(inFilePathSmall).getMaskedImage().getVariance())
+        sketch = coaddKaiser.BinapproxSketch()
+        sketch.addValue(float(varArr[0, 0]))
+        sketch.setPrior(varArr.mean(), varArr.std())
+        self.assertTrue(sketch.isBinned())
+        self.assertTrue(sketch.getRangeMin() <= varArr.mean() - coaddKaiser.BinapproxSketch.RangeNSigma * varArr.std())
+        self.assertRaises(pexEx.LsstCppException, sketch.setPrior, 0.0, 1.0)
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.BinapproxSketch().setPrior, 0.0, 0.0)
+
+        sketch = coaddKaiser.BinapproxSketch()
+        sketch.setPrior(0.0, 1.0)
+        for value in (-100.0, 0.1, 0.2, 100.0):
+            sketch.addValue(value)
+        self.assertEqual((sketch.getNBelow(), sketch.getNAbove()), (1, 1))
+        self.assertTrue(abs(sketch.getMedian() - 0.1) <= 0.5 * sketch.getBinWidth())
+        self.assertEqual(sketch.getQuantile(1.0), 100.0)
+        self.assertRaises(pexEx.LsstCppException, sketch.getQuantile, 0.1)
+
+    def testMerge(self):
+        """Make sure merging sketches of strips matches a sketch of the whole image"""
+        image = afwImage.ExposureF(inFilePathSmall).getMaskedImage().getVariance()
+        varArr = imTestUtils.arrayFromImage(image)
+        stripList = makeStrips(image, 37)
+
+        # with the same prior, merging is exact
+        wholeSketch = coaddKaiser.BinapproxSketch()
+        wholeSketch.setPrior(varArr.mean(), varArr.std())
+        wholeSketch.addImage(image)
+        mergedSketch = coaddKaiser.BinapproxSketch()
+        for strip in stripList:
+            stripSketch = coaddKaiser.BinapproxSketch()
+            stripSketch.setPrior(varArr.mean(), varArr.std())
+            stripSketch.addImage(strip)
+            mergedSketch.merge(stripSketch)
+        self.assertEqual(mergedSketch.getCount(), wholeSketch.getCount())
+        self.assertEqual(mergedSketch.getBinWidth(), wholeSketch.getBinWidth())
+        for fraction in (0.1, 0.5, 0.9):
+            self.assertEqual(mergedSketch.getQuantile(fraction), wholeSketch.getQuantile(fraction))
+
+        # with adaptive ranges, merging coarsens to the widest bins
+        mergedSketch = coaddKaiser.BinapproxSketch(1000, 500)
+        maxBinWidth = 0
+        for strip in stripList:
+            stripSketch = coaddKaiser.BinapproxSketch(1000, 500)
+            stripSketch.addImage(strip)
+            maxBinWidth = max(maxBinWidth, stripSketch.getBinWidth())
+            mergedSketch.merge(stripSketch)
+        self.assertEqual(mergedSketch.getCount(), varArr.size)
+        self.assertEqual(mergedSketch.getBinWidth(), maxBinWidth)
+        self.assertAlmostEqual(mergedSketch.getMean() / varArr.mean(), 1.0, 6)
+        self.assertAlmostEqual(mergedSketch.getSigma() / varArr.std(), 1.0, 6)
+        self.assertTrue(abs(mergedSketch.getMedian() - exactQuantile(varArr, 0.5)) <= 0.5 * maxBinWidth)
+
+        self.assertRaises(pexEx.LsstCppException, mergedSketch.merge, coaddKaiser.BinapproxSketch(100))
+
+    def testSerialize(self):
+        """Make sure a deserialized sketch matches the original, binned or not"""
+        image = afwImage.ExposureF(inFilePathSmall).getMaskedImage().getImage()
+        for sampleSize in (1000, image.getWidth() * image.getHeight() + 1):
+            sketch = coaddKaiser.BinapproxSketch(1000, sampleSize)
+            sketch.addImage(image)
+            data = sketch.serialize()
+            newSketch = coaddKaiser.BinapproxSketch.deserialize(data)
+            self.assertEqual(newSketch.serialize(), data)
+            self.assertEqual(newSketch.isBinned(), sketch.isBinned())
+            self.assertEqual(newSketch.getCount(), sketch.getCount())
+            self.assertEqual(newSketch.getMedian(), sketch.getMedian())
+            if sketch.isBinned():
+                binnedData = data
+        self.assertTrue(len(binnedData) < len(data))
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.BinapproxSketch.deserialize, data[:-1])
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.BinapproxSketch.deserialize, "not a sketch")
+
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(BinapproxSketchTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
@@ -0,0 +1,171 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""
+Test lsst.coadd.kaiser.BlurredPsfCache
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import shutil
+import tempfile
+import unittest
+
+import numpy
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.afw.math as afwMath
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests") 
+
+InputMaskedImageNameSmall = "small_MI"
+
+currDir = os.path.abspath(os.path.dirname(__file__))
+inFilePathSmall = os.path.join(dataDir, InputMaskedImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def makeKernel(sigma):
+    return afwMath.AnalyticKernel(11, 11, afwMath.GaussianFunction2D(sigma, 2.0))
+
+def computeReferenceBlurredPsfImage(kernel, normalizePsf):
+    """Compute the blurred PSF image by convolving a padded, reflected kernel image with the kernel
+    """
+    width = kernel.getWidth()
+    height = kernel.getHeight()
+    paddedReflImage = afwImage.ImageD(3 * width - 2, 3 * height - 2, 0)
+    reflImage = afwImage.ImageD(paddedReflImage, afwImage.BBox(afwImage.PointI(width - 1, height - 1), width, height))
+    kernel.computeImage(reflImage, True)
+    coaddKaiser.reflectImage(reflImage)
+    paddedBlurredImage = afwImage.ImageD(3 * width - 2, 3 * height - 2)
+    afwMath.convolve(paddedBlurredImage, paddedReflImage, kernel, normalizePsf)
+    return afwImage.ImageD(paddedBlurredImage,
+        afwImage.BBox(afwImage.PointI(kernel.getCtrX(), kernel.getCtrY()), 2 * width - 1, 2 * height - 1), True)
+
+class BlurredPsfCacheTestCase(unittest.TestCase):
+    """
+    A test case for BlurredPsfCache
+    """
+    def setUp(self):
+        self.cacheDir = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.cacheDir)
+
+    def assertImagesEqual(self, image1, image2):
+        arr1 = imTestUtils.arrayFromImage(image1)
+        arr2 = imTestUtils.arrayFromImage(image2)
+        self.assertEqual(arr1.shape, arr2.shape)
+        self.assertTrue(numpy.all(arr1 == arr2))
+
+    def testComputeBlurredPsfImage(self):
+        """Test computeBlurredPsfImage for separable and non-separable kernels
+        """
+        for kFunc in (
+            afwMath.GaussianFunction2D(1.5, 2.0),           # separable
+            afwMath.DoubleGaussianFunction2D(1.5, 3.0, 0.1), # sum of two separable terms
+            afwMath.GaussianFunction2D(1.5, 3.0, 0.5),      # not separable
+        ):
+            kernel = afwMath.AnalyticKernel(15, 13, kFunc)
+            kernel.setCtrX(6)
+            for normalizePsf in (False, True):
+                refArr = imTestUtils.arrayFromImage(computeReferenceBlurredPsfImage(kernel, normalizePsf))
+                arr = imTestUtils.arrayFromImage(coaddKaiser.computeBlurredPsfImage(kernel, normalizePsf))
+                self.assertEqual(refArr.shape, arr.shape)
+                self.assertTrue(numpy.abs(refArr - arr).max() <= 1.0e-12 * numpy.abs(refArr).max())
+
+    def testMemory(self):
+        """Test hits, misses and that cached images match computed images
+        """
+        cache = coaddKaiser.BlurredPsfCache()
+        for sigma in (1.5, 2.0, 1.5, 1.5, 2.0):
+            # use a new kernel each time, so hits depend only on the kernel image
+            kernel = makeKernel(sigma)
+            for normalizePsf in (False, True):
+                self.assertImagesEqual(cache.get(kernel, normalizePsf),
+                    coaddKaiser.computeBlurredPsfImage(kernel, normalizePsf))
+        self.assertEqual(cache.getNMisses(), 4)
+        self.assertEqual(cache.getNHits(), 6)
+        self.assertEqual(cache.getNDiskHits(), 0)
+        self.assertEqual(cache.getSize(), 4)
+        cache.clear()
+        self.assertEqual(cache.getSize(), 0)
+        self.assertEqual(cache.getNHits(), 0)
+
+    def testDisk(self):
+        """Test that entries stored on disk are found by a new cache
+        """
+        kernel = makeKernel(1.75)
+        cache = coaddKaiser.BlurredPsfCache(self.cacheDir)
+        blurredPsfImage = cache.get(kernel, True)
+        self.assertEqual(cache.getNMisses(), 1)
+
+        newCache = coaddKaiser.BlurredPsfCache(self.cacheDir)
+        self.assertImagesEqual(newCache.get(kernel, True), blurredPsfImage)
+        self.assertEqual(newCache.getNDiskHits(), 1)
+        self.assertEqual(newCache.getNMisses(), 0)
+        newCache.get(kernel, False)
+        self.assertEqual(newCache.getNMisses(), 1)
+
+    def testCoaddComponent(self):
+        """Test that CoaddComponent gives the same blurred PSF with and without a cache
+        """
+        exposure = afwImage.ExposureF(inFilePathSmall)
+        kernel = makeKernel(1.75)
+        control = coaddKaiser.CoaddComponentControl()
+        control.setBlurredPsfCache(coaddKaiser.BlurredPsfCache())
+        for i in range(2):
+            coaddComponent = coaddKaiser.CoaddComponentD(exposure, kernel, True)
+            cachedCoaddComponent = coaddKaiser.CoaddComponentD(exposure, kernel, True, control)
+            self.assertImagesEqual(coaddComponent.getBlurredPsfImage(), cachedCoaddComponent.getBlurredPsfImage())
+        self.assertEqual(control.getBlurredPsfCache().getNHits(), 1)
+
+         
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(BlurredPsfCacheTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
@@ -0,0 +1,207 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""
+Test lsst.coadd.kaiser.CoaddCheckpoint
+"""
+from __future__ import with_statement
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import shutil
+import tempfile
+import unittest
+
+import numpy
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.afw.math as afwMath
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.coadd.kaiser.testUtils as kaiserTestUtils
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests") 
+
+InputMaskedImageNameSmall = "small_MI"
+
+currDir = os.path.abspath(os.path.dirname(__file__))
+inFilePathSmall = os.path.join(dataDir, InputMaskedImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+NInputs = 5
+TileSize = 64
+
+class CoaddCheckpointTestCase(unittest.TestCase):
+    """
+    A test case for CoaddCheckpoint
+    """
+    def setUp(self):
+        self.checkpointDir = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.checkpointDir)
+
+    def assertCoaddsEqual(self, kaiserCoadd1, kaiserCoadd2):
+        self.assertEqual(kaiserCoadd1.getNComponents(), kaiserCoadd2.getNComponents())
+        for arr1, arr2 in zip(kaiserTestUtils.getCoaddArrays(kaiserCoadd1, True),
+            kaiserTestUtils.getCoaddArrays(kaiserCoadd2, True)):
+            isNan = numpy.isnan(arr1)
+            self.assertTrue(numpy.all(isNan == numpy.isnan(arr2)))
+            self.assertTrue(numpy.all(arr1[~isNan] == arr2[~isNan]))
+
+    def runPipeline(self, nInputs, checkpointInterval):
+        """Add the first nInputs inputs to a new coadd, checkpointing it
+        """
+        kaiserCoadd = kaiserTestUtils.makeKaiserCoadd(inFilePathSmall)
+        control = coaddKaiser.CoaddPipelineControl(2)
+        control.setCheckpointInterval(checkpointInterval)
+        coaddPipeline = coaddKaiser.CoaddPipelineD(kaiserCoadd, True, coaddKaiser.CoaddComponentControl(),
+            control)
+        coaddPipeline.setCheckpoint(coaddKaiser.CoaddCheckpoint(self.checkpointDir, TileSize))
+        for kernel in kaiserTestUtils.makeKernelList(nInputs):
+            coaddPipeline.addInput(inFilePathSmall, kernel)
+        nAdded = coaddPipeline.run()
+        return kaiserCoadd, coaddPipeline, nAdded
+
+    def testRoundTrip(self):
+        """Test that restoring a checkpoint reproduces the coadd
+        """
+        kaiserCoadd = kaiserTestUtils.makeKaiserCoadd(inFilePathSmall)
+        checkpoint = coaddKaiser.CoaddCheckpoint(self.checkpointDir, TileSize)
+        self.assertEqual(checkpoint.getNCheckpoints(), 0)
+        for i, kernel in enumerate(kaiserTestUtils.makeKernelList(NInputs)):
+            exposure = afwImage.ExposureF(inFilePathSmall)
+            kaiserCoadd.addComponent(coaddKaiser.CoaddComponentD(exposure, kernel))
+            checkpoint.addInput("input%d" % (i,))
+            checkpoint.write(kaiserCoadd)
+        self.assertEqual(checkpoint.getNCheckpoints(), NInputs)
+        # nothing has changed, so this should not write a checkpoint
+        checkpoint.write(kaiserCoadd)
+        self.assertEqual(checkpoint.getNCheckpoints(), NInputs)
+
+        checkpoint = coaddKaiser.CoaddCheckpoint(self.checkpointDir, TileSize)
+        self.assertEqual(checkpoint.getNCheckpoints(), NInputs)
+        self.assertEqual(checkpoint.getNInputs(), NInputs)
+        for i in range(NInputs):
+            self.assertEqual(checkpoint.getInput(i), "input%d" % (i,))
+        self.assertRaises(pexEx.LsstCppException, checkpoint.getInput, NInputs)
+        restoredCoadd = kaiserTestUtils.makeKaiserCoadd(inFilePathSmall)
+        checkpoint.restore(restoredCoadd)
+        self.assertCoaddsEqual(kaiserCoadd, restoredCoadd)
+        # a coadd stored in tiles may be restored from (and checkpointed as) a dense coadd
+        exposure = afwImage.ExposureF(inFilePathSmall)
+        sparseCoadd = coaddKaiser.KaiserCoadd(exposure.getWidth(), exposure.getHeight(), exposure.getWcs(),
+            0xFFFF, 3, TileSize / 2 + 1)
+        checkpoint.restore(sparseCoadd)
+        self.assertCoaddsEqual(kaiserCoadd, sparseCoadd)
+        # a coadd that already has components cannot be restored
+        self.assertRaises(pexEx.LsstCppException, checkpoint.restore, restoredCoadd)
+
+    def testTruncatedJournal(self):
+        """Test that a block cut short at the end of the journal is discarded, even in its "end" line
+        """
+        kaiserCoadd = kaiserTestUtils.makeKaiserCoadd(inFilePathSmall)
+        checkpoint = coaddKaiser.CoaddCheckpoint(self.checkpointDir, TileSize)
+        for i, kernel in enumerate(kaiserTestUtils.makeKernelList(2)):
+            exposure = afwImage.ExposureF(inFilePathSmall)
+            kaiserCoadd.addComponent(coaddKaiser.CoaddComponentD(exposure, kernel))
+            checkpoint.addInput("input%d" % (i,))
+            checkpoint.write(kaiserCoadd)
+        journalPath = os.path.join(self.checkpointDir, "journal.txt")
+        journalText = open(journalPath).read()
+        lastBlock = journalText[journalText.rindex("checkpoint 2\n"):]
+        for cutText in ("end ", "end 2"):
+            # a crash while appending checkpoint 3 could leave its "end 3" line without the newline,
+            # or cut the number short
+            partialBlock = lastBlock.replace("checkpoint 2", "checkpoint 3").replace("end 2\n", cutText)
+            with open(journalPath, "a") as journal:
+                journal.write(partialBlock)
+            checkpoint = coaddKaiser.CoaddCheckpoint(self.checkpointDir, TileSize)
+            self.assertEqual(checkpoint.getNCheckpoints(), 2)
+            self.assertEqual(open(journalPath).read(), journalText)
+
+    def testTileSize(self):
+        """Test that the tile size must match that of existing checkpoints
+        """
+        self.runPipeline(1, 0)
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.CoaddCheckpoint, self.checkpointDir, TileSize + 1)
+
+    def testResume(self):
+        """Test that a pipeline resumed from a checkpoint matches an uninterrupted pipeline
+        """
+        refCoadd = kaiserTestUtils.makeKaiserCoadd(inFilePathSmall)
+        refPipeline = coaddKaiser.CoaddPipelineD(refCoadd, True, coaddKaiser.CoaddComponentControl(),
+            coaddKaiser.CoaddPipelineControl(2))
+        for kernel in kaiserTestUtils.makeKernelList(NInputs):
+            refPipeline.addInput(inFilePathSmall, kernel)
+        refPipeline.run()
+
+        # add some inputs, as if the pipeline had stopped part way through
+        kaiserCoadd, coaddPipeline, nAdded = self.runPipeline(3, 2)
+        self.assertEqual(nAdded, 3)
+        self.assertEqual(coaddPipeline.getCheckpoint().getNInputs(), 3)
+
+        kaiserCoadd, coaddPipeline, nAdded = self.runPipeline(NInputs, 2)
+        self.assertEqual(nAdded, NInputs - 3)
+        self.assertEqual(coaddPipeline.getNGoodPixels(0), -1)
+        self.assertTrue(coaddPipeline.getNGoodPixels(NInputs - 1) > 0)
+        self.assertCoaddsEqual(refCoadd, kaiserCoadd)
+
+    def testMismatchedInputs(self):
+        """Test that inputs that do not match the checkpoint raise an exception
+        """
+        self.runPipeline(2, 0)
+        kaiserCoadd = kaiserTestUtils.makeKaiserCoadd(inFilePathSmall)
+        coaddPipeline = coaddKaiser.CoaddPipelineD(kaiserCoadd)
+        coaddPipeline.setCheckpoint(coaddKaiser.CoaddCheckpoint(self.checkpointDir, TileSize))
+        coaddPipeline.addInput(os.path.join(currDir, "otherExposure"), kaiserTestUtils.makeKernelList(1)[0])
+        self.assertRaises(pexEx.LsstCppException, coaddPipeline.run)
+
+         
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(CoaddCheckpointTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
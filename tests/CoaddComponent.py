@@ -40,6 +40,7 @@ import lsst.utils.tests as utilsTests
 import lsst.pex.logging as pexLog
 import lsst.pex.exceptions as pexEx
 import lsst.coadd.kaiser as coaddKaiser
+import lsst.afw.image.testUtils as imTestUtils
 
 Verbosity = 0 # increase to see trace
 pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
@@ -71,6 +72,154 @@ class CoaddComponentTestCase(unittest.TestCase):
         coaddComp = coaddKaiser.CoaddComponent(testExposure, nullKernel)
         #... now verify that we got the right component back
 
+    def testFloat(self):
+        """
+        Make sure a float CoaddComponent matches a double CoaddComponent to float precision
+        """
+        testExposure = afwImage.ExposureF(inFilePathSmall)
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0)
+        kernel = afwMath.AnalyticKernel(11, 11, gaussFunc)
+        coaddCompD = coaddKaiser.CoaddComponentD(testExposure, kernel)
+        coaddCompF = coaddKaiser.CoaddComponentF(testExposure, kernel)
+        self.assertEqual(coaddCompD.getSigmaSq(), coaddCompF.getSigmaSq())
+        for getImage in (
+            lambda cc: cc.getBlurredExposure().getMaskedImage().getImage(),
+            lambda cc: cc.getBlurredPsfImage(),
+        ):
+            arrD = imTestUtils.arrayFromImage(getImage(coaddCompD))
+            arrF = imTestUtils.arrayFromImage(getImage(coaddCompF))
+            isFinite = numpy.isfinite(arrD)
+            self.assertTrue(numpy.all(isFinite == numpy.isfinite(arrF)))
+            self.assertTrue(numpy.allclose(arrD[isFinite], arrF[isFinite], rtol=1.0e-5))
+
+    def testArrays(self):
+        """
+        Make sure getBlurredArrays and getBlurredPsfArray are views of the blurred exposure and PSF image
+        """
+        testExposure = afwImage.ExposureF(inFilePathSmall)
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0)
+        kernel = afwMath.AnalyticKernel(11, 11, gaussFunc)
+        coaddComp = coaddKaiser.CoaddComponentD(testExposure, kernel)
+        blurredMI = coaddComp.getBlurredExposure().getMaskedImage()
+        for arr, image in zip(coaddComp.getBlurredArrays(),
+            (blurredMI.getImage(), blurredMI.getMask(), blurredMI.getVariance())):
+            refArr = imTestUtils.arrayFromImage(image)
+            isFinite = numpy.isfinite(refArr)
+            self.assertTrue(numpy.all(arr[isFinite] == refArr[isFinite]))
+        psfArr = coaddComp.getBlurredPsfArray()
+        self.assertTrue(numpy.all(psfArr == imTestUtils.arrayFromImage(coaddComp.getBlurredPsfImage())))
+        psfArr[0, 0] = -1.0
+        self.assertEqual(coaddComp.getBlurredPsfImage().get(0, 0), -1.0)
+
+    def testStreaming(self):
+        """
+        Make sure computing a CoaddComponent in strips matches computing it all at once
+        """
+        testExposure = afwImage.ExposureF(inFilePathSmall)
+        testMI = testExposure.getMaskedImage()
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0)
+        kernel = afwMath.AnalyticKernel(11, 11, gaussFunc)
+        control = coaddKaiser.CoaddComponentControl()
+        coaddComp = coaddKaiser.CoaddComponent(testExposure, kernel, True, control)
+        blurredArr = imTestUtils.arrayFromImage(coaddComp.getBlurredExposure().getMaskedImage().getImage())
+        isFinite = numpy.isfinite(blurredArr)
+        for stripHeight in (1, 37, testMI.getHeight() + 5):
+            control.setStripHeight(stripHeight)
+            stripsMI = afwImage.MaskedImageD(testMI.getDimensions())
+            stripsMI.setXY0(testMI.getXY0())
+            source = coaddKaiser.ExposureStripSource(testExposure)
+            sink = coaddKaiser.MaskedImageStripSinkD(stripsMI)
+            stripsCoaddComp = coaddKaiser.CoaddComponent(source, kernel, sink, True, control)
+            self.assertAlmostEqual(stripsCoaddComp.getSigmaSq() / coaddComp.getSigmaSq(), 1.0, 2)
+            stripsArr = imTestUtils.arrayFromImage(stripsMI.getImage())
+            self.assertTrue(numpy.all(isFinite == numpy.isfinite(stripsArr)))
+            self.assertTrue(numpy.allclose(blurredArr[isFinite], stripsArr[isFinite]))
+
+    def testLazy(self):
+        """
+        Make sure a lazy CoaddComponent matches an eager one, and regions match the whole blurred exposure
+        """
+        testExposure = afwImage.ExposureF(inFilePathSmall)
+        testMI = testExposure.getMaskedImage()
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0)
+        kernel = afwMath.AnalyticKernel(11, 9, gaussFunc)
+        control = coaddKaiser.CoaddComponentControl()
+        coaddComp = coaddKaiser.CoaddComponent(testExposure, kernel, True, control)
+        control.setLazy(True)
+        lazyCoaddComp = coaddKaiser.CoaddComponent(testExposure, kernel, True, control)
+        self.assertTrue(lazyCoaddComp.isLazy())
+        self.assertFalse(coaddComp.isLazy())
+        self.assertEqual(lazyCoaddComp.getBBox().getWidth(), testMI.getWidth())
+        self.assertEqual(lazyCoaddComp.getBBox().getHeight(), testMI.getHeight())
+
+        blurredMI = coaddComp.getBlurredExposure().getMaskedImage()
+        blurredArr = imTestUtils.arrayFromImage(blurredMI.getImage())
+        blurredMaskArr = imTestUtils.arrayFromImage(blurredMI.getMask())
+        for x0, y0, width, height in (
+            (0, 0, testMI.getWidth(), 15),
+            (20, 31, 17, 12),
+            (22, 33, 5, 5),     # inside the previous region
+            (testMI.getWidth() - 9, testMI.getHeight() - 7, 9, 7),
+        ):
+            bbox = afwImage.BBox(afwImage.PointI(x0, y0), width, height)
+            # blurRegion computes the same pixels as getBlurredExposure(bbox) but does not save them
+            for regionExposure in (lazyCoaddComp.getBlurredExposure(bbox), lazyCoaddComp.blurRegion(bbox)):
+                self.assertTrue(regionExposure.hasWcs())
+                regionMI = regionExposure.getMaskedImage()
+                self.assertEqual(regionMI.getX0(), x0)
+                self.assertEqual(regionMI.getY0(), y0)
+                regionArr = imTestUtils.arrayFromImage(regionMI.getImage())
+                regionMaskArr = imTestUtils.arrayFromImage(regionMI.getMask())
+                expectedArr = blurredArr[x0:x0 + width, y0:y0 + height]
+                isFinite = numpy.isfinite(expectedArr)
+                self.assertTrue(numpy.all(isFinite == numpy.isfinite(regionArr)))
+                self.assertTrue(numpy.allclose(expectedArr[isFinite], regionArr[isFinite]))
+                self.assertTrue(numpy.all(blurredMaskArr[x0:x0 + width, y0:y0 + height] == regionMaskArr))
+
+        self.assertAlmostEqual(lazyCoaddComp.getSigmaSq(), coaddComp.getSigmaSq())
+        psfArr = imTestUtils.arrayFromImage(coaddComp.getBlurredPsfImage())
+        lazyPsfArr = imTestUtils.arrayFromImage(lazyCoaddComp.getBlurredPsfImage())
+        self.assertTrue(numpy.allclose(psfArr, lazyPsfArr))
+
+        badBBox = afwImage.BBox(afwImage.PointI(testMI.getWidth() - 5, 0), 10, 10)
+        self.assertRaises(pexEx.LsstCppException, lazyCoaddComp.getBlurredExposure, badBBox)
+        self.assertRaises(pexEx.LsstCppException, lazyCoaddComp.blurRegion, badBBox)
+
+    def testStats(self):
+        """
+        Make sure CoaddComponent stats are recorded, and lazy stats grow as items are computed
+        """
+        testExposure = afwImage.ExposureF(inFilePathSmall)
+        testMI = testExposure.getMaskedImage()
+        nPix = testMI.getWidth() * testMI.getHeight()
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0)
+        kernel = afwMath.AnalyticKernel(11, 9, gaussFunc)
+        control = coaddKaiser.CoaddComponentControl(coaddKaiser.DIRECT_CONVOLUTION)
+        coaddComp = coaddKaiser.CoaddComponent(testExposure, kernel, True, control)
+        stats = coaddComp.getStats()
+        self.assertEqual(stats.nMaskedPixels + stats.nUnmaskedPixels, nPix)
+        self.assertTrue(stats.nUnmaskedPixels > 0)
+        self.assertEqual(stats.kernelWidth, 11)
+        self.assertEqual(stats.kernelHeight, 9)
+        self.assertEqual(stats.convolutionMethod, coaddKaiser.DIRECT_CONVOLUTION)
+        for stageTime in (stats.sigmaSqTime, stats.blurredPsfTime, stats.blurredExposureTime):
+            self.assertTrue(stageTime >= 0)
+        self.assertTrue(stats.nBytesAllocated >= nPix * 8)
+        self.assertTrue(len(stats.toString()) > 0)
+        stats.trace("testStats", 5)
+
+        control.setLazy(True)
+        lazyCoaddComp = coaddKaiser.CoaddComponent(testExposure, kernel, True, control)
+        lazyStats = lazyCoaddComp.getStats()
+        self.assertEqual(lazyStats.nUnmaskedPixels, 0)
+        self.assertEqual(lazyStats.nBytesAllocated, 0)
+        lazyCoaddComp.getSigmaSq()
+        lazyCoaddComp.getBlurredExposure(afwImage.BBox(afwImage.PointI(0, 0), 20, 20))
+        lazyStats = lazyCoaddComp.getStats()
+        self.assertEqual(lazyStats.nUnmaskedPixels, stats.nUnmaskedPixels)
+        self.assertEqual(lazyStats.convolutionMethod, coaddKaiser.DIRECT_CONVOLUTION)
+        self.assertTrue(0 < lazyStats.nBytesAllocated < stats.nBytesAllocated)
+
          
 #-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
@@ -0,0 +1,165 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+
+"""
+Test lsst.coadd.kaiser.CoaddPipeline
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import unittest
+
+import numpy
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.afw.math as afwMath
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.coadd.kaiser.testUtils as kaiserTestUtils
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests") 
+
+InputMaskedImageNameSmall = "small_MI"
+
+currDir = os.path.abspath(os.path.dirname(__file__))
+inFilePathSmall = os.path.join(dataDir, InputMaskedImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+NInputs = 4
+
+class CoaddPipelineTestCase(unittest.TestCase):
+    """
+    A test case for CoaddPipeline
+    """
+    def runPipeline(self, nThreads, maxInFlightMemory, subtractBackground=True):
+        kaiserCoadd = kaiserTestUtils.makeKaiserCoadd(inFilePathSmall)
+        control = coaddKaiser.CoaddPipelineControl(nThreads, maxInFlightMemory)
+        control.setSubtractBackground(subtractBackground)
+        coaddPipeline = coaddKaiser.CoaddPipelineD(kaiserCoadd, True, coaddKaiser.CoaddComponentControl(),
+            control)
+        for kernel in kaiserTestUtils.makeKernelList(NInputs):
+            coaddPipeline.addInput(inFilePathSmall, kernel)
+        self.assertEqual(coaddPipeline.run(), NInputs)
+        self.assertEqual(coaddPipeline.run(), 0)
+        self.assertEqual(kaiserCoadd.getNComponents(), NInputs)
+        for i in range(NInputs):
+            self.assertTrue(coaddPipeline.getNGoodPixels(i) > 0)
+        return kaiserCoadd
+
+    def testMatchesSerial(self):
+        """Test that the pipeline matches adding the components one at a time
+        """
+        serialCoadd = kaiserTestUtils.makeKaiserCoadd(inFilePathSmall)
+        for kernel in kaiserTestUtils.makeKernelList(NInputs):
+            exposure = afwImage.ExposureF(inFilePathSmall)
+            serialCoadd.addComponent(coaddKaiser.CoaddComponentD(exposure, kernel))
+        pipelineCoadd = self.runPipeline(2, 0, False)
+        for serialArr, pipelineArr in zip(kaiserTestUtils.getCoaddArrays(serialCoadd),
+            kaiserTestUtils.getCoaddArrays(pipelineCoadd)):
+            self.assertTrue(numpy.all(serialArr == pipelineArr))
+
+    def testDeterministic(self):
+        """Test that the result does not depend on the number of threads or the memory limit
+        """
+        refArrList = kaiserTestUtils.getCoaddArrays(self.runPipeline(1, 0))
+        for nThreads, maxInFlightMemory in ((3, 0), (3, 1), (0, 2.0e9)):
+            arrList = kaiserTestUtils.getCoaddArrays(self.runPipeline(nThreads, maxInFlightMemory))
+            for refArr, arr in zip(refArrList, arrList):
+                self.assertTrue(numpy.all(refArr == arr))
+
+    def testMissingInput(self):
+        """Test that a missing input raises an exception and the inputs before it are added
+        """
+        kaiserCoadd = kaiserTestUtils.makeKaiserCoadd(inFilePathSmall)
+        coaddPipeline = coaddKaiser.CoaddPipelineF(kaiserCoadd)
+        kernelList = kaiserTestUtils.makeKernelList(NInputs)
+        coaddPipeline.addInput(inFilePathSmall, kernelList[0])
+        self.assertEqual(coaddPipeline.run(), 1)
+        coaddPipeline.addInput(os.path.join(currDir, "noSuchExposure"), kernelList[1])
+        self.assertRaises(pexEx.LsstCppException, coaddPipeline.run)
+        self.assertEqual(kaiserCoadd.getNComponents(), 1)
+        self.assertEqual(coaddPipeline.getNGoodPixels(1), -1)
+
+    def testMissingInputAfterGoodInputs(self):
+        """Test that a missing input queued after good ones in the same run adds the inputs before it
+        """
+        kaiserCoadd = kaiserTestUtils.makeKaiserCoadd(inFilePathSmall)
+        coaddPipeline = coaddKaiser.CoaddPipelineF(kaiserCoadd, True, coaddKaiser.CoaddComponentControl(),
+            coaddKaiser.CoaddPipelineControl(2))
+        kernelList = kaiserTestUtils.makeKernelList(4)
+        coaddPipeline.addInput(inFilePathSmall, kernelList[0])
+        coaddPipeline.addInput(inFilePathSmall, kernelList[1])
+        coaddPipeline.addInput(os.path.join(currDir, "noSuchExposure"), kernelList[2])
+        coaddPipeline.addInput(inFilePathSmall, kernelList[3])
+        self.assertRaises(pexEx.LsstCppException, coaddPipeline.run)
+        self.assertEqual(kaiserCoadd.getNComponents(), 2)
+        for i in range(2):
+            self.assertTrue(coaddPipeline.getNGoodPixels(i) > 0)
+        for i in range(2, 4):
+            self.assertEqual(coaddPipeline.getNGoodPixels(i), -1)
+
+    def testBuffersReleasedOnFailure(self):
+        """Test that the blurred exposure buffers of components not added are returned to the pool
+        """
+        kaiserCoadd = kaiserTestUtils.makeKaiserCoadd(inFilePathSmall)
+        coaddPipeline = coaddKaiser.CoaddPipelineF(kaiserCoadd, True, coaddKaiser.CoaddComponentControl(),
+            coaddKaiser.CoaddPipelineControl(NInputs))
+        kernelList = kaiserTestUtils.makeKernelList(NInputs)
+        # a PSF of a different size from the first cannot be added to the coadd
+        kernelList[1] = afwMath.AnalyticKernel(15, 15, afwMath.GaussianFunction2D(1.5, 2.0))
+        for kernel in kernelList:
+            coaddPipeline.addInput(inFilePathSmall, kernel)
+        self.assertRaises(pexEx.LsstCppException, coaddPipeline.run)
+        self.assertEqual(kaiserCoadd.getNComponents(), 1)
+        bufferPool = coaddPipeline.getBufferPool()
+        self.assertEqual(bufferPool.getNFree(), min(bufferPool.getMaxFree(), bufferPool.getNAllocated()))
+
+         
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(CoaddPipelineTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
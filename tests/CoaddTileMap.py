@@ -0,0 +1,133 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""
+Test lsst.coadd.kaiser.CoaddTileMap
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import unittest
+
+import numpy
+
+import lsst.afw.image as afwImage
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+Width = 100
+Height = 70
+TileSize = 32
+
+class CoaddTileMapTestCase(unittest.TestCase):
+    """
+    A test case for CoaddTileMap
+    """
+    def testTiles(self):
+        """Test the tile grid and allocation of tiles"""
+        tileMap = coaddKaiser.CoaddTileMap(Width, Height, TileSize)
+        self.assertEqual((tileMap.getNTilesX(), tileMap.getNTilesY()), (4, 3))
+        self.assertEqual(tileMap.getNPopulatedTiles(), 0)
+        lastBBox = tileMap.getTileBBox(3, 2)
+        self.assertEqual((lastBBox.getX0(), lastBBox.getY0()), (96, 64))
+        self.assertEqual((lastBBox.getWidth(), lastBBox.getHeight()), (4, 6))
+        self.assertEqual((tileMap.getTileIX(95), tileMap.getTileIY(64)), (2, 2))
+        self.assertTrue(tileMap.findTile(3, 2) is None)
+
+        tile = tileMap.getOrAddTile(3, 2)
+        self.assertEqual((tile.getIX(), tile.getIY()), (3, 2))
+        maskedImage = tile.getMaskedImage()
+        self.assertEqual((maskedImage.getWidth(), maskedImage.getHeight()), (4, 6))
+        self.assertEqual((maskedImage.getX0(), maskedImage.getY0()), (96, 64))
+        self.assertTrue(numpy.all(imTestUtils.arrayFromImage(tile.getDepthMap()) == 0))
+        tileMap.getOrAddTile(3, 2)
+        self.assertEqual(tileMap.getNPopulatedTiles(), 1)
+        self.assertEqual(tileMap.getPopulatedTile(0).getIX(), 3)
+        self.assertFalse(tileMap.findTile(3, 2) is None)
+        self.assertRaises(pexEx.LsstCppException, tileMap.getOrAddTile, 4, 0)
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.CoaddTileMap, 0, Height, TileSize)
+
+        # a tile size <= 0 gives one tile covering the coadd, allocated at once
+        denseMap = coaddKaiser.CoaddTileMap(Width, Height, 0)
+        self.assertEqual((denseMap.getNTilesX(), denseMap.getNTilesY(), denseMap.getNPopulatedTiles()), (1, 1, 1))
+        denseBBox = denseMap.getPopulatedTile(0).getBBox()
+        self.assertEqual((denseBBox.getWidth(), denseBBox.getHeight()), (Width, Height))
+
+    def testRegions(self):
+        """Test that setRegion only allocates tiles with nonzero depth and getRegion reads them back"""
+        tileMap = coaddKaiser.CoaddTileMap(Width, Height, TileSize)
+        bbox = afwImage.BBox(afwImage.PointI(10, 20), 60, 40)
+        maskedImage = afwImage.MaskedImageD(bbox.getWidth(), bbox.getHeight())
+        depthMap = afwImage.ImageU(bbox.getWidth(), bbox.getHeight())
+        for image in (maskedImage.getImage(), maskedImage.getMask(), maskedImage.getVariance(), depthMap):
+            image.set(0)
+        # write pixels that fall in tiles (1, 0) and (1, 1)
+        for x, y in ((30, 5), (40, 30)):
+            maskedImage.getImage().set(x, y, x + 0.5)
+            maskedImage.getMask().set(x, y, 0x1)
+            maskedImage.getVariance().set(x, y, y + 0.5)
+            depthMap.set(x, y, 1)
+        tileMap.setRegion(bbox, maskedImage, depthMap)
+        self.assertEqual(tileMap.getNPopulatedTiles(), 2)
+        self.assertFalse(tileMap.findTile(1, 0) is None)
+        self.assertFalse(tileMap.findTile(1, 1) is None)
+
+        outMaskedImage = afwImage.MaskedImageD(bbox.getWidth(), bbox.getHeight())
+        outDepthMap = afwImage.ImageU(bbox.getWidth(), bbox.getHeight())
+        tileMap.getRegion(bbox, outMaskedImage, outDepthMap)
+        for inImage, outImage in ((maskedImage.getImage(), outMaskedImage.getImage()),
+            (maskedImage.getMask(), outMaskedImage.getMask()),
+            (maskedImage.getVariance(), outMaskedImage.getVariance()), (depthMap, outDepthMap)):
+            self.assertTrue(numpy.all(imTestUtils.arrayFromImage(inImage) == imTestUtils.arrayFromImage(outImage)))
+
+        badBBox = afwImage.BBox(afwImage.PointI(50, 40), 60, 40)
+        self.assertRaises(pexEx.LsstCppException, tileMap.getRegion, badBBox, outMaskedImage, outDepthMap)
+        smallDepthMap = afwImage.ImageU(bbox.getWidth() - 1, bbox.getHeight())
+        self.assertRaises(pexEx.LsstCppException, tileMap.setRegion, bbox, maskedImage, smallDepthMap)
+
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(CoaddTileMapTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
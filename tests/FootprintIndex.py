@@ -0,0 +1,146 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""
+Test lsst.coadd.kaiser.FootprintIndex
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import random
+import unittest
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests") 
+
+InputMaskedImageNameSmall = "small_MI"
+
+inFilePathSmall = os.path.join(dataDir, InputMaskedImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def isEmpty(bbox):
+    """Return True if a bounding box is empty"""
+    return (bbox.getWidth() <= 0) or (bbox.getHeight() <= 0)
+
+def bboxesOverlap(bbox1, bbox2):
+    """Return True if two non-empty bounding boxes overlap"""
+    return (bbox1.getX0() <= bbox2.getX1()) and (bbox1.getX1() >= bbox2.getX0()) \
+        and (bbox1.getY0() <= bbox2.getY1()) and (bbox1.getY1() >= bbox2.getY0())
+
+class FootprintIndexTestCase(unittest.TestCase):
+    """
+    A test case for FootprintIndex
+    """
+    def setUp(self):
+        self.testExposure = afwImage.ExposureF(inFilePathSmall)
+        self.wcs = self.testExposure.getWcs()
+        self.width = self.testExposure.getWidth()
+        self.height = self.testExposure.getHeight()
+
+    def tearDown(self):
+        del self.testExposure
+        del self.wcs
+
+    def testAddExposure(self):
+        """Test that reading the header of an exposure gives the same footprint as the exposure itself"""
+        index = coaddKaiser.FootprintIndex(self.wcs, self.width * 3, self.height * 3)
+        self.assertEqual(index.addExposure(inFilePathSmall), 0)
+        bbox = afwImage.BBox(self.testExposure.getMaskedImage().getXY0(), self.width, self.height)
+        self.assertEqual(index.addFootprint(self.wcs, bbox), 1)
+        self.assertEqual(index.getNFootprints(), 2)
+        footprint = index.getFootprint(0)
+        self.assertFalse(isEmpty(footprint))
+        self.assertEqual((footprint.getX0(), footprint.getY0(), footprint.getX1(), footprint.getY1()),
+            (index.getFootprint(1).getX0(), index.getFootprint(1).getY0(),
+            index.getFootprint(1).getX1(), index.getFootprint(1).getY1()))
+        self.assertRaises(pexEx.LsstCppException, index.getFootprint, 2)
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.FootprintIndex, self.wcs, 0, self.height)
+
+    def testFindOverlapping(self):
+        """Test findOverlapping against a brute force search, with exposures scattered over the coadd"""
+        coaddWidth = self.width * 10
+        coaddHeight = self.height * 10
+        index = coaddKaiser.FootprintIndex(self.wcs, coaddWidth, coaddHeight)
+        random.seed(1)
+        nFootprints = 500
+        for i in range(nFootprints):
+            x0 = random.randint(-self.width, coaddWidth)
+            y0 = random.randint(-self.height, coaddHeight)
+            index.addFootprint(self.wcs, afwImage.BBox(afwImage.PointI(x0, y0), self.width, self.height))
+        self.assertEqual(index.getNFootprints(), nFootprints)
+        footprintList = [index.getFootprint(i) for i in range(nFootprints)]
+        self.assertTrue(True in [isEmpty(footprint) for footprint in footprintList])
+
+        patchSize = self.width * 2
+        nPatchesX = (coaddWidth + patchSize - 1) // patchSize
+        nPatchesY = (coaddHeight + patchSize - 1) // patchSize
+        nFound = 0
+        for ix in range(nPatchesX):
+            for iy in range(nPatchesY):
+                patchBBox = index.getPatchBBox(ix, iy, patchSize)
+                predIndexList = [i for i, footprint in enumerate(footprintList)
+                    if not isEmpty(footprint) and bboxesOverlap(footprint, patchBBox)]
+                indexList = list(index.findOverlapping(patchBBox))
+                self.assertEqual(indexList, predIndexList)
+                nFound += len(indexList)
+        self.assertTrue(nFound > 0)
+        self.assertEqual(list(index.findOverlapping(afwImage.BBox())), [])
+
+    def testPatchBBox(self):
+        """Test the grid of patches"""
+        index = coaddKaiser.FootprintIndex(self.wcs, 100, 70)
+        lastBBox = index.getPatchBBox(3, 2, 32)
+        self.assertEqual((lastBBox.getX0(), lastBBox.getY0()), (96, 64))
+        self.assertEqual((lastBBox.getWidth(), lastBBox.getHeight()), (4, 6))
+        self.assertRaises(pexEx.LsstCppException, index.getPatchBBox, 4, 0, 32)
+        self.assertRaises(pexEx.LsstCppException, index.getPatchBBox, 0, 0, 0)
+
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(FootprintIndexTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
@@ -0,0 +1,226 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+
+"""
+Test lsst.coadd.kaiser.KaiserCoadd
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import unittest
+
+import numpy
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.afw.math as afwMath
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests") 
+
+InputMaskedImageNameSmall = "small_MI"
+
+currDir = os.path.abspath(os.path.dirname(__file__))
+inFilePathSmall = os.path.join(dataDir, InputMaskedImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+class KaiserCoaddTestCase(unittest.TestCase):
+    """
+    A test case for KaiserCoadd
+    """
+    def makeCoaddComponent(self, pixelType="D"):
+        testExposure = afwImage.ExposureF(inFilePathSmall)
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0)
+        kernel = afwMath.AnalyticKernel(11, 11, gaussFunc)
+        return testExposure, getattr(coaddKaiser, "CoaddComponent%s" % (pixelType,))(testExposure, kernel)
+
+    def testSameWcs(self):
+        """Test that adding components with the coadd's WCS scales by 1/sigmaSq and sums
+        """
+        edgeMask = afwImage.MaskU.getPlaneBitMask("EDGE")
+        for pixelType in ("F", "D"):
+            testExposure, coaddComp = self.makeCoaddComponent(pixelType)
+            kaiserCoadd = coaddKaiser.KaiserCoadd(testExposure.getWidth(), testExposure.getHeight(),
+                testExposure.getWcs(), edgeMask)
+            sigmaSq = coaddComp.getSigmaSq()
+            blurredMI = coaddComp.getBlurredExposure().getMaskedImage()
+            blurredArr = imTestUtils.arrayFromImage(blurredMI.getImage())
+            blurredVarArr = imTestUtils.arrayFromImage(blurredMI.getVariance())
+            for nComponents in (1, 2):
+                nGood = kaiserCoadd.addComponent(coaddComp)
+                self.assertEqual(kaiserCoadd.getNComponents(), nComponents)
+                depthArr = imTestUtils.arrayFromImage(kaiserCoadd.getDepthMap())
+                isGood = depthArr > 0
+                self.assertEqual(nGood, isGood.sum())
+                self.assertTrue(numpy.all(depthArr[isGood] == nComponents))
+                self.assertTrue(numpy.all(numpy.isfinite(blurredArr[isGood])))
+                coaddMI = kaiserCoadd.getMaskedImage()
+                coaddArr = imTestUtils.arrayFromImage(coaddMI.getImage())
+                coaddVarArr = imTestUtils.arrayFromImage(coaddMI.getVariance())
+                self.assertTrue(numpy.allclose(coaddArr[isGood], blurredArr[isGood] * nComponents / sigmaSq,
+                    rtol=1.0e-5))
+                self.assertTrue(numpy.allclose(coaddVarArr[isGood],
+                    blurredVarArr[isGood] * nComponents / sigmaSq**2, rtol=1.0e-5))
+                self.assertTrue(numpy.all(coaddArr[numpy.logical_not(isGood)] == 0))
+
+                psfArr = imTestUtils.arrayFromImage(kaiserCoadd.getBlurredPsfImage())
+                blurredPsfArr = imTestUtils.arrayFromImage(coaddComp.getBlurredPsfImage())
+                self.assertTrue(numpy.allclose(psfArr, blurredPsfArr * nComponents / sigmaSq))
+
+    def testWarpTiles(self):
+        """Test that adding a component in warp tiles matches adding it in one piece, lazy or not
+        """
+        edgeMask = afwImage.MaskU.getPlaneBitMask("EDGE")
+        testExposure = afwImage.ExposureF(inFilePathSmall)
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0)
+        kernel = afwMath.AnalyticKernel(11, 11, gaussFunc)
+        refCoadd = coaddKaiser.KaiserCoadd(testExposure.getWidth(), testExposure.getHeight(),
+            testExposure.getWcs(), edgeMask)
+        self.assertEqual(refCoadd.getWarpTileSize(), 0)
+        refNGood = refCoadd.addComponent(coaddKaiser.CoaddComponentD(testExposure, kernel))
+        refArr = imTestUtils.arrayFromImage(refCoadd.getMaskedImage().getImage())
+        refDepthArr = imTestUtils.arrayFromImage(refCoadd.getDepthMap())
+        for lazy in (False, True):
+            control = coaddKaiser.CoaddComponentControl()
+            control.setLazy(lazy)
+            for warpTileSize in (1, 37, 1000):
+                kaiserCoadd = coaddKaiser.KaiserCoadd(testExposure.getWidth(), testExposure.getHeight(),
+                    testExposure.getWcs(), edgeMask)
+                kaiserCoadd.setWarpTileSize(warpTileSize)
+                coaddComp = coaddKaiser.CoaddComponentD(testExposure, kernel, True, control)
+                self.assertEqual(kaiserCoadd.addComponent(coaddComp), refNGood)
+                coaddArr = imTestUtils.arrayFromImage(kaiserCoadd.getMaskedImage().getImage())
+                depthArr = imTestUtils.arrayFromImage(kaiserCoadd.getDepthMap())
+                self.assertTrue(numpy.all(depthArr == refDepthArr))
+                self.assertTrue(numpy.allclose(coaddArr, refArr, rtol=1.0e-7, atol=1.0e-10))
+
+    def testSparse(self):
+        """Test that a coadd stored in tiles allocated on first write matches a dense coadd
+        """
+        edgeMask = afwImage.MaskU.getPlaneBitMask("EDGE")
+        testExposure, coaddComp = self.makeCoaddComponent()
+        # make the coadd larger than the exposure, so some tiles are never written
+        width = testExposure.getWidth() * 2
+        height = testExposure.getHeight() + 50
+        denseCoadd = coaddKaiser.KaiserCoadd(width, height, testExposure.getWcs(), edgeMask)
+        self.assertFalse(denseCoadd.isSparse())
+        denseNGood = denseCoadd.addComponent(coaddComp)
+        denseArrList = [imTestUtils.arrayFromImage(image) for image in (denseCoadd.getMaskedImage().getImage(),
+            denseCoadd.getMaskedImage().getVariance(), denseCoadd.getDepthMap())]
+        for coaddTileSize in (16, 37):
+            for warpTileSize in (0, 50):
+                kaiserCoadd = coaddKaiser.KaiserCoadd(width, height, testExposure.getWcs(), edgeMask, 3,
+                    coaddTileSize)
+                kaiserCoadd.setWarpTileSize(warpTileSize)
+                self.assertTrue(kaiserCoadd.isSparse())
+                tileMap = kaiserCoadd.getTileMap()
+                self.assertEqual(tileMap.getNPopulatedTiles(), 0)
+                self.assertEqual(kaiserCoadd.addComponent(coaddComp), denseNGood)
+                arrList = [imTestUtils.arrayFromImage(image) for image in (kaiserCoadd.getMaskedImage().getImage(),
+                    kaiserCoadd.getMaskedImage().getVariance(), kaiserCoadd.getDepthMap())]
+                for arr, denseArr in zip(arrList, denseArrList):
+                    self.assertTrue(numpy.allclose(arr, denseArr, rtol=1.0e-7, atol=1.0e-10))
+
+                # exactly the tiles that hold good pixels are populated
+                depthArr = denseArrList[2]
+                nPopulated = 0
+                for iy in range(tileMap.getNTilesY()):
+                    for ix in range(tileMap.getNTilesX()):
+                        bbox = tileMap.getTileBBox(ix, iy)
+                        tileDepthArr = depthArr[bbox.getX0():bbox.getX1() + 1, bbox.getY0():bbox.getY1() + 1]
+                        self.assertEqual(tileMap.findTile(ix, iy) is not None, numpy.any(tileDepthArr > 0))
+                        if numpy.any(tileDepthArr > 0):
+                            nPopulated += 1
+                self.assertEqual(tileMap.getNPopulatedTiles(), nPopulated)
+                self.assertTrue(nPopulated < tileMap.getNTilesX() * tileMap.getNTilesY())
+
+    def testErrors(self):
+        """Test that invalid components are rejected
+        """
+        testExposure, coaddComp = self.makeCoaddComponent()
+        kaiserCoadd = coaddKaiser.KaiserCoadd(testExposure.getWidth(), testExposure.getHeight(),
+            testExposure.getWcs(), 0xFFFF)
+        kaiserCoadd.addComponent(coaddComp)
+
+        # blurred PSF image of a different size
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0)
+        kernel = afwMath.AnalyticKernel(7, 7, gaussFunc)
+        smallPsfCoaddComp = coaddKaiser.CoaddComponentD(testExposure, kernel)
+        self.assertRaises(pexEx.LsstCppException, kaiserCoadd.addComponent, smallPsfCoaddComp)
+
+        # component computed in strips has no blurred exposure
+        stripsMI = afwImage.MaskedImageD(testExposure.getMaskedImage().getDimensions())
+        source = coaddKaiser.ExposureStripSource(testExposure)
+        sink = coaddKaiser.MaskedImageStripSinkD(stripsMI)
+        stripsCoaddComp = coaddKaiser.CoaddComponentD(source, kernel, sink)
+        self.assertRaises(pexEx.LsstCppException, kaiserCoadd.addComponent, stripsCoaddComp)
+        self.assertEqual(kaiserCoadd.getNComponents(), 1)
+
+    def testNoOverlap(self):
+        """Test that a component that does not overlap the coadd is not counted or added to the coadd PSF
+        """
+        testExposure, coaddComp = self.makeCoaddComponent()
+        kaiserCoadd = coaddKaiser.KaiserCoadd(testExposure.getWidth(), testExposure.getHeight(),
+            testExposure.getWcs(), 0xFFFF)
+        kaiserCoadd.addComponent(coaddComp)
+        psfArr = imTestUtils.arrayFromImage(kaiserCoadd.getBlurredPsfImage())
+
+        farMI = testExposure.getMaskedImage()
+        farMI.setXY0(afwImage.PointI(testExposure.getWidth() * 10, testExposure.getHeight() * 10))
+        farExposure = afwImage.ExposureF(farMI, testExposure.getWcs())
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0)
+        kernel = afwMath.AnalyticKernel(11, 11, gaussFunc)
+        farCoaddComp = coaddKaiser.CoaddComponentD(farExposure, kernel)
+        self.assertEqual(kaiserCoadd.addComponent(farCoaddComp), 0)
+        self.assertEqual(kaiserCoadd.getNComponents(), 1)
+        self.assertTrue(numpy.all(psfArr == imTestUtils.arrayFromImage(kaiserCoadd.getBlurredPsfImage())))
+
+         
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(KaiserCoaddTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
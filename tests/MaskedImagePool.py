@@ -0,0 +1,129 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""
+Test lsst.coadd.kaiser.MaskedImagePool
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import unittest
+
+import numpy
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.afw.math as afwMath
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests") 
+
+InputMaskedImageNameSmall = "small_MI"
+
+currDir = os.path.abspath(os.path.dirname(__file__))
+inFilePathSmall = os.path.join(dataDir, InputMaskedImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+class MaskedImagePoolTestCase(unittest.TestCase):
+    """
+    A test case for MaskedImagePool
+    """
+    def testGetRelease(self):
+        """Make sure released masked images are reused, and only up to maxFree are kept"""
+        pool = coaddKaiser.MaskedImagePoolF(2)
+        self.assertEqual(pool.getMaxFree(), 2)
+        mi1 = pool.get(20, 30)
+        mi2 = pool.get(20, 30)
+        self.assertEqual((mi1.getWidth(), mi1.getHeight()), (20, 30))
+        self.assertEqual(pool.getNAllocated(), 2)
+        mi2.setXY0(afwImage.PointI(5, 6))
+        pool.release(mi1)
+        pool.release(mi2)
+        pool.release(afwImage.MaskedImageF(10, 10))
+        self.assertEqual(pool.getNFree(), 2)
+        
+        # mi1 was discarded (the oldest), and there is no free 15x15 masked image
+        mi3 = pool.get(20, 30)
+        mi4 = pool.get(10, 10)
+        mi5 = pool.get(15, 15)
+        self.assertEqual(pool.getNReused(), 2)
+        self.assertEqual(pool.getNAllocated(), 3)
+        self.assertEqual(pool.getNFree(), 0)
+        self.assertEqual((mi3.getX0(), mi3.getY0()), (0, 0))
+        self.assertEqual((mi4.getWidth(), mi4.getHeight()), (10, 10))
+        
+        pool.release(mi3)
+        pool.clear()
+        self.assertEqual(pool.getNFree(), 0)
+        self.assertEqual(pool.getNReused(), 0)
+        self.assertRaises(pexEx.LsstCppException, pool.get, 0, 5)
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.MaskedImagePoolF, -1)
+
+    def testCoaddComponent(self):
+        """Make sure a CoaddComponent blurred into a caller-provided exposure matches one that is not"""
+        exposure = afwImage.ExposureF(inFilePathSmall)
+        kernel = afwMath.AnalyticKernel(11, 11, afwMath.GaussianFunction2D(2.0, 3.0))
+        coaddComponent = coaddKaiser.CoaddComponentD(exposure, kernel, True)
+        
+        pool = coaddKaiser.MaskedImagePoolD(1)
+        blurredMI = pool.get(exposure.getWidth(), exposure.getHeight())
+        blurredExposure = afwImage.ExposureD(blurredMI)
+        pooledCoaddComponent = coaddKaiser.CoaddComponentD(exposure, kernel, blurredExposure, True)
+        self.assertAlmostEqual(pooledCoaddComponent.getSigmaSq(), coaddComponent.getSigmaSq())
+        arr = imTestUtils.arrayFromImage(coaddComponent.getBlurredExposure().getMaskedImage().getImage())
+        pooledArr = imTestUtils.arrayFromImage(blurredMI.getImage())
+        isFinite = numpy.isfinite(arr)
+        self.assertTrue(numpy.all(isFinite == numpy.isfinite(pooledArr)))
+        self.assertTrue(numpy.all(arr[isFinite] == pooledArr[isFinite]))
+        
+        badExposure = afwImage.ExposureD(exposure.getWidth() + 1, exposure.getHeight())
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.CoaddComponentD, exposure, kernel, badExposure, True)
+
+         
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(MaskedImagePoolTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
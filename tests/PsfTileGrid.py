@@ -0,0 +1,166 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+
+"""
+Test lsst.coadd.kaiser.PsfTileGrid and convolveWithPsfTiles
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import unittest
+
+import numpy
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.afw.math as afwMath
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.coadd.kaiser.testUtils as kaiserTestUtils
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests")
+
+InputMaskedImageNameSmall = "small_MI"
+
+currDir = os.path.abspath(os.path.dirname(__file__))
+inFilePathSmall = os.path.join(dataDir, InputMaskedImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+class PsfTileGridTestCase(unittest.TestCase):
+    """
+    A test case for PsfTileGrid and convolveWithPsfTiles
+    """
+    def testGrid(self):
+        """Test the tile layout of PsfTileGrid
+        """
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0)
+        kernel = afwMath.AnalyticKernel(11, 11, gaussFunc)
+        bbox = afwImage.BBox(afwImage.PointI(10, 20), 101, 52)
+        tileGrid = coaddKaiser.PsfTileGrid(kernel, bbox, 3, 2)
+        self.assertEqual(tileGrid.getNTilesX(), 3)
+        self.assertEqual(tileGrid.getNTilesY(), 2)
+        nPix = 0
+        for iy in range(2):
+            for ix in range(3):
+                tileBBox = tileGrid.getTileBBox(ix, iy)
+                nPix += tileBBox.getWidth() * tileBBox.getHeight()
+                kImArr = imTestUtils.arrayFromImage(tileGrid.getKernelImage(ix, iy))
+                reflKImArr = imTestUtils.arrayFromImage(tileGrid.getKernelImage(ix, iy, True))
+                self.assertAlmostEqual(kImArr.sum(), 1.0)
+                self.assertTrue(numpy.allclose(kImArr[::-1, ::-1], reflKImArr))
+        self.assertEqual(nPix, 101 * 52)
+        self.assertRaises(pexEx.LsstCppException, tileGrid.getTileBBox, 3, 0)
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.PsfTileGrid, kernel, bbox, 0, 2)
+
+    def testFixedKernel(self):
+        """Test that tiles and blending have no effect for a fixed kernel
+        """
+        maskedImage = afwImage.MaskedImageF(inFilePathSmall)
+        bbox = afwImage.BBox(maskedImage.getXY0(), maskedImage.getWidth(), maskedImage.getHeight())
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0)
+        kernel = afwMath.AnalyticKernel(11, 11, gaussFunc)
+        directMI = afwImage.MaskedImageD(maskedImage.getDimensions())
+        afwMath.convolve(directMI, maskedImage, kernel, True)
+        for nTiles in ((1, 1), (3, 2)):
+            tileGrid = coaddKaiser.PsfTileGrid(kernel, bbox, nTiles[0], nTiles[1])
+            for blendTiles in (False, True):
+                for method in (coaddKaiser.DIRECT_CONVOLUTION, coaddKaiser.FFT_CONVOLUTION):
+                    tiledMI = afwImage.MaskedImageD(maskedImage.getDimensions())
+                    coaddKaiser.convolveWithPsfTiles(tiledMI, maskedImage, tileGrid, False, blendTiles, method)
+                    kaiserTestUtils.assertMaskedImagesNearlyEqual(self, directMI, tiledMI)
+
+    def testReflectedKernel(self):
+        """Test convolution with the reflected PSF
+        """
+        maskedImage = afwImage.MaskedImageF(inFilePathSmall)
+        bbox = afwImage.BBox(maskedImage.getXY0(), maskedImage.getWidth(), maskedImage.getHeight())
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0, 0.5)
+        kernel = afwMath.AnalyticKernel(11, 9, gaussFunc)
+        kImage = afwImage.ImageD(kernel.getWidth(), kernel.getHeight())
+        kernel.computeImage(kImage, True)
+        coaddKaiser.reflectImage(kImage)
+        reflKernel = afwMath.FixedKernel(kImage)
+        directMI = afwImage.MaskedImageD(maskedImage.getDimensions())
+        afwMath.convolve(directMI, maskedImage, reflKernel, False)
+
+        tileGrid = coaddKaiser.PsfTileGrid(kernel, bbox, 2, 2)
+        tiledMI = afwImage.MaskedImageD(maskedImage.getDimensions())
+        coaddKaiser.convolveWithPsfTiles(tiledMI, maskedImage, tileGrid, True)
+        kaiserTestUtils.assertMaskedImagesNearlyEqual(self, directMI, tiledMI)
+
+    def testCoaddComponent(self):
+        """Test CoaddComponent with PSF tiles and a reflected PSF
+        """
+        exposure = afwImage.ExposureF(inFilePathSmall)
+        gaussFunc = afwMath.GaussianFunction2D(2.0, 3.0)
+        kernel = afwMath.AnalyticKernel(11, 11, gaussFunc)
+        control = coaddKaiser.CoaddComponentControl()
+        control.setReflectPsf(True)
+        coaddComp = coaddKaiser.CoaddComponent(exposure, kernel, True, control)
+        self.assertEqual(coaddComp.getPsfTileGrid().getNTilesX(), 1)
+
+        # a fixed kernel is evaluated on a single tile whatever grid is requested, so it is never blended
+        control.setNPsfTiles(2, 3)
+        control.setBlendPsfTiles(True)
+        coaddComp = coaddKaiser.CoaddComponent(exposure, kernel, True, control)
+        tileGrid = coaddComp.getPsfTileGrid()
+        self.assertEqual((tileGrid.getNTilesX(), tileGrid.getNTilesY()), (1, 1))
+
+        # a spatially varying kernel uses the requested grid
+        kernelList = afwMath.KernelList()
+        for sigma in (2.0, 3.0):
+            kernelList.append(afwMath.AnalyticKernel(11, 11, afwMath.GaussianFunction2D(sigma, sigma)))
+        varyingKernel = afwMath.LinearCombinationKernel(kernelList, afwMath.PolynomialFunction2DD(1))
+        varyingKernel.setSpatialParameters(((1.0, 0.0, 0.0), (0.0, 1.0e-3, 0.0)))
+        coaddComp = coaddKaiser.CoaddComponent(exposure, varyingKernel, True, control)
+        tileGrid = coaddComp.getPsfTileGrid()
+        self.assertEqual((tileGrid.getNTilesX(), tileGrid.getNTilesY()), (2, 3))
+
+        
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(PsfTileGridTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
@@ -0,0 +1,193 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""
+Test lsst.coadd.kaiser.SigmaSqMap
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import unittest
+
+import numpy
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.afw.math as afwMath
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests") 
+
+InputMaskedImageNameSmall = "small_MI"
+
+currDir = os.path.abspath(os.path.dirname(__file__))
+inFilePathSmall = os.path.join(dataDir, InputMaskedImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def makeSigmaSqMap(maskedImage, nCellsX, nCellsY):
+    """Make an empty SigmaSqMap covering maskedImage"""
+    bbox = afwImage.BBox(maskedImage.getXY0(), maskedImage.getWidth(), maskedImage.getHeight())
+    return coaddKaiser.SigmaSqMap(bbox, nCellsX, nCellsY)
+
+class SigmaSqMapTestCase(unittest.TestCase):
+    """
+    A test case for SigmaSqMap
+    """
+    def testCellMedians(self):
+        """Make sure each cell holds the median variance of its unmasked pixels"""
+        maskedImage = afwImage.ExposureF(inFilePathSmall).getMaskedImage()
+        varArr = imTestUtils.arrayFromImage(maskedImage.getVariance())
+        maskArr = imTestUtils.arrayFromImage(maskedImage.getMask())
+        sigmaSqMap = makeSigmaSqMap(maskedImage, 3, 2)
+        self.assertRaises(pexEx.LsstCppException, sigmaSqMap.getCellSigmaSq, 0, 0)
+        sigmaSqMap.addMaskedImage(maskedImage)
+        sigmaSqMap.finish()
+        self.assertTrue(sigmaSqMap.isFinished())
+        for iy in range(sigmaSqMap.getNCellsY()):
+            for ix in range(sigmaSqMap.getNCellsX()):
+                cellBBox = sigmaSqMap.getCellBBox(ix, iy)
+                cellVarArr = varArr[cellBBox.getX0():cellBBox.getX1() + 1, cellBBox.getY0():cellBBox.getY1() + 1]
+                cellMaskArr = maskArr[cellBBox.getX0():cellBBox.getX1() + 1, cellBBox.getY0():cellBBox.getY1() + 1]
+                goodVarArr = cellVarArr[cellMaskArr == 0]
+                self.assertEqual(sigmaSqMap.getCellCount(ix, iy), len(goodVarArr))
+                if len(goodVarArr) > 0:
+                    self.assertAlmostEqual(sigmaSqMap.getCellSigmaSq(ix, iy) / numpy.median(goodVarArr), 1.0, 2)
+
+                # at a cell center the interpolated value is that of the cell
+                xInd = (ix + 0.5) * maskedImage.getWidth() / float(sigmaSqMap.getNCellsX()) - 0.5
+                yInd = (iy + 0.5) * maskedImage.getHeight() / float(sigmaSqMap.getNCellsY()) - 0.5
+                self.assertAlmostEqual(sigmaSqMap.getSigmaSq(xInd, yInd), sigmaSqMap.getCellSigmaSq(ix, iy))
+        self.assertRaises(pexEx.LsstCppException, sigmaSqMap.addMaskedImage, maskedImage)
+        self.assertRaises(pexEx.LsstCppException, sigmaSqMap.getCellBBox, 3, 0)
+
+    def testStripsAndThreads(self):
+        """Make sure adding strips, or using several threads, gives the same result as adding all at once"""
+        maskedImage = afwImage.ExposureF(inFilePathSmall).getMaskedImage()
+        sigmaSqMap = makeSigmaSqMap(maskedImage, 2, 4)
+        sigmaSqMap.addMaskedImage(maskedImage)
+        sigmaSqMap.finish()
+        threadsMap = makeSigmaSqMap(maskedImage, 2, 4)
+        threadsMap.addMaskedImage(maskedImage, 3)
+        threadsMap.finish()
+        stripsMap = makeSigmaSqMap(maskedImage, 2, 4)
+        stripHeight = 17
+        for y0 in range(0, maskedImage.getHeight(), stripHeight):
+            height = min(stripHeight, maskedImage.getHeight() - y0)
+            strip = afwImage.MaskedImageF(maskedImage,
+                afwImage.BBox(afwImage.PointI(0, y0), maskedImage.getWidth(), height), False)
+            stripsMap.addMaskedImage(strip)
+        stripsMap.finish()
+        # strips that each hold a whole row of cells give exactly the same result
+        cellRowsMap = makeSigmaSqMap(maskedImage, 2, 4)
+        for iy in range(cellRowsMap.getNCellsY()):
+            cellBBox = cellRowsMap.getCellBBox(0, iy)
+            strip = afwImage.MaskedImageF(maskedImage,
+                afwImage.BBox(afwImage.PointI(0, cellBBox.getY0()), maskedImage.getWidth(), cellBBox.getHeight()),
+                False)
+            cellRowsMap.addMaskedImage(strip)
+        cellRowsMap.finish()
+        for iy in range(sigmaSqMap.getNCellsY()):
+            for ix in range(sigmaSqMap.getNCellsX()):
+                self.assertEqual(threadsMap.getCellSigmaSq(ix, iy), sigmaSqMap.getCellSigmaSq(ix, iy))
+                self.assertEqual(cellRowsMap.getCellSigmaSq(ix, iy), sigmaSqMap.getCellSigmaSq(ix, iy))
+                self.assertAlmostEqual(stripsMap.getCellSigmaSq(ix, iy) / sigmaSqMap.getCellSigmaSq(ix, iy), 1.0, 2)
+
+        badBBox = afwImage.BBox(afwImage.PointI(0, 0), maskedImage.getWidth() - 1, maskedImage.getHeight())
+        badMap = coaddKaiser.SigmaSqMap(badBBox, 1, 1)
+        self.assertRaises(pexEx.LsstCppException, badMap.addMaskedImage, maskedImage)
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.SigmaSqMap, badBBox, 0, 1)
+
+    def testGradient(self):
+        """Make sure a cell whose variance has a gradient gets its own median
+
+        The first rows of the cell are not representative of the whole cell.
+        """
+        width, height = 200, 100
+        maskedImage = afwImage.MaskedImageF(width, height)
+        maskedImage.getImage().set(0)
+        maskedImage.getMask().set(0)
+        variance = maskedImage.getVariance()
+        for y in range(height):
+            for x in range(width):
+                if x < width // 2:
+                    variance.set(x, y, 1.0 + 0.1 * y)
+                else:
+                    variance.set(x, y, 3.0 + 0.001 * ((7 * x + 13 * y) % 17))
+        sigmaSqMap = makeSigmaSqMap(maskedImage, 2, 1)
+        sigmaSqMap.addMaskedImage(maskedImage)
+        sigmaSqMap.finish()
+        varArr = imTestUtils.arrayFromImage(variance)
+        for ix in range(2):
+            cellBBox = sigmaSqMap.getCellBBox(ix, 0)
+            cellVarArr = varArr[cellBBox.getX0():cellBBox.getX1() + 1, cellBBox.getY0():cellBBox.getY1() + 1]
+            # the median of the gradient cell lies between two of its values, which differ by 0.1
+            self.assertTrue(abs(sigmaSqMap.getCellSigmaSq(ix, 0) - numpy.median(cellVarArr)) < 0.1)
+
+    def testCoaddComponent(self):
+        """Make sure CoaddComponent computes a SigmaSqMap when asked, including in lazy mode"""
+        exposure = afwImage.ExposureF(inFilePathSmall)
+        kernel = afwMath.AnalyticKernel(11, 11, afwMath.GaussianFunction2D(2.0, 3.0))
+        control = coaddKaiser.CoaddComponentControl()
+        coaddComponent = coaddKaiser.CoaddComponentD(exposure, kernel, True, control)
+        self.assertTrue(coaddComponent.getSigmaSqMap() is None)
+        
+        control.setNSigmaSqCells(3, 2)
+        coaddComponent = coaddKaiser.CoaddComponentD(exposure, kernel, True, control)
+        sigmaSqMap = coaddComponent.getSigmaSqMap()
+        self.assertEqual((sigmaSqMap.getNCellsX(), sigmaSqMap.getNCellsY()), (3, 2))
+        
+        control.setLazy(True)
+        lazyCoaddComponent = coaddKaiser.CoaddComponentD(exposure, kernel, True, control)
+        lazySigmaSqMap = lazyCoaddComponent.getSigmaSqMap()
+        for iy in range(sigmaSqMap.getNCellsY()):
+            for ix in range(sigmaSqMap.getNCellsX()):
+                self.assertEqual(lazySigmaSqMap.getCellSigmaSq(ix, iy), sigmaSqMap.getCellSigmaSq(ix, iy))
+
+         
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(SigmaSqMapTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
@@ -0,0 +1,129 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+
+"""
+Test lsst.coadd.kaiser.dilateMask
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import unittest
+
+import numpy
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.afw.math as afwMath
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests") 
+
+InputMaskedImageNameSmall = "small_MI"
+
+currDir = os.path.abspath(os.path.dirname(__file__))
+inFilePathSmall = os.path.join(dataDir, InputMaskedImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+class DilateMaskTestCase(unittest.TestCase):
+    """
+    A test case for dilateMask
+    """
+    def testMatchesConvolve(self):
+        """Test that dilateMask matches the mask computed by afwMath.convolve, except at the edges
+        """
+        maskedImage = afwImage.MaskedImageF(inFilePathSmall)
+        for kWidth, kHeight, ctrX, ctrY in ((1, 1, 0, 0), (5, 5, 2, 2), (21, 21, 10, 10), (9, 4, 1, 3)):
+            gaussFunc = afwMath.GaussianFunction2D(kWidth / 4.0, kHeight / 4.0)
+            kernel = afwMath.AnalyticKernel(kWidth, kHeight, gaussFunc)
+            kernel.setCtrX(ctrX)
+            kernel.setCtrY(ctrY)
+            directMI = afwImage.MaskedImageD(maskedImage.getDimensions())
+            afwMath.convolve(directMI, maskedImage, kernel, True)
+
+            outMask = afwImage.MaskU(maskedImage.getDimensions())
+            coaddKaiser.dilateMask(outMask, maskedImage.getMask(), kWidth, kHeight, ctrX, ctrY)
+            directArr = imTestUtils.arrayFromImage(directMI.getMask())
+            outArr = imTestUtils.arrayFromImage(outMask)
+            # arrays are indexed [x, y]
+            goodSlice = (slice(ctrX, outMask.getWidth() + 1 + ctrX - kWidth),
+                slice(ctrY, outMask.getHeight() + 1 + ctrY - kHeight))
+            self.assertTrue(numpy.all(directArr[goodSlice] == outArr[goodSlice]),
+                "mask mismatch for %d x %d kernel" % (kWidth, kHeight))
+            # edge pixels are not changed
+            edgeArr = outArr.copy()
+            edgeArr[goodSlice] = 0
+            self.assertTrue(numpy.all(edgeArr == 0))
+
+    def testUniform(self):
+        """Test uniform masks, whose tiles are filled without being dilated
+        """
+        for maskVal in (0, 0x5):
+            inMask = afwImage.MaskU(150, 130)
+            inMask.set(maskVal)
+            outMask = afwImage.MaskU(150, 130)
+            coaddKaiser.dilateMask(outMask, inMask, 11, 11, 5, 5)
+            outArr = imTestUtils.arrayFromImage(outMask)
+            self.assertTrue(numpy.all(outArr[5:-5, 5:-5] == maskVal))
+
+    def testBadArguments(self):
+        """Test that invalid arguments are rejected
+        """
+        inMask = afwImage.MaskU(20, 20)
+        outMask = afwImage.MaskU(20, 20)
+        wrongSizeMask = afwImage.MaskU(20, 21)
+        self.assertRaises(pexEx.LsstCppException,
+            coaddKaiser.dilateMask, wrongSizeMask, inMask, 3, 3, 1, 1)
+        self.assertRaises(pexEx.LsstCppException,
+            coaddKaiser.dilateMask, outMask, inMask, 0, 3, 0, 1)
+        self.assertRaises(pexEx.LsstCppException,
+            coaddKaiser.dilateMask, outMask, inMask, 3, 3, 3, 1)
+
+
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(DilateMaskTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
@@ -0,0 +1,137 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""
+Test lsst.coadd.kaiser.fftConvolve, separableConvolve and convolveMaskedImage
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import unittest
+
+import numpy
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.afw.math as afwMath
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.coadd.kaiser.testUtils as kaiserTestUtils
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests")
+
+InputMaskedImageNameSmall = "small_MI"
+
+currDir = os.path.abspath(os.path.dirname(__file__))
+inFilePathSmall = os.path.join(dataDir, InputMaskedImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+class FftConvolveTestCase(unittest.TestCase):
+    """
+    A test case for fftConvolve
+    """
+    def testMatchesDirect(self):
+        """Test that fftConvolve matches afwMath.convolve for a fixed kernel
+        """
+        maskedImage = afwImage.MaskedImageF(inFilePathSmall)
+        for kSize in (5, 21):
+            gaussFunc = afwMath.GaussianFunction2D(kSize / 5.0, kSize / 4.0)
+            kernel = afwMath.AnalyticKernel(kSize, kSize, gaussFunc)
+            for doNormalize in (False, True):
+                directMI = afwImage.MaskedImageD(maskedImage.getDimensions())
+                afwMath.convolve(directMI, maskedImage, kernel, doNormalize)
+                # use a small FFT size to exercise tiling
+                for fftSize in (0, 64):
+                    fftMI = afwImage.MaskedImageD(maskedImage.getDimensions())
+                    coaddKaiser.fftConvolve(fftMI, maskedImage, kernel, doNormalize, fftSize)
+                    kaiserTestUtils.assertMaskedImagesNearlyEqual(self, directMI, fftMI)
+
+    def testSeparable(self):
+        """Test that separableConvolve matches afwMath.convolve for Gaussian and double Gaussian kernels
+        """
+        maskedImage = afwImage.MaskedImageF(inFilePathSmall)
+        for kFunc in (
+            afwMath.GaussianFunction2D(2.0, 3.0),
+            afwMath.DoubleGaussianFunction2D(2.0, 4.0, 0.1),
+        ):
+            kernel = afwMath.AnalyticKernel(19, 19, kFunc)
+            for doNormalize in (False, True):
+                directMI = afwImage.MaskedImageD(maskedImage.getDimensions())
+                afwMath.convolve(directMI, maskedImage, kernel, doNormalize)
+                separableMI = afwImage.MaskedImageD(maskedImage.getDimensions())
+                coaddKaiser.separableConvolve(separableMI, maskedImage, kernel, doNormalize)
+                kaiserTestUtils.assertMaskedImagesNearlyEqual(self, directMI, separableMI)
+            self.assertEqual(coaddKaiser.chooseConvolutionMethod(4096, 4096, kernel),
+                coaddKaiser.SEPARABLE_CONVOLUTION)
+
+        # a rotated elliptical Gaussian is not a sum of a few separable terms
+        kernel = afwMath.AnalyticKernel(19, 19, afwMath.GaussianFunction2D(2.0, 4.0, 0.5))
+        separableMI = afwImage.MaskedImageD(maskedImage.getDimensions())
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.separableConvolve,
+            separableMI, maskedImage, kernel, True)
+        self.assertNotEqual(coaddKaiser.chooseConvolutionMethod(4096, 4096, kernel),
+            coaddKaiser.SEPARABLE_CONVOLUTION)
+
+    def testMethods(self):
+        """Test convolveMaskedImage method selection
+        """
+        maskedImage = afwImage.MaskedImageF(inFilePathSmall)
+        gaussFunc = afwMath.GaussianFunction2D(4.0, 4.0)
+        kernel = afwMath.AnalyticKernel(21, 21, gaussFunc)
+        self.assertEqual(coaddKaiser.chooseConvolutionMethod(4096, 4096, kernel), coaddKaiser.SEPARABLE_CONVOLUTION)
+        for method in (coaddKaiser.DIRECT_CONVOLUTION, coaddKaiser.FFT_CONVOLUTION,
+            coaddKaiser.SEPARABLE_CONVOLUTION):
+            outMI = afwImage.MaskedImageD(maskedImage.getDimensions())
+            methodUsed = coaddKaiser.convolveMaskedImage(outMI, maskedImage, kernel, True, method)
+            self.assertEqual(methodUsed, method)
+        outMI = afwImage.MaskedImageD(maskedImage.getDimensions())
+        methodUsed = coaddKaiser.convolveMaskedImage(outMI, maskedImage, kernel, True)
+        self.assertNotEqual(methodUsed, coaddKaiser.AUTO_CONVOLUTION)
+
+
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(FftConvolveTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
@@ -52,9 +52,11 @@ if not dataDir:
     raise RuntimeError("Must set up afwdata to run these tests") 
 
 InputImageNameSmall = "small_MI_img.fits"
+InputMaskedImageNameSmall = "small_MI"
 
 currDir = os.path.abspath(os.path.dirname(__file__))
 inFilePathSmallImage = os.path.join(dataDir, InputImageNameSmall)
+inFilePathSmallMaskedImage = os.path.join(dataDir, InputMaskedImageNameSmall)
 #-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
 def refMedian(inArr):
@@ -97,6 +99,63 @@ class medianBinApproxTestCase(unittest.TestCase):
         image = afwImage.ImageF(inFilePathSmallImage)
         for nBins in (10, 100, 1000):
             self._testOneImage(image, nBins)
+
+    def testMaskedImage(self):
+        """Test median of the unmasked pixels of the variance plane of a small masked image
+        """
+        maskedImage = afwImage.MaskedImageF(inFilePathSmallMaskedImage)
+        variance = maskedImage.getVariance()
+        mask = maskedImage.getMask()
+        varArr = imTestUtils.arrayFromImage(variance)
+        maskArr = imTestUtils.arrayFromImage(mask)
+        for badMask in (0xFFFF, mask.getPlaneBitMask("EDGE")):
+            goodArr = varArr[(maskArr & badMask) == 0]
+            refMed = refMedian(goodArr)
+            maxErr = goodArr.std() / 1000.0
+            med = coaddKaiser.medianBinapproxMaskedImage(variance, mask, badMask, 1000)
+            if abs(med - refMed) > maxErr:
+                self.fail("Computed median error too large for badMask=0x%x" % (badMask,))
+        med = coaddKaiser.medianBinapproxMaskedImage(variance, mask, 0, 1000)
+        self.assertEqual(med, coaddKaiser.medianBinapproxImage(variance, 1000))
+
+    def testArray(self):
+        """Test medianBinapproxArray on numpy arrays and views, with and without a mask
+        """
+        maskedImage = afwImage.MaskedImageF(inFilePathSmallMaskedImage)
+        varArr = imTestUtils.arrayFromImage(maskedImage.getVariance())
+        maskArr = imTestUtils.arrayFromImage(maskedImage.getMask()).astype(numpy.uint16)
+        nBins = 1000
+        for dtype in (numpy.float32, numpy.float64):
+            arr = varArr.astype(dtype)
+            for view in (arr, arr.transpose(), arr[::3, 1:-1], arr[::-1, 5], arr[4:20].reshape(-1)):
+                med = coaddKaiser.medianBinapproxArray(view, nBins=nBins)
+                if abs(med - refMedian(view)) > view.std() / float(nBins):
+                    self.fail("Computed median error too large for view of shape %s" % (view.shape,))
+            badMask = maskedImage.getMask().getPlaneBitMask("EDGE")
+            med = coaddKaiser.medianBinapproxArray(arr[:, ::2], maskArr[:, ::2], badMask, nBins)
+            goodArr = arr[:, ::2][(maskArr[:, ::2] & badMask) == 0]
+            if abs(med - refMedian(goodArr)) > goodArr.std() / float(nBins):
+                self.fail("Computed median error too large for masked array")
+        self.assertRaises(TypeError, coaddKaiser.medianBinapproxArray, varArr.astype(numpy.int32))
+        self.assertRaises(ValueError, coaddKaiser.medianBinapproxArray, varArr, maskArr[1:])
+        # the entry points that take a raw address are not public
+        for name in ("medianBinapproxBufferF", "medianBinapproxMaskedBufferD", "getPixelAddress"):
+            self.assertFalse(hasattr(coaddKaiser, name))
+
+    def testImageToArray(self):
+        """Test that imageToArray gives a view of an image (or subimage) that shares its pixels
+        """
+        image = afwImage.ImageF(inFilePathSmallImage)
+        subImage = afwImage.ImageF(image, afwImage.BBox(afwImage.PointI(3, 4), 20, 10), False)
+        for im in (image, subImage):
+            arr = coaddKaiser.imageToArray(im)
+            self.assertEqual(arr.shape, (im.getWidth(), im.getHeight()))
+            self.assertTrue(numpy.all(arr == imTestUtils.arrayFromImage(im)))
+            med = coaddKaiser.medianBinapproxArray(arr)
+            self.assertAlmostEqual(med, coaddKaiser.medianBinapproxImage(im), 3)
+        arr = coaddKaiser.imageToArray(subImage)
+        arr[1, 2] = -5.0
+        self.assertEqual(image.get(4, 6), -5.0)
     
         
 
@@ -0,0 +1,165 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+
+"""
+Test lsst.coadd.kaiser.medianBinapproxStack
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import unittest
+
+import numpy
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.pex.exceptions as pexEx
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests") 
+
+InputMaskedImageNameSmall = "small_MI"
+
+currDir = os.path.abspath(os.path.dirname(__file__))
+inFilePathSmallMaskedImage = os.path.join(dataDir, InputMaskedImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+NImages = 7
+NBins = 100
+
+def makeStack(maskedImage, imageClass):
+    """Make a stack of noisy copies of a masked image, with a different mask for each copy
+    
+    @return (imageList, maskList) as swig vectors, and the stack as a 3-d numpy array
+    """
+    numpy.random.seed(0)
+    imArr = imTestUtils.arrayFromImage(maskedImage.getImage())
+    imageList = getattr(coaddKaiser, "Image%sPtrVector" % (imageClass.__name__[-1],))()
+    maskList = coaddKaiser.MaskPtrVector()
+    stackArr = []
+    for i in range(NImages):
+        noisyArr = imArr + numpy.random.normal(0.0, 10.0, imArr.shape)
+        image = imTestUtils.imageFromArray(noisyArr, imageClass)
+        imageList.append(image)
+        stackArr.append(imTestUtils.arrayFromImage(image))
+        mask = afwImage.MaskU(maskedImage.getDimensions())
+        mask.set(0)
+        # mask a different band of rows in each image
+        for y in range(i * 5, (i * 5) + 10):
+            for x in range(mask.getWidth()):
+                mask.set(x, y, 1)
+        maskList.append(mask)
+    return imageList, maskList, numpy.array(stackArr)
+
+class MedianBinapproxStackTestCase(unittest.TestCase):
+    """
+    A test case for medianBinapproxStack
+    """
+    def testMedian(self):
+        """Test the median against the numpy median of the unmasked values of each pixel
+        """
+        maskedImage = afwImage.MaskedImageF(inFilePathSmallMaskedImage)
+        for imageClass in (afwImage.ImageF, afwImage.ImageD):
+            imageList, maskList, stackArr = makeStack(maskedImage, imageClass)
+            medianImage = imageClass(maskedImage.getDimensions())
+            coaddKaiser.medianBinapproxStack(medianImage, imageList, maskList, 1, NBins)
+            medArr = imTestUtils.arrayFromImage(medianImage)
+            maskArr = numpy.array([imTestUtils.arrayFromImage(mask) for mask in maskList])
+            for x in range(0, medianImage.getWidth(), 7):
+                for y in range(medianImage.getHeight()):
+                    goodValues = stackArr[:, x, y][maskArr[:, x, y] == 0]
+                    maxErr = goodValues.std() / NBins + 1.0e-5 * abs(goodValues).max()
+                    if abs(medArr[x, y] - numpy.median(goodValues)) > maxErr:
+                        self.fail("median of pixel %d, %d is %s; expected %s" % \
+                            (x, y, medArr[x, y], numpy.median(goodValues)))
+
+            # with no masks every value is used
+            coaddKaiser.medianBinapproxStack(medianImage, imageList, coaddKaiser.MaskPtrVector(), 1, NBins)
+            medArr = imTestUtils.arrayFromImage(medianImage)
+            refArr = numpy.median(stackArr, 0)
+            maxErrArr = stackArr.std(0) / NBins + 1.0e-5 * numpy.abs(stackArr).max(0)
+            self.assertTrue(numpy.all(numpy.abs(medArr - refArr) <= maxErrArr))
+
+    def testRowBlocks(self):
+        """Test that computing the median one block of rows at a time gives the same answer
+        """
+        maskedImage = afwImage.MaskedImageF(inFilePathSmallMaskedImage)
+        imageList, maskList, stackArr = makeStack(maskedImage, afwImage.ImageF)
+        width, height = maskedImage.getDimensions()
+        medianImage = afwImage.ImageF(width, height)
+        coaddKaiser.medianBinapproxStack(medianImage, imageList, maskList, 1, NBins)
+
+        blockMedianImage = afwImage.ImageF(width, height)
+        blockHeight = 13
+        for y0 in range(0, height, blockHeight):
+            bbox = afwImage.BBox(afwImage.PointI(0, y0), width, min(blockHeight, height - y0))
+            blockImageList = coaddKaiser.ImageFPtrVector()
+            blockMaskList = coaddKaiser.MaskPtrVector()
+            for image, mask in zip(imageList, maskList):
+                blockImageList.append(afwImage.ImageF(image, bbox))
+                blockMaskList.append(afwImage.MaskU(mask, bbox))
+            coaddKaiser.medianBinapproxStack(afwImage.ImageF(blockMedianImage, bbox),
+                blockImageList, blockMaskList, 1, NBins)
+        self.assertTrue(numpy.all(imTestUtils.arrayFromImage(medianImage) == \
+            imTestUtils.arrayFromImage(blockMedianImage)))
+
+    def testErrors(self):
+        """Test that mismatched inputs are rejected
+        """
+        maskedImage = afwImage.MaskedImageF(inFilePathSmallMaskedImage)
+        imageList, maskList, stackArr = makeStack(maskedImage, afwImage.ImageF)
+        width, height = maskedImage.getDimensions()
+        wrongSizeImage = afwImage.ImageF(width + 1, height)
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.medianBinapproxStack,
+            wrongSizeImage, imageList, maskList, 1, NBins)
+        maskList.pop()
+        self.assertRaises(pexEx.LsstCppException, coaddKaiser.medianBinapproxStack,
+            afwImage.ImageF(width, height), imageList, maskList, 1, NBins)
+
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(MedianBinapproxStackTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())
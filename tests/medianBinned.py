@@ -0,0 +1,130 @@
+#!/usr/bin/env python
+
+# 
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+# 
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the LSST License Statement and 
+# the GNU General Public License along with this program.  If not, 
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+
+"""
+Test lsst.coadd.kaiser.medianBinnedImage
+"""
+
+import os
+import math
+import pdb # we may want to say pdb.set_trace()
+import unittest
+
+import numpy
+
+import eups
+import lsst.afw.image as afwImage
+import lsst.utils.tests as utilsTests
+import lsst.pex.logging as pexLog
+import lsst.coadd.kaiser as coaddKaiser
+import lsst.afw.image.testUtils as imTestUtils
+
+Verbosity = 0 # increase to see trace
+pexLog.Trace_setVerbosity("lsst.coadd.kaiser", Verbosity)
+
+dataDir = eups.productDir("afwdata")
+if not dataDir:
+    raise RuntimeError("Must set up afwdata to run these tests") 
+
+InputImageNameSmall = "small_MI_img.fits"
+
+currDir = os.path.abspath(os.path.dirname(__file__))
+inFilePathSmallImage = os.path.join(dataDir, InputImageNameSmall)
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def refMedian(inArr):
+    """Compute the median of an array of any shape, in the precision of the array
+    """
+    linArr = numpy.sort(inArr.flatten())
+    nPts = linArr.size
+    ctrInd = (nPts-1)//2
+    if nPts % 2 == 0:
+        return linArr.dtype.type((float(linArr[ctrInd]) + float(linArr[ctrInd+1])) / 2.0)
+    return linArr[ctrInd]
+
+class MedianBinnedTestCase(unittest.TestCase):
+    """
+    A test case for medianBinnedImage
+    """
+    def testBinapprox(self):
+        """Test that BINAPPROX matches medianBinapproxImage
+        """
+        image = afwImage.ImageF(inFilePathSmallImage)
+        stdDev = imTestUtils.arrayFromImage(image).std()
+        for nBins in (10, 100, 1000):
+            control = coaddKaiser.MedianBinnedControl(coaddKaiser.BINAPPROX, nBins)
+            med = coaddKaiser.medianBinnedImage(image, control)
+            oldMed = coaddKaiser.medianBinapproxImage(image, nBins)
+            self.assertTrue(abs(med - oldMed) <= stdDev * 1.0e-5)
+
+    def testBinmedian(self):
+        """Test that BINMEDIAN is exact, for odd and even numbers of pixels
+        """
+        image = afwImage.ImageF(inFilePathSmallImage)
+        for width in (image.getWidth(), image.getWidth() - 1):
+            bbox = afwImage.BBox(afwImage.PointI(0, 0), width, image.getHeight())
+            subImage = afwImage.ImageF(image, bbox)
+            refMed = refMedian(imTestUtils.arrayFromImage(subImage))
+            for nBins in (10, 1000):
+                control = coaddKaiser.MedianBinnedControl(coaddKaiser.BINMEDIAN, nBins)
+                self.assertEqual(coaddKaiser.medianBinnedImage(subImage, control), refMed)
+            subImageD = afwImage.ImageD(subImage, True)
+            control = coaddKaiser.MedianBinnedControl(coaddKaiser.BINMEDIAN)
+            self.assertAlmostEqual(coaddKaiser.medianBinnedImage(subImageD, control), refMed, 5)
+
+    def testThreads(self):
+        """Test that the result does not depend on the number of threads
+
+        BINAPPROX may differ by roundoff because the moments are summed in a different order.
+        """
+        image = afwImage.ImageF(inFilePathSmallImage)
+        stdDev = imTestUtils.arrayFromImage(image).std()
+        for algorithm in (coaddKaiser.BINAPPROX, coaddKaiser.BINMEDIAN):
+            control = coaddKaiser.MedianBinnedControl(algorithm)
+            med = coaddKaiser.medianBinnedImage(image, control)
+            for nThreads in (0, 4):
+                control.setNThreads(nThreads)
+                threadedMed = coaddKaiser.medianBinnedImage(image, control)
+                if algorithm == coaddKaiser.BINMEDIAN:
+                    self.assertEqual(threadedMed, med)
+                else:
+                    self.assertTrue(abs(threadedMed - med) <= stdDev * 1.0e-3)
+
+#-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+def suite():
+    """
+    Returns a suite containing all the test cases in this module.
+    """
+    utilsTests.init()
+
+    suites = []
+    suites += unittest.makeSuite(MedianBinnedTestCase)
+    suites += unittest.makeSuite(utilsTests.MemoryTestCase)
+
+    return unittest.TestSuite(suites)
+
+if __name__ == "__main__":
+    utilsTests.run(suite())